@@ -14,6 +14,14 @@ GLFWwindow* window;
 #include <glm/gtc/matrix_transform.hpp>
 using namespace glm;
 #include "common.hpp"
+#include "objloader.hpp"
+#include "vboindexer.hpp"
+#include "meshcache.hpp"
+#include "quantize.hpp"
+#include "meshlets.hpp"
+#include "meshsimplify.hpp"
+#include "texturestream.hpp"
+#include "shaderreload.hpp"
 #include "controls.hpp"
 
 
@@ -83,41 +91,109 @@ int main( void )
 	// Load the texture using any two methods
 	//GLuint Texture = loadBMP_custom("uvtemplate.bmp");
 	//GLuint Texture = loadBMP("uvtemplate.bmp");
-	GLuint Texture = loadDDS("uvmap.DDS");
+	//GLuint Texture = loadDDS("uvmap.DDS");
+	// ... or in the background : the render loop starts at once and the
+	// texture shows up, smallest mipmaps first, as it comes in.
+	TextureStreamer streamer;
+	streamer.start();
+	GLuint Texture = streamer.load("uvmap.DDS");
 	
 	// Get a handle for our "myTextureSampler" uniform
 	GLuint TextureID  = glGetUniformLocation(programID, "myTextureSampler");
 
-	// Read our .obj file
-	std::vector<glm::vec3> vertices;
-	std::vector<glm::vec2> uvs;
-	std::vector<glm::vec3> normals;
-	bool res = loadOBJ("suzanne.obj", vertices, uvs, normals);
+	// Read our .obj file, as one vertex per distinct (v, vt, vn) plus indices.
+	// The first run writes suzanne.obj.mesh ; later runs just map it.
+	CachedMesh mesh;
+	bool res = loadOBJCached("suzanne.obj", mesh);
+	if (!res) {
+		glfwTerminate();
+		return -1;
+	}
+	GLenum indexType = mesh.indexSize == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
 
-	GLuint vertexbuffer;
+	// Either one buffer of 16-byte QuantizedVertex, which the vertex shader
+	// decodes, or the three float buffers (32 bytes per vertex). Both are in
+	// the cache.
+	const bool useQuantizedVertices = true;
+	GLuint vertexbuffer, uvbuffer = 0, normalbuffer = 0;
 	glGenBuffers(1, &vertexbuffer);
 	glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer);
-	glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(glm::vec3), &vertices[0], GL_STATIC_DRAW);
+	if (useQuantizedVertices) {
+		glBufferData(GL_ARRAY_BUFFER, mesh.vertexCount * sizeof(QuantizedVertex), mesh.quantized, GL_STATIC_DRAW);
+	} else {
+		glBufferData(GL_ARRAY_BUFFER, mesh.vertexCount * sizeof(glm::vec3), mesh.vertices, GL_STATIC_DRAW);
+
+		glGenBuffers(1, &uvbuffer);
+		glBindBuffer(GL_ARRAY_BUFFER, uvbuffer);
+		glBufferData(GL_ARRAY_BUFFER, mesh.vertexCount * sizeof(glm::vec2), mesh.uvs, GL_STATIC_DRAW);
 
-	GLuint uvbuffer;
-	glGenBuffers(1, &uvbuffer);
-	glBindBuffer(GL_ARRAY_BUFFER, uvbuffer);
-	glBufferData(GL_ARRAY_BUFFER, uvs.size() * sizeof(glm::vec2), &uvs[0], GL_STATIC_DRAW);
+		glGenBuffers(1, &normalbuffer);
+		glBindBuffer(GL_ARRAY_BUFFER, normalbuffer);
+		glBufferData(GL_ARRAY_BUFFER, mesh.vertexCount * sizeof(glm::vec3), mesh.normals, GL_STATIC_DRAW);
+	}
 
-  GLuint normalbuffer;
-  glGenBuffers(1, &normalbuffer);
-  glBindBuffer(GL_ARRAY_BUFFER, normalbuffer);
-  glBufferData(GL_ARRAY_BUFFER, normals.size() * sizeof(glm::vec3), &normals[0], GL_STATIC_DRAW);
+	// Generate a buffer for the indices as well
+	GLuint elementbuffer;
+	glGenBuffers(1, &elementbuffer);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementbuffer);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, mesh.indexCount * mesh.indexSize, mesh.indices, GL_STATIC_DRAW);
+
+	// The levels of detail the cache holds, and the meshlets of each, culled
+	// on the CPU every frame ; only the index ranges of the visible ones are
+	// drawn.
+	std::vector<MeshLOD> lods(mesh.lods, mesh.lods + mesh.lodCount);
+	std::vector<std::vector<Meshlet> > meshlets(lods.size());
+	for (size_t l = 0; l < lods.size(); l++) {
+		if (mesh.indexSize == 2)
+			buildMeshlets((const unsigned short *)mesh.indices + lods[l].firstIndex, lods[l].indexCount, mesh.vertices, mesh.vertexCount, meshlets[l]);
+		else
+			buildMeshlets((const unsigned int *)mesh.indices + lods[l].firstIndex, lods[l].indexCount, mesh.vertices, mesh.vertexCount, meshlets[l]);
+		for (size_t m = 0; m < meshlets[l].size(); m++) meshlets[l][m].firstIndex += lods[l].firstIndex;
+	}
+	glm::vec3 meshCenter = (mesh.boundsMin + mesh.boundsMax) * 0.5f;
+	float meshRadius = glm::length(mesh.boundsMax - mesh.boundsMin) * 0.5f;
+	unsigned int indexSize = mesh.indexSize;
+	std::vector<GLsizei> meshletCounts;
+	std::vector<const void *> meshletOffsets;
+
+	// OpenGL has its own copy now
+	closeMeshCache(mesh);
 
 	GLuint LightID = glGetUniformLocation(programID, "LightPosition_worldspace");
 
-  // Use our shader
-  glUseProgram(programID);
+	// Build the program again when its shaders are saved, and look the
+	// uniforms up again in the new one
+	ShaderReloader shaders;
+	size_t standardShading = shaders.watch(&programID, "StandardShading.vertexshader", "StandardShading.fragmentshader");
+	shaders.uniform(standardShading, "MVP", &MatrixID);
+	shaders.uniform(standardShading, "V", &ViewMatrixID);
+	shaders.uniform(standardShading, "M", &ModelMatrixID);
+	shaders.uniform(standardShading, "myTextureSampler", &TextureID);
+	shaders.uniform(standardShading, "LightPosition_worldspace", &LightID);
+	bool newProgram = true;
 
 	glClearColor(0.0f, 0.0f, 0.4f, 0.0f);
 
 	do{
 
+		// Upload what the streaming threads have read since the last frame
+		streamer.update();
+
+		// Swap in the program if its shaders were saved since the last frame
+		if (shaders.update()) newProgram = true;
+		if (newProgram) {
+			// Use our shader
+			glUseProgram(programID);
+
+			// Tell the vertex shader how the vertices are stored
+			glUniform1i(glGetUniformLocation(programID, "QuantizedVertices"), useQuantizedVertices);
+			if (useQuantizedVertices) {
+				glUniform3f(glGetUniformLocation(programID, "PositionOffset"), mesh.positionOffset.x, mesh.positionOffset.y, mesh.positionOffset.z);
+				glUniform3f(glGetUniformLocation(programID, "PositionScale"), mesh.positionScale.x, mesh.positionScale.y, mesh.positionScale.z);
+			}
+			newProgram = false;
+		}
+
 		// Clear the screen
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
     computeMatricesFromInputs();
@@ -141,43 +217,65 @@ int main( void )
 		// Set our "myTextureSampler" sampler to user Texture Unit 0
 		glUniform1i(TextureID, 0);
 
-		// 1rst attribute buffer : vertices
-		glEnableVertexAttribArray(0);
-		glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer);
-		glVertexAttribPointer(
-			0,                  // attribute. No particular reason for 0, but must match the layout in the shader.
-			3,                  // size
-			GL_FLOAT,           // type
-			GL_FALSE,           // normalized?
-			0,                  // stride
-			(void*)0            // array buffer offset
-		);
-
-		// 2nd attribute buffer : UVs
-		glEnableVertexAttribArray(1);
-		glBindBuffer(GL_ARRAY_BUFFER, uvbuffer);
-		glVertexAttribPointer(
-			1,                                // attribute. No particular reason for 1, but must match the layout in the shader.
-			2,                                // size : U+V => 2
-			GL_FLOAT,                         // type
-			GL_FALSE,                         // normalized?
-			0,                                // stride
-			(void*)0                          // array buffer offset
-		);
-
-    glEnableVertexAttribArray(2);
-		glBindBuffer(GL_ARRAY_BUFFER, normalbuffer);
-    glVertexAttribPointer(
-      2,
-      3,
-      GL_FLOAT,
-      GL_FALSE,
-      0,
-      (void*)0
-    );
-
-		// Draw the triangle !
-		glDrawArrays(GL_TRIANGLES, 0, vertices.size());
+		if (useQuantizedVertices) {
+			// All three attributes from the one interleaved buffer
+			glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer);
+			glEnableVertexAttribArray(0);
+			glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_FALSE, sizeof(QuantizedVertex), (void*)offsetof(QuantizedVertex, position));
+			glEnableVertexAttribArray(1);
+			glVertexAttribPointer(1, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(QuantizedVertex), (void*)offsetof(QuantizedVertex, uv));
+			glEnableVertexAttribArray(2);
+			glVertexAttribPointer(2, 2, GL_SHORT, GL_TRUE, sizeof(QuantizedVertex), (void*)offsetof(QuantizedVertex, normal));
+		} else {
+			// 1rst attribute buffer : vertices
+			glEnableVertexAttribArray(0);
+			glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer);
+			glVertexAttribPointer(
+				0,                  // attribute. No particular reason for 0, but must match the layout in the shader.
+				3,                  // size
+				GL_FLOAT,           // type
+				GL_FALSE,           // normalized?
+				0,                  // stride
+				(void*)0            // array buffer offset
+			);
+
+			// 2nd attribute buffer : UVs
+			glEnableVertexAttribArray(1);
+			glBindBuffer(GL_ARRAY_BUFFER, uvbuffer);
+			glVertexAttribPointer(
+				1,                                // attribute. No particular reason for 1, but must match the layout in the shader.
+				2,                                // size : U+V => 2
+				GL_FLOAT,                         // type
+				GL_FALSE,                         // normalized?
+				0,                                // stride
+				(void*)0                          // array buffer offset
+			);
+
+			glEnableVertexAttribArray(2);
+			glBindBuffer(GL_ARRAY_BUFFER, normalbuffer);
+			glVertexAttribPointer(
+				2,
+				3,
+				GL_FLOAT,
+				GL_FALSE,
+				0,
+				(void*)0
+			);
+		}
+
+		// Index buffer
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementbuffer);
+
+		// The coarsest level that is off by less than a pixel from here. The
+		// model matrix is the identity, so the camera is already in model
+		// space.
+		float distance = glm::length(position - meshCenter) - meshRadius;
+		size_t lod = selectLOD(&lods[0], lods.size(), proj, distance, (float)height);
+
+		// Draw the triangles of the meshlets that may be seen !
+		size_t visible = cullMeshlets(meshlets[lod], MVP, position, indexSize, meshletCounts, meshletOffsets);
+		if (visible > 0)
+			glMultiDrawElements(GL_TRIANGLES, &meshletCounts[0], indexType, &meshletOffsets[0], (GLsizei)visible);
 
 		glDisableVertexAttribArray(0);
 		glDisableVertexAttribArray(1);
@@ -185,17 +283,23 @@ int main( void )
 
 		// Swap buffers
 		glfwSwapBuffers(window);
+		shaders.presented();
 		glfwPollEvents();
 
 	} // Check if the ESC key was pressed or the window was closed
 	while( glfwGetKey(window, GLFW_KEY_ESCAPE ) != GLFW_PRESS &&
 		   glfwWindowShouldClose(window) == 0 );
 
+	streamer.stop();
+	shaders.stop();
+
 	// Cleanup VBO and shader
 	glDeleteBuffers(1, &vertexbuffer);
 	glDeleteBuffers(1, &uvbuffer);
+	glDeleteBuffers(1, &normalbuffer);
+	glDeleteBuffers(1, &elementbuffer);
 	glDeleteProgram(programID);
-	glDeleteTextures(1, &TextureID);
+	glDeleteTextures(1, &Texture);
 	glDeleteVertexArrays(1, &VertexArrayID);
 
 	// Close OpenGL window and terminate GLFW
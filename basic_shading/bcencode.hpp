@@ -0,0 +1,409 @@
+#ifndef BCENCODE_HPP
+#define BCENCODE_HPP
+
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include "threads.hpp"
+#include "bcdecode.hpp"
+
+// Compression of RGBA8 pixels to BC1 (DXT1) and BC3 (DXT5), fast rather
+// than best : a range fit, as squish calls it. The colours of a block are
+// fitted with a line along their principal axis (the covariance matrix by
+// power iteration), the endpoints are where the pixels' extent along it
+// ends, and each pixel takes the palette entry its projection rounds to.
+// BC3 alpha is the same in one dimension, from the lowest to the highest
+// alpha. Blocks are always in four colour mode : no BC1 punch-through.
+//
+// The SSE2 version works on the 16 pixels of a block as channel vectors
+// and does the sums, the projections and the index selection there ; the
+// scalar version does the same arithmetic, so both give the same blocks.
+
+// Encodes a row of `count` blocks from 4 rows of 4 * `count` pixels,
+// `stride` bytes apart.
+typedef void (*BCEncodeRow)(GLenum format, const unsigned char * pixels, size_t stride, unsigned int count, unsigned char * blocks);
+
+inline bool bcEncodable(GLenum format) {
+	return bcDecodable(format) && bcAlphaKind(format) != 2;
+}
+
+// What the fit needs of a block, exact in integers.
+struct BCBlockSums {
+	int r, g, b;
+	int rr, gg, bb, rg, rb, gb;
+};
+
+// 256 times the covariance matrix of the colours of a block, exact, and
+// the column to start the power iteration from : that of the largest
+// variance, which is never at right angles to the axis.
+inline int bcBlockCovariance(const BCBlockSums & s, float c[3][3]) {
+	c[0][0] = (float)(16 * s.rr - s.r * s.r);
+	c[1][1] = (float)(16 * s.gg - s.g * s.g);
+	c[2][2] = (float)(16 * s.bb - s.b * s.b);
+	c[0][1] = c[1][0] = (float)(16 * s.rg - s.r * s.g);
+	c[0][2] = c[2][0] = (float)(16 * s.rb - s.r * s.b);
+	c[1][2] = c[2][1] = (float)(16 * s.gb - s.g * s.b);
+	int k = c[1][1] > c[0][0] ? 1 : 0;
+	if (c[2][2] > c[k][k]) k = 2;
+	return k;
+}
+
+// `v` to unit length, or (1, 1, 1) / sqrt(3) if it is zero : all the
+// colours of the block are the same.
+inline void bcNormalizeAxis(const float v[3], float axis[3]) {
+	float length = sqrtf(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+	if (length == 0.0f) {
+		axis[0] = axis[1] = axis[2] = 0.57735027f;
+		return;
+	}
+	for (int j = 0; j < 3; j++) axis[j] = v[j] / length;
+}
+
+#define BC_AXIS_ITERATIONS 4
+
+// Unit principal axis of the colours of a block.
+inline void bcBlockAxis(const BCBlockSums & s, float axis[3]) {
+	float c[3][3];
+	int k = bcBlockCovariance(s, c);
+	float v[3] = { c[0][k], c[1][k], c[2][k] };
+	for (int i = 0; i < BC_AXIS_ITERATIONS; i++) {
+		float w[3];
+		for (int j = 0; j < 3; j++) w[j] = c[j][0] * v[0] + c[j][1] * v[1] + c[j][2] * v[2];
+		float m = fabsf(w[0]);
+		if (fabsf(w[1]) > m) m = fabsf(w[1]);
+		if (fabsf(w[2]) > m) m = fabsf(w[2]);
+		if (m == 0.0f) break;
+		m = 1.0f / m;
+		for (int j = 0; j < 3; j++) v[j] = w[j] * m;
+	}
+	bcNormalizeAxis(v, axis);
+}
+
+inline unsigned int bcQuantize(float value, float levels) {
+	if (value < 0.0f) value = 0.0f;
+	if (value > 255.0f) value = 255.0f;
+	return (unsigned int)(value * (levels / 255.0f) + 0.5f);
+}
+
+// The 565 endpoints of a block whose pixels project between `low` and
+// `high` on `axis`, c0 > c1 unless they are equal.
+inline void bcColorEndpoints(const BCBlockSums & s, const float axis[3], float low, float high, unsigned int & c0, unsigned int & c1) {
+	float mean[3] = { s.r / 16.0f, s.g / 16.0f, s.b / 16.0f };
+	float centre = mean[0] * axis[0] + mean[1] * axis[1] + mean[2] * axis[2];
+	unsigned int ends[2];
+	for (int e = 0; e < 2; e++) {
+		float t = (e ? low : high) - centre;
+		ends[e] = bcQuantize(mean[0] + axis[0] * t, 31.0f) << 11 | bcQuantize(mean[1] + axis[1] * t, 63.0f) << 5 | bcQuantize(mean[2] + axis[2] * t, 31.0f);
+	}
+	c0 = ends[0] > ends[1] ? ends[0] : ends[1];
+	c1 = ends[0] > ends[1] ? ends[1] : ends[0];
+}
+
+// A 565 colour as the decoder expands it.
+inline void bcExpand565(unsigned int c, int rgb[3]) {
+	rgb[0] = (c >> 8 & 0xf8) | (c >> 13);
+	rgb[1] = (c >> 3 & 0xfc) | (c >> 9 & 0x3);
+	rgb[2] = (c << 3 & 0xf8) | (c >> 2 & 0x7);
+}
+
+inline void bcStoreColor(unsigned char * block, unsigned int c0, unsigned int c1, uint32_t bits) {
+	block[0] = (unsigned char)c0; block[1] = (unsigned char)(c0 >> 8);
+	block[2] = (unsigned char)c1; block[3] = (unsigned char)(c1 >> 8);
+	block[4] = (unsigned char)bits; block[5] = (unsigned char)(bits >> 8);
+	block[6] = (unsigned char)(bits >> 16); block[7] = (unsigned char)(bits >> 24);
+}
+
+inline void bcStoreAlpha(unsigned char * block, unsigned int a0, unsigned int a1, uint64_t bits) {
+	block[0] = (unsigned char)a0;
+	block[1] = (unsigned char)a1;
+	for (int i = 0; i < 6; i++) block[2 + i] = (unsigned char)(bits >> (8 * i));
+}
+
+void bcEncodeRowScalar(GLenum format, const unsigned char * pixels, size_t stride, unsigned int count, unsigned char * blocks) {
+	bool alpha = bcAlphaKind(format) == 3;
+	for (unsigned int b = 0; b < count; b++, blocks += alpha ? 16 : 8) {
+		int p[16][4];
+		for (int i = 0; i < 16; i++)
+			for (int c = 0; c < 4; c++) p[i][c] = pixels[(i >> 2) * stride + 16 * b + 4 * (i & 3) + c];
+
+		if (alpha) {
+			int low = 255, high = 0;
+			for (int i = 0; i < 16; i++) {
+				if (p[i][3] < low) low = p[i][3];
+				if (p[i][3] > high) high = p[i][3];
+			}
+			uint64_t bits = 0;
+			if (high > low) {
+				// Steps down from the highest ; step 0 is index 0, step 7
+				// index 1, step s index s + 1.
+				float scale = 7.0f / (float)(high - low);
+				for (int i = 0; i < 16; i++) {
+					int step = (int)((float)(high - p[i][3]) * scale + 0.5f);
+					int code = step == 0 ? 0 : step == 7 ? 1 : step + 1;
+					bits |= (uint64_t)code << (3 * i);
+				}
+			}
+			bcStoreAlpha(blocks, high, low, bits);
+		}
+
+		BCBlockSums s;
+		memset(&s, 0, sizeof s);
+		for (int i = 0; i < 16; i++) {
+			s.r += p[i][0]; s.g += p[i][1]; s.b += p[i][2];
+			s.rr += p[i][0] * p[i][0]; s.gg += p[i][1] * p[i][1]; s.bb += p[i][2] * p[i][2];
+			s.rg += p[i][0] * p[i][1]; s.rb += p[i][0] * p[i][2]; s.gb += p[i][1] * p[i][2];
+		}
+		float axis[3];
+		bcBlockAxis(s, axis);
+		float low = 0.0f, high = 0.0f;
+		for (int i = 0; i < 16; i++) {
+			float t = (float)p[i][0] * axis[0] + (float)p[i][1] * axis[1] + (float)p[i][2] * axis[2];
+			if (i == 0 || t < low) low = t;
+			if (i == 0 || t > high) high = t;
+		}
+		unsigned int c0, c1;
+		bcColorEndpoints(s, axis, low, high, c0, c1);
+
+		uint32_t bits = 0;
+		int e0[3], e1[3];
+		bcExpand565(c0, e0);
+		bcExpand565(c1, e1);
+		int d[3] = { e1[0] - e0[0], e1[1] - e0[1], e1[2] - e0[2] };
+		int dd = d[0] * d[0] + d[1] * d[1] + d[2] * d[2];
+		if (c0 != c1 && dd > 0) {
+			// Thirds of the way from c0 to c1 ; third 0 is index 0, third
+			// 3 index 1, third t index t + 1.
+			float scale = 3.0f / (float)dd;
+			for (int i = 0; i < 16; i++) {
+				int dot = (p[i][0] - e0[0]) * d[0] + (p[i][1] - e0[1]) * d[1] + (p[i][2] - e0[2]) * d[2];
+				float t = (float)dot * scale + 0.5f;
+				if (t < 0.0f) t = 0.0f;
+				if (t > 3.0f) t = 3.0f;
+				int third = (int)t;
+				int code = third == 0 ? 0 : third == 3 ? 1 : third + 1;
+				bits |= (uint32_t)code << (2 * i);
+			}
+		}
+		bcStoreColor(alpha ? blocks + 8 : blocks, c0, c1, bits);
+	}
+}
+
+#ifdef BC_DECODE_X86
+__attribute__((target("sse2")))
+inline int bcSum32(__m128i v) {
+	v = _mm_add_epi32(v, _mm_shuffle_epi32(v, 0x4e));
+	v = _mm_add_epi32(v, _mm_shuffle_epi32(v, 0xb1));
+	return _mm_cvtsi128_si32(v);
+}
+
+__attribute__((target("sse2")))
+void bcEncodeRowSSE2(GLenum format, const unsigned char * pixels, size_t stride, unsigned int count, unsigned char * blocks) {
+	bool alpha = bcAlphaKind(format) == 3;
+	const __m128i byte = _mm_set1_epi32(0xff), ones = _mm_set1_epi16(1), one = _mm_set1_epi32(1), zero = _mm_setzero_si128();
+	const __m128 half = _mm_set1_ps(0.5f);
+	for (unsigned int b = 0; b < count; b++, blocks += alpha ? 16 : 8) {
+		// Row y of the block, and its channels as 32-bit lanes.
+		__m128i p[4], r[4], g[4], bl[4];
+		for (int y = 0; y < 4; y++) {
+			p[y] = _mm_loadu_si128((const __m128i *)(pixels + y * stride + 16 * b));
+			r[y] = _mm_and_si128(p[y], byte);
+			g[y] = _mm_and_si128(_mm_srli_epi32(p[y], 8), byte);
+			bl[y] = _mm_and_si128(_mm_srli_epi32(p[y], 16), byte);
+		}
+
+		if (alpha) {
+			__m128i lo = _mm_min_epu8(_mm_min_epu8(p[0], p[1]), _mm_min_epu8(p[2], p[3]));
+			__m128i hi = _mm_max_epu8(_mm_max_epu8(p[0], p[1]), _mm_max_epu8(p[2], p[3]));
+			lo = _mm_min_epu8(lo, _mm_shuffle_epi32(lo, 0x4e));
+			lo = _mm_min_epu8(lo, _mm_shuffle_epi32(lo, 0xb1));
+			hi = _mm_max_epu8(hi, _mm_shuffle_epi32(hi, 0x4e));
+			hi = _mm_max_epu8(hi, _mm_shuffle_epi32(hi, 0xb1));
+			int low = (int)((uint32_t)_mm_cvtsi128_si32(lo) >> 24), high = (int)((uint32_t)_mm_cvtsi128_si32(hi) >> 24);
+			uint64_t bits = 0;
+			if (high > low) {
+				__m128 scale = _mm_set1_ps(7.0f / (float)(high - low));
+				__m128i top = _mm_set1_epi32(high), seven = _mm_set1_epi32(7), minusSeven = _mm_set1_epi32(-7);
+				int codes[16];
+				for (int y = 0; y < 4; y++) {
+					__m128 down = _mm_cvtepi32_ps(_mm_sub_epi32(top, _mm_srli_epi32(p[y], 24)));
+					__m128i step = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(down, scale), half));
+					// step + 1, less 1 for step 0 and 7 for step 7.
+					__m128i code = _mm_add_epi32(_mm_add_epi32(step, one),
+						_mm_add_epi32(_mm_cmpeq_epi32(step, zero), _mm_and_si128(_mm_cmpeq_epi32(step, seven), minusSeven)));
+					_mm_storeu_si128((__m128i *)(codes + 4 * y), code);
+				}
+				for (int i = 0; i < 16; i++) bits |= (uint64_t)codes[i] << (3 * i);
+			}
+			bcStoreAlpha(blocks, high, low, bits);
+		}
+
+		// Two rows to a register, as 16-bit lanes : products of two
+		// channels and their pairwise sums fit madd.
+		__m128i r16[2] = { _mm_packs_epi32(r[0], r[1]), _mm_packs_epi32(r[2], r[3]) };
+		__m128i g16[2] = { _mm_packs_epi32(g[0], g[1]), _mm_packs_epi32(g[2], g[3]) };
+		__m128i b16[2] = { _mm_packs_epi32(bl[0], bl[1]), _mm_packs_epi32(bl[2], bl[3]) };
+		BCBlockSums s;
+		s.r = bcSum32(_mm_add_epi32(_mm_madd_epi16(r16[0], ones), _mm_madd_epi16(r16[1], ones)));
+		s.g = bcSum32(_mm_add_epi32(_mm_madd_epi16(g16[0], ones), _mm_madd_epi16(g16[1], ones)));
+		s.b = bcSum32(_mm_add_epi32(_mm_madd_epi16(b16[0], ones), _mm_madd_epi16(b16[1], ones)));
+		s.rr = bcSum32(_mm_add_epi32(_mm_madd_epi16(r16[0], r16[0]), _mm_madd_epi16(r16[1], r16[1])));
+		s.gg = bcSum32(_mm_add_epi32(_mm_madd_epi16(g16[0], g16[0]), _mm_madd_epi16(g16[1], g16[1])));
+		s.bb = bcSum32(_mm_add_epi32(_mm_madd_epi16(b16[0], b16[0]), _mm_madd_epi16(b16[1], b16[1])));
+		s.rg = bcSum32(_mm_add_epi32(_mm_madd_epi16(r16[0], g16[0]), _mm_madd_epi16(r16[1], g16[1])));
+		s.rb = bcSum32(_mm_add_epi32(_mm_madd_epi16(r16[0], b16[0]), _mm_madd_epi16(r16[1], b16[1])));
+		s.gb = bcSum32(_mm_add_epi32(_mm_madd_epi16(g16[0], b16[0]), _mm_madd_epi16(g16[1], b16[1])));
+		float axis[3];
+		bcBlockAxis(s, axis);
+
+		__m128 ax = _mm_set1_ps(axis[0]), ay = _mm_set1_ps(axis[1]), az = _mm_set1_ps(axis[2]);
+		__m128 lo, hi;
+		for (int y = 0; y < 4; y++) {
+			__m128 t = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(r[y]), ax), _mm_mul_ps(_mm_cvtepi32_ps(g[y]), ay)), _mm_mul_ps(_mm_cvtepi32_ps(bl[y]), az));
+			lo = y ? _mm_min_ps(lo, t) : t;
+			hi = y ? _mm_max_ps(hi, t) : t;
+		}
+		lo = _mm_min_ps(lo, _mm_shuffle_ps(lo, lo, 0x4e));
+		lo = _mm_min_ps(lo, _mm_shuffle_ps(lo, lo, 0xb1));
+		hi = _mm_max_ps(hi, _mm_shuffle_ps(hi, hi, 0x4e));
+		hi = _mm_max_ps(hi, _mm_shuffle_ps(hi, hi, 0xb1));
+		unsigned int c0, c1;
+		bcColorEndpoints(s, axis, _mm_cvtss_f32(lo), _mm_cvtss_f32(hi), c0, c1);
+
+		uint32_t bits = 0;
+		int e0[3], e1[3];
+		bcExpand565(c0, e0);
+		bcExpand565(c1, e1);
+		int d[3] = { e1[0] - e0[0], e1[1] - e0[1], e1[2] - e0[2] };
+		int dd = d[0] * d[0] + d[1] * d[1] + d[2] * d[2];
+		if (c0 != c1 && dd > 0) {
+			__m128 scale = _mm_set1_ps(3.0f / (float)dd), three = _mm_set1_ps(3.0f), none = _mm_setzero_ps();
+			__m128i dRG = _mm_set1_epi32((int)((unsigned int)d[1] << 16 | (d[0] & 0xffff))), dB = _mm_set1_epi32(d[2] & 0xffff);
+			__m128i er = _mm_set1_epi16((short)e0[0]), eg = _mm_set1_epi16((short)e0[1]), eb = _mm_set1_epi16((short)e0[2]);
+			__m128i threeI = _mm_set1_epi32(3), minusThree = _mm_set1_epi32(-3);
+			int codes[16];
+			for (int k = 0; k < 2; k++) {
+				__m128i dr = _mm_sub_epi16(r16[k], er), dg = _mm_sub_epi16(g16[k], eg), db = _mm_sub_epi16(b16[k], eb);
+				for (int h = 0; h < 2; h++) {
+					__m128i rg = h ? _mm_unpackhi_epi16(dr, dg) : _mm_unpacklo_epi16(dr, dg);
+					__m128i bz = h ? _mm_unpackhi_epi16(db, zero) : _mm_unpacklo_epi16(db, zero);
+					__m128i dot = _mm_add_epi32(_mm_madd_epi16(rg, dRG), _mm_madd_epi16(bz, dB));
+					__m128 t = _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(dot), scale), half);
+					__m128i third = _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(t, none), three));
+					// third + 1, less 1 for third 0 and 3 for third 3.
+					__m128i code = _mm_add_epi32(_mm_add_epi32(third, one),
+						_mm_add_epi32(_mm_cmpeq_epi32(third, zero), _mm_and_si128(_mm_cmpeq_epi32(third, threeI), minusThree)));
+					_mm_storeu_si128((__m128i *)(codes + 8 * k + 4 * h), code);
+				}
+			}
+			for (int i = 0; i < 16; i++) bits |= (uint32_t)codes[i] << (2 * i);
+		}
+		bcStoreColor(alpha ? blocks + 8 : blocks, c0, c1, bits);
+	}
+}
+#endif
+
+// The fastest version this machine runs.
+inline BCEncodeRow bcBestEncoder() {
+#ifdef BC_DECODE_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("sse2")) return bcEncodeRowSSE2;
+#endif
+	return bcEncodeRowScalar;
+}
+
+// `width` * `height` RGBA8 pixels, rows one after the other, and where
+// their blocks go.
+struct BCEncodeSurface {
+	const unsigned char * pixels;
+	unsigned int width, height;
+	unsigned char * blocks;
+};
+
+// A thread's share : block rows [firstRow, endRow) counting across all the
+// surfaces.
+struct BCEncodeChunk {
+	GLenum format;
+	const BCEncodeSurface * surfaces;
+	size_t surfaceCount;
+	uint64_t firstRow, endRow;
+	BCEncodeRow encode;
+};
+
+int bcEncodeChunk(void * arg) {
+	const BCEncodeChunk & chunk = *(const BCEncodeChunk *)arg;
+	size_t blockBytes = bcAlphaKind(chunk.format) ? 16 : 8;
+	std::vector<unsigned char> scratch;
+	uint64_t row = 0;
+	for (size_t s = 0; s < chunk.surfaceCount && row < chunk.endRow; s++) {
+		const BCEncodeSurface & surface = chunk.surfaces[s];
+		unsigned int blocksX = (surface.width + 3) / 4, blocksY = (surface.height + 3) / 4;
+		size_t stride = (size_t)surface.width * 4;
+		for (unsigned int by = 0; by < blocksY; by++, row++) {
+			if (row < chunk.firstRow) continue;
+			if (row >= chunk.endRow) break;
+			const unsigned char * in = surface.pixels + (size_t)by * 4 * stride;
+			unsigned char * out = surface.blocks + (size_t)by * blocksX * blockBytes;
+			if (surface.width % 4 == 0 && surface.height - by * 4 >= 4) {
+				chunk.encode(chunk.format, in, stride, blocksX, out);
+				continue;
+			}
+			// Blocks hanging over the edge : the last row and column are
+			// repeated to fill them.
+			size_t scratchStride = (size_t)blocksX * 16;
+			scratch.resize(scratchStride * 4);
+			for (unsigned int y = 0; y < 4; y++) {
+				unsigned int sy = by * 4 + y < surface.height ? by * 4 + y : surface.height - 1;
+				const unsigned char * src = surface.pixels + sy * stride;
+				unsigned char * dst = &scratch[y * scratchStride];
+				memcpy(dst, src, stride);
+				for (unsigned int x = surface.width; x < blocksX * 4; x++) memcpy(dst + 4 * x, src + stride - 4, 4);
+			}
+			chunk.encode(chunk.format, &scratch[0], scratchStride, blocksX, out);
+		}
+	}
+	return 0;
+}
+
+// Encodes `count` surfaces (a whole mipmap chain, say) to `format`, BC1 or
+// BC3, on `threads` threads (0 : one per core), each taking a run of
+// block rows. `encode` picks a version, the fastest by default.
+void bcEncodeSurfaces(GLenum format, const BCEncodeSurface * surfaces, size_t count, unsigned int threads = 0, BCEncodeRow encode = NULL) {
+	if (!encode) encode = bcBestEncoder();
+	uint64_t totalRows = 0, totalBlocks = 0;
+	for (size_t s = 0; s < count; s++) {
+		totalRows += (surfaces[s].height + 3) / 4;
+		totalBlocks += (uint64_t)((surfaces[s].width + 3) / 4) * ((surfaces[s].height + 3) / 4);
+	}
+	if (threads == 0) threads = defaultThreadCount();
+	// Not worth a thread under a thousand blocks, nor more threads than rows.
+	if (totalBlocks / threads < 1024) threads = (unsigned int)(totalBlocks / 1024) + 1;
+	if (threads > totalRows) threads = totalRows > 0 ? (unsigned int)totalRows : 1;
+
+	// The rows of the chain's small levels are short : split by blocks,
+	// rounded to whole rows.
+	std::vector<uint64_t> bounds(threads + 1, totalRows);
+	bounds[0] = 0;
+	uint64_t row = 0, block = 0;
+	unsigned int next = 1;
+	for (size_t s = 0; s < count && next < threads; s++) {
+		unsigned int blocksX = (surfaces[s].width + 3) / 4, blocksY = (surfaces[s].height + 3) / 4;
+		for (unsigned int by = 0; by < blocksY && next < threads; by++) {
+			while (next < threads && block >= totalBlocks * next / threads) bounds[next++] = row;
+			row++;
+			block += blocksX;
+		}
+	}
+
+	std::vector<BCEncodeChunk> chunks(threads);
+	for (unsigned int i = 0; i < threads; i++) {
+		BCEncodeChunk chunk = { format, surfaces, count, bounds[i], bounds[i + 1], encode };
+		chunks[i] = chunk;
+	}
+	runChunks(chunks, bcEncodeChunk);
+}
+
+#endif
@@ -1,2 +1,2 @@
 #!/usr/bin sh
-g++ basic_shading.cpp -o basic_shading -L/usr/local/lib -I/usr/local/include -I/Local/Users/john/Documents/c/ogl/ -lglew -framework OpenGL -lglfw3
+g++ basic_shading.cpp /Local/Users/john/Documents/c/ogl/deps/tinycthread.c -o basic_shading -L/usr/local/lib -I/usr/local/include -I/Local/Users/john/Documents/c/ogl/ -lglew -framework OpenGL -lglfw3
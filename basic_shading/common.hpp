@@ -8,156 +8,160 @@ using namespace std;
 
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 #include <GL/glew.h>
-GLuint LoadShaders(const char * vertex_file_path,const char * fragment_file_path){
-
-  // Create the shaders
-  GLuint VertexShaderID = glCreateShader(GL_VERTEX_SHADER);
-  GLuint FragmentShaderID = glCreateShader(GL_FRAGMENT_SHADER);
-
-  // Read the Vertex Shader code from the file
-  std::string VertexShaderCode;
-  std::ifstream VertexShaderStream(vertex_file_path, std::ios::in);
-  if(VertexShaderStream.is_open()){
-    std::string Line = "";
-    while(getline(VertexShaderStream, Line))
-      VertexShaderCode += "\n" + Line;
-    VertexShaderStream.close();
-  }else{
-    printf("Impossible to open %s. Are you in the right directory ? Don't forget to read the FAQ !\n", vertex_file_path);
-    getchar();
-    return 0;
-  }
-
-  // Read the Fragment Shader code from the file
-  std::string FragmentShaderCode;
-  std::ifstream FragmentShaderStream(fragment_file_path, std::ios::in);
-  if(FragmentShaderStream.is_open()){
-    std::string Line = "";
-    while(getline(FragmentShaderStream, Line))
-      FragmentShaderCode += "\n" + Line;
-    FragmentShaderStream.close();
-  }
-
-  GLint Result = GL_FALSE;
-  int InfoLogLength;
-
-
-  // Compile Vertex Shader
-  printf("Compiling shader : %s\n", vertex_file_path);
-  char const * VertexSourcePointer = VertexShaderCode.c_str();
-  glShaderSource(VertexShaderID, 1, &VertexSourcePointer , NULL);
-  glCompileShader(VertexShaderID);
-
-  // Check Vertex Shader
-  glGetShaderiv(VertexShaderID, GL_COMPILE_STATUS, &Result);
-  glGetShaderiv(VertexShaderID, GL_INFO_LOG_LENGTH, &InfoLogLength);
-  if ( InfoLogLength > 0 ){
-    std::vector<char> VertexShaderErrorMessage(InfoLogLength+1);
-    glGetShaderInfoLog(VertexShaderID, InfoLogLength, NULL, &VertexShaderErrorMessage[0]);
-    printf("%s\n", &VertexShaderErrorMessage[0]);
-  }
-
-
-
-  // Compile Fragment Shader
-  printf("Compiling shader : %s\n", fragment_file_path);
-  char const * FragmentSourcePointer = FragmentShaderCode.c_str();
-  glShaderSource(FragmentShaderID, 1, &FragmentSourcePointer , NULL);
-  glCompileShader(FragmentShaderID);
-
-  // Check Fragment Shader
-  glGetShaderiv(FragmentShaderID, GL_COMPILE_STATUS, &Result);
-  glGetShaderiv(FragmentShaderID, GL_INFO_LOG_LENGTH, &InfoLogLength);
-  if ( InfoLogLength > 0 ){
-    std::vector<char> FragmentShaderErrorMessage(InfoLogLength+1);
-    glGetShaderInfoLog(FragmentShaderID, InfoLogLength, NULL, &FragmentShaderErrorMessage[0]);
-    printf("%s\n", &FragmentShaderErrorMessage[0]);
-  }
-
-
-
-  // Link the program
-  printf("Linking program\n");
-  GLuint ProgramID = glCreateProgram();
-  glAttachShader(ProgramID, VertexShaderID);
-  glAttachShader(ProgramID, FragmentShaderID);
-  glLinkProgram(ProgramID);
-
-  // Check the program
-  glGetProgramiv(ProgramID, GL_LINK_STATUS, &Result);
-  glGetProgramiv(ProgramID, GL_INFO_LOG_LENGTH, &InfoLogLength);
-  if ( InfoLogLength > 0 ){
-    std::vector<char> ProgramErrorMessage(InfoLogLength+1);
-    glGetProgramInfoLog(ProgramID, InfoLogLength, NULL, &ProgramErrorMessage[0]);
-    printf("%s\n", &ProgramErrorMessage[0]);
-  }
-
-  
-  glDetachShader(ProgramID, VertexShaderID);
-  glDetachShader(ProgramID, FragmentShaderID);
-  
-  glDeleteShader(VertexShaderID);
-  glDeleteShader(FragmentShaderID);
-
-  return ProgramID;
+
+#include "arena.hpp"
+#include "mappedfile.hpp"
+#include "bcdecode.hpp"
+#include "bcencode.hpp"
+#include "mipgen.hpp"
+#include "ppmdecode.hpp"
+#include "programbatch.hpp"
+
+// Compiles and links a program, or loads it from the program cache
+// (programcache.hpp) if this driver linked the same sources with the same
+// `defines` before. A batch of one : ProgramBatch (programbatch.hpp)
+// compiles many at once. 0 if it fails.
+GLuint LoadShaders(const char * vertex_file_path,const char * fragment_file_path, const char * defines = NULL){
+	ProgramBatch batch;
+	batch.add(vertex_file_path, fragment_file_path, defines);
+	batch.finish();
+	return batch.program(0);
 }
 
 #define FOURCC_DXT1 0x31545844 // Equivalent to "DXT1" in ASCII
 #define FOURCC_DXT3 0x33545844 // Equivalent to "DXT3" in ASCII
 #define FOURCC_DXT5 0x35545844 // Equivalent to "DXT5" in ASCII
+#define FOURCC_DXT2 0x32545844 // "DXT2", DXT3 with premultiplied alpha
+#define FOURCC_DXT4 0x34545844 // "DXT4", DXT5 with premultiplied alpha
+#define FOURCC_ATI1 0x31495441 // "ATI1", BC4
+#define FOURCC_ATI2 0x32495441 // "ATI2", BC5
+#define FOURCC_BC4U 0x55344342 // "BC4U"
+#define FOURCC_BC5U 0x55354342 // "BC5U"
+#define FOURCC_DX10 0x30315844 // "DX10", followed by a DDSHeaderDX10
+
+inline unsigned int readLE16(const unsigned char * p) { return p[0] | p[1] << 8; }
+inline unsigned int readLE32(const unsigned char * p) { return p[0] | p[1] << 8 | p[2] << 16 | (unsigned int)p[3] << 24; }
+
+// What readBMPHeader finds in a BMP file : uncompressed 8-bit (palette),
+// 24-bit or 32-bit pixels, rows bottom-up or top-down, each padded to 4
+// bytes.
+struct BMPInfo {
+	unsigned int width, height;
+	unsigned int bpp;
+	bool topDown;
+	bool alpha;                     // 32-bit with an alpha mask
+	GLenum format;                  // of the pixels as they are in the file : GL_BGR, GL_BGRA or GL_RGBA ; 0 for 8-bit
+	const unsigned char * pixels;   // the first row of the file
+	size_t pitch;                   // bytes from one row to the next
+	const unsigned char * palette;  // 8-bit : B, G, R, unused
+	unsigned int paletteSize;
+};
+
+bool readBMPHeader(const unsigned char * data, size_t size, BMPInfo & info) {
+	if (size < 54 || data[0] != 'B' || data[1] != 'M') return false;
+	unsigned int dataPos = readLE32(data + 0x0A), headerSize = readLE32(data + 0x0E);
+	unsigned int bpp = readLE16(data + 0x1C), compression = readLE32(data + 0x1E), colours = readLE32(data + 0x2E);
+	int w = (int)readLE32(data + 0x12), h = (int)readLE32(data + 0x16);
+	if (headerSize < 40 || headerSize > size - 14 || w <= 0 || w > 65535 || h == 0 || h > 65535 || h < -65535) return false;
+	info.width = (unsigned int)w;
+	info.height = (unsigned int)(h < 0 ? -h : h);
+	info.topDown = h < 0;
+	info.bpp = bpp;
+	info.alpha = false;
+	info.palette = NULL;
+	info.paletteSize = 0;
+	if (bpp == 8 && compression == 0) {
+		info.format = 0;
+		info.paletteSize = colours ? colours : 256;
+		info.palette = data + 14 + headerSize;
+		if (info.paletteSize > 256 || (size_t)(info.palette - data) + info.paletteSize * 4 > size) return false;
+	} else if (bpp == 24 && compression == 0) {
+		info.format = GL_BGR;
+	} else if (bpp == 32 && (compression == 0 || compression == 3 || compression == 6)) {
+		// The masks of BI_BITFIELDS follow a 40-byte header, and are part
+		// of the longer ones. Without them the fourth byte is padding.
+		info.format = GL_BGRA;
+		if (compression != 0) {
+			const unsigned char * masks = data + 14 + 40;
+			if (masks + 16 > data + size) return false;
+			unsigned int r = readLE32(masks), g = readLE32(masks + 4), b = readLE32(masks + 8);
+			unsigned int a = compression == 6 || headerSize >= 56 ? readLE32(masks + 12) : 0;
+			if (r == 0x00ff0000 && g == 0x0000ff00 && b == 0x000000ff) info.format = GL_BGRA;
+			else if (r == 0x000000ff && g == 0x0000ff00 && b == 0x00ff0000) info.format = GL_RGBA;
+			else return false;
+			info.alpha = a == 0xff000000;
+		}
+	} else {
+		return false;
+	}
+	info.pitch = ((size_t)info.width * bpp / 8 + 3) & ~(size_t)3;
+	if (dataPos == 0) dataPos = 54;
+	if (dataPos > size || (size - dataPos) / info.pitch < info.height) return false;
+	info.pixels = data + dataPos;
+	return true;
+}
 
-GLuint loadBMP(const char * imagepath){
+// Seconds on a clock that only goes forward, to time the loaders with.
+inline double loaderClock() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
 
-	printf("Reading image %s\n", imagepath);
+// The file is mapped, and 24 and 32-bit pixels go to the driver straight
+// from the mapping : a BMP's rows are padded to 4 bytes, which is what
+// GL_UNPACK_ALIGNMENT 4 expects. Top-down files are handed a row at a
+// time, bottom row first. 8-bit pixels are looked up in their palette,
+// into `arena` if one is given. `copied` gets the bytes this copied on
+// the way, if not NULL.
+GLuint loadBMP(const char * imagepath, Arena * arena = NULL, size_t * copied = NULL){
 
-	// Data read from the header of the BMP file
-	unsigned char header[54];
-	unsigned int dataPos;
-	unsigned int imageSize;
-	unsigned int width, height;
-	// Actual RGB data
-	unsigned char * data;
-
-	// Open the file
-	FILE * file = fopen(imagepath,"rb");
-	if (!file)							    {printf("%s could not be opened. Are you in the right directory ? Don't forget to read the FAQ !\n", imagepath); getchar(); return 0;}
+	printf("Reading image %s\n", imagepath);
+	ArenaScope scope(arena);
 
-	// Read the header, i.e. the 54 first bytes
+	// Map the file
+	double start = loaderClock();
+	MappedFile file;
+	if (!mapFile(imagepath, file))   {printf("%s could not be opened. Are you in the right directory ? Don't forget to read the FAQ !\n", imagepath); getchar(); return 0;}
 
-	// If less than 54 bytes are read, problem
-	if ( fread(header, 1, 54, file)!=54 ){ 
+	// Read and check the header
+	BMPInfo info;
+	if (!readBMPHeader((const unsigned char *)file.data, file.size, info)) {
 		printf("Not a correct BMP file\n");
+		unmapFile(file);
 		return 0;
 	}
-	// A BMP files always begins with "BM"
-	if ( header[0]!='B' || header[1]!='M' ){
-		printf("Not a correct BMP file\n");
-		return 0;
+	unsigned int width = info.width, height = info.height;
+
+	// The bottom row and the step to the next one up, as GL takes them.
+	const unsigned char * bottom = info.topDown ? info.pixels + (height - 1) * info.pitch : info.pixels;
+	ptrdiff_t stride = info.topDown ? -(ptrdiff_t)info.pitch : (ptrdiff_t)info.pitch;
+	GLenum format = info.format;
+	unsigned int channels = info.bpp / 8;
+	size_t copiedBytes = 0;
+	unsigned char * expanded = NULL;
+	if (info.bpp == 8) {
+		// Palette entries are B, G, R : rows of BGR, bottom-up.
+		size_t rowBytes = ((size_t)width * 3 + 3) & ~(size_t)3;
+		expanded = (unsigned char *)arenaAlloc(arena, rowBytes * height);
+		for (unsigned int y = 0; y < height; y++) {
+			const unsigned char * src = bottom + (ptrdiff_t)y * stride;
+			unsigned char * dst = expanded + y * rowBytes;
+			for (unsigned int x = 0; x < width; x++, dst += 3) {
+				unsigned int index = src[x] < info.paletteSize ? src[x] : 0;
+				memcpy(dst, info.palette + 4 * index, 3);
+			}
+		}
+		copiedBytes = rowBytes * height;
+		bottom = expanded;
+		stride = (ptrdiff_t)rowBytes;
+		format = GL_BGR;
+		channels = 3;
 	}
-	// Make sure this is a 24bpp file
-	if ( *(int*)&(header[0x1E])!=0  )         {printf("Not a correct BMP file\n");    return 0;}
-	if ( *(int*)&(header[0x1C])!=24 )         {printf("Not a correct BMP file\n");    return 0;}
-
-	// Read the information about the image
-	dataPos    = *(int*)&(header[0x0A]);
-	imageSize  = *(int*)&(header[0x22]);
-	width      = *(int*)&(header[0x12]);
-	height     = *(int*)&(header[0x16]);
-
-	// Some BMP files are misformatted, guess missing information
-	if (imageSize==0)    imageSize=width*height*3; // 3 : one byte for each Red, Green and Blue component
-	if (dataPos==0)      dataPos=54; // The BMP header is done that way
-
-	// Create a buffer
-	data = new unsigned char [imageSize];
-
-	// Read the actual data from the file into the buffer
-	fread(data,1,imageSize,file);
-
-	// Everything is in memory now, the file wan be closed
-	fclose (file);
+	GLint internalFormat = info.alpha ? GL_RGBA : GL_RGB;
 
 	// Create one OpenGL texture
 	GLuint textureID;
@@ -167,10 +171,20 @@ GLuint loadBMP(const char * imagepath){
 	glBindTexture(GL_TEXTURE_2D, textureID);
 
 	// Give the image to OpenGL
-	glTexImage2D(GL_TEXTURE_2D, 0,GL_RGB, width, height, 0, GL_BGR, GL_UNSIGNED_BYTE, data);
-
-	// OpenGL has now copied the data. Free our own version
-	delete [] data;
+	GLint alignment, rowLength;
+	glGetIntegerv(GL_UNPACK_ALIGNMENT, &alignment);
+	glGetIntegerv(GL_UNPACK_ROW_LENGTH, &rowLength);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+	if (stride > 0) {
+		glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, GL_UNSIGNED_BYTE, bottom);
+	} else {
+		glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, GL_UNSIGNED_BYTE, NULL);
+		for (unsigned int y = 0; y < height; y++)
+			glTexSubImage2D(GL_TEXTURE_2D, 0, 0, y, width, 1, format, GL_UNSIGNED_BYTE, bottom + (ptrdiff_t)y * stride);
+	}
+	glPixelStorei(GL_UNPACK_ALIGNMENT, alignment);
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, rowLength);
 
 	// Poor filtering, or ...
 	//glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
@@ -181,109 +195,346 @@ GLuint loadBMP(const char * imagepath){
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR); 
-	glGenerateMipmap(GL_TEXTURE_2D);
+
+	// The mipmaps, made on the CPU as light rather than as sRGB values,
+	// from the mapping too.
+	MipChain chain;
+	buildMipChain(bottom, width, height, channels, stride, true, chain);
+	uploadMipChain(GL_TEXTURE_2D, chain, internalFormat, format);
+	double elapsed = loaderClock() - start;
+
+	// OpenGL has now copied the data. Give back our own
+	if (expanded) arenaFree(arena, expanded);
+	unmapFile(file);
+
+	printf("%s : %ux%u, %u bits, %lu bytes copied, %.2f ms\n", imagepath, width, height, info.bpp, (unsigned long)copiedBytes, elapsed * 1e3);
+	if (copied) *copied = copiedBytes;
 
 	// Return the ID of the texture we just created
 	return textureID;
 }
 
-GLuint loadDDS(const char * imagepath){
+// DDS files are read in place : the file is mapped, its header checked,
+// and glCompressedTexImage2D gets pointers into the mapping, so the pixels
+// are never copied before the driver makes its own copy. Besides the
+// DXT1/3/5 of the tutorials this takes the DX10 extended header, texture
+// arrays, cubemaps, BC4, BC5, BC7 and plain 8-bit RGB(A).
+
+#define DDS_MAGIC                     0x20534444 // "DDS "
+#define DDPF_ALPHAPIXELS              0x1
+#define DDPF_FOURCC                   0x4
+#define DDPF_RGB                      0x40
+#define DDSCAPS2_CUBEMAP              0x200
+#define DDSCAPS2_CUBEMAP_ALLFACES     0xFC00
+#define DDSCAPS2_VOLUME               0x200000
+#define DDS_DIMENSION_TEXTURE2D       3
+#define DDS_RESOURCE_MISC_TEXTURECUBE 0x4
+#define DDS_MAX_LEVELS                16 // 32768 x 32768
+#define DDS_MAX_LAYERS                2048
+
+struct DDSPixelFormat {
+	unsigned int size; // 32
+	unsigned int flags;
+	unsigned int fourCC;
+	unsigned int rgbBitCount;
+	unsigned int rBitMask, gBitMask, bBitMask, aBitMask;
+};
+
+struct DDSHeader {
+	unsigned int size; // 124
+	unsigned int flags;
+	unsigned int height;
+	unsigned int width;
+	unsigned int pitchOrLinearSize;
+	unsigned int depth;
+	unsigned int mipMapCount;
+	unsigned int reserved1[11];
+	DDSPixelFormat ddspf;
+	unsigned int caps, caps2, caps3, caps4;
+	unsigned int reserved2;
+};
+
+// Follows DDSHeader when ddspf.fourCC is "DX10".
+struct DDSHeaderDX10 {
+	unsigned int dxgiFormat;
+	unsigned int resourceDimension;
+	unsigned int miscFlag;
+	unsigned int arraySize;
+	unsigned int miscFlags2;
+};
+
+// A DDS file mapped in memory, checked and ready to upload. The surfaces
+// are stored layer by layer, face by face, each with all its levels.
+struct DDSImage {
+	MappedFile file;
+	unsigned int width, height;
+	unsigned int levels;
+	unsigned int layers;          // elements of a texture array, 1 otherwise
+	unsigned int faces;           // 6 for a cubemap, 1 otherwise
+	GLenum internalFormat;
+	GLenum format, type;          // of uncompressed pixels ; 0 if compressed
+	unsigned int blockBytes;      // per 4x4 block, or per pixel if uncompressed
+	size_t levelOffset[DDS_MAX_LEVELS + 1]; // within a face ; the last one is its size
+	const unsigned char * pixels; // first byte after the header(s)
+};
+
+inline size_t ddsLevelSize(const DDSImage & image, unsigned int level) {
+	unsigned int width = image.width >> level, height = image.height >> level;
+	if (width < 1) width = 1;
+	if (height < 1) height = 1;
+	if (image.format == 0) return (size_t)((width + 3) / 4) * ((height + 3) / 4) * image.blockBytes;
+	return (size_t)width * height * image.blockBytes;
+}
 
-	unsigned char header[124];
+// Level `level` of face `face` (0 to 5, +X -X +Y -Y +Z -Z) of array
+// element `layer`, inside the mapping.
+inline const unsigned char * ddsLevelData(const DDSImage & image, unsigned int layer, unsigned int face, unsigned int level) {
+	size_t surface = (size_t)layer * image.faces + face;
+	return image.pixels + surface * image.levelOffset[image.levels] + image.levelOffset[level];
+}
 
-	FILE *fp; 
- 
-	/* try to open the file */ 
-	fp = fopen(imagepath, "rb"); 
-	if (fp == NULL){
-		printf("%s could not be opened. Are you in the right directory ? Don't forget to read the FAQ !\n", imagepath); getchar(); 
-		return 0;
+// The OpenGL format of a legacy (FourCC or bit mask) pixel format.
+bool ddsLegacyFormat(const DDSPixelFormat & pf, DDSImage & image) {
+	image.format = image.type = 0;
+	if (pf.flags & DDPF_FOURCC) {
+		switch (pf.fourCC) {
+		case FOURCC_DXT1: image.internalFormat = GL_COMPRESSED_RGBA_S3TC_DXT1_EXT; image.blockBytes = 8;  return true;
+		case FOURCC_DXT2:
+		case FOURCC_DXT3: image.internalFormat = GL_COMPRESSED_RGBA_S3TC_DXT3_EXT; image.blockBytes = 16; return true;
+		case FOURCC_DXT4:
+		case FOURCC_DXT5: image.internalFormat = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT; image.blockBytes = 16; return true;
+		case FOURCC_ATI1:
+		case FOURCC_BC4U: image.internalFormat = GL_COMPRESSED_RED_RGTC1;           image.blockBytes = 8;  return true;
+		case FOURCC_ATI2:
+		case FOURCC_BC5U: image.internalFormat = GL_COMPRESSED_RG_RGTC2;            image.blockBytes = 16; return true;
+		}
+		return false;
 	}
-   
-	/* verify the type of file */ 
-	char filecode[4]; 
-	fread(filecode, 1, 4, fp); 
-	if (strncmp(filecode, "DDS ", 4) != 0) { 
-		fclose(fp); 
-		return 0; 
+	if (!(pf.flags & DDPF_RGB) || pf.gBitMask != 0x0000ff00) return false;
+	bool alpha = (pf.flags & DDPF_ALPHAPIXELS) && pf.aBitMask == 0xff000000;
+	image.type = GL_UNSIGNED_BYTE;
+	if (pf.rgbBitCount == 32 && pf.rBitMask == 0x00ff0000 && pf.bBitMask == 0x000000ff) image.format = GL_BGRA;
+	else if (pf.rgbBitCount == 32 && pf.rBitMask == 0x000000ff && pf.bBitMask == 0x00ff0000) image.format = GL_RGBA;
+	else if (pf.rgbBitCount == 24 && pf.rBitMask == 0x00ff0000 && pf.bBitMask == 0x000000ff) image.format = GL_BGR;
+	else if (pf.rgbBitCount == 24 && pf.rBitMask == 0x000000ff && pf.bBitMask == 0x00ff0000) image.format = GL_RGB;
+	else return false;
+	image.internalFormat = alpha ? GL_RGBA8 : GL_RGB8;
+	image.blockBytes = pf.rgbBitCount / 8;
+	return true;
+}
+
+// The OpenGL format of a DXGI_FORMAT from a DX10 header.
+bool ddsDXGIFormat(unsigned int dxgiFormat, DDSImage & image) {
+	image.format = image.type = 0;
+	switch (dxgiFormat) {
+	case 71: image.internalFormat = GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;       image.blockBytes = 8;  return true; // BC1_UNORM
+	case 72: image.internalFormat = GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT; image.blockBytes = 8;  return true; // BC1_UNORM_SRGB
+	case 74: image.internalFormat = GL_COMPRESSED_RGBA_S3TC_DXT3_EXT;       image.blockBytes = 16; return true; // BC2_UNORM
+	case 75: image.internalFormat = GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT; image.blockBytes = 16; return true; // BC2_UNORM_SRGB
+	case 77: image.internalFormat = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;       image.blockBytes = 16; return true; // BC3_UNORM
+	case 78: image.internalFormat = GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT; image.blockBytes = 16; return true; // BC3_UNORM_SRGB
+	case 80: image.internalFormat = GL_COMPRESSED_RED_RGTC1;                image.blockBytes = 8;  return true; // BC4_UNORM
+	case 81: image.internalFormat = GL_COMPRESSED_SIGNED_RED_RGTC1;         image.blockBytes = 8;  return true; // BC4_SNORM
+	case 83: image.internalFormat = GL_COMPRESSED_RG_RGTC2;                 image.blockBytes = 16; return true; // BC5_UNORM
+	case 84: image.internalFormat = GL_COMPRESSED_SIGNED_RG_RGTC2;          image.blockBytes = 16; return true; // BC5_SNORM
+	case 98: image.internalFormat = GL_COMPRESSED_RGBA_BPTC_UNORM;          image.blockBytes = 16; return true; // BC7_UNORM
+	case 99: image.internalFormat = GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM;    image.blockBytes = 16; return true; // BC7_UNORM_SRGB
 	}
-	
-	/* get the surface desc */ 
-	fread(&header, 124, 1, fp); 
-
-	unsigned int height      = *(unsigned int*)&(header[8 ]);
-	unsigned int width	     = *(unsigned int*)&(header[12]);
-	unsigned int linearSize	 = *(unsigned int*)&(header[16]);
-	unsigned int mipMapCount = *(unsigned int*)&(header[24]);
-	unsigned int fourCC      = *(unsigned int*)&(header[80]);
-
- 
-	unsigned char * buffer;
-	unsigned int bufsize;
-	/* how big is it going to be including all mipmaps? */ 
-	bufsize = mipMapCount > 1 ? linearSize * 2 : linearSize; 
-	buffer = (unsigned char*)malloc(bufsize * sizeof(unsigned char)); 
-	fread(buffer, 1, bufsize, fp); 
-	/* close the file pointer */ 
-	fclose(fp);
+	image.type = GL_UNSIGNED_BYTE;
+	image.blockBytes = 4;
+	switch (dxgiFormat) {
+	case 28: image.internalFormat = GL_RGBA8;         image.format = GL_RGBA; return true; // R8G8B8A8_UNORM
+	case 29: image.internalFormat = GL_SRGB8_ALPHA8;  image.format = GL_RGBA; return true; // R8G8B8A8_UNORM_SRGB
+	case 87: image.internalFormat = GL_RGBA8;         image.format = GL_BGRA; return true; // B8G8R8A8_UNORM
+	case 91: image.internalFormat = GL_SRGB8_ALPHA8;  image.format = GL_BGRA; return true; // B8G8R8A8_UNORM_SRGB
+	}
+	return false;
+}
+
+static bool ddsReject(const char * imagepath, DDSImage & image, const char * problem) {
+	printf("%s is %s\n", imagepath, problem);
+	unmapFile(image.file);
+	return false;
+}
 
-	unsigned int components  = (fourCC == FOURCC_DXT1) ? 3 : 4; 
-	unsigned int format;
-	switch(fourCC) 
-	{ 
-	case FOURCC_DXT1: 
-		format = GL_COMPRESSED_RGBA_S3TC_DXT1_EXT; 
-		break; 
-	case FOURCC_DXT3: 
-		format = GL_COMPRESSED_RGBA_S3TC_DXT3_EXT; 
-		break; 
-	case FOURCC_DXT5: 
-		format = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT; 
-		break; 
-	default: 
-		free(buffer); 
-		return 0; 
+// Maps `imagepath` and checks that the header describes something this
+// code can upload and that the file holds every surface it announces.
+// Prints why and returns false otherwise.
+bool openDDS(const char * imagepath, DDSImage & image) {
+	if (!mapFile(imagepath, image.file)) {
+		printf("%s could not be opened. Are you in the right directory ? Don't forget to read the FAQ !\n", imagepath); getchar();
+		return false;
+	}
+	const char * data = image.file.data;
+	size_t size = image.file.size;
+	size_t dataOffset = 4 + sizeof(DDSHeader);
+	const DDSHeader * header = (const DDSHeader *)(data + 4);
+
+	if (size < dataOffset || *(const unsigned int *)data != DDS_MAGIC || header->size != sizeof(DDSHeader) || header->ddspf.size != sizeof(DDSPixelFormat))
+		return ddsReject(imagepath, image, "not a DDS file");
+	if (header->width == 0 || header->height == 0 || header->width > (1u << (DDS_MAX_LEVELS - 1)) || header->height > (1u << (DDS_MAX_LEVELS - 1)))
+		return ddsReject(imagepath, image, "of an unsupported size");
+	if (header->caps2 & DDSCAPS2_VOLUME)
+		return ddsReject(imagepath, image, "a volume texture, which is not supported");
+	if ((header->caps2 & DDSCAPS2_CUBEMAP) && (header->caps2 & DDSCAPS2_CUBEMAP_ALLFACES) != DDSCAPS2_CUBEMAP_ALLFACES)
+		return ddsReject(imagepath, image, "a cubemap with missing faces");
+
+	image.width = header->width;
+	image.height = header->height;
+	image.layers = 1;
+	image.faces = (header->caps2 & DDSCAPS2_CUBEMAP) ? 6 : 1;
+	if ((header->ddspf.flags & DDPF_FOURCC) && header->ddspf.fourCC == FOURCC_DX10) {
+		const DDSHeaderDX10 * dx10 = (const DDSHeaderDX10 *)(data + dataOffset);
+		dataOffset += sizeof(DDSHeaderDX10);
+		if (size < dataOffset)
+			return ddsReject(imagepath, image, "truncated");
+		if (dx10->resourceDimension != DDS_DIMENSION_TEXTURE2D || dx10->arraySize == 0 || dx10->arraySize > DDS_MAX_LAYERS)
+			return ddsReject(imagepath, image, "not a 2D texture or array");
+		if (!ddsDXGIFormat(dx10->dxgiFormat, image))
+			return ddsReject(imagepath, image, "in an unsupported DXGI format");
+		image.layers = dx10->arraySize;
+		image.faces = (dx10->miscFlag & DDS_RESOURCE_MISC_TEXTURECUBE) ? 6 : 1;
+	} else if (!ddsLegacyFormat(header->ddspf, image)) {
+		return ddsReject(imagepath, image, "in an unsupported pixel format");
 	}
 
-	// Create one OpenGL texture
-	GLuint textureID;
-	glGenTextures(1, &textureID);
+	// Some writers leave the count at 0 when there is just the one level.
+	image.levels = header->mipMapCount ? header->mipMapCount : 1;
+	unsigned int fullChain = 1;
+	while ((image.width | image.height) >> fullChain) fullChain++;
+	if (image.levels > fullChain)
+		return ddsReject(imagepath, image, "announcing more mipmaps than its size allows");
+
+	image.levelOffset[0] = 0;
+	for (unsigned int level = 0; level < image.levels; level++)
+		image.levelOffset[level + 1] = image.levelOffset[level] + ddsLevelSize(image, level);
+	// At most 2^32 bytes per face and 12288 faces : no overflow in 64 bits.
+	unsigned long long total = (unsigned long long)image.levelOffset[image.levels] * image.layers * image.faces;
+	if (total > size - dataOffset)
+		return ddsReject(imagepath, image, "truncated");
+	image.pixels = (const unsigned char *)data + dataOffset;
+	return true;
+}
 
-	// "Bind" the newly created texture : all future texture functions will modify this texture
-	glBindTexture(GL_TEXTURE_2D, textureID);
-	glPixelStorei(GL_UNPACK_ALIGNMENT,1);	
-	
-	unsigned int blockSize = (format == GL_COMPRESSED_RGBA_S3TC_DXT1_EXT) ? 8 : 16; 
-	unsigned int offset = 0;
+void closeDDS(DDSImage & image) {
+	unmapFile(image.file);
+}
 
-	/* load the mipmaps */ 
-	for (unsigned int level = 0; level < mipMapCount && (width || height); ++level) 
-	{ 
-		unsigned int size = ((width+3)/4)*((height+3)/4)*blockSize; 
-		glCompressedTexImage2D(GL_TEXTURE_2D, level, format, width, height,  
-			0, size, buffer + offset); 
-	 
-		offset += size; 
-		width  /= 2; 
-		height /= 2; 
+// BC1 to BC3 surfaces of `image` decoded to RGBA8 into `pixels`, on every
+// core, all levels of all faces and layers at once. `decoded` describes
+// them the way openDDS would an uncompressed file.
+template <typename Allocator>
+void decodeDDS(const DDSImage & image, DDSImage & decoded, std::vector<unsigned char, Allocator> & pixels) {
+	decoded = image;
+	decoded.file.data = NULL;
+	decoded.file.size = 0;
+	decoded.file.mapped = false;
+	decoded.internalFormat = bcDecodedFormat(image.internalFormat);
+	decoded.format = GL_RGBA;
+	decoded.type = GL_UNSIGNED_BYTE;
+	decoded.blockBytes = 4;
+	decoded.levelOffset[0] = 0;
+	for (unsigned int level = 0; level < image.levels; level++)
+		decoded.levelOffset[level + 1] = decoded.levelOffset[level] + ddsLevelSize(decoded, level);
+	pixels.resize(decoded.levelOffset[image.levels] * image.layers * image.faces);
+	decoded.pixels = pixels.empty() ? NULL : &pixels[0];
+
+	std::vector<BCSurface> surfaces;
+	for (unsigned int layer = 0; layer < image.layers; layer++) {
+		for (unsigned int face = 0; face < image.faces; face++) {
+			for (unsigned int level = 0; level < image.levels; level++) {
+				BCSurface surface;
+				surface.blocks = ddsLevelData(image, layer, face, level);
+				surface.width = image.width >> level ? image.width >> level : 1;
+				surface.height = image.height >> level ? image.height >> level : 1;
+				surface.pixels = (unsigned char *)ddsLevelData(decoded, layer, face, level);
+				surfaces.push_back(surface);
+			}
+		}
+	}
+	bcDecodeSurfaces(image.internalFormat, &surfaces[0], surfaces.size());
+}
 
-		// Deal with Non-Power-Of-Two textures. This code is not included in the webpage to reduce clutter.
-		if(width < 1) width = 1;
-		if(height < 1) height = 1;
+// Creates a texture from an opened DDS file, straight from the mapping :
+// a GL_TEXTURE_2D, GL_TEXTURE_CUBE_MAP, GL_TEXTURE_2D_ARRAY or
+// GL_TEXTURE_CUBE_MAP_ARRAY with all the levels the file has. The texture
+// is left bound to that target. If the driver has no S3TC, BC1 to BC3 are
+// decoded here (decodeDDS) and go up as RGBA8, from `arena` if one is
+// given.
+GLuint uploadDDS(const DDSImage & image, Arena * arena = NULL) {
+	if (image.format == 0 && bcDecodable(image.internalFormat) && !GLEW_EXT_texture_compression_s3tc) {
+		ArenaScope scope(arena);
+		DDSImage decoded;
+		std::vector<unsigned char, ArenaAllocator<unsigned char> > pixels((ArenaAllocator<unsigned char>(arena)));
+		decodeDDS(image, decoded, pixels);
+		return uploadDDS(decoded);
+	}
 
-	} 
+	GLenum target;
+	if (image.faces == 6) target = image.layers > 1 ? GL_TEXTURE_CUBE_MAP_ARRAY : GL_TEXTURE_CUBE_MAP;
+	else                  target = image.layers > 1 ? GL_TEXTURE_2D_ARRAY : GL_TEXTURE_2D;
+	bool compressed = image.format == 0;
 
-	free(buffer); 
+	GLuint textureID;
+	glGenTextures(1, &textureID);
+	glBindTexture(target, textureID);
+	GLint alignment;
+	glGetIntegerv(GL_UNPACK_ALIGNMENT, &alignment);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+	for (unsigned int level = 0; level < image.levels; level++) {
+		GLsizei width = image.width >> level, height = image.height >> level;
+		if (width < 1) width = 1;
+		if (height < 1) height = 1;
+		GLsizei size = (GLsizei)ddsLevelSize(image, level);
+
+		if (image.layers == 1) {
+			// One image per face : the pointers go to OpenGL as they are.
+			for (unsigned int face = 0; face < image.faces; face++) {
+				GLenum faceTarget = image.faces == 6 ? GL_TEXTURE_CUBE_MAP_POSITIVE_X + face : GL_TEXTURE_2D;
+				const unsigned char * pixels = ddsLevelData(image, 0, face, level);
+				if (compressed) glCompressedTexImage2D(faceTarget, level, image.internalFormat, width, height, 0, size, pixels);
+				else glTexImage2D(faceTarget, level, image.internalFormat, width, height, 0, image.format, image.type, pixels);
+			}
+			continue;
+		}
 
+		// Arrays : the file keeps each layer's levels together, OpenGL wants
+		// each level's layers together. Allocate the level, then give it
+		// the layers one by one from the mapping.
+		GLsizei depth = image.layers * image.faces;
+		if (compressed) glCompressedTexImage3D(target, level, image.internalFormat, width, height, depth, 0, size * depth, NULL);
+		else glTexImage3D(target, level, image.internalFormat, width, height, depth, 0, image.format, image.type, NULL);
+		for (GLsizei z = 0; z < depth; z++) {
+			const unsigned char * pixels = ddsLevelData(image, z / image.faces, z % image.faces, level);
+			if (compressed) glCompressedTexSubImage3D(target, level, 0, 0, z, width, height, 1, image.internalFormat, size, pixels);
+			else glTexSubImage3D(target, level, 0, 0, z, width, height, 1, image.format, image.type, pixels);
+		}
+	}
+	glPixelStorei(GL_UNPACK_ALIGNMENT, alignment);
+	// Complete with the levels there are, even without a full chain.
+	glTexParameteri(target, GL_TEXTURE_MAX_LEVEL, image.levels - 1);
 	return textureID;
+}
 
-
+// Maps a DDS file and uploads it, zero-copy (see openDDS and uploadDDS).
+// Returns 0 if the file is not one this code can read. Nothing is
+// allocated along the way, unless the driver has no S3TC : the decoded
+// pixels then come from `arena`, if one is given.
+GLuint loadDDS(const char * imagepath, Arena * arena = NULL){
+	DDSImage image;
+	if (!openDDS(imagepath, image)) return 0;
+	GLuint textureID = uploadDDS(image, arena);
+	closeDDS(image);
+	return textureID;
 }
 
 typedef unsigned int uint32_t;
 
 int check_ppm(FILE *fp);
-void *load_ppm(FILE *fp, unsigned long *xsz, unsigned long *ysz);
+/* the pixels come from `arena` if one is given : they are then not to be
+ * freed, and live until the caller's ArenaScope ends */
+void *load_ppm(FILE *fp, unsigned long *xsz, unsigned long *ysz, Arena *arena = 0);
 
 #if !defined(LITTLE_ENDIAN) && !defined(BIG_ENDIAN)
 #if  defined(__i386__) || defined(__ia64__) || defined(WIN32) || \
@@ -307,205 +558,266 @@ void *load_ppm(FILE *fp, unsigned long *xsz, unsigned long *ysz);
 #define PACK_COLOR24(r, g, b) (((b & 0xff) << 16) | ((g & 0xff) << 8) | (r & 0xff))
 #endif
 
-void *load_image(const char *fname, unsigned long *xsz, unsigned long *ysz) {
-	FILE *fp = fopen(fname, "r");
-	if(!fp) {
+/* the byte order of PACK_COLOR24 with alpha on top, as ppmDecode wants it */
+#ifdef LITTLE_ENDIAN
+static const unsigned char PACKED_ORDER[4] = { 2, 1, 0, 3 };
+#else
+static const unsigned char PACKED_ORDER[4] = { 3, 2, 1, 0 };
+#endif
+
+/* decodes a whole netpbm file in memory (see ppmdecode.hpp) to packed
+ * pixels, alpha in the top byte */
+static void *decode_ppm(const unsigned char *data, size_t size, unsigned long *xsz, unsigned long *ysz, Arena *arena) {
+	PPMHeader header;
+	uint32_t *pixels;
+
+	if(!ppmReadHeader(data, size, header)) {
+		return 0;
+	}
+	if(!(pixels = (uint32_t*) arenaAlloc(arena, (size_t)header.width * header.height * sizeof *pixels))) {
+		fputs("malloc failed\n", stderr);
+		return 0;
+	}
+	if(!ppmDecode(data, size, header, PACKED_ORDER, (unsigned char*)pixels)) {
+		arenaFree(arena, pixels);
+		return 0;
+	}
+
+	if(xsz) *xsz = header.width;
+	if(ysz) *ysz = header.height;
+	return pixels;
+}
+
+void *load_image(const char *fname, unsigned long *xsz, unsigned long *ysz, Arena *arena = 0) {
+	MappedFile file;
+	if(!mapFile(fname, file)) {
 		fprintf(stderr, "failed to open: %s\n", fname);
 		return 0;
 	}
 
-	if(check_ppm(fp)) {
-		return load_ppm(fp, xsz, ysz);
+	void *pixels = 0;
+	const unsigned char *data = (const unsigned char*)file.data;
+	if(file.size >= 2 && data[0] == 'P' && data[1] && strchr("3567", data[1])) {
+		if(!(pixels = decode_ppm(data, file.size, xsz, ysz, arena))) {
+			fprintf(stderr, "load_image: %s could not be read\n", fname);
+		}
+	} else {
+		fprintf(stderr, "unsupported image format\n");
 	}
-	
-	fclose(fp);
-	fprintf(stderr, "unsupported image format\n");
-	return 0;
+	unmapFile(file);
+	return pixels;
 }
 
 int check_ppm(FILE *fp) {
 	fseek(fp, 0, SEEK_SET);
-	if(fgetc(fp) == 'P' && fgetc(fp) == '6') {
-		return 1;
+	if(fgetc(fp) == 'P') {
+		int c = fgetc(fp);
+		return c == '3' || c == '5' || c == '6' || c == '7';
 	}
 	return 0;
 }
 
-static int read_to_wspace(FILE *fp, char *buf, int bsize) {
-	int c, count = 0;
-	
-	while((c = fgetc(fp)) != -1 && !isspace(c) && count < bsize - 1) {
-		if(c == '#') {
-			while((c = fgetc(fp)) != -1 && c != '\n' && c != '\r');
-			c = fgetc(fp);
-			if(c == '\n' || c == '\r') continue;
-		}
-		*buf++ = c;
-		count++;
-	}
-	*buf = 0;
-	
-	while((c = fgetc(fp)) != -1 && isspace(c));
-	ungetc(c, fp);
-	return count;
-}
-
-void *load_ppm(FILE *fp, unsigned long *xsz, unsigned long *ysz) {
-	char buf[64];
-	int bytes, raw;
-	unsigned int w, h, i, sz;
-	uint32_t *pixels;
-	
-	fseek(fp, 0, SEEK_SET);
-	
-	bytes = read_to_wspace(fp, buf, 64);
-	raw = buf[1] == '6';
+/* reads the whole of `fp` in one go, and closes it */
+void *load_ppm(FILE *fp, unsigned long *xsz, unsigned long *ysz, Arena *arena) {
+	std::vector<unsigned char> data;
+	long size;
 
-	if((bytes = read_to_wspace(fp, buf, 64)) == 0) {
-		fclose(fp);
-		return 0;
-	}
-	if(!isdigit(*buf)) {
-		fprintf(fp, "load_ppm: invalid width: %s", buf);
+	if(fseek(fp, 0, SEEK_END) != 0 || (size = ftell(fp)) <= 0 || fseek(fp, 0, SEEK_SET) != 0) {
 		fclose(fp);
 		return 0;
 	}
-	w = atoi(buf);
+	data.resize((size_t)size);
+	size_t got = fread(&data[0], 1, data.size(), fp);
+	fclose(fp);
+	return decode_ppm(&data[0], got, xsz, ysz, arena);
+}
 
-	if((bytes = read_to_wspace(fp, buf, 64)) == 0) {
-		fclose(fp);
-		return 0;
-	}
-	if(!isdigit(*buf)) {
-		fprintf(fp, "load_ppm: invalid height: %s", buf);
-		fclose(fp);
-		return 0;
+// Uncompressed images to BC1 and BC3 DDS (see bcencode.hpp), to write
+// offline with writeDDS or to upload straight away with loadCompressed.
+
+// An 8, 24 or 32-bit uncompressed BMP, alpha only with an alpha mask.
+static bool readBMPRGBA(const unsigned char * data, size_t size, std::vector<unsigned char> & pixels, unsigned int & width, unsigned int & height) {
+	BMPInfo info;
+	if (!readBMPHeader(data, size, info)) return false;
+	width = info.width;
+	height = info.height;
+	pixels.resize((size_t)width * height * 4);
+	unsigned int bytes = info.bpp / 8;
+	for (unsigned int y = 0; y < height; y++) {
+		const unsigned char * src = info.pixels + (info.topDown ? y : height - 1 - y) * info.pitch;
+		unsigned char * dst = &pixels[(size_t)y * width * 4];
+		for (unsigned int x = 0; x < width; x++, src += bytes, dst += 4) {
+			const unsigned char * p = src;
+			if (bytes == 1) p = info.palette + 4 * (*src < info.paletteSize ? *src : 0);
+			bool bgr = info.format != GL_RGBA;
+			dst[0] = p[bgr ? 2 : 0]; dst[1] = p[1]; dst[2] = p[bgr ? 0 : 2];
+			dst[3] = info.alpha ? p[3] : 255;
+		}
 	}
-	h = atoi(buf);
+	return true;
+}
 
-	if((bytes = read_to_wspace(fp, buf, 64)) == 0) {
-		fclose(fp);
-		return 0;
-	}
-	if(!isdigit(*buf) || atoi(buf) != 255) {
-		fprintf(fp, "load_ppm: invalid or unsupported max value: %s", buf);
-		fclose(fp);
-		return 0;
+// A true colour (24 or 32-bit) or grey (8-bit) TGA, raw or run-length
+// encoded, without a colour map.
+static bool readTGARGBA(const unsigned char * data, size_t size, std::vector<unsigned char> & pixels, unsigned int & width, unsigned int & height) {
+	if (size < 18 || data[1] != 0) return false;
+	unsigned int type = data[2], bpp = data[16], bytes = bpp / 8;
+	bool grey = (type & 7) == 3, rle = type >= 8;
+	if ((type & ~8u) != 2 && (type & ~8u) != 3) return false;
+	if (grey ? bpp != 8 : bpp != 24 && bpp != 32) return false;
+	width = readLE16(data + 12);
+	height = readLE16(data + 14);
+	if (width == 0 || height == 0) return false;
+	bool topDown = (data[17] & 0x20) != 0;
+	const unsigned char * src = data + 18 + data[0], * end = data + size;
+	pixels.resize((size_t)width * height * 4);
+	size_t count = (size_t)width * height, i = 0;
+	while (i < count) {
+		// A raw file is one long raw packet.
+		size_t run = count - i;
+		bool repeat = false;
+		if (rle) {
+			if (src >= end) return false;
+			repeat = (*src & 0x80) != 0;
+			run = (*src++ & 0x7f) + 1u;
+			if (run > count - i) run = count - i;
+		}
+		if (src + (repeat ? 1 : run) * bytes > end) return false;
+		for (size_t k = 0; k < run; k++, i++) {
+			const unsigned char * p = src + (repeat ? 0 : k * bytes);
+			size_t y = i / width, x = i % width;
+			unsigned char * dst = &pixels[((topDown ? y : height - 1 - y) * width + x) * 4];
+			dst[0] = grey ? p[0] : p[2];
+			dst[1] = grey ? p[0] : p[1];
+			dst[2] = p[0];
+			dst[3] = bpp == 32 ? p[3] : 255;
+		}
+		src += (repeat ? 1 : run) * bytes;
 	}
+	return true;
+}
 
-	if(!(pixels = (uint32*) malloc(w * h * sizeof *pixels))) {
-		fputs("malloc failed", fp);
-		fclose(fp);
-		return 0;
+// The pixels of a BMP, TGA or netpbm image (PPM, PGM, PAM) as RGBA8, top
+// row first. `alpha` is set if any pixel is not opaque.
+bool readImageRGBA(const char * imagepath, std::vector<unsigned char> & pixels, unsigned int & width, unsigned int & height, bool & alpha) {
+	MappedFile file;
+	if (!mapFile(imagepath, file)) {
+		printf("%s could not be opened. Are you in the right directory ? Don't forget to read the FAQ !\n", imagepath);
+		return false;
 	}
-
-	sz = h * w;
-	for(i=0; i<sz; i++) {
-		int r = fgetc(fp);
-		int g = fgetc(fp);
-		int b = fgetc(fp);
-
-		if(r == -1 || g == -1 || b == -1) {
-			free(pixels);
-			fclose(fp);
-			fputs("load_ppm: EOF while reading pixel data", fp);
-			return 0;
+	const unsigned char * data = (const unsigned char *)file.data;
+	const char * extension = strrchr(imagepath, '.');
+	bool ok;
+	if (file.size >= 2 && data[0] == 'B' && data[1] == 'M') {
+		ok = readBMPRGBA(data, file.size, pixels, width, height);
+	} else if (file.size >= 2 && data[0] == 'P' && data[1] && strchr("3567", data[1])) {
+		static const unsigned char order[4] = { 0, 1, 2, 3 };
+		PPMHeader header;
+		ok = ppmReadHeader(data, file.size, header);
+		if (ok) {
+			width = header.width;
+			height = header.height;
+			pixels.resize((size_t)width * height * 4);
+			ok = ppmDecode(data, file.size, header, order, &pixels[0]);
 		}
-		pixels[i] = PACK_COLOR24(r, g, b);
+	} else if (extension && (strcmp(extension, ".tga") == 0 || strcmp(extension, ".TGA") == 0)) {
+		ok = readTGARGBA(data, file.size, pixels, width, height);
+	} else {
+		ok = false;
 	}
+	unmapFile(file);
+	if (!ok) {
+		printf("%s is not a BMP, TGA or PPM file this code can read\n", imagepath);
+		return false;
+	}
+	alpha = false;
+	for (size_t i = 3; i < pixels.size() && !alpha; i += 4) alpha = pixels[i] != 255;
+	return true;
+}
 
-	fclose(fp);
-
-	if(xsz) *xsz = w;
-	if(ysz) *ysz = h;
-	return pixels;
+// Compresses `width` x `height` RGBA8 pixels, top row first, to BC1, or
+// BC3 if `alpha`, with all the levels of a mipmap chain unless `mipmaps`
+// is false. The blocks go in `blocks`, and `image` describes them the way
+// openDDS would a file, for uploadDDS or writeDDS.
+void encodeDDS(const unsigned char * rgba, unsigned int width, unsigned int height, bool alpha, DDSImage & image, std::vector<unsigned char> & blocks, bool mipmaps = true) {
+	memset(&image, 0, sizeof image);
+	image.width = width;
+	image.height = height;
+	image.layers = image.faces = 1;
+	image.internalFormat = alpha ? GL_COMPRESSED_RGBA_S3TC_DXT5_EXT : GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;
+	image.blockBytes = alpha ? 16 : 8;
+	image.levels = 1;
+	while (mipmaps && (width | height) >> image.levels) image.levels++;
+	image.levelOffset[0] = 0;
+	for (unsigned int level = 0; level < image.levels; level++)
+		image.levelOffset[level + 1] = image.levelOffset[level] + ddsLevelSize(image, level);
+	blocks.resize(image.levelOffset[image.levels]);
+	image.pixels = &blocks[0];
+
+	// The whole chain uncompressed, filtered as light, then all of it at once.
+	MipChain chain;
+	if (mipmaps) buildMipChain(rgba, width, height, 4, 0, true, chain);
+	std::vector<BCEncodeSurface> surfaces(image.levels);
+	for (unsigned int level = 0; level < image.levels; level++) {
+		BCEncodeSurface & surface = surfaces[level];
+		surface.pixels = level ? chain.level(level) : rgba;
+		surface.width = width >> level ? width >> level : 1;
+		surface.height = height >> level ? height >> level : 1;
+		surface.blocks = &blocks[image.levelOffset[level]];
+	}
+	bcEncodeSurfaces(image.internalFormat, &surfaces[0], surfaces.size());
 }
-// Read file `path`, write the data in out_vertices|out_uvs|out_normals and return if something went wrong.
-bool loadOBJ(const char* path, std::vector<glm::vec3>& out_vertices, std::vector<glm::vec2>& out_uvs, std::vector<glm::vec3>& out_normals) {
-  // Open file for reading
-	FILE * file = fopen(path, "r");
-	if( file == NULL ){
-		printf("Impossible to open the file ! Are you in the right path ? See Tutorial 1 for details\n");
-		getchar();
+
+// Writes a 2D BC1, BC2 or BC3 image with a legacy header, which is what
+// openDDS and every other reader takes.
+bool writeDDS(const char * path, const DDSImage & image) {
+	unsigned int fourCC = 0;
+	switch (image.internalFormat) {
+	case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT: fourCC = FOURCC_DXT1; break;
+	case GL_COMPRESSED_RGBA_S3TC_DXT3_EXT: fourCC = FOURCC_DXT3; break;
+	case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT: fourCC = FOURCC_DXT5; break;
+	}
+	if (fourCC == 0 || image.layers != 1 || image.faces != 1) {
+		printf("%s : only 2D DXT1, DXT3 and DXT5 images are written\n", path);
+		return false;
+	}
+	DDSHeader header;
+	memset(&header, 0, sizeof header);
+	header.size = sizeof header;
+	header.flags = 0x1 | 0x2 | 0x4 | 0x1000 | 0x80000 | (image.levels > 1 ? 0x20000 : 0); // caps, height, width, pixel format, linear size, mipmap count
+	header.height = image.height;
+	header.width = image.width;
+	header.pitchOrLinearSize = (unsigned int)ddsLevelSize(image, 0);
+	header.mipMapCount = image.levels;
+	header.ddspf.size = sizeof header.ddspf;
+	header.ddspf.flags = DDPF_FOURCC;
+	header.ddspf.fourCC = fourCC;
+	header.caps = 0x1000 | (image.levels > 1 ? 0x400000 | 0x8 : 0); // texture, mipmap, complex
+
+	FILE * fp = fopen(path, "wb");
+	if (!fp) {
+		printf("%s could not be opened for writing\n", path);
 		return false;
 	}
+	unsigned int magic = DDS_MAGIC;
+	bool ok = fwrite(&magic, 4, 1, fp) == 1 && fwrite(&header, sizeof header, 1, fp) == 1
+		&& fwrite(image.pixels, 1, image.levelOffset[image.levels], fp) == image.levelOffset[image.levels];
+	if (fclose(fp) != 0) ok = false;
+	if (!ok) printf("%s could not be written\n", path);
+	return ok;
+}
 
-  // Temp vars to store contents of .obj
-	std::vector<unsigned int> vertexIndices, uvIndices, normalIndices;
-	std::vector<glm::vec3> temp_vertices; 
-	std::vector<glm::vec2> temp_uvs;
-	std::vector<glm::vec3> temp_normals;
-
-  // Reads until EOF is reached
-  while (1) {
-    char lineHeader[128];
-    // read first word
-    int res = fscanf(file, "%s", lineHeader);
-    if (EOF == res) break;
-
-    if (strcmp(lineHeader, "v") == 0) {
-      glm::vec3 vertex;
-      fscanf(file, "%f %f %f\n", &vertex.x, &vertex.y, &vertex.z );
-      temp_vertices.push_back(vertex);
-    }
-    else if (strcmp(lineHeader, "vt") == 0) {
-			glm::vec2 uv;
-			fscanf(file, "%f %f\n", &uv.x, &uv.y );
-			uv.y = -uv.y; // Invert V coordinate since we will only use DDS texture, which are inverted. Remove if you want to use TGA or BMP loaders.
-			temp_uvs.push_back(uv);
-    }
-    else if (strcmp(lineHeader, "vn") == 0) {
-			glm::vec3 normal;
-			fscanf(file, "%f %f %f\n", &normal.x, &normal.y, &normal.z );
-			temp_normals.push_back(normal);
-    }
-    else if (strcmp(lineHeader, "f") == 0) {
-			std::string vertex1, vertex2, vertex3;
-			unsigned int vertexIndex[3], uvIndex[3], normalIndex[3];
-			int matches = fscanf(file, "%d/%d/%d %d/%d/%d %d/%d/%d\n", &vertexIndex[0], &uvIndex[0], &normalIndex[0], &vertexIndex[1], &uvIndex[1], &normalIndex[1], &vertexIndex[2], &uvIndex[2], &normalIndex[2] );
-			if (matches != 9){
-				printf("File can't be read by our simple parser :-( Try exporting with other options\n");
-				return false;
-			}
-			vertexIndices.push_back(vertexIndex[0]);
-			vertexIndices.push_back(vertexIndex[1]);
-			vertexIndices.push_back(vertexIndex[2]);
-			uvIndices    .push_back(uvIndex[0]);
-			uvIndices    .push_back(uvIndex[1]);
-			uvIndices    .push_back(uvIndex[2]);
-			normalIndices.push_back(normalIndex[0]);
-			normalIndices.push_back(normalIndex[1]);
-			normalIndices.push_back(normalIndex[2]);
-    }
-		else{
-			// Probably a comment, eat up the rest of the line
-			char stupidBuffer[1000];
-
-      // fgets:
-      // Reads characters from stream and stores them as a C string 
-      // into str until (num-1) characters have been read or either 
-      // a newline or the end-of-file is reached, whichever happens first.
-			fgets(stupidBuffer, 1000, file);
-		}
-    //We go through each vertex ( each v/vt/vn ) of each triangle ( each line with a “f” ) :
-    // For each vertex of each triangle
-    for( unsigned int i=0; i<vertexIndices.size(); i++ ){
-
-      // Get the indices of its attributes
-      unsigned int vertexIndex = vertexIndices[i];
-      unsigned int uvIndex = uvIndices[i];
-      unsigned int normalIndex = normalIndices[i];
-      
-      // Get the attributes thanks to the index
-      glm::vec3 vertex = temp_vertices[ vertexIndex-1 ];
-      glm::vec2 uv = temp_uvs[ uvIndex-1 ];
-      glm::vec3 normal = temp_normals[ normalIndex-1 ];
-      
-      // Put the attributes in buffers
-      out_vertices.push_back(vertex);
-      out_uvs     .push_back(uv);
-      out_normals .push_back(normal);
-    }
-  }
-  return true;
+// Reads a BMP, TGA or PPM, compresses it to BC1 (BC3 if it has alpha) with
+// a full mipmap chain and uploads that : a quarter to an eighth of the
+// memory loadBMP takes. Rows go up top first, as from a DDS file, so UVs
+// are the ones of loadDDS, not of loadBMP.
+GLuint loadCompressed(const char * imagepath) {
+	std::vector<unsigned char> pixels, blocks;
+	unsigned int width, height;
+	bool alpha;
+	if (!readImageRGBA(imagepath, pixels, width, height, alpha)) return 0;
+	DDSImage image;
+	encodeDDS(&pixels[0], width, height, alpha, image, blocks);
+	std::vector<unsigned char>().swap(pixels);
+	return uploadDDS(image);
 }
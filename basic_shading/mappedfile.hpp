@@ -0,0 +1,66 @@
+#ifndef MAPPEDFILE_HPP
+#define MAPPEDFILE_HPP
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#if defined(__unix__) || defined(unix) || defined(__APPLE__)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#define MAPPED_FILE_HAVE_MMAP
+#endif
+
+// A whole file, read-only. Mapped where the platform allows it, otherwise
+// read into one malloc'd block.
+struct MappedFile {
+	const char * data;
+	size_t size;
+	bool mapped;
+};
+
+bool mapFile(const char * path, MappedFile & file) {
+	file.data = NULL;
+	file.size = 0;
+	file.mapped = false;
+#ifdef MAPPED_FILE_HAVE_MMAP
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) return false;
+	struct stat st;
+	if (fstat(fd, &st) != 0) { close(fd); return false; }
+	file.size = (size_t)st.st_size;
+	if (file.size > 0) {
+		void * p = mmap(NULL, file.size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (p == MAP_FAILED) { close(fd); return false; }
+		madvise(p, file.size, MADV_SEQUENTIAL);
+		file.data = (const char *)p;
+		file.mapped = true;
+	}
+	close(fd);
+	return true;
+#else
+	FILE * fp = fopen(path, "rb");
+	if (!fp) return false;
+	fseek(fp, 0, SEEK_END);
+	file.size = (size_t)ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+	char * buffer = (char *)malloc(file.size ? file.size : 1);
+	if (fread(buffer, 1, file.size, fp) != file.size) { free(buffer); fclose(fp); return false; }
+	fclose(fp);
+	file.data = buffer;
+	return true;
+#endif
+}
+
+void unmapFile(MappedFile & file) {
+#ifdef MAPPED_FILE_HAVE_MMAP
+	if (file.mapped) munmap((void *)file.data, file.size);
+#else
+	free((void *)file.data);
+#endif
+	file.data = NULL;
+	file.size = 0;
+}
+
+#endif
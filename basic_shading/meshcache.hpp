@@ -0,0 +1,274 @@
+#ifndef MESHCACHE_HPP
+#define MESHCACHE_HPP
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <sys/stat.h>
+
+// Include GLM
+#include <glm/glm.hpp>
+
+#include "objloader.hpp"
+#include "vboindexer.hpp"
+#include "meshoptimize.hpp"
+#include "meshsimplify.hpp"
+#include "quantize.hpp"
+
+// Binary cache of an indexed mesh, written next to the .obj it comes from
+// ("suzanne.obj" -> "suzanne.obj.mesh"). The file is the header below
+// followed by the positions, uvs, normals, the same vertices quantized
+// (QuantizedVertex, with the offset and scale in the header), indices and
+// levels of detail, each starting on a 16-byte boundary, in the byte order
+// of the machine that wrote it. The indices are those of every level, the
+// full mesh first ; the MeshLOD table says where each level is. Once
+// mapped, every stream can go to glBufferData as is.
+#define MESH_CACHE_MAGIC   0x4853454D // "MESH"
+#define MESH_CACHE_VERSION 4
+
+struct MeshCacheHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t byteOrder;   // 0x01020304 as written
+	uint32_t indexSize;   // 2 or 4 bytes
+	uint32_t vertexCount;
+	uint32_t indexCount;  // of all the levels
+	uint32_t lodCount;
+	uint32_t reserved;
+	// The .obj this was built from ; the cache is rebuilt if they change.
+	uint64_t sourceSize;
+	int64_t  sourceMtime;
+	float    boundsMin[3];
+	float    boundsMax[3];
+	float    positionOffset[3]; // of the quantized positions
+	float    positionScale[3];
+	uint64_t verticesOffset;
+	uint64_t uvsOffset;
+	uint64_t normalsOffset;
+	uint64_t quantizedOffset;
+	uint64_t indicesOffset;
+	uint64_t lodsOffset;
+	uint64_t fileSize;
+};
+
+// A cache file mapped in memory (or, if it couldn't be written, built in
+// memory). The pointers are valid until closeMeshCache.
+struct CachedMesh {
+	MappedFile file;
+	std::vector<char> image;
+	unsigned int vertexCount;
+	unsigned int indexCount; // of all the levels ; lods[0] is the full mesh
+	unsigned int indexSize;
+	unsigned int lodCount;
+	glm::vec3 boundsMin, boundsMax;
+	const glm::vec3 * vertices;
+	const glm::vec2 * uvs;
+	const glm::vec3 * normals;
+	const QuantizedVertex * quantized; // the same vertices, quantized
+	glm::vec3 positionOffset, positionScale; // position = offset + quantized position * scale
+	const void * indices;
+	const MeshLOD * lods;
+};
+
+inline uint64_t meshCacheAlign(uint64_t offset) {
+	return (offset + 15) & ~(uint64_t)15;
+}
+
+bool meshCacheSourceStat(const char * objpath, uint64_t * size, int64_t * mtime) {
+	struct stat st;
+	if (stat(objpath, &st) != 0) return false;
+	*size = (uint64_t)st.st_size;
+	*mtime = (int64_t)st.st_mtime;
+	return true;
+}
+
+// Lays out an indexed mesh in the cache format, in memory. `quantized`
+// holds the same vertices as QuantizedVertex.
+template <typename Index>
+void buildMeshCache(const char * objpath, const std::vector<Index> & indices, const std::vector<glm::vec3> & vertices, const std::vector<glm::vec2> & uvs, const std::vector<glm::vec3> & normals,
+	const QuantizedMesh & quantized, const std::vector<MeshLOD> & lods, std::vector<char> & image) {
+	MeshCacheHeader header;
+	memset(&header, 0, sizeof header);
+	header.magic = MESH_CACHE_MAGIC;
+	header.version = MESH_CACHE_VERSION;
+	header.byteOrder = 0x01020304;
+	header.indexSize = sizeof(Index);
+	header.vertexCount = (uint32_t)vertices.size();
+	header.indexCount = (uint32_t)indices.size();
+	header.lodCount = (uint32_t)lods.size();
+	meshCacheSourceStat(objpath, &header.sourceSize, &header.sourceMtime);
+
+	glm::vec3 lo(0.0f), hi(0.0f);
+	if (!vertices.empty()) lo = hi = vertices[0];
+	for (size_t i = 1; i < vertices.size(); i++) {
+		lo = glm::min(lo, vertices[i]);
+		hi = glm::max(hi, vertices[i]);
+	}
+	for (int k = 0; k < 3; k++) {
+		header.boundsMin[k] = lo[k];
+		header.boundsMax[k] = hi[k];
+		header.positionOffset[k] = quantized.offset[k];
+		header.positionScale[k] = quantized.scale[k];
+	}
+
+	header.verticesOffset = meshCacheAlign(sizeof header);
+	header.uvsOffset      = meshCacheAlign(header.verticesOffset + vertices.size() * sizeof(glm::vec3));
+	header.normalsOffset  = meshCacheAlign(header.uvsOffset + uvs.size() * sizeof(glm::vec2));
+	header.quantizedOffset = meshCacheAlign(header.normalsOffset + normals.size() * sizeof(glm::vec3));
+	header.indicesOffset  = meshCacheAlign(header.quantizedOffset + quantized.vertices.size() * sizeof(QuantizedVertex));
+	header.lodsOffset     = meshCacheAlign(header.indicesOffset + indices.size() * sizeof(Index));
+	header.fileSize       = header.lodsOffset + lods.size() * sizeof(MeshLOD);
+
+	image.assign((size_t)header.fileSize, 0);
+	memcpy(&image[0], &header, sizeof header);
+	if (!vertices.empty()) memcpy(&image[header.verticesOffset], &vertices[0], vertices.size() * sizeof(glm::vec3));
+	if (!uvs.empty())      memcpy(&image[header.uvsOffset], &uvs[0], uvs.size() * sizeof(glm::vec2));
+	if (!normals.empty())  memcpy(&image[header.normalsOffset], &normals[0], normals.size() * sizeof(glm::vec3));
+	if (!quantized.vertices.empty()) memcpy(&image[header.quantizedOffset], &quantized.vertices[0], quantized.vertices.size() * sizeof(QuantizedVertex));
+	if (!indices.empty())  memcpy(&image[header.indicesOffset], &indices[0], indices.size() * sizeof(Index));
+	if (!lods.empty())     memcpy(&image[header.lodsOffset], &lods[0], lods.size() * sizeof(MeshLOD));
+}
+
+// Writes a cache image to disk. Goes through a temporary file so that a
+// reader never sees half a cache.
+bool writeMeshCache(const char * cachepath, const std::vector<char> & image) {
+	std::string temppath = std::string(cachepath) + ".tmp";
+	FILE * fp = fopen(temppath.c_str(), "wb");
+	if (!fp) return false;
+	bool ok = fwrite(&image[0], 1, image.size(), fp) == image.size();
+	ok = fclose(fp) == 0 && ok;
+	if (!ok || rename(temppath.c_str(), cachepath) != 0) {
+		remove(temppath.c_str());
+		return false;
+	}
+	return true;
+}
+
+// Whether `count` items of `stride` bytes from `offset` end before `next`,
+// with `offset` on a 16-byte boundary.
+inline bool meshCacheFits(uint64_t offset, uint64_t count, uint64_t stride, uint64_t next) {
+	return offset % 16 == 0 && offset <= next && count * stride <= next - offset;
+}
+
+// Whether every index is below `vertexCount`.
+template <typename Index>
+bool meshCacheIndicesFit(const Index * indices, uint32_t count, uint32_t vertexCount) {
+	for (uint32_t i = 0; i < count; i++)
+		if (indices[i] >= vertexCount) return false;
+	return true;
+}
+
+// Checks a cache image and points `mesh` into it. Returns its header, or
+// NULL if the data isn't a cache this code can read. Every stream has to
+// lie within the file, before the next one, and every index has to name a
+// vertex, so that a damaged cache can't make the draw calls read outside
+// the buffers.
+const MeshCacheHeader * viewMeshCache(const char * data, size_t size, CachedMesh & mesh) {
+	const MeshCacheHeader * header = (const MeshCacheHeader *)data;
+	bool ok = size >= sizeof(MeshCacheHeader) &&
+		header->magic == MESH_CACHE_MAGIC && header->version == MESH_CACHE_VERSION &&
+		header->byteOrder == 0x01020304 && header->fileSize == size &&
+		(header->indexSize == 2 || header->indexSize == 4) &&
+		header->verticesOffset >= sizeof(MeshCacheHeader) &&
+		meshCacheFits(header->verticesOffset, header->vertexCount, sizeof(glm::vec3), header->uvsOffset) &&
+		meshCacheFits(header->uvsOffset, header->vertexCount, sizeof(glm::vec2), header->normalsOffset) &&
+		meshCacheFits(header->normalsOffset, header->vertexCount, sizeof(glm::vec3), header->quantizedOffset) &&
+		meshCacheFits(header->quantizedOffset, header->vertexCount, sizeof(QuantizedVertex), header->indicesOffset) &&
+		meshCacheFits(header->indicesOffset, header->indexCount, header->indexSize, header->lodsOffset) &&
+		header->lodCount >= 1 && header->lodCount <= MESH_LOD_MAX &&
+		meshCacheFits(header->lodsOffset, header->lodCount, sizeof(MeshLOD), size);
+	if (!ok) return NULL;
+	const MeshLOD * lods = (const MeshLOD *)(data + header->lodsOffset);
+	for (uint32_t i = 0; i < header->lodCount; i++)
+		if ((uint64_t)lods[i].firstIndex + lods[i].indexCount > header->indexCount) return NULL;
+	const char * indices = data + header->indicesOffset;
+	if (header->indexSize == 2 ? !meshCacheIndicesFit((const unsigned short *)indices, header->indexCount, header->vertexCount)
+		: !meshCacheIndicesFit((const unsigned int *)indices, header->indexCount, header->vertexCount))
+		return NULL;
+
+	mesh.vertexCount = header->vertexCount;
+	mesh.indexCount  = header->indexCount;
+	mesh.indexSize   = header->indexSize;
+	mesh.lodCount    = header->lodCount;
+	mesh.boundsMin   = glm::vec3(header->boundsMin[0], header->boundsMin[1], header->boundsMin[2]);
+	mesh.boundsMax   = glm::vec3(header->boundsMax[0], header->boundsMax[1], header->boundsMax[2]);
+	mesh.positionOffset = glm::vec3(header->positionOffset[0], header->positionOffset[1], header->positionOffset[2]);
+	mesh.positionScale  = glm::vec3(header->positionScale[0], header->positionScale[1], header->positionScale[2]);
+	mesh.vertices = (const glm::vec3 *)(data + header->verticesOffset);
+	mesh.uvs      = (const glm::vec2 *)(data + header->uvsOffset);
+	mesh.normals  = (const glm::vec3 *)(data + header->normalsOffset);
+	mesh.quantized = (const QuantizedVertex *)(data + header->quantizedOffset);
+	mesh.indices  = indices;
+	mesh.lods     = lods;
+	return header;
+}
+
+// Maps `cachepath` and checks it against `objpath`. Fails, without
+// printing anything, if the cache is missing, stale or not ours.
+bool openMeshCache(const char * cachepath, const char * objpath, CachedMesh & mesh) {
+	if (!mapFile(cachepath, mesh.file)) return false;
+
+	const MeshCacheHeader * header = viewMeshCache(mesh.file.data, mesh.file.size, mesh);
+	uint64_t sourceSize;
+	int64_t sourceMtime;
+	bool ok = header != NULL;
+	// A missing .obj is fine : the cache can ship on its own.
+	if (ok && meshCacheSourceStat(objpath, &sourceSize, &sourceMtime))
+		ok = sourceSize == header->sourceSize && sourceMtime == header->sourceMtime;
+	if (!ok) unmapFile(mesh.file);
+	return ok;
+}
+
+void closeMeshCache(CachedMesh & mesh) {
+	unmapFile(mesh.file);
+	std::vector<char>().swap(mesh.image);
+}
+
+// Read the .obj at `path` through its binary cache : maps `path`.mesh if
+// it is up to date, otherwise loads the .obj, optimizes it for the vertex
+// cache and overdraw (optimizeMesh), builds its levels of detail
+// (buildLODChain), quantizes its vertices (quantizeVertices, whose error
+// is printed then), writes the cache and maps that. 16-bit indices are used
+// whenever the mesh is small enough.
+bool loadOBJCached(const char * path, CachedMesh & mesh) {
+	std::string cachepath = std::string(path) + ".mesh";
+	if (openMeshCache(cachepath.c_str(), path, mesh)) return true;
+
+	std::vector<unsigned int> indices;
+	std::vector<glm::vec3> vertices;
+	std::vector<glm::vec2> uvs;
+	std::vector<glm::vec3> normals;
+	if (!loadOBJIndexed(path, indices, vertices, uvs, normals)) return false;
+	optimizeMesh(indices, vertices, uvs, normals);
+	std::vector<MeshLOD> lods;
+	if (!vertices.empty()) buildLODChain(indices, &vertices[0], vertices.size(), lods);
+	else lods.resize(1, MeshLOD());
+	QuantizedMesh quantized;
+	if (!vertices.empty()) {
+		quantizeVertices(&vertices[0], &uvs[0], &normals[0], vertices.size(), quantized);
+		printQuantizationError(path, quantizationError(quantized, &vertices[0], &uvs[0], &normals[0]));
+	}
+
+	std::vector<char> image;
+	if (vertices.size() <= 65536) {
+		std::vector<unsigned short> shortIndices(indices.begin(), indices.end());
+		buildMeshCache(path, shortIndices, vertices, uvs, normals, quantized, lods, image);
+	} else {
+		buildMeshCache(path, indices, vertices, uvs, normals, quantized, lods, image);
+	}
+	if (writeMeshCache(cachepath.c_str(), image) && openMeshCache(cachepath.c_str(), path, mesh))
+		return true;
+
+	// Read-only directory or the like : use the image we just built.
+	printf("Impossible to write the mesh cache %s, using it from memory\n", cachepath.c_str());
+	mesh.file.data = NULL;
+	mesh.file.size = 0;
+	mesh.file.mapped = false;
+	mesh.image.swap(image);
+	viewMeshCache(&mesh.image[0], mesh.image.size(), mesh);
+	return true;
+}
+
+#endif
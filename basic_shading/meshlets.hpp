@@ -0,0 +1,183 @@
+#ifndef MESHLETS_HPP
+#define MESHLETS_HPP
+
+#include <math.h>
+#include <vector>
+
+// Include GLM
+#include <glm/glm.hpp>
+
+// Splits an indexed mesh into meshlets, small runs of triangles that can be
+// culled on their own, and culls them against the view frustum and against
+// their normal cone (all triangles facing away from the camera).
+//
+// A meshlet is a contiguous range of the index buffer, so the ones that
+// survive culling are drawn straight from the mesh's element buffer with
+// one glMultiDrawElements. Ranges are cut in index buffer order : run
+// optimizeVertexCache first and they come out compact.
+
+#define MESHLET_MAX_VERTICES  64
+#define MESHLET_MAX_TRIANGLES 124
+
+struct Meshlet {
+	unsigned int firstIndex;
+	unsigned int indexCount;
+	unsigned int vertexCount;
+	// Bounding sphere.
+	glm::vec3 center;
+	float radius;
+	// Every triangle normal is within acos(sqrt(1 - coneCutoff^2)) of
+	// coneAxis ; coneCutoff is 2 (never culled) if they spread too wide.
+	glm::vec3 coneAxis;
+	float coneCutoff;
+};
+
+// Bounding sphere and normal cone of the triangles of `meshlet`, whose
+// distinct vertices are `unique`.
+template <typename Index>
+void computeMeshletBounds(const Index * indices, const glm::vec3 * vertices, const std::vector<unsigned int> & unique, Meshlet & meshlet) {
+	// Centre of the bounding box, then the farthest vertex from it : not
+	// the smallest sphere, but close and cheap.
+	glm::vec3 lo = vertices[unique[0]], hi = lo;
+	for (size_t i = 1; i < unique.size(); i++) {
+		lo = glm::min(lo, vertices[unique[i]]);
+		hi = glm::max(hi, vertices[unique[i]]);
+	}
+	meshlet.center = (lo + hi) * 0.5f;
+	float radius2 = 0.0f;
+	for (size_t i = 0; i < unique.size(); i++) {
+		glm::vec3 d = vertices[unique[i]] - meshlet.center;
+		radius2 = fmaxf(radius2, glm::dot(d, d));
+	}
+	meshlet.radius = sqrtf(radius2);
+
+	const Index * triangle = indices + meshlet.firstIndex;
+	size_t triangleCount = meshlet.indexCount / 3;
+	std::vector<glm::vec3> normals;
+	normals.reserve(triangleCount);
+	glm::vec3 sum(0.0f);
+	for (size_t t = 0; t < triangleCount; t++, triangle += 3) {
+		const glm::vec3 & a = vertices[triangle[0]];
+		glm::vec3 n = glm::cross(vertices[triangle[1]] - a, vertices[triangle[2]] - a);
+		float length = glm::length(n);
+		if (length == 0.0f) continue;
+		normals.push_back(n / length);
+		sum += normals.back();
+	}
+	float length = glm::length(sum);
+	meshlet.coneAxis = length > 0.0f ? sum / length : glm::vec3(0.0f, 0.0f, 1.0f);
+	float minDot = 1.0f;
+	for (size_t i = 0; i < normals.size(); i++) minDot = fminf(minDot, glm::dot(normals[i], meshlet.coneAxis));
+	// Past 90 degrees some triangle always faces the camera.
+	meshlet.coneCutoff = length > 0.0f && minDot > 0.0f ? sqrtf(1.0f - minDot * minDot) : 2.0f;
+}
+
+// Cuts `indices` into meshlets of at most MESHLET_MAX_VERTICES distinct
+// vertices and MESHLET_MAX_TRIANGLES triangles each, appended to
+// `meshlets`.
+template <typename Index>
+void buildMeshlets(const Index * indices, size_t indexCount, const glm::vec3 * vertices, size_t vertexCount, std::vector<Meshlet> & meshlets) {
+	// Which meshlet last used each vertex, to count distinct ones.
+	std::vector<unsigned int> seen(vertexCount, 0xFFFFFFFFu);
+	std::vector<unsigned int> unique;
+	unique.reserve(MESHLET_MAX_VERTICES);
+	Meshlet meshlet;
+	meshlet.firstIndex = 0;
+	meshlet.indexCount = 0;
+	unsigned int id = (unsigned int)meshlets.size();
+
+	for (size_t i = 0; i + 2 < indexCount; i += 3) {
+		const Index * t = indices + i;
+		size_t added = (seen[t[0]] != id) + (seen[t[1]] != id && t[1] != t[0]) + (seen[t[2]] != id && t[2] != t[0] && t[2] != t[1]);
+		if (meshlet.indexCount / 3 == MESHLET_MAX_TRIANGLES || unique.size() + added > MESHLET_MAX_VERTICES) {
+			meshlet.vertexCount = (unsigned int)unique.size();
+			computeMeshletBounds(indices, vertices, unique, meshlet);
+			meshlets.push_back(meshlet);
+			meshlet.firstIndex = (unsigned int)i;
+			meshlet.indexCount = 0;
+			unique.clear();
+			id++;
+		}
+		for (int k = 0; k < 3; k++) {
+			Index v = indices[i + k];
+			if (seen[v] != id) {
+				seen[v] = id;
+				unique.push_back(v);
+			}
+		}
+		meshlet.indexCount += 3;
+	}
+	if (meshlet.indexCount > 0) {
+		meshlet.vertexCount = (unsigned int)unique.size();
+		computeMeshletBounds(indices, vertices, unique, meshlet);
+		meshlets.push_back(meshlet);
+	}
+}
+
+// The six planes of the frustum of `mvp`, in the space the mesh is in
+// (Gribb and Hartmann) : a point p is inside when dot(plane.xyz, p) +
+// plane.w >= 0 for all six.
+struct Frustum {
+	glm::vec4 planes[6];
+};
+
+inline Frustum frustumFromMatrix(const glm::mat4 & mvp) {
+	Frustum frustum;
+	for (int i = 0; i < 3; i++) {
+		for (int side = 0; side < 2; side++) {
+			glm::vec4 plane;
+			for (int c = 0; c < 4; c++)
+				plane[c] = mvp[c][3] + (side ? -mvp[c][i] : mvp[c][i]);
+			float length = sqrtf(plane.x * plane.x + plane.y * plane.y + plane.z * plane.z);
+			frustum.planes[i * 2 + side] = length > 0.0f ? plane / length : plane;
+		}
+	}
+	return frustum;
+}
+
+struct MeshletCullStats {
+	size_t meshlets, triangles;
+	size_t frustumCulled, backfaceCulled; // triangles, by each test
+};
+
+// Fills `counts` and `offsets` (in bytes, for an `indexSize`-byte element
+// buffer) with the meshlets that are at least partly in the frustum and
+// not entirely facing away from `camera`, both in the space of the mesh.
+// Returns how many there are, ready for glMultiDrawElements.
+size_t cullMeshlets(const std::vector<Meshlet> & meshlets, const glm::mat4 & mvp, const glm::vec3 & camera, unsigned int indexSize,
+	std::vector<int> & counts, std::vector<const void *> & offsets, MeshletCullStats * stats = NULL) {
+	Frustum frustum = frustumFromMatrix(mvp);
+	counts.resize(meshlets.size());
+	offsets.resize(meshlets.size());
+	size_t visible = 0, frustumCulled = 0, backfaceCulled = 0, triangles = 0;
+	for (size_t m = 0; m < meshlets.size(); m++) {
+		const Meshlet & meshlet = meshlets[m];
+		triangles += meshlet.indexCount / 3;
+		bool inside = true;
+		for (int p = 0; p < 6 && inside; p++) {
+			const glm::vec4 & plane = frustum.planes[p];
+			inside = plane.x * meshlet.center.x + plane.y * meshlet.center.y + plane.z * meshlet.center.z + plane.w >= -meshlet.radius;
+		}
+		if (!inside) {
+			frustumCulled += meshlet.indexCount / 3;
+			continue;
+		}
+		glm::vec3 view = meshlet.center - camera;
+		if (glm::dot(view, meshlet.coneAxis) >= meshlet.coneCutoff * glm::length(view) + meshlet.radius) {
+			backfaceCulled += meshlet.indexCount / 3;
+			continue;
+		}
+		counts[visible] = (int)meshlet.indexCount;
+		offsets[visible] = (const void *)((size_t)meshlet.firstIndex * indexSize);
+		visible++;
+	}
+	if (stats) {
+		stats->meshlets = meshlets.size();
+		stats->triangles = triangles;
+		stats->frustumCulled = frustumCulled;
+		stats->backfaceCulled = backfaceCulled;
+	}
+	return visible;
+}
+
+#endif
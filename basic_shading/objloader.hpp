@@ -0,0 +1,759 @@
+#ifndef OBJLOADER_HPP
+#define OBJLOADER_HPP
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <limits.h>
+#include <math.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+// Include GLM
+#include <glm/glm.hpp>
+
+#include "threads.hpp"
+
+#include "arena.hpp"
+#include "mappedfile.hpp"
+
+// Tokenizer. Every function takes the current position and the end of the
+// buffer, never reads past `end`, and does not depend on the C locale.
+
+inline const char * objSkipSpaces(const char * p, const char * end) {
+	while (p < end && (*p == ' ' || *p == '\t')) p++;
+	return p;
+}
+
+// Returns the first character of the next non-empty line. Lines may end in
+// LF, CRLF or a lone CR (suzanne.obj has all three).
+inline const char * objSkipLine(const char * p, const char * end) {
+	while (p < end && *p != '\n' && *p != '\r') p++;
+	while (p < end && (*p == '\n' || *p == '\r' || *p == ' ' || *p == '\t')) p++;
+	return p;
+}
+
+inline bool objIsDigit(char c) {
+	return (unsigned char)(c - '0') < 10;
+}
+
+inline double objScale10(double value, int exponent) {
+	static const double pow10[] = {
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+		1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+	};
+	if (exponent < 0)
+		return exponent >= -22 ? value / pow10[-exponent] : value * pow(10.0, exponent);
+	if (exponent > 0)
+		return exponent <= 22 ? value * pow10[exponent] : value * pow(10.0, exponent);
+	return value;
+}
+
+// Appends the run of decimal digits at `p` to `value` and returns the end of
+// the run.
+inline const char * objParseDigits(const char * p, const char * end, uint64_t & value) {
+	while (p < end && objIsDigit(*p))
+		value = value * 10 + (*p++ - '0');
+	return p;
+}
+
+// Parses [+-]digits[.digits][(e|E)[+-]digits]. The mantissa is gathered as
+// an integer and scaled once by an exact power of ten, which is correctly
+// rounded for everything an exporter writes out (up to 15 significant
+// digits). Returns NULL if there is no number at `p`.
+inline const char * objParseFloat(const char * p, const char * end, float * out) {
+	bool negative = false;
+	if (p < end && (*p == '-' || *p == '+')) {
+		negative = *p == '-';
+		p++;
+	}
+
+	// Fast path : plain decimals short enough for the mantissa to fit in 64
+	// bits without any bookkeeping, which is what every exporter writes.
+	const char * start = p;
+	uint64_t mantissa = 0;
+	p = objParseDigits(p, end, mantissa);
+	int digits = (int)(p - start);
+	int exponent = 0;
+	if (p < end && *p == '.') {
+		const char * fraction = ++p;
+		p = objParseDigits(p, end, mantissa);
+		exponent = (int)(fraction - p);
+		digits -= exponent;
+	}
+	if (digits == 0) return NULL;
+	if (digits > 19) {
+		// Too many digits : start over, keeping only the first 19.
+		const char * q = start;
+		int kept = 0;
+		mantissa = 0;
+		exponent = 0;
+		for (; q < end && objIsDigit(*q); q++) {
+			if (kept < 19) {
+				mantissa = mantissa * 10 + (*q - '0');
+				if (mantissa) kept++;
+			} else {
+				exponent++;
+			}
+		}
+		if (q < end && *q == '.') {
+			for (q++; q < end && objIsDigit(*q); q++) {
+				if (kept < 19) {
+					mantissa = mantissa * 10 + (*q - '0');
+					if (mantissa) kept++;
+					exponent--;
+				}
+			}
+		}
+	}
+
+	if (p < end && (*p == 'e' || *p == 'E')) {
+		const char * e = p + 1;
+		bool negexp = false;
+		if (e < end && (*e == '-' || *e == '+')) {
+			negexp = *e == '-';
+			e++;
+		}
+		if (e < end && objIsDigit(*e)) {
+			int value = 0;
+			for (; e < end && objIsDigit(*e); e++)
+				if (value < 10000) value = value * 10 + (*e - '0');
+			exponent += negexp ? -value : value;
+			p = e;
+		}
+	}
+
+	double value = objScale10((double)mantissa, exponent);
+	*out = (float)(negative ? -value : value);
+	return p;
+}
+
+// Parses an optionally negative decimal integer. Returns NULL if there is
+// none at `p`, or if it doesn't fit in an int.
+inline const char * objParseIndex(const char * p, const char * end, int * out) {
+	bool negative = p < end && *p == '-';
+	if (negative) p++;
+	if (p >= end || !objIsDigit(*p)) return NULL;
+	int value = 0;
+	for (; p < end && objIsDigit(*p); p++) {
+		int digit = *p - '0';
+		if (value > (INT_MAX - digit) / 10) return NULL;
+		value = value * 10 + digit;
+	}
+	*out = negative ? -value : value;
+	return p;
+}
+
+// A run of triangles sharing an object/group name and a material, from the
+// `o`, `g` and `usemtl` statements.
+struct ObjSubmesh {
+	std::string name;
+	std::string material;
+	size_t first; // first vertex (or index) of the run
+	size_t count;
+};
+
+// Where a group or material changes, in the corners of an ObjData. A range
+// of the file parsed on its own doesn't know the name or material in effect
+// where it starts ; those stay unknown until the ranges are put back
+// together.
+struct ObjGroupChange {
+	size_t firstCorner;
+	std::string name, material;
+	bool nameKnown, materialKnown;
+};
+
+// Everything read from the text of an .obj, before indices are resolved.
+// Lives in `arena` if one is given, on the heap otherwise.
+struct ObjData {
+	ObjData(Arena * arena = NULL) :
+		vertices(arena), uvs(arena), normals(arena),
+		vertexIndices(arena), uvIndices(arena), normalIndices(arena),
+		relativeVertices(arena), relativeUvs(arena), relativeNormals(arena),
+		groups(arena), partial(false) {}
+
+	std::vector<glm::vec3, ArenaAllocator<glm::vec3> > vertices;
+	std::vector<glm::vec2, ArenaAllocator<glm::vec2> > uvs;
+	std::vector<glm::vec3, ArenaAllocator<glm::vec3> > normals;
+	// 1-based, three entries per triangle. 0 means the corner has no uv or
+	// no normal.
+	std::vector<unsigned int, ArenaAllocator<unsigned int> > vertexIndices, uvIndices, normalIndices;
+	// Corners whose index was relative (negative) : they were resolved
+	// against the attributes of this range only, and must be shifted by the
+	// attributes that come before it in the file.
+	std::vector<size_t, ArenaAllocator<size_t> > relativeVertices, relativeUvs, relativeNormals;
+	std::vector<ObjGroupChange, ArenaAllocator<ObjGroupChange> > groups;
+	// A range that doesn't start the file : a relative index may reach
+	// before it, and is only checked once shifted.
+	bool partial;
+};
+
+// One v, v/vt, v//vn or v/vt/vn of a face.
+struct ObjCorner {
+	unsigned int v, vt, vn;
+	bool relativeV, relativeVt, relativeVn;
+};
+
+// Turns a file index into a 1-based index into `count` attributes ; a
+// negative index counts back from the last attribute read so far. False if
+// it counts back past the first one, unless `partial`, where that is only
+// known once the range is shifted.
+inline bool objResolveIndex(int index, size_t count, bool partial, unsigned int * out, bool * relative) {
+	*relative = index < 0;
+	if (index < 0 && !partial && (size_t)-(long long)index > count) return false;
+	*out = index < 0 ? (unsigned int)(count + 1 + index) : (unsigned int)index;
+	return true;
+}
+
+inline const char * objParseCorner(const char * p, const char * end, const ObjData & data, ObjCorner & corner) {
+	int v, vt = 0, vn = 0;
+	if (!(p = objParseIndex(p, end, &v)) || v == 0) return NULL;
+	if (p < end && *p == '/') {
+		p++;
+		if (p < end && *p != '/' && !(p = objParseIndex(p, end, &vt))) return NULL;
+		if (p < end && *p == '/') {
+			if (!(p = objParseIndex(p + 1, end, &vn))) return NULL;
+		}
+	}
+	if (!objResolveIndex(v, data.vertices.size(), data.partial, &corner.v, &corner.relativeV) ||
+		!objResolveIndex(vt, data.uvs.size(), data.partial, &corner.vt, &corner.relativeVt) ||
+		!objResolveIndex(vn, data.normals.size(), data.partial, &corner.vn, &corner.relativeVn))
+		return NULL;
+	return p;
+}
+
+inline void objPushCorner(ObjData & data, const ObjCorner & corner) {
+	size_t at = data.vertexIndices.size();
+	if (corner.relativeV)  data.relativeVertices.push_back(at);
+	if (corner.relativeVt) data.relativeUvs.push_back(at);
+	if (corner.relativeVn) data.relativeNormals.push_back(at);
+	data.vertexIndices.push_back(corner.v);
+	data.uvIndices    .push_back(corner.vt);
+	data.normalIndices.push_back(corner.vn);
+}
+
+// The rest of the line, without surrounding blanks.
+inline std::string objRestOfLine(const char * p, const char * end) {
+	p = objSkipSpaces(p, end);
+	const char * last = p;
+	while (last < end && *last != '\n' && *last != '\r') last++;
+	while (last > p && (last[-1] == ' ' || last[-1] == '\t')) last--;
+	return std::string(p, last);
+}
+
+inline bool objIsKeyword(const char * p, const char * end, const char * keyword, size_t length) {
+	return (size_t)(end - p) > length && memcmp(p, keyword, length) == 0 && (p[length] == ' ' || p[length] == '\t');
+}
+
+// Parses the lines in [begin, end) and appends them to `data`. Returns the
+// start of the offending line if something can't be read, NULL otherwise.
+const char * objParseRange(const char * begin, const char * end, ObjData & data) {
+	const char * p = begin;
+	while (p < end) {
+		const char * line = p;
+		p = objSkipSpaces(p, end);
+		if (p >= end) break;
+		if (*p == '\n' || *p == '\r') {
+			p = objSkipLine(p, end);
+			continue;
+		}
+
+		if (p[0] == 'v' && p + 1 < end && (p[1] == ' ' || p[1] == '\t')) {
+			glm::vec3 vertex;
+			p = objSkipSpaces(p + 1, end);
+			if (!(p = objParseFloat(p, end, &vertex.x))) return line;
+			p = objSkipSpaces(p, end);
+			if (!(p = objParseFloat(p, end, &vertex.y))) return line;
+			p = objSkipSpaces(p, end);
+			if (!(p = objParseFloat(p, end, &vertex.z))) return line;
+			data.vertices.push_back(vertex);
+		}
+		else if (p[0] == 'v' && p + 2 < end && p[1] == 't' && (p[2] == ' ' || p[2] == '\t')) {
+			glm::vec2 uv;
+			p = objSkipSpaces(p + 2, end);
+			if (!(p = objParseFloat(p, end, &uv.x))) return line;
+			p = objSkipSpaces(p, end);
+			if (!(p = objParseFloat(p, end, &uv.y))) return line;
+			uv.y = -uv.y; // Invert V coordinate since we will only use DDS texture, which are inverted. Remove if you want to use TGA or BMP loaders.
+			data.uvs.push_back(uv);
+		}
+		else if (p[0] == 'v' && p + 2 < end && p[1] == 'n' && (p[2] == ' ' || p[2] == '\t')) {
+			glm::vec3 normal;
+			p = objSkipSpaces(p + 2, end);
+			if (!(p = objParseFloat(p, end, &normal.x))) return line;
+			p = objSkipSpaces(p, end);
+			if (!(p = objParseFloat(p, end, &normal.y))) return line;
+			p = objSkipSpaces(p, end);
+			if (!(p = objParseFloat(p, end, &normal.z))) return line;
+			data.normals.push_back(normal);
+		}
+		else if (p[0] == 'f' && p + 1 < end && (p[1] == ' ' || p[1] == '\t')) {
+			// Triangles, quads and bigger polygons alike : corners 0, i-1, i
+			// make a triangle for every corner i after the second, a fan.
+			ObjCorner first, previous, corner;
+			int n = 0;
+			p++;
+			for (;;) {
+				p = objSkipSpaces(p, end);
+				if (p >= end || *p == '\n' || *p == '\r' || *p == '#') break;
+				if (!(p = objParseCorner(p, end, data, corner))) return line;
+				if (n == 0) {
+					first = corner;
+				} else if (n >= 2) {
+					objPushCorner(data, first);
+					objPushCorner(data, previous);
+					objPushCorner(data, corner);
+				}
+				previous = corner;
+				n++;
+			}
+			if (n < 3) return line;
+		}
+		else if (objIsKeyword(p, end, "o", 1) || objIsKeyword(p, end, "g", 1) || objIsKeyword(p, end, "usemtl", 6)) {
+			ObjGroupChange change;
+			if (data.groups.empty()) {
+				change.nameKnown = change.materialKnown = false;
+			} else {
+				change = data.groups.back();
+			}
+			change.firstCorner = data.vertexIndices.size();
+			if (p[0] == 'u') {
+				change.material = objRestOfLine(p + 6, end);
+				change.materialKnown = true;
+			} else {
+				change.name = objRestOfLine(p + 1, end);
+				change.nameKnown = true;
+			}
+			// Several statements before the same face make one change.
+			if (!data.groups.empty() && data.groups.back().firstCorner == change.firstCorner)
+				data.groups.back() = change;
+			else
+				data.groups.push_back(change);
+		}
+		// Anything else is a comment or something we don't use : the rest of
+		// the line is skipped below.
+		p = objSkipLine(p, end);
+	}
+	return NULL;
+}
+
+// How many attributes and triangle corners objParseRange will find in
+// [begin, end), from a quick look at the start of each line and at the
+// corners of each face.
+struct ObjCounts {
+	size_t vertices, uvs, normals, corners;
+};
+
+void objCountRange(const char * begin, const char * end, ObjCounts & counts) {
+	counts.vertices = counts.uvs = counts.normals = counts.corners = 0;
+	const char * p = objSkipSpaces(begin, end);
+	while (p < end) {
+		if (p + 1 < end && p[0] == 'v') {
+			if (p[1] == ' ' || p[1] == '\t') counts.vertices++;
+			else if (p[1] == 't') counts.uvs++;
+			else if (p[1] == 'n') counts.normals++;
+		} else if (p + 1 < end && p[0] == 'f' && (p[1] == ' ' || p[1] == '\t')) {
+			size_t n = 0;
+			for (p++; ; n++) {
+				p = objSkipSpaces(p, end);
+				if (p >= end || *p == '\n' || *p == '\r' || *p == '#') break;
+				while (p < end && *p != ' ' && *p != '\t' && *p != '\n' && *p != '\r') p++;
+			}
+			if (n >= 3) counts.corners += 3 * (n - 2);
+		}
+		p = objSkipLine(p, end);
+	}
+}
+
+// Sizes the arrays of `data` for `counts` once, so that parsing never
+// grows them, and tells the arena what that saved.
+void objReserve(ObjData & data, const ObjCounts & counts, Arena * arena) {
+	data.vertices.reserve(counts.vertices);
+	data.uvs.reserve(counts.uvs);
+	data.normals.reserve(counts.normals);
+	data.vertexIndices.reserve(counts.corners);
+	data.uvIndices.reserve(counts.corners);
+	data.normalIndices.reserve(counts.corners);
+	if (!arena) return;
+	arena->noteReserve(counts.vertices, sizeof(glm::vec3));
+	arena->noteReserve(counts.uvs, sizeof(glm::vec2));
+	arena->noteReserve(counts.normals, sizeof(glm::vec3));
+	for (int i = 0; i < 3; i++) arena->noteReserve(counts.corners, sizeof(unsigned int));
+}
+
+// Turns the group changes of a whole file (corners counted from the start
+// of the file) into runs of faces, appended to `out_submeshes` with their
+// vertices shifted by `first`. Empty runs are left out.
+template <typename Changes>
+void objBuildSubmeshes(const Changes & changes, size_t ncorners, size_t first, std::vector<ObjSubmesh> & out_submeshes) {
+	ObjSubmesh submesh;
+	submesh.first = 0;
+	for (size_t i = 0; i <= changes.size(); i++) {
+		size_t next = i < changes.size() ? changes[i].firstCorner : ncorners;
+		if (next > submesh.first) {
+			submesh.count = next - submesh.first;
+			out_submeshes.push_back(submesh);
+			out_submeshes.back().first += first;
+		}
+		if (i == changes.size()) break;
+		if (changes[i].nameKnown) submesh.name = changes[i].name;
+		if (changes[i].materialKnown) submesh.material = changes[i].material;
+		submesh.first = next;
+	}
+}
+
+// Flat normal of the triangle abc.
+inline glm::vec3 objFaceNormal(const glm::vec3 & a, const glm::vec3 & b, const glm::vec3 & c) {
+	glm::vec3 n = glm::cross(b - a, c - a);
+	float length = glm::length(n);
+	return length > 0.0f ? n / length : glm::vec3(0.0f, 0.0f, 1.0f);
+}
+
+// Looks up the attributes of the face corners of `faces` and writes them
+// to out_*, one vertex per corner, in file order. Indices refer into the
+// attribute arrays of `attributes`, which may be `faces` itself. Corners
+// without a uv get (0,0) ; corners without a normal get their triangle's.
+bool objExpandRange(const ObjData & faces, const ObjData & attributes, glm::vec3 * out_vertices, glm::vec2 * out_uvs, glm::vec3 * out_normals) {
+	size_t nindices = faces.vertexIndices.size();
+	for (size_t i = 0; i < nindices; i += 3) {
+		bool flat = false;
+		for (size_t j = i; j < i + 3; j++) {
+			unsigned int vertexIndex = faces.vertexIndices[j];
+			unsigned int uvIndex = faces.uvIndices[j];
+			unsigned int normalIndex = faces.normalIndices[j];
+
+			if (vertexIndex-1 >= attributes.vertices.size() ||
+				(uvIndex != 0 && uvIndex-1 >= attributes.uvs.size()) ||
+				(normalIndex != 0 && normalIndex-1 >= attributes.normals.size()))
+				return false;
+
+			out_vertices[j] = attributes.vertices[vertexIndex-1];
+			out_uvs[j]      = uvIndex ? attributes.uvs[uvIndex-1] : glm::vec2(0.0f, 0.0f);
+			if (normalIndex)
+				out_normals[j] = attributes.normals[normalIndex-1];
+			else
+				flat = true;
+		}
+		if (flat) {
+			glm::vec3 n = objFaceNormal(out_vertices[i], out_vertices[i+1], out_vertices[i+2]);
+			for (size_t j = i; j < i + 3; j++)
+				if (!faces.normalIndices[j]) out_normals[j] = n;
+		}
+	}
+	return true;
+}
+
+// Appends the expanded triangles of `data` to the output buffers.
+bool objExpand(const ObjData & data, std::vector<glm::vec3> & out_vertices, std::vector<glm::vec2> & out_uvs, std::vector<glm::vec3> & out_normals) {
+	size_t first = out_vertices.size();
+	size_t nindices = data.vertexIndices.size();
+	out_vertices.resize(first + nindices);
+	out_uvs     .resize(first + nindices);
+	out_normals .resize(first + nindices);
+	if (nindices == 0) return true;
+	return objExpandRange(data, data, &out_vertices[first], &out_uvs[first], &out_normals[first]);
+}
+
+// Read file `path`, write the data in out_vertices|out_uvs|out_normals and
+// the runs of faces of each group/material in out_submeshes, and return if
+// something went wrong. With an `arena`, the parsed text is counted first
+// and kept in the arena, sized once, until the function returns.
+bool loadOBJ(const char * path, std::vector<glm::vec3> & out_vertices, std::vector<glm::vec2> & out_uvs, std::vector<glm::vec3> & out_normals, std::vector<ObjSubmesh> & out_submeshes, Arena * arena = NULL) {
+	ArenaScope scope(arena);
+	MappedFile file;
+	if (!mapFile(path, file)) {
+		printf("Impossible to open the file ! Are you in the right path ? See Tutorial 1 for details\n");
+		getchar();
+		return false;
+	}
+
+	ObjData data(arena);
+	if (arena) {
+		ObjCounts counts;
+		objCountRange(file.data, file.data + file.size, counts);
+		objReserve(data, counts, arena);
+	}
+	const char * error = objParseRange(file.data, file.data + file.size, data);
+	unmapFile(file);
+	if (error) {
+		printf("File can't be read by our simple parser :-( Try exporting with other options\n");
+		return false;
+	}
+
+	size_t first = out_vertices.size();
+	if (!objExpand(data, out_vertices, out_uvs, out_normals)) {
+		printf("Face references a vertex that doesn't exist in %s\n", path);
+		return false;
+	}
+	objBuildSubmeshes(data.groups, data.vertexIndices.size(), first, out_submeshes);
+	return true;
+}
+
+// Read file `path`, write the data in out_vertices|out_uvs|out_normals and return if something went wrong.
+bool loadOBJ(const char * path, std::vector<glm::vec3> & out_vertices, std::vector<glm::vec2> & out_uvs, std::vector<glm::vec3> & out_normals) {
+	std::vector<ObjSubmesh> submeshes;
+	return loadOBJ(path, out_vertices, out_uvs, out_normals, submeshes);
+}
+
+bool loadOBJ(const char * path, std::vector<glm::vec3> & out_vertices, std::vector<glm::vec2> & out_uvs, std::vector<glm::vec3> & out_normals, Arena * arena) {
+	std::vector<ObjSubmesh> submeshes;
+	return loadOBJ(path, out_vertices, out_uvs, out_normals, submeshes, arena);
+}
+
+// Receives the triangles of loadOBJStreaming, `count` corners (a multiple
+// of three) at a time, laid out as loadOBJ would. The pointers are only
+// valid during the call : copy the data where it has to go, for instance
+// into a buffer mapped with glMapBufferRange. Return false to stop loading.
+typedef bool (*ObjBatchSink)(void * user, const glm::vec3 * vertices, const glm::vec2 * uvs, const glm::vec3 * normals, size_t count);
+
+// Same triangles as loadOBJ, but the file is read `window` bytes at a time
+// and the triangles of each window are handed to `sink` as soon as they are
+// expanded. Only the window, its triangles and the v/vt/vn read so far are
+// ever held in memory. A line longer than the window makes it grow.
+// out_submeshes counts corners from the first one given to `sink`.
+bool loadOBJStreaming(const char * path, ObjBatchSink sink, void * user, std::vector<ObjSubmesh> & out_submeshes, size_t window = 4 << 20) {
+	FILE * file = fopen(path, "rb");
+	if (!file) {
+		printf("Impossible to open the file ! Are you in the right path ? See Tutorial 1 for details\n");
+		getchar();
+		return false;
+	}
+
+	// No bigger than the file itself.
+	fseek(file, 0, SEEK_END);
+	long size = ftell(file);
+	fseek(file, 0, SEEK_SET);
+	if (size >= 0 && (size_t)size < window) window = (size_t)size;
+	std::vector<char> buffer(window > 0 ? window : 1);
+	std::vector<glm::vec3> vertices, normals;
+	std::vector<glm::vec2> uvs;
+	std::vector<ObjGroupChange> groups;
+	// Keeps every attribute, so that indices, relative ones included, are
+	// resolved as in loadOBJ ; the faces are dropped after each window.
+	ObjData data;
+	size_t used = 0, ncorners = 0;
+	bool ok = true;
+	for (;;) {
+		if (used == buffer.size()) buffer.resize(buffer.size() * 2);
+		used += fread(&buffer[used], 1, buffer.size() - used, file);
+		if (ferror(file)) {
+			printf("Impossible to read %s\n", path);
+			ok = false;
+			break;
+		}
+		bool last = feof(file) != 0;
+
+		// Parse up to the last line break ; the line cut by the window is
+		// kept for the next read.
+		const char * begin = &buffer[0];
+		const char * end = begin + used;
+		const char * cut = end;
+		if (!last) {
+			while (cut > begin && cut[-1] != '\n' && cut[-1] != '\r') cut--;
+			if (cut == begin) continue;
+		}
+		if (objParseRange(begin, cut, data)) {
+			printf("File can't be read by our simple parser :-( Try exporting with other options\n");
+			ok = false;
+			break;
+		}
+
+		size_t count = data.vertexIndices.size();
+		vertices.resize(count);
+		uvs     .resize(count);
+		normals .resize(count);
+		if (count > 0 && !objExpandRange(data, data, &vertices[0], &uvs[0], &normals[0])) {
+			printf("Face references a vertex that doesn't exist in %s\n", path);
+			ok = false;
+			break;
+		}
+		if (count > 0 && !sink(user, &vertices[0], &uvs[0], &normals[0], count)) {
+			ok = false;
+			break;
+		}
+
+		for (size_t i = 0; i < data.groups.size(); i++) {
+			groups.push_back(data.groups[i]);
+			groups.back().firstCorner += ncorners;
+		}
+		ncorners += count;
+		data.vertexIndices.clear();
+		data.uvIndices.clear();
+		data.normalIndices.clear();
+		data.relativeVertices.clear();
+		data.relativeUvs.clear();
+		data.relativeNormals.clear();
+		data.groups.clear();
+
+		used = end - cut;
+		memmove(&buffer[0], cut, used);
+		if (last) break;
+	}
+	fclose(file);
+	if (ok) objBuildSubmeshes(groups, ncorners, 0, out_submeshes);
+	return ok;
+}
+
+bool loadOBJStreaming(const char * path, ObjBatchSink sink, void * user, size_t window = 4 << 20) {
+	std::vector<ObjSubmesh> submeshes;
+	return loadOBJStreaming(path, sink, user, submeshes, window);
+}
+
+// One slice of the file, for loadOBJParallel. Each thread parses its own
+// slice into its own ObjData, then writes its triangles at the offset the
+// slices before it add up to.
+struct ObjChunk {
+	const char * begin;
+	const char * end;
+	const char * error;
+	ObjData data;
+
+	// Filled in between the two passes.
+	ObjData * merged;
+	size_t firstVertex, firstUv, firstNormal, firstCorner;
+	glm::vec3 * out_vertices;
+	glm::vec2 * out_uvs;
+	glm::vec3 * out_normals;
+	bool ok;
+};
+
+int objParseChunk(void * arg) {
+	ObjChunk * chunk = (ObjChunk *)arg;
+	chunk->error = objParseRange(chunk->begin, chunk->end, chunk->data);
+	return 0;
+}
+
+// Shifts the relative indices of a chunk by the attributes before it.
+// False if one still counts back past the first attribute of the file.
+bool objShiftRelative(std::vector<unsigned int, ArenaAllocator<unsigned int> > & indices, const std::vector<size_t, ArenaAllocator<size_t> > & relative, size_t first) {
+	bool ok = true;
+	for (size_t i = 0; i < relative.size(); i++) {
+		// Below 1, wrapped around, if it counted back past the chunk's start.
+		long long index = (long long)(int)indices[relative[i]] + (long long)first;
+		if (index <= 0) ok = false;
+		indices[relative[i]] = (unsigned int)index;
+	}
+	return ok;
+}
+
+int objStitchChunk(void * arg) {
+	ObjChunk * chunk = (ObjChunk *)arg;
+	ObjData * merged = chunk->merged;
+	// Relative indices were resolved as if the chunk were the whole file.
+	ObjData & data = chunk->data;
+	if (!objShiftRelative(data.vertexIndices, data.relativeVertices, chunk->firstVertex) ||
+		!objShiftRelative(data.uvIndices, data.relativeUvs, chunk->firstUv) ||
+		!objShiftRelative(data.normalIndices, data.relativeNormals, chunk->firstNormal))
+		chunk->error = chunk->begin;
+	std::copy(chunk->data.vertices.begin(), chunk->data.vertices.end(), merged->vertices.begin() + chunk->firstVertex);
+	std::copy(chunk->data.uvs.begin(), chunk->data.uvs.end(), merged->uvs.begin() + chunk->firstUv);
+	std::copy(chunk->data.normals.begin(), chunk->data.normals.end(), merged->normals.begin() + chunk->firstNormal);
+	return 0;
+}
+
+int objExpandChunk(void * arg) {
+	ObjChunk * chunk = (ObjChunk *)arg;
+	chunk->ok = objExpandRange(chunk->data, *chunk->merged,
+		chunk->out_vertices + chunk->firstCorner, chunk->out_uvs + chunk->firstCorner, chunk->out_normals + chunk->firstCorner);
+	return 0;
+}
+
+// Same as loadOBJ, but splits the file at line boundaries and parses the
+// pieces on `nthreads` threads (0 : one per core). Gives exactly the same
+// buffers as loadOBJ.
+bool loadOBJParallel(const char * path, std::vector<glm::vec3> & out_vertices, std::vector<glm::vec2> & out_uvs, std::vector<glm::vec3> & out_normals, std::vector<ObjSubmesh> & out_submeshes, unsigned int nthreads = 0) {
+	MappedFile file;
+	if (!mapFile(path, file)) {
+		printf("Impossible to open the file ! Are you in the right path ? See Tutorial 1 for details\n");
+		getchar();
+		return false;
+	}
+
+	// Small files aren't worth the threads.
+	if (nthreads == 0) nthreads = defaultThreadCount();
+	const size_t minChunk = 1 << 20;
+	if (file.size / nthreads < minChunk) nthreads = (unsigned int)(file.size / minChunk) + 1;
+
+	// Cut at the first line break after each even split point.
+	const char * end = file.data + file.size;
+	std::vector<ObjChunk> chunks(nthreads);
+	const char * p = file.data;
+	for (unsigned int i = 0; i < nthreads; i++) {
+		const char * cut = i + 1 == nthreads ? end : file.data + file.size / nthreads * (i + 1);
+		if (cut < p) cut = p;
+		while (cut < end && *cut != '\n' && *cut != '\r') cut++;
+		chunks[i].begin = p;
+		chunks[i].end = cut;
+		chunks[i].data.partial = i > 0;
+		p = cut;
+	}
+	runChunks(chunks, objParseChunk);
+
+	// Prefix sums : where each chunk's attributes and corners start.
+	ObjData merged;
+	size_t nvertices = 0, nuvs = 0, nnormals = 0, ncorners = 0;
+	bool ok = true;
+	for (unsigned int i = 0; i < nthreads; i++) {
+		ObjChunk & chunk = chunks[i];
+		if (chunk.error) ok = false;
+		chunk.merged = &merged;
+		chunk.firstVertex = nvertices;
+		chunk.firstUv = nuvs;
+		chunk.firstNormal = nnormals;
+		chunk.firstCorner = ncorners;
+		nvertices += chunk.data.vertices.size();
+		nuvs      += chunk.data.uvs.size();
+		nnormals  += chunk.data.normals.size();
+		ncorners  += chunk.data.vertexIndices.size();
+	}
+	unmapFile(file);
+	if (!ok) {
+		printf("File can't be read by our simple parser :-( Try exporting with other options\n");
+		return false;
+	}
+
+	merged.vertices.resize(nvertices);
+	merged.uvs.resize(nuvs);
+	merged.normals.resize(nnormals);
+	runChunks(chunks, objStitchChunk);
+	for (unsigned int i = 0; i < nthreads; i++) {
+		if (chunks[i].error) {
+			printf("File can't be read by our simple parser :-( Try exporting with other options\n");
+			return false;
+		}
+	}
+
+	size_t first = out_vertices.size();
+	out_vertices.resize(first + ncorners);
+	out_uvs     .resize(first + ncorners);
+	out_normals .resize(first + ncorners);
+	for (unsigned int i = 0; i < nthreads; i++) {
+		chunks[i].out_vertices = ncorners ? &out_vertices[first] : NULL;
+		chunks[i].out_uvs      = ncorners ? &out_uvs[first]      : NULL;
+		chunks[i].out_normals  = ncorners ? &out_normals[first]  : NULL;
+	}
+	runChunks(chunks, objExpandChunk);
+
+	std::vector<ObjGroupChange> groups;
+	for (unsigned int i = 0; i < nthreads; i++) {
+		if (!chunks[i].ok) {
+			printf("Face references a vertex that doesn't exist in %s\n", path);
+			return false;
+		}
+		for (size_t j = 0; j < chunks[i].data.groups.size(); j++) {
+			groups.push_back(chunks[i].data.groups[j]);
+			groups.back().firstCorner += chunks[i].firstCorner;
+		}
+	}
+	objBuildSubmeshes(groups, ncorners, first, out_submeshes);
+	return true;
+}
+
+bool loadOBJParallel(const char * path, std::vector<glm::vec3> & out_vertices, std::vector<glm::vec2> & out_uvs, std::vector<glm::vec3> & out_normals, unsigned int nthreads = 0) {
+	std::vector<ObjSubmesh> submeshes;
+	return loadOBJParallel(path, out_vertices, out_uvs, out_normals, submeshes, nthreads);
+}
+
+#endif
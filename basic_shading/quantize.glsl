@@ -0,0 +1,13 @@
+// Set for meshes uploaded as QuantizedVertex (see quantize.hpp) : positions
+// are 16-bit steps across the mesh bounds, normals are octahedral.
+uniform bool QuantizedVertices;
+uniform vec3 PositionOffset;
+uniform vec3 PositionScale;
+
+// Unfolds a normal from the [-1,1]^2 square onto the unit sphere.
+vec3 octDecode(vec2 e){
+	vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	float t = max(-n.z, 0.0);
+	n.xy += mix(vec2(t), vec2(-t), greaterThanEqual(n.xy, vec2(0.0)));
+	return normalize(n);
+}
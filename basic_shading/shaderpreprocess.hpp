@@ -0,0 +1,210 @@
+#ifndef SHADERPREPROCESS_HPP
+#define SHADERPREPROCESS_HPP
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <sys/stat.h>
+
+#include "mappedfile.hpp"
+
+// Shader files as they go to glShaderSource : every #include "file"
+// replaced by that file, and the defines of a permutation put after the
+// #version line.
+//
+// An included path is relative to the file that includes it. The GLSL
+// preprocessor still does everything else, so an include guard
+// (#ifndef/#define) keeps a file from going in twice, and an #include
+// under an #if that is false is read all the same. The #version line of an
+// included file is left out ; #line directives keep the line numbers of
+// the compiler's messages right, with the file as source string number :
+// files[n] of the ShaderSource is what "n:" stands for in a log.
+//
+// A file without #include comes out as LoadShaders has always read it.
+//
+// Preprocessed sources are kept per path and defines, and given again
+// while none of the files that went in has changed size or modification
+// time. Files saved a moment ago aren't kept, as two saves within one tick
+// of the file system's clock would look the same.
+
+// Puts `defines`, GLSL text such as "#define FOG\n", right after the
+// #version line of `code` (at the start if there is none).
+void insertShaderDefines(std::string & code, const char * defines) {
+	if (!defines || !*defines) return;
+	size_t at = 0, version = code.find("#version");
+	if (version != std::string::npos) {
+		at = code.find('\n', version);
+		at = at == std::string::npos ? code.size() : at + 1;
+	}
+	std::string text(defines);
+	if (text[text.size() - 1] != '\n') text += '\n';
+	code.insert(at, text);
+}
+
+// When `path` was last written, in seconds on the realtime clock, and its
+// size ; 0 and -1 if it isn't there.
+struct ShaderFileStamp {
+	double modified;
+	long long size;
+};
+
+inline ShaderFileStamp shaderFileStamp(const char * path) {
+	ShaderFileStamp stamp = { 0, -1 };
+	struct stat st;
+	if (stat(path, &st) != 0) return stamp;
+#ifdef __APPLE__
+	stamp.modified = st.st_mtimespec.tv_sec + st.st_mtimespec.tv_nsec * 1e-9;
+#else
+	stamp.modified = st.st_mtim.tv_sec + st.st_mtim.tv_nsec * 1e-9;
+#endif
+	stamp.size = (long long)st.st_size;
+	return stamp;
+}
+
+inline double shaderFileTime(const char * path) { return shaderFileStamp(path).modified; }
+
+struct ShaderSource {
+	std::string code;
+	std::vector<std::string> files; // the file itself, then every file it includes
+};
+
+struct ShaderSourceCacheEntry {
+	ShaderSource source;
+	std::vector<ShaderFileStamp> stamps; // of source.files
+};
+
+struct ShaderPreprocessStats {
+	unsigned long hits;   // path and defines known, files unchanged : nothing read
+	unsigned long misses; // preprocessed
+	unsigned long files;  // read, includes too
+	unsigned long includes;
+};
+
+inline ShaderPreprocessStats & shaderPreprocessStats() {
+	static ShaderPreprocessStats stats = { 0, 0, 0, 0 };
+	return stats;
+}
+
+// The name in `#include "name"` if the line from `p` to `end` is one ;
+// `name` is left empty for an #include without quotes.
+static bool shaderIncludeLine(const char * p, const char * end, std::string & name) {
+	while (p < end && (*p == ' ' || *p == '\t')) p++;
+	if (p == end || *p++ != '#') return false;
+	while (p < end && (*p == ' ' || *p == '\t')) p++;
+	if (end - p < 7 || memcmp(p, "include", 7) != 0) return false;
+	p += 7;
+	while (p < end && (*p == ' ' || *p == '\t')) p++;
+	name.clear();
+	if (p == end || *p != '"') return true;
+	const char * close = (const char *)memchr(p + 1, '"', end - p - 1);
+	if (close) name.assign(p + 1, close);
+	return true;
+}
+
+static bool shaderVersionLine(const char * p, const char * end) {
+	while (p < end && (*p == ' ' || *p == '\t')) p++;
+	if (p == end || *p++ != '#') return false;
+	while (p < end && (*p == ' ' || *p == '\t')) p++;
+	return end - p >= 7 && memcmp(p, "version", 7) == 0;
+}
+
+// Appends the file at `path`, and what it includes, to `source`. `stack`
+// holds the files being included, to stop at a file that includes itself.
+static bool shaderAppendFile(const std::string & path, ShaderSource & source, std::vector<std::string> & stack) {
+	for (size_t i = 0; i < stack.size(); i++) {
+		if (stack[i] != path) continue;
+		printf("%s : includes itself, through %s\n", path.c_str(), stack.back().c_str());
+		return false;
+	}
+	MappedFile file;
+	if (!mapFile(path.c_str(), file)) {
+		if (stack.empty()) printf("Impossible to open %s. Are you in the right directory ? Don't forget to read the FAQ !\n", path.c_str());
+		else printf("%s : can't open %s\n", stack.back().c_str(), path.c_str());
+		return false;
+	}
+	shaderPreprocessStats().files++;
+	stack.push_back(path);
+	char number[32];
+	unsigned long index = source.files.size();
+	source.files.push_back(path);
+	size_t slash = path.rfind('/');
+	std::string dir = slash == std::string::npos ? "" : path.substr(0, slash + 1);
+
+	size_t size = file.size;
+	if (size && file.data[size - 1] == '\n') size--;
+	const char * p = file.data, * end = file.data + size;
+	unsigned long line = 1;
+	bool ok = true;
+	std::string name;
+	while (ok && p < end) {
+		const char * eol = (const char *)memchr(p, '\n', end - p);
+		if (!eol) eol = end;
+		if (shaderIncludeLine(p, eol, name)) {
+			if (name.empty()) {
+				printf("%s:%lu : #include needs a \"file\"\n", path.c_str(), line);
+				ok = false;
+				break;
+			}
+			shaderPreprocessStats().includes++;
+			snprintf(number, sizeof number, "#line 1 %lu\n", (unsigned long)source.files.size());
+			source.code += number;
+			ok = shaderAppendFile(name[0] == '/' ? name : dir + name, source, stack);
+			snprintf(number, sizeof number, "\n#line %lu %lu", line + 1, index);
+			source.code += number;
+		} else if (!shaderVersionLine(p, eol) || stack.size() == 1) {
+			source.code.append(p, eol);
+		}
+		if (eol < end) source.code += '\n';
+		p = eol + 1;
+		line++;
+	}
+	unmapFile(file);
+	stack.pop_back();
+	return ok;
+}
+
+// The source of the shader at `path` with `defines` (NULL for none), from
+// the files or as it was last time.
+bool preprocessShader(const char * path, const char * defines, ShaderSource & source) {
+	static std::map<std::string, ShaderSourceCacheEntry> cache;
+	std::string key = std::string(path) + '\0' + (defines ? defines : "");
+	std::map<std::string, ShaderSourceCacheEntry>::iterator c = cache.find(key);
+	if (c != cache.end()) {
+		bool same = true;
+		for (size_t i = 0; same && i < c->second.stamps.size(); i++) {
+			ShaderFileStamp now = shaderFileStamp(c->second.source.files[i].c_str());
+			same = now.modified == c->second.stamps[i].modified && now.size == c->second.stamps[i].size;
+		}
+		if (same) {
+			shaderPreprocessStats().hits++;
+			source = c->second.source;
+			return true;
+		}
+		cache.erase(c);
+	}
+
+	shaderPreprocessStats().misses++;
+	ShaderSourceCacheEntry entry;
+	std::vector<std::string> stack;
+	// Each line after a '\n', as LoadShaders has always read them.
+	entry.source.code = "\n";
+	if (!shaderAppendFile(path, entry.source, stack)) return false;
+	insertShaderDefines(entry.source.code, defines);
+	source = entry.source;
+
+	// Not kept if a file was written in the last two seconds : it may have
+	// changed again since it was read, within the same modification time.
+	double recent = (double)time(NULL) - 2;
+	for (size_t i = 0; i < entry.source.files.size(); i++) {
+		entry.stamps.push_back(shaderFileStamp(entry.source.files[i].c_str()));
+		if (entry.stamps[i].modified > recent) return true;
+	}
+	cache[key] = entry;
+	return true;
+}
+
+#endif
@@ -0,0 +1,435 @@
+#ifndef TEXTUREATLAS_HPP
+#define TEXTUREATLAS_HPP
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "mipgen.hpp"
+
+// readImageRGBA comes from common.hpp, to be included first.
+
+// Many small textures as one : packed side by side into a single 2D
+// atlas, or into the layers of a GL_TEXTURE_2D_ARRAY, so that whatever is
+// drawn with them needs one glBindTexture a frame instead of one a draw.
+//
+// Rectangles are placed by a skyline packer : each layer keeps the outline
+// of what is already placed, as horizontal segments, and a new rectangle
+// goes where its top ends lowest, then where it leaves the least space
+// unusable under it. Tallest first. A 2D atlas starts at the smallest
+// power of two square that could hold everything and grows until it does,
+// then its height is cut to what was used ; an array has layers of a fixed
+// size and opens a new one when nothing fits in the others.
+//
+// Each image keeps a gutter of `padding` texels, its own edge texels
+// repeated, so that bilinear filtering doesn't pull its neighbours in.
+// Mipmaps stop at the level where the gutter is one texel wide, and
+// rectangles sit on multiples of that level's texel so that none share one.
+//
+// Images are placed top row first, as loadDDS and loadCompressed do : a
+// mesh keeps the UVs it has for those. atlasRemapUVs moves them into the
+// image's rectangle (with the layer as a third coordinate for an array,
+// for a sampler2DArray) ; atlasTransform gives the same as a scale and
+// offset, for a vertex shader to apply. An atlas can't repeat : UVs are
+// moved by whole units into [0,1] a triangle at a time, and the triangles
+// that span more than one copy of the image are clamped and counted.
+
+enum AtlasKind {
+	ATLAS_2D,
+	ATLAS_ARRAY
+};
+
+// Where an image went, in texels, its gutter not included.
+struct AtlasRect {
+	unsigned int layer;
+	unsigned int x, y;
+	unsigned int width, height;
+};
+
+// Pixels of an image, RGBA8, tightly packed, top row first.
+struct AtlasImage {
+	const unsigned char * rgba;
+	unsigned int width, height;
+};
+
+struct TextureAtlas {
+	AtlasKind kind;
+	GLenum target;               // GL_TEXTURE_2D or GL_TEXTURE_2D_ARRAY
+	GLuint texture;              // 0 until uploadTextureAtlas
+	unsigned int width, height;  // of a layer
+	unsigned int layers;
+	unsigned int padding;        // gutter around each image
+	unsigned int levels;         // of the mipmap chain
+	std::vector<AtlasRect> rects;  // one per image, in the order given
+	double occupancy;            // image texels over layer texels
+};
+
+struct SkylineSegment {
+	unsigned int x, y, width;
+};
+
+struct SkylineLayer {
+	unsigned int width, height;
+	size_t freeArea;
+	std::vector<SkylineSegment> segments;
+};
+
+inline void skylineReset(SkylineLayer & layer, unsigned int width, unsigned int height) {
+	layer.width = width;
+	layer.height = height;
+	layer.freeArea = (size_t)width * height;
+	layer.segments.clear();
+	SkylineSegment floor = { 0, 0, width };
+	layer.segments.push_back(floor);
+}
+
+// The best place in `layer` for a `width` x `height` rectangle, against
+// the left or the right end of a segment : the one where its top is
+// lowest, then the one that wastes least under it. False if there is none.
+bool skylineFind(const SkylineLayer & layer, unsigned int width, unsigned int height, size_t & segment, unsigned int & x, unsigned int & y, unsigned long & waste) {
+	bool found = false;
+	unsigned int bestTop = 0;
+	unsigned long bestWaste = 0;
+	const std::vector<SkylineSegment> & s = layer.segments;
+	for (size_t k = 0; k < 2 * s.size(); k++) {
+		// Even k : left ends ; odd k : right ends, from the segment the rectangle starts on.
+		size_t i = k / 2;
+		unsigned int left = s[i].x;
+		if (k & 1) {
+			unsigned int right = s[i].x + s[i].width;
+			if (right < width) continue;
+			left = right - width;
+			while (i > 0 && s[i].x > left) i--;
+		}
+		if (left + width > layer.width) continue;
+		// The highest segment under the rectangle decides where it rests.
+		unsigned int top = 0;
+		size_t end = i;
+		for (; end < s.size() && s[end].x < left + width; end++)
+			if (s[end].y > top) top = s[end].y;
+		if (top + height > layer.height) continue;
+		if (found && top + height > bestTop) continue;
+		unsigned long lost = 0;
+		for (size_t j = i; j < end; j++) {
+			unsigned int l = std::max(s[j].x, left), right = std::min(s[j].x + s[j].width, left + width);
+			lost += (unsigned long)(top - s[j].y) * (right - l);
+		}
+		if (found && top + height == bestTop && lost >= bestWaste) continue;
+		found = true;
+		bestTop = top + height;
+		bestWaste = lost;
+		segment = i;
+		x = left;
+		y = top;
+	}
+	waste = bestWaste;
+	return found;
+}
+
+// Puts a rectangle where skylineFind said : its top becomes a segment,
+// over the ones it covers, and segments of the same height merge.
+void skylinePlace(SkylineLayer & layer, size_t segment, unsigned int x, unsigned int y, unsigned int width, unsigned int height) {
+	std::vector<SkylineSegment> & s = layer.segments;
+	SkylineSegment top = { x, y + height, width };
+	// What of the first segment is left of the rectangle stays.
+	if (s[segment].x < x) {
+		SkylineSegment left = { s[segment].x, s[segment].y, x - s[segment].x };
+		s.insert(s.begin() + segment, left);
+		s[++segment].width -= left.width;
+		s[segment].x = x;
+	}
+	s.insert(s.begin() + segment, top);
+	size_t i = segment + 1;
+	while (i < s.size() && s[i].x < x + width) {
+		unsigned int right = s[i].x + s[i].width;
+		if (right <= x + width) {
+			s.erase(s.begin() + i);
+		} else {
+			s[i].width = right - (x + width);
+			s[i].x = x + width;
+			break;
+		}
+	}
+	for (i = segment > 0 ? segment - 1 : 0; i + 1 < s.size() && s[i].x <= x + width; ) {
+		if (s[i].y == s[i + 1].y) {
+			s[i].width += s[i + 1].width;
+			s.erase(s.begin() + i + 1);
+		} else {
+			i++;
+		}
+	}
+	layer.freeArea -= (size_t)width * height;
+}
+
+struct SkylineTallerFirst {
+	const unsigned int * widths, * heights;
+	bool operator()(size_t a, size_t b) const {
+		if (heights[a] != heights[b]) return heights[a] > heights[b];
+		if (widths[a] != widths[b]) return widths[a] > widths[b];
+		return a < b;
+	}
+};
+
+// Places `count` rectangles in layers of `layerWidth` x `layerHeight`, at
+// most `maxLayers` of them. `rects` gets the place of each, in the order
+// given, and `layers` the number of layers used. False if a rectangle
+// fits nowhere.
+bool skylinePack(const unsigned int * widths, const unsigned int * heights, size_t count, unsigned int layerWidth, unsigned int layerHeight,
+	unsigned int maxLayers, std::vector<AtlasRect> & rects, unsigned int & layers) {
+	std::vector<size_t> order(count);
+	for (size_t i = 0; i < count; i++) order[i] = i;
+	SkylineTallerFirst taller = { widths, heights };
+	std::sort(order.begin(), order.end(), taller);
+
+	rects.resize(count);
+	std::vector<SkylineLayer> open;
+	for (size_t k = 0; k < count; k++) {
+		size_t i = order[k];
+		unsigned int w = widths[i], h = heights[i];
+		if (w > layerWidth || h > layerHeight) return false;
+		// Every layer with room enough, the lowest top of all of them.
+		bool found = false;
+		unsigned int bestTop = 0, bestLayer = 0, bestX = 0, bestY = 0;
+		size_t bestSegment = 0;
+		for (size_t l = 0; l < open.size(); l++) {
+			if (open[l].freeArea < (size_t)w * h) continue;
+			size_t segment;
+			unsigned int x, y;
+			unsigned long waste;
+			if (!skylineFind(open[l], w, h, segment, x, y, waste)) continue;
+			if (found && y + h >= bestTop) continue;
+			found = true;
+			bestTop = y + h;
+			bestLayer = (unsigned int)l;
+			bestSegment = segment;
+			bestX = x;
+			bestY = y;
+		}
+		if (!found) {
+			if (open.size() >= maxLayers) return false;
+			open.push_back(SkylineLayer());
+			skylineReset(open.back(), layerWidth, layerHeight);
+			bestLayer = (unsigned int)open.size() - 1;
+			bestSegment = 0;
+			bestX = bestY = 0;
+		}
+		skylinePlace(open[bestLayer], bestSegment, bestX, bestY, w, h);
+		AtlasRect & r = rects[i];
+		r.layer = bestLayer;
+		r.x = bestX;
+		r.y = bestY;
+		r.width = w;
+		r.height = h;
+	}
+	layers = (unsigned int)open.size();
+	return true;
+}
+
+inline unsigned int atlasPowerOfTwo(unsigned int n) {
+	unsigned int p = 1;
+	while (p < n) p <<= 1;
+	return p;
+}
+
+// Places images of `widths` x `heights` for an atlas of `kind`, without
+// any GL : `atlas` gets its size, layers, levels and rectangles. A 2D atlas
+// is at most `maxSize` square ; array layers are `layerSize` square (0 :
+// 1024, or the largest image if that is larger). False if they don't fit.
+bool packTextureAtlas(const unsigned int * widths, const unsigned int * heights, size_t count, AtlasKind kind, TextureAtlas & atlas,
+	unsigned int padding = 4, unsigned int layerSize = 0, unsigned int maxSize = 16384, unsigned int maxLayers = 2048) {
+	atlas.kind = kind;
+	atlas.target = kind == ATLAS_ARRAY ? GL_TEXTURE_2D_ARRAY : GL_TEXTURE_2D;
+	atlas.texture = 0;
+	atlas.padding = padding;
+	atlas.levels = 1;
+	while (padding >> atlas.levels) atlas.levels++;
+	unsigned int align = 1u << (atlas.levels - 1);
+
+	// Gutter included, rounded up to the texel of the last level.
+	std::vector<unsigned int> cellWidths(count), cellHeights(count);
+	unsigned int widest = 1, tallest = 1;
+	double area = 0, imageArea = 0;
+	for (size_t i = 0; i < count; i++) {
+		cellWidths[i] = (widths[i] + 2 * padding + align - 1) & ~(align - 1);
+		cellHeights[i] = (heights[i] + 2 * padding + align - 1) & ~(align - 1);
+		widest = std::max(widest, cellWidths[i]);
+		tallest = std::max(tallest, cellHeights[i]);
+		area += (double)cellWidths[i] * cellHeights[i];
+		imageArea += (double)widths[i] * heights[i];
+	}
+
+	bool packed = false;
+	if (kind == ATLAS_ARRAY) {
+		unsigned int size = layerSize ? layerSize : std::max(1024u, atlasPowerOfTwo(std::max(widest, tallest)));
+		atlas.width = atlas.height = size;
+		packed = skylinePack(count ? &cellWidths[0] : NULL, count ? &cellHeights[0] : NULL, count, size, size, maxLayers, atlas.rects, atlas.layers);
+	} else {
+		unsigned int w = atlasPowerOfTwo(std::max(widest, (unsigned int)ceil(sqrt(area))));
+		unsigned int h = atlasPowerOfTwo(std::max(tallest, (unsigned int)ceil(area / w)));
+		while (w <= maxSize && h <= maxSize) {
+			if (skylinePack(count ? &cellWidths[0] : NULL, count ? &cellHeights[0] : NULL, count, w, h, 1, atlas.rects, atlas.layers)) {
+				packed = true;
+				break;
+			}
+			if (h < w) h <<= 1;
+			else w <<= 1;
+		}
+		atlas.width = w;
+		atlas.height = 1;
+		for (size_t i = 0; i < atlas.rects.size() && packed; i++)
+			atlas.height = std::max(atlas.height, atlas.rects[i].y + atlas.rects[i].height);
+		atlas.layers = 1;
+	}
+	if (!packed) {
+		printf("Texture atlas : %lu images don't fit\n", (unsigned long)count);
+		atlas.rects.clear();
+		return false;
+	}
+	// From cells back to the images in them.
+	for (size_t i = 0; i < count; i++) {
+		atlas.rects[i].x += padding;
+		atlas.rects[i].y += padding;
+		atlas.rects[i].width = widths[i];
+		atlas.rects[i].height = heights[i];
+	}
+	atlas.occupancy = imageArea / ((double)atlas.width * atlas.height * atlas.layers);
+	return true;
+}
+
+// Copies `image` into `layer` (RGBA8, `stride` texels a row) at `rect`,
+// and fills its gutter, out to the cell's edges, with its edge texels.
+void atlasBlit(const AtlasImage & image, const AtlasRect & rect, unsigned int padding, unsigned int align, unsigned char * layer, size_t stride) {
+	unsigned int right = (rect.width + 2 * padding + align - 1) & ~(align - 1);
+	unsigned int bottom = (rect.height + 2 * padding + align - 1) & ~(align - 1);
+	unsigned int left = rect.x - padding, top = rect.y - padding;
+	for (unsigned int cy = 0; cy < bottom; cy++) {
+		unsigned int sy = cy < padding ? 0 : std::min(cy - padding, image.height - 1);
+		const unsigned char * src = image.rgba + (size_t)sy * image.width * 4;
+		unsigned char * dst = layer + ((size_t)(top + cy) * stride + left) * 4;
+		for (unsigned int cx = 0; cx < padding; cx++) memcpy(dst + cx * 4, src, 4);
+		memcpy(dst + padding * 4, src, (size_t)image.width * 4);
+		for (unsigned int cx = padding + image.width; cx < right; cx++) memcpy(dst + cx * 4, src + (image.width - 1) * 4, 4);
+	}
+}
+
+// Makes the texture of a packed atlas from the images it was packed for,
+// in the same order. Leaves it bound.
+bool uploadTextureAtlas(TextureAtlas & atlas, const AtlasImage * images, size_t count) {
+	if (count != atlas.rects.size()) return false;
+	GLint maxSize = 0, maxLayers = 0;
+	glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxSize);
+	glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &maxLayers);
+	if (atlas.width > (unsigned int)maxSize || atlas.height > (unsigned int)maxSize || (atlas.kind == ATLAS_ARRAY && atlas.layers > (unsigned int)maxLayers)) {
+		printf("Texture atlas : %ux%u, %u layers, is more than this GL takes (%d, %d layers)\n", atlas.width, atlas.height, atlas.layers, maxSize, maxLayers);
+		return false;
+	}
+
+	glGenTextures(1, &atlas.texture);
+	glBindTexture(atlas.target, atlas.texture);
+	GLint alignment;
+	glGetIntegerv(GL_UNPACK_ALIGNMENT, &alignment);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	if (atlas.kind == ATLAS_ARRAY)
+		for (unsigned int level = 0; level < atlas.levels; level++)
+			glTexImage3D(GL_TEXTURE_2D_ARRAY, level, GL_RGBA8, std::max(atlas.width >> level, 1u), std::max(atlas.height >> level, 1u), atlas.layers, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+
+	// A layer at a time : every image of it, then its levels.
+	unsigned int align = 1u << (atlas.levels - 1);
+	std::vector<unsigned char> pixels((size_t)atlas.width * atlas.height * 4);
+	MipChain chain;
+	for (unsigned int layer = 0; layer < atlas.layers; layer++) {
+		if (layer) memset(&pixels[0], 0, pixels.size());
+		for (size_t i = 0; i < count; i++)
+			if (atlas.rects[i].layer == layer) atlasBlit(images[i], atlas.rects[i], atlas.padding, align, &pixels[0], atlas.width);
+		if (atlas.levels > 1) buildMipChain(&pixels[0], atlas.width, atlas.height, 4, 0, true, chain, MIP_BOX, 0, atlas.levels);
+		for (unsigned int level = 0; level < atlas.levels; level++) {
+			const unsigned char * data = level ? chain.level(level) : &pixels[0];
+			unsigned int w = std::max(atlas.width >> level, 1u), h = std::max(atlas.height >> level, 1u);
+			if (atlas.kind == ATLAS_ARRAY) glTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, layer, w, h, 1, GL_RGBA, GL_UNSIGNED_BYTE, data);
+			else glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA8, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
+		}
+	}
+	glPixelStorei(GL_UNPACK_ALIGNMENT, alignment);
+	glTexParameteri(atlas.target, GL_TEXTURE_MAX_LEVEL, atlas.levels - 1);
+	glTexParameteri(atlas.target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(atlas.target, GL_TEXTURE_MIN_FILTER, atlas.levels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+	glTexParameteri(atlas.target, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(atlas.target, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	return true;
+}
+
+// Packs and uploads `count` images in memory.
+bool buildTextureAtlas(const AtlasImage * images, size_t count, AtlasKind kind, TextureAtlas & atlas, unsigned int padding = 4) {
+	std::vector<unsigned int> widths(count), heights(count);
+	for (size_t i = 0; i < count; i++) {
+		widths[i] = images[i].width;
+		heights[i] = images[i].height;
+	}
+	GLint maxSize = 0;
+	glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxSize);
+	if (!packTextureAtlas(count ? &widths[0] : NULL, count ? &heights[0] : NULL, count, kind, atlas, padding, 0, (unsigned int)maxSize)) return false;
+	return uploadTextureAtlas(atlas, images, count);
+}
+
+// The same from BMP, TGA and netpbm files (readImageRGBA), in the order
+// of `imagepaths`. Prints the atlas's size and how full it is.
+bool loadTextureAtlas(const std::vector<std::string> & imagepaths, AtlasKind kind, TextureAtlas & atlas, unsigned int padding = 4) {
+	std::vector<std::vector<unsigned char> > pixels(imagepaths.size());
+	std::vector<AtlasImage> images(imagepaths.size());
+	for (size_t i = 0; i < imagepaths.size(); i++) {
+		bool alpha;
+		if (!readImageRGBA(imagepaths[i].c_str(), pixels[i], images[i].width, images[i].height, alpha)) return false;
+		images[i].rgba = &pixels[i][0];
+	}
+	if (!buildTextureAtlas(images.empty() ? NULL : &images[0], images.size(), kind, atlas, padding)) return false;
+	printf("Texture atlas : %lu images in %ux%u%s%u, %.0f%% full\n", (unsigned long)images.size(), atlas.width, atlas.height,
+		kind == ATLAS_ARRAY ? " x " : ", layers : ", atlas.layers, atlas.occupancy * 100.0);
+	return true;
+}
+
+// Scale (x, y) and offset (z, w) that take UVs of image `image`, in
+// [0,1], to the atlas.
+inline glm::vec4 atlasTransform(const TextureAtlas & atlas, size_t image) {
+	const AtlasRect & r = atlas.rects[image];
+	return glm::vec4((float)r.width / atlas.width, (float)r.height / atlas.height, (float)r.x / atlas.width, (float)r.y / atlas.height);
+}
+
+// Moves the UVs of `count` corners, three a triangle, into the rectangle
+// of image `image`. Returns the number of triangles that had to be clamped.
+size_t atlasRemapUVs(glm::vec2 * uvs, size_t count, const TextureAtlas & atlas, size_t image) {
+	glm::vec4 t = atlasTransform(atlas, image);
+	size_t clamped = 0;
+	for (size_t i = 0; i + 3 <= count; i += 3) {
+		glm::vec2 * uv = uvs + i;
+		bool over = false;
+		for (int axis = 0; axis < 2; axis++) {
+			float low = std::min(uv[0][axis], std::min(uv[1][axis], uv[2][axis]));
+			float high = std::max(uv[0][axis], std::max(uv[1][axis], uv[2][axis]));
+			// Whole units, so that a triangle on [-1,0] (V turned for DDS) lands on [0,1].
+			float shift = -floorf(low + 1e-5f);
+			if (high + shift > 1.0f + 1e-5f) over = true;
+			for (int c = 0; c < 3; c++) {
+				float v = std::min(std::max(uv[c][axis] + shift, 0.0f), 1.0f);
+				uv[c][axis] = v * t[axis] + t[axis + 2];
+			}
+		}
+		if (over) clamped++;
+	}
+	return clamped;
+}
+
+// The same for an array : `out` gets the UVs and the layer.
+size_t atlasRemapUVs(const glm::vec2 * uvs, size_t count, const TextureAtlas & atlas, size_t image, glm::vec3 * out) {
+	std::vector<glm::vec2> moved(uvs, uvs + count);
+	size_t clamped = count ? atlasRemapUVs(&moved[0], count, atlas, image) : 0;
+	for (size_t i = 0; i < count; i++) out[i] = glm::vec3(moved[i].x, moved[i].y, (float)atlas.rects[image].layer);
+	return clamped;
+}
+
+#endif
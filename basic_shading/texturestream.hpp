@@ -0,0 +1,574 @@
+#ifndef TEXTURESTREAM_HPP
+#define TEXTURESTREAM_HPP
+
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <algorithm>
+
+#include <GL/glew.h>
+
+#include "deps/tinycthread.h"
+#include "mappedfile.hpp"
+
+// DDSImage, openDDS, closeDDS, decodeDDS, readBMPHeader and buildMipChain
+// come from common.hpp, to be included first.
+
+// Textures loaded in the background while the render loop runs.
+//
+// load() gives back a texture name at once. Worker threads map the file
+// and copy its pixels, a band of rows at a time, into a ring of pixel
+// buffer objects ; the GL thread, in update(), only hands the filled
+// buffers to glCompressedTexSubImage2D or glTexSubImage2D, up to a budget
+// of bytes per frame. A frame then never waits on the disk and never pays
+// for more than its share.
+//
+// The smallest levels of every texture go first. The mip tail, every level
+// that fits in one slot with all the smaller ones, is one band and goes up
+// before anything else of its texture, together with the storage of the
+// whole chain ; that storage counts against the budget too, since drivers
+// clear it, at about the cost of filling it. A texture samples as black
+// until its tail is in, then blurry, and sharpens as the larger levels
+// arrive : GL_TEXTURE_BASE_LEVEL follows the finest level of which every
+// row is uploaded.
+//
+// With GL_ARB_buffer_storage the ring is mapped once, persistently, and
+// the workers write straight into it ; otherwise the GL thread maps a slot
+// when it gives it to a worker and unmaps it just before the upload. Either
+// way a slot is reused only once the fence after its upload has signaled.
+//
+// DDS files (as openDDS reads them, 2D textures only) and BMP files (as
+// loadBMP reads them) are streamed. A BMP's mipmaps are made by the worker
+// that opens it, with buildMipChain as loadBMP makes them, and are then
+// streamed like the levels of a DDS.
+
+#define TEXTURE_STREAM_SLOTS     8
+#define TEXTURE_STREAM_SLOT_SIZE (1 << 20)
+#define TEXTURE_STREAM_BUDGET    (4 << 20) // bytes uploaded per update()
+
+// A texture being streamed. The image is filled in by the worker that
+// opens the file, everything else belongs to the GL thread.
+struct StreamedTexture {
+	std::string path;
+	GLuint texture;
+	DDSImage image;                           // a BMP is described as an uncompressed DDS
+	std::vector<unsigned char> decoded;       // image's pixels when decoded : BC1 to BC3, or an 8-bit or top-down BMP
+	MipChain mips;                            // a BMP's levels below the first ; none for a DDS
+	unsigned int alignment;                   // of its rows : 4 for BMP, 1 for DDS
+	unsigned int bandsLeft[DDS_MAX_LEVELS];   // per level, not uploaded yet
+	unsigned int tail;                        // first level of the mip tail ; levels if there is none
+	unsigned int resident;                    // finest complete level ; levels while there is none
+	bool allocated;                           // storage made
+	unsigned int pending;                     // bands of all levels not uploaded yet
+	bool opened;
+	bool bmp;                                 // sampled as loadBMP samples, once all in
+};
+
+// What a worker is asked to do : open a texture (slot < 0) or copy
+// `rowCount` rows of `level` from `firstRow` on into a slot. A `rowCount`
+// of 0 is the mip tail : every level from `level` on, whole.
+struct TextureStreamJob {
+	StreamedTexture * texture;
+	int slot;
+	unsigned int level, firstRow, rowCount;
+	size_t bytes;
+};
+
+// Uploads go smallest first, the tails before everything.
+inline size_t textureStreamPriority(const TextureStreamJob & job) {
+	return job.rowCount == 0 ? 0 : ddsLevelSize(job.texture->image, job.level);
+}
+
+inline unsigned int textureStreamRows(const StreamedTexture & t, unsigned int level) {
+	unsigned int height = t.image.height >> level;
+	if (height < 1) height = 1;
+	return t.image.format == 0 ? (height + 3) / 4 : height;
+}
+
+inline size_t textureStreamRowBytes(const StreamedTexture & t, unsigned int level) {
+	unsigned int width = t.image.width >> level;
+	if (width < 1) width = 1;
+	if (t.image.format == 0) return (size_t)((width + 3) / 4) * t.image.blockBytes;
+	return ((size_t)width * t.image.blockBytes + t.alignment - 1) / t.alignment * t.alignment;
+}
+
+// A BMP, as readBMPHeader reads it, mapped and described as an uncompressed
+// DDS : rows padded to 4 bytes and bottom row first as GL takes them. 24 and
+// 32-bit files stored bottom-up are streamed from the mapping ; 8-bit ones
+// are looked up in their palette, and top-down ones turned over, into
+// `decoded`. The levels below the first go in `mips`, made from it by
+// buildMipChain ; levelOffset gives them with padded rows too, as they are
+// laid out in a slot.
+bool openStreamedBMP(const char * imagepath, DDSImage & image, std::vector<unsigned char> & decoded, MipChain & mips) {
+	if (!mapFile(imagepath, image.file)) {
+		printf("%s could not be opened. Are you in the right directory ? Don't forget to read the FAQ !\n", imagepath);
+		return false;
+	}
+	BMPInfo info;
+	if (!readBMPHeader((const unsigned char *)image.file.data, image.file.size, info)) {
+		printf("Not a correct BMP file\n");
+		unmapFile(image.file);
+		return false;
+	}
+	image.width = info.width;
+	image.height = info.height;
+	image.levels = image.layers = image.faces = 1;
+	image.internalFormat = info.alpha ? GL_RGBA8 : GL_RGB8;
+	image.format = info.bpp == 8 ? GL_BGR : info.format;
+	image.type = GL_UNSIGNED_BYTE;
+	image.blockBytes = info.bpp == 8 ? 3 : info.bpp / 8;
+	size_t rowBytes = ((size_t)info.width * image.blockBytes + 3) & ~(size_t)3;
+	image.levelOffset[0] = 0;
+	image.levelOffset[1] = rowBytes * info.height;
+	image.pixels = info.pixels;
+	if (info.bpp == 8 || info.topDown) {
+		decoded.assign(image.levelOffset[1], 0);
+		for (unsigned int y = 0; y < info.height; y++) {
+			const unsigned char * src = info.pixels + (info.topDown ? info.height - 1 - y : y) * info.pitch;
+			unsigned char * dst = &decoded[y * rowBytes];
+			if (info.bpp != 8) {
+				memcpy(dst, src, rowBytes);
+				continue;
+			}
+			// Palette entries are B, G, R.
+			for (unsigned int x = 0; x < info.width; x++, dst += 3) {
+				unsigned int index = src[x] < info.paletteSize ? src[x] : 0;
+				memcpy(dst, info.palette + 4 * index, 3);
+			}
+		}
+		image.pixels = &decoded[0];
+	}
+
+	// As loadBMP makes them : filtered as light.
+	buildMipChain(image.pixels, info.width, info.height, image.blockBytes, (ptrdiff_t)rowBytes, true, mips);
+	image.levels = mips.levels;
+	for (unsigned int level = 1; level < mips.levels; level++) {
+		size_t levelRowBytes = ((size_t)mips.levelWidth(level) * image.blockBytes + 3) & ~(size_t)3;
+		image.levelOffset[level + 1] = image.levelOffset[level] + levelRowBytes * mips.levelHeight(level);
+	}
+	return true;
+}
+
+// Copies the rows of `job` into `slot`, as levelOffset lays them out : the
+// rows of a level textureStreamRowBytes apart, and for a tail one level
+// after the other. The levels of a DDS, and the first level of a BMP, are
+// that way in memory already ; the levels of `mips` are packed, and go a
+// row at a time.
+void textureStreamCopy(const StreamedTexture & t, const TextureStreamJob & job, unsigned char * slot) {
+	unsigned int last = job.rowCount ? job.level : t.image.levels - 1;
+	for (unsigned int level = job.level; level <= last; level++) {
+		unsigned int first = job.rowCount ? job.firstRow : 0;
+		unsigned int rows = job.rowCount ? job.rowCount : textureStreamRows(t, level);
+		size_t rowBytes = textureStreamRowBytes(t, level);
+		if (level == 0 || level >= t.mips.levels) {
+			memcpy(slot, ddsLevelData(t.image, 0, 0, level) + first * rowBytes, rows * rowBytes);
+		} else {
+			size_t packed = (size_t)t.mips.levelWidth(level) * t.mips.channels;
+			for (unsigned int y = 0; y < rows; y++) memcpy(slot + y * rowBytes, t.mips.level(level) + (first + y) * packed, packed);
+		}
+		slot += rows * rowBytes;
+	}
+}
+
+class TextureStreamer {
+public:
+	TextureStreamer() : bytesUploaded(0), started(false), quit(false), persistent(false), decodeBC(false), slotSize(0), outstanding(0) {}
+
+	~TextureStreamer() {
+		stop();
+	}
+
+	// Makes the ring of `slots` buffers of `slotSize` bytes and starts
+	// `threads` workers. Needs the GL context current.
+	bool start(unsigned int threads = 2, unsigned int slots = TEXTURE_STREAM_SLOTS, size_t slotSize = TEXTURE_STREAM_SLOT_SIZE) {
+		if (started) return true;
+		this->slotSize = slotSize;
+		persistent = GLEW_ARB_buffer_storage != 0;
+		decodeBC = !GLEW_EXT_texture_compression_s3tc;
+		ring.resize(slots);
+		for (unsigned int i = 0; i < slots; i++) {
+			Slot & slot = ring[i];
+			slot.data = NULL;
+			slot.fence = 0;
+			slot.busy = false;
+			glGenBuffers(1, &slot.buffer);
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.buffer);
+			if (persistent) {
+				GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+				glBufferStorage(GL_PIXEL_UNPACK_BUFFER, slotSize, NULL, flags);
+				slot.data = (unsigned char *)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, slotSize, flags);
+			} else {
+				glBufferData(GL_PIXEL_UNPACK_BUFFER, slotSize, NULL, GL_STREAM_DRAW);
+			}
+		}
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+		mtx_init(&lock, mtx_plain);
+		cnd_init(&wake);
+		quit = false;
+		started = true;
+		workers.resize(threads > 0 ? threads : 1);
+		for (size_t i = 0; i < workers.size(); i++) {
+			if (thrd_create(&workers[i], worker, this) != thrd_success) {
+				workers.resize(i);
+				break;
+			}
+		}
+		if (workers.empty()) {
+			printf("Impossible to start the texture streaming threads\n");
+			stop();
+			return false;
+		}
+		return true;
+	}
+
+	// A new texture name for `imagepath`, bound to nothing yet. The file is
+	// opened and uploaded in the background ; the texture stays incomplete
+	// until its smallest level is in, or for good if the file can't be read.
+	GLuint load(const char * imagepath) {
+		StreamedTexture * t = new StreamedTexture();
+		t->path = imagepath;
+		glGenTextures(1, &t->texture);
+		t->pending = 0;
+		t->opened = false;
+		t->mips.levels = 0;
+		textures.push_back(t);
+		outstanding++;
+
+		TextureStreamJob job = { t, -1, 0, 0, 0, 0 };
+		mtx_lock(&lock);
+		jobs.push_back(job);
+		cnd_signal(&wake);
+		mtx_unlock(&lock);
+		return t->texture;
+	}
+
+	// Once per frame : takes in what the workers finished, uploads up to
+	// `budget` bytes of it (always at least one band, so a budget smaller
+	// than a band still makes progress) and gives the free slots new work.
+	// Returns the bytes uploaded or allocated. Leaves no pixel unpack buffer bound, and
+	// the last streamed texture bound to GL_TEXTURE_2D.
+	size_t update(size_t budget = TEXTURE_STREAM_BUDGET) {
+		if (!started) return 0;
+
+		for (size_t i = 0; i < ring.size(); i++) {
+			Slot & slot = ring[i];
+			if (!slot.fence) continue;
+			GLenum state = glClientWaitSync(slot.fence, 0, 0);
+			if (state == GL_TIMEOUT_EXPIRED) continue;
+			glDeleteSync(slot.fence);
+			slot.fence = 0;
+			slot.busy = false;
+		}
+
+		std::deque<TextureStreamJob> finished;
+		mtx_lock(&lock);
+		finished.swap(done);
+		mtx_unlock(&lock);
+		for (size_t i = 0; i < finished.size(); i++) {
+			if (finished[i].slot < 0) allocate(*finished[i].texture);
+			else filled.push_back(finished[i]);
+		}
+
+		size_t spent = 0;
+		for (std::deque<TextureStreamJob>::iterator it = filled.begin(); it != filled.end(); ) {
+			const StreamedTexture & t = *it->texture;
+			// Nothing of a texture goes up before its tail, which makes
+			// the storage.
+			if (!t.allocated && t.tail < t.image.levels && it->rowCount != 0) {
+				++it;
+				continue;
+			}
+			size_t cost = it->bytes + (t.allocated ? 0 : t.image.levelOffset[t.image.levels]);
+			if (spent > 0 && spent + cost > budget) break;
+			TextureStreamJob job = *it;
+			it = filled.erase(it);
+			upload(job);
+			spent += cost;
+			bytesUploaded += job.bytes;
+		}
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+		// Smallest levels first, across every texture.
+		for (size_t i = 0; i < ring.size() && !waiting.empty(); i++) {
+			Slot & slot = ring[i];
+			if (slot.busy) continue;
+			if (!persistent) {
+				glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.buffer);
+				slot.data = (unsigned char *)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, slotSize, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+				glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+				if (!slot.data) continue;
+			}
+			TextureStreamJob job = waiting.front();
+			waiting.pop_front();
+			job.slot = (int)i;
+			slot.busy = true;
+			mtx_lock(&lock);
+			jobs.push_back(job);
+			cnd_signal(&wake);
+			mtx_unlock(&lock);
+		}
+		return spent;
+	}
+
+	// True when every texture asked for is either fully uploaded or failed.
+	bool idle() const {
+		return outstanding == 0;
+	}
+
+	// Stops the workers and frees the ring. The texture names stay the
+	// caller's ; whatever wasn't uploaded yet never will be.
+	void stop() {
+		if (started) {
+			mtx_lock(&lock);
+			quit = true;
+			cnd_broadcast(&wake);
+			mtx_unlock(&lock);
+			for (size_t i = 0; i < workers.size(); i++) thrd_join(workers[i], NULL);
+			workers.clear();
+			mtx_destroy(&lock);
+			cnd_destroy(&wake);
+			started = false;
+		}
+		for (size_t i = 0; i < ring.size(); i++) {
+			if (ring[i].fence) glDeleteSync(ring[i].fence);
+			if (ring[i].data) {
+				glBindBuffer(GL_PIXEL_UNPACK_BUFFER, ring[i].buffer);
+				glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+			}
+			glDeleteBuffers(1, &ring[i].buffer);
+		}
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		ring.clear();
+		for (size_t i = 0; i < textures.size(); i++) {
+			if (textures[i]->opened) closeDDS(textures[i]->image);
+			delete textures[i];
+		}
+		textures.clear();
+		jobs.clear();
+		done.clear();
+		filled.clear();
+		waiting.clear();
+		outstanding = 0;
+	}
+
+	size_t bytesUploaded; // since start()
+
+private:
+	struct Slot {
+		GLuint buffer;
+		unsigned char * data; // mapped, while a worker fills it or for good
+		GLsync fence;         // after the upload from it
+		bool busy;
+	};
+
+	TextureStreamer(const TextureStreamer &);
+	TextureStreamer & operator=(const TextureStreamer &);
+
+	static int worker(void * arg) {
+		TextureStreamer * s = (TextureStreamer *)arg;
+		mtx_lock(&s->lock);
+		for (;;) {
+			while (!s->quit && s->jobs.empty()) cnd_wait(&s->wake, &s->lock);
+			if (s->quit) break;
+			TextureStreamJob job = s->jobs.front();
+			s->jobs.pop_front();
+			unsigned char * slotData = job.slot >= 0 ? s->ring[job.slot].data : NULL;
+			mtx_unlock(&s->lock);
+
+			StreamedTexture & t = *job.texture;
+			if (job.slot < 0) {
+				// The disk is read here, one page fault at a time, as the
+				// rows are copied ; the GL thread never touches the file.
+				MappedFile probe;
+				t.opened = false;
+				if (!mapFile(t.path.c_str(), probe)) {
+					printf("%s could not be opened. Are you in the right directory ? Don't forget to read the FAQ !\n", t.path.c_str());
+				} else {
+					bool bmp = probe.size >= 2 && probe.data[0] == 'B' && probe.data[1] == 'M';
+					unmapFile(probe);
+					t.opened = bmp ? openStreamedBMP(t.path.c_str(), t.image, t.decoded, t.mips) : openDDS(t.path.c_str(), t.image);
+					t.alignment = bmp ? 4 : 1;
+					t.bmp = bmp;
+				}
+				if (t.opened && (t.image.layers != 1 || t.image.faces != 1)) {
+					printf("%s is a cubemap or an array, which is not streamed ; use loadDDS\n", t.path.c_str());
+					closeDDS(t.image);
+					t.opened = false;
+				}
+				if (t.opened && s->decodeBC && t.image.format == 0 && bcDecodable(t.image.internalFormat)) {
+					// No S3TC : the whole chain is decoded now and streamed
+					// as RGBA8 from memory.
+					DDSImage decoded;
+					decodeDDS(t.image, decoded, t.decoded);
+					closeDDS(t.image);
+					t.image = decoded;
+				}
+			} else {
+				textureStreamCopy(t, job, slotData);
+			}
+
+			mtx_lock(&s->lock);
+			s->done.push_back(job);
+		}
+		mtx_unlock(&s->lock);
+		return 0;
+	}
+
+	// Puts the bands of a texture the worker just opened in line for the
+	// workers.
+	void allocate(StreamedTexture & t) {
+		const DDSImage & image = t.image;
+		if (t.opened && textureStreamRowBytes(t, 0) > slotSize) {
+			printf("%s has rows wider than a texture stream slot\n", t.path.c_str());
+			closeDDS(t.image);
+			t.opened = false;
+		}
+		if (!t.opened) {
+			outstanding--;
+			return;
+		}
+		glBindTexture(GL_TEXTURE_2D, t.texture);
+		// Incomplete (base above max) until the tail is in.
+		if (image.levels > 1) glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, image.levels - 1);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, image.levels);
+		t.resident = image.levels;
+		t.allocated = false;
+		t.tail = image.levels;
+		while (t.tail > 0 && image.levelOffset[image.levels] - image.levelOffset[t.tail - 1] <= slotSize) t.tail--;
+
+		std::vector<TextureStreamJob> bands;
+		if (t.tail < image.levels) {
+			TextureStreamJob job = { &t, -1, t.tail, 0, 0, image.levelOffset[image.levels] - image.levelOffset[t.tail] };
+			bands.push_back(job);
+		}
+		for (unsigned int level = 0; level < image.levels; level++) {
+			t.bandsLeft[level] = 1;
+			if (level >= t.tail) continue;
+			size_t rowBytes = textureStreamRowBytes(t, level);
+			unsigned int rows = textureStreamRows(t, level);
+			unsigned int bandRows = (unsigned int)(slotSize / rowBytes);
+			t.bandsLeft[level] = 0;
+			for (unsigned int row = 0; row < rows; row += bandRows) {
+				TextureStreamJob job = { &t, -1, level, row, std::min(bandRows, rows - row), 0 };
+				job.bytes = job.rowCount * rowBytes;
+				bands.push_back(job);
+				t.bandsLeft[level]++;
+			}
+		}
+		for (size_t i = 0; i < bands.size(); i++) {
+			// Behind every band at least as small.
+			size_t priority = textureStreamPriority(bands[i]);
+			std::deque<TextureStreamJob>::iterator at = waiting.begin();
+			while (at != waiting.end() && textureStreamPriority(*at) <= priority) ++at;
+			waiting.insert(at, bands[i]);
+		}
+		t.pending = (unsigned int)bands.size();
+		if (t.pending == 0) finish(t);
+	}
+
+	// Immutable storage where there is glTexStorage2D : Mesa, for one,
+	// otherwise guesses a whole chain from the first level it is given and
+	// may have to make it again as the others come. A texture without a
+	// tail stays mutable so that it is incomplete until its smallest level
+	// is in.
+	void allocateStorage(StreamedTexture & t) {
+		const DDSImage & image = t.image;
+		if (GLEW_ARB_texture_storage && t.tail < image.levels) {
+			glTexStorage2D(GL_TEXTURE_2D, image.levels, image.internalFormat, image.width, image.height);
+		} else {
+			for (unsigned int level = 0; level < image.levels; level++) {
+				GLsizei width = image.width >> level, height = image.height >> level;
+				if (width < 1) width = 1;
+				if (height < 1) height = 1;
+				if (image.format == 0) glCompressedTexImage2D(GL_TEXTURE_2D, level, image.internalFormat, width, height, 0, (GLsizei)ddsLevelSize(image, level), NULL);
+				else glTexImage2D(GL_TEXTURE_2D, level, image.internalFormat, width, height, 0, image.format, image.type, NULL);
+			}
+		}
+		t.allocated = true;
+	}
+
+	// `rowCount` rows of `level` from `firstRow` on, at `offset` in the
+	// bound unpack buffer.
+	void subImage(const StreamedTexture & t, unsigned int level, unsigned int firstRow, unsigned int rowCount, size_t offset, size_t bytes) {
+		const DDSImage & image = t.image;
+		GLsizei width = image.width >> level, height = image.height >> level;
+		if (width < 1) width = 1;
+		if (height < 1) height = 1;
+		bool compressed = image.format == 0;
+		GLint y = firstRow * (compressed ? 4 : 1);
+		GLsizei rows = std::min((GLsizei)(rowCount * (compressed ? 4 : 1)), height - y);
+		if (compressed) glCompressedTexSubImage2D(GL_TEXTURE_2D, level, 0, y, width, rows, image.internalFormat, (GLsizei)bytes, (const void *)offset);
+		else glTexSubImage2D(GL_TEXTURE_2D, level, 0, y, width, rows, image.format, image.type, (const void *)offset);
+	}
+
+	void upload(const TextureStreamJob & job) {
+		StreamedTexture & t = *job.texture;
+		const DDSImage & image = t.image;
+		glBindTexture(GL_TEXTURE_2D, t.texture);
+		if (!t.allocated) {
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+			allocateStorage(t);
+		}
+
+		Slot & slot = ring[job.slot];
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.buffer);
+		if (!persistent) {
+			glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+			slot.data = NULL;
+		}
+		glPixelStorei(GL_UNPACK_ALIGNMENT, t.alignment);
+		if (job.rowCount == 0) {
+			for (unsigned int level = job.level; level < image.levels; level++) {
+				subImage(t, level, 0, textureStreamRows(t, level), image.levelOffset[level] - image.levelOffset[job.level], ddsLevelSize(image, level));
+				t.bandsLeft[level]--;
+			}
+		} else {
+			subImage(t, job.level, job.firstRow, job.rowCount, 0, job.bytes);
+			t.bandsLeft[job.level]--;
+		}
+		slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		t.pending--;
+		unsigned int resident = t.resident;
+		while (resident > 0 && t.bandsLeft[resident - 1] == 0) resident--;
+		if (resident != t.resident) {
+			t.resident = resident;
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, resident);
+		}
+		if (t.pending == 0) finish(t);
+	}
+
+	void finish(StreamedTexture & t) {
+		if (t.bmp) {
+			// Same sampling as loadBMP.
+			glBindTexture(GL_TEXTURE_2D, t.texture);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		}
+		closeDDS(t.image);
+		std::vector<unsigned char>().swap(t.decoded);
+		std::vector<unsigned char>().swap(t.mips.pixels);
+		t.opened = false;
+		outstanding--;
+	}
+
+	bool started, quit, persistent;
+	bool decodeBC;                            // the driver has no S3TC
+	size_t slotSize;
+	std::vector<Slot> ring;
+	std::vector<thrd_t> workers;
+	mtx_t lock;
+	cnd_t wake;
+	std::deque<TextureStreamJob> jobs;     // for the workers, under `lock`
+	std::deque<TextureStreamJob> done;     // from the workers, under `lock`
+	std::deque<TextureStreamJob> filled;   // slots ready to upload
+	std::deque<TextureStreamJob> waiting;  // bands without a slot yet
+	std::vector<StreamedTexture *> textures;
+	unsigned int outstanding;
+};
+
+#endif
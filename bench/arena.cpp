@@ -0,0 +1,102 @@
+// Loads the same batch of assets over and over, with the loaders' temporaries
+// on the heap and then in one Arena, and prints what the arena saw for each
+// asset.
+//
+//   ./arena          10 rounds of the default batch
+//   ./arena 50       50 rounds
+//
+// Each mode runs in its own process so peak RSS is per-mode.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <string.h>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+using namespace glm;
+#include "../basic_shading/common.hpp"
+#include "../basic_shading/objloader.hpp"
+#include "bench.hpp"
+
+struct Asset {
+	char path[64];
+	bool image;
+};
+
+static std::vector<Asset> batch;
+static int rounds = 10;
+
+// Stands in for the upload : touches the result so it can't be skipped.
+static unsigned long checksum;
+
+bool load_asset(const Asset &asset, Arena *arena) {
+	if (asset.image) {
+		ArenaScope scope(arena);
+		unsigned long w, h;
+		unsigned int *pixels = (unsigned int *)load_image(asset.path, &w, &h, arena);
+		if (!pixels) return false;
+		checksum += pixels[w * h / 2];
+		arenaFree(arena, pixels);
+		return true;
+	}
+	std::vector<glm::vec3> vertices, normals;
+	std::vector<glm::vec2> uvs;
+	if (!loadOBJ(asset.path, vertices, uvs, normals, arena)) return false;
+	checksum += vertices.size();
+	return true;
+}
+
+int run_batch(int use_arena) {
+	Arena arena;
+	Arena *a = use_arena ? &arena : NULL;
+	double start = bench_now();
+	for (int r = 0; r < rounds; r++) {
+		for (size_t i = 0; i < batch.size(); i++) {
+			if (!load_asset(batch[i], a)) return 0;
+			if (a && r == 0) printArenaStats(batch[i].path, arena.last);
+		}
+	}
+	double elapsed = bench_now() - start;
+	printf("  %-6s %4d rounds %9.3f s  %8.2f ms/round  peak RSS %8.1f MB",
+		use_arena ? "arena" : "heap", rounds, elapsed, elapsed * 1e3 / rounds, bench_peak_rss_mb());
+	if (a) printf("  (%lu blocks in all)", (unsigned long)arena.stats.blocks);
+	printf("\n");
+	return 1;
+}
+
+void add_asset(const char *path, bool image) {
+	Asset asset;
+	snprintf(asset.path, sizeof asset.path, "%s", path);
+	asset.image = image;
+	batch.push_back(asset);
+}
+
+int main(int argc, char **argv) {
+	if (argc > 1) rounds = atoi(argv[1]);
+
+	const unsigned long faces[] = { 10000, 100000, 1000000 };
+	add_asset("../basic_shading/suzanne.obj", false);
+	add_asset("../model_loading/cube.obj", false);
+	for (int i = 0; i < 3; i++) {
+		unsigned int w, h;
+		char path[64];
+		bench_grid_for_faces(faces[i], &w, &h);
+		snprintf(path, sizeof path, "/tmp/bench_grid_%ux%u.obj", w, h);
+		if (bench_file_size(path) < 0 && !bench_write_grid_obj(path, w, h)) return 1;
+		add_asset(path, false);
+	}
+	const unsigned int sides[] = { 256, 1024 };
+	for (int i = 0; i < 2; i++) {
+		char path[64];
+		snprintf(path, sizeof path, "/tmp/bench_%ux%u.ppm", sides[i], sides[i]);
+		if (bench_file_size(path) < 0 && !bench_write_ppm(path, sides[i], sides[i])) return 1;
+		add_asset(path, true);
+	}
+
+	if (!bench_isolated(run_batch, 0)) printf("  heap : load failed\n");
+	if (!bench_isolated(run_batch, 1)) printf("  arena : load failed\n");
+	return 0;
+}
@@ -0,0 +1,94 @@
+// Software S3TC decoding (bcdecode.hpp), as loadDDS does it on a driver
+// without S3TC : whole mipmap chains of a 4K BC1 and a 4K BC3 file, with
+// each version of the decoder on one thread, then with the fastest on more
+// and more threads.
+//
+//   ./bc_decode            4096x4096, up to 2x the cores
+//   ./bc_decode 2048 16    2048x2048, up to 16 threads
+//
+// The files are read warm ; every figure is the best of 5 runs, in
+// millions of decoded pixels per second.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include "../basic_shading/common.hpp"
+#include "bench.hpp"
+
+static DDSImage images[2];
+static std::vector<unsigned char> pixels[2];
+static DDSImage decoded[2];
+
+// Seconds to decode both files with `threads` threads of `decode`.
+double decode_both(unsigned int threads, BCDecodeRow decode) {
+	double best = 1e30;
+	for (int run = 0; run < 5; run++) {
+		double start = bench_now();
+		for (int i = 0; i < 2; i++) {
+			std::vector<BCSurface> surfaces;
+			for (unsigned int level = 0; level < images[i].levels; level++) {
+				BCSurface surface;
+				surface.blocks = ddsLevelData(images[i], 0, 0, level);
+				surface.width = images[i].width >> level ? images[i].width >> level : 1;
+				surface.height = images[i].height >> level ? images[i].height >> level : 1;
+				surface.pixels = (unsigned char *)ddsLevelData(decoded[i], 0, 0, level);
+				surfaces.push_back(surface);
+			}
+			bcDecodeSurfaces(images[i].internalFormat, &surfaces[0], surfaces.size(), threads, decode);
+		}
+		double t = bench_now() - start;
+		if (t < best) best = t;
+	}
+	return best;
+}
+
+int main(int argc, char **argv) {
+	unsigned int size = argc > 1 ? (unsigned int)atoi(argv[1]) : 4096;
+	unsigned int cores = defaultThreadCount();
+	unsigned int maxThreads = argc > 2 ? (unsigned int)atoi(argv[2]) : 2 * cores;
+
+	double mpixels = 0;
+	for (int i = 0; i < 2; i++) {
+		char path[64];
+		snprintf(path, sizeof path, "/tmp/bench_dds_%u_%d_%s.dds", size, i, i % 2 ? "bc3" : "bc1");
+		if (bench_file_size(path) < 0 && !bench_write_dds(path, size, size, i % 2 != 0)) return 1;
+		if (!openDDS(path, images[i])) return 1;
+		// Sizes the output, and reads the file in.
+		decodeDDS(images[i], decoded[i], pixels[i]);
+		mpixels += decoded[i].levelOffset[decoded[i].levels] / 4 / 1e6;
+	}
+	printf("BC1 and BC3 %ux%u with all levels, %.1f Mpixels ; %u cores\n", size, size, mpixels, cores);
+
+	printf("%-10s %10s %12s\n", "1 thread", "time", "Mpixels/s");
+	const char *names[] = { "scalar", "SSSE3", "AVX2", "NEON" };
+	BCDecodeRow decoders[4] = { bcDecodeRowScalar, NULL, NULL, NULL };
+#ifdef BC_DECODE_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("ssse3")) decoders[1] = bcDecodeRowSSSE3;
+	if (__builtin_cpu_supports("avx2")) decoders[2] = bcDecodeRowAVX2;
+#endif
+#ifdef BC_DECODE_NEON
+	decoders[3] = bcDecodeRowNEON;
+#endif
+	for (int d = 0; d < 4; d++) {
+		if (!decoders[d]) continue;
+		double t = decode_both(1, decoders[d]);
+		printf("%-10s %7.1f ms %12.0f\n", names[d], t * 1e3, mpixels / t);
+	}
+
+	printf("%-10s %10s %12s %9s\n", "threads", "time", "Mpixels/s", "speedup");
+	double single = 0;
+	for (unsigned int threads = 1; threads <= maxThreads; threads *= 2) {
+		double t = decode_both(threads, bcBestDecoder());
+		if (threads == 1) single = t;
+		printf("%-10u %7.1f ms %12.0f %8.2fx\n", threads, t * 1e3, mpixels / t, single / t);
+		if (threads < cores && threads * 2 > cores) threads = cores / 2; // the core count itself too
+	}
+
+	for (int i = 0; i < 2; i++) closeDDS(images[i]);
+	return 0;
+}
@@ -0,0 +1,171 @@
+// The BC1/BC3 encoder of bcencode.hpp : its speed with each version on one
+// thread and with the fastest on more, the quality it gets on the repo's
+// images and on a synthetic one, and what a compressed texture saves over
+// loadBMP's, in texture memory and in bytes handed to the driver.
+//
+//   ./bc_encode            a 4096x4096 BMP, up to 2x the cores
+//   ./bc_encode 2048 16    2048x2048, up to 16 threads
+//
+// Encoding figures are the best of 3 runs, on the top level alone, in
+// millions of input pixels per second. The GL part runs on whatever the
+// default context is (llvmpipe on the test machines).
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <vector>
+
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+#include "../basic_shading/common.hpp"
+#include "bench.hpp"
+
+static char bmpPath[64], ddsPath[64];
+static std::vector<unsigned char> pixels;
+static unsigned int width, height;
+
+// Seconds to encode the top level to `format` with `threads` threads.
+double encode_top(GLenum format, unsigned int threads, BCEncodeRow encode, std::vector<unsigned char> &blocks) {
+	blocks.resize((size_t)((width + 3) / 4) * ((height + 3) / 4) * (bcAlphaKind(format) ? 16 : 8));
+	BCEncodeSurface surface = { &pixels[0], width, height, &blocks[0] };
+	double best = 1e30;
+	for (int run = 0; run < 3; run++) {
+		double start = bench_now();
+		bcEncodeSurfaces(format, &surface, 1, threads, encode);
+		double t = bench_now() - start;
+		if (t < best) best = t;
+	}
+	return best;
+}
+
+// PSNR of the colour channels of the top level of `path` after BC1.
+double psnr_bc1(const char *path, unsigned int *w, unsigned int *h) {
+	std::vector<unsigned char> in, blocks;
+	bool alpha;
+	if (!readImageRGBA(path, in, *w, *h, alpha)) return 0;
+	DDSImage image;
+	encodeDDS(&in[0], *w, *h, false, image, blocks, false);
+	std::vector<unsigned char> out(in.size());
+	BCSurface surface = { &blocks[0], *w, *h, &out[0] };
+	bcDecodeSurfaces(image.internalFormat, &surface, 1);
+	double error = 0;
+	for (size_t i = 0; i < in.size(); i += 4)
+		for (int c = 0; c < 3; c++) error += (double)(in[i + c] - out[i + c]) * (in[i + c] - out[i + c]);
+	error /= (double)*w * *h * 3;
+	return error > 0 ? 10.0 * log10(255.0 * 255.0 / error) : 99.0;
+}
+
+// Texture memory of every level of the bound texture, as the driver
+// reports it.
+size_t texture_bytes() {
+	size_t total = 0;
+	GLint levels = 0;
+	glGetTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, &levels);
+	for (GLint level = 0; level <= levels && level < 16; level++) {
+		GLint w = 0, h = 0, compressed = 0, size = 0, bits = 0, b;
+		glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_WIDTH, &w);
+		glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_HEIGHT, &h);
+		if (w == 0 || h == 0) break;
+		glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_COMPRESSED, &compressed);
+		if (compressed) {
+			glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_COMPRESSED_IMAGE_SIZE, &size);
+			total += size;
+			continue;
+		}
+		GLenum channels[] = { GL_TEXTURE_RED_SIZE, GL_TEXTURE_GREEN_SIZE, GL_TEXTURE_BLUE_SIZE, GL_TEXTURE_ALPHA_SIZE };
+		for (int c = 0; c < 4; c++) {
+			glGetTexLevelParameteriv(GL_TEXTURE_2D, level, channels[c], &b);
+			bits += b;
+		}
+		total += (size_t)w * h * bits / 8;
+	}
+	return total;
+}
+
+// 0 : loadBMP ; 1 : loadCompressed, encoding as it loads ; 2 : loadDDS of
+// the file dds_convert would write.
+int run(int mode) {
+	glfwInit();
+	GLFWwindow *window = glfwCreateWindow(64, 64, "bc_encode", NULL, NULL);
+	if (!window) return 0;
+	glfwMakeContextCurrent(window);
+	glewExperimental = true;
+	glewInit();
+
+	double start = bench_now();
+	GLuint texture = mode == 0 ? loadBMP(bmpPath) : mode == 1 ? loadCompressed(bmpPath) : loadDDS(ddsPath);
+	glFinish();
+	double elapsed = bench_now() - start;
+	glBindTexture(GL_TEXTURE_2D, texture);
+	// What went through glTexImage2D / glCompressedTexImage2D.
+	size_t handed = mode == 0 ? (size_t)width * height * 3 : (size_t)bench_file_size(ddsPath) - 128;
+	printf(" %9.1f ms %9.1f MB %9.1f MB", elapsed * 1e3, handed / (1024.0 * 1024.0), texture_bytes() / (1024.0 * 1024.0));
+	glDeleteTextures(1, &texture);
+	glfwTerminate();
+	return 1;
+}
+
+int main(int argc, char **argv) {
+	unsigned int size = argc > 1 ? (unsigned int)atoi(argv[1]) : 4096;
+	unsigned int cores = defaultThreadCount();
+	unsigned int maxThreads = argc > 2 ? (unsigned int)atoi(argv[2]) : 2 * cores;
+
+	snprintf(bmpPath, sizeof bmpPath, "/tmp/bench_bmp_%u.bmp", size);
+	snprintf(ddsPath, sizeof ddsPath, "/tmp/bench_bmp_%u.dds", size);
+	if (bench_file_size(bmpPath) < 0 && !bench_write_bmp(bmpPath, size, size)) return 1;
+	bool alpha;
+	if (!readImageRGBA(bmpPath, pixels, width, height, alpha)) return 1;
+	double mpixels = (double)width * height / 1e6;
+	printf("%ux%u, %.1f Mpixels ; %u cores\n", width, height, mpixels, cores);
+
+	std::vector<unsigned char> blocks[2];
+	GLenum formats[] = { GL_COMPRESSED_RGBA_S3TC_DXT1_EXT, GL_COMPRESSED_RGBA_S3TC_DXT5_EXT };
+	const char *names[] = { "scalar", "SSE2" };
+	BCEncodeRow encoders[2] = { bcEncodeRowScalar, NULL };
+#ifdef BC_DECODE_X86
+	encoders[1] = bcEncodeRowSSE2;
+#endif
+	printf("%-10s %14s %14s\n", "1 thread", "BC1 Mpix/s", "BC3 Mpix/s");
+	for (int e = 0; e < 2; e++) {
+		if (!encoders[e]) continue;
+		printf("%-10s", names[e]);
+		for (int f = 0; f < 2; f++) printf(" %14.1f", mpixels / encode_top(formats[f], 1, encoders[e], blocks[f]));
+		printf("\n");
+	}
+	printf("%-10s %14s %14s %9s\n", "threads", "BC1 Mpix/s", "BC3 Mpix/s", "speedup");
+	double single = 0;
+	for (unsigned int threads = 1; threads <= maxThreads; threads *= 2) {
+		double t[2];
+		for (int f = 0; f < 2; f++) t[f] = encode_top(formats[f], threads, bcBestEncoder(), blocks[f]);
+		if (threads == 1) single = t[0];
+		printf("%-10u %14.1f %14.1f %8.2fx\n", threads, mpixels / t[0], mpixels / t[1], single / t[0]);
+		if (threads < cores && threads * 2 > cores) threads = cores / 2; // the core count itself too
+	}
+
+	printf("%-34s %9s\n", "BC1 quality", "PSNR");
+	const char *images[] = { bmpPath, "../textured_cube/uvtemplate.bmp", "../textured_cube/uvtemplate.tga", "../textured_cube/pal.ppm" };
+	for (int i = 0; i < 4; i++) {
+		unsigned int w = 0, h = 0;
+		double db = psnr_bc1(images[i], &w, &h);
+		if (w) printf("%-34s %6.2f dB\n", images[i], db);
+	}
+
+	// The file dds_convert would write, with the whole chain.
+	DDSImage image;
+	double start = bench_now();
+	encodeDDS(&pixels[0], width, height, false, image, blocks[0]);
+	double chain = bench_now() - start;
+	if (!writeDDS(ddsPath, image)) return 1;
+	printf("BC1 with all %u levels : %.1f ms\n", image.levels, chain * 1e3);
+
+	printf("%-22s %12s %12s %12s\n", "", "load", "handed", "texture");
+	const char *cases[] = { "loadBMP", "loadCompressed", "loadDDS (converted)" };
+	for (int c = 0; c < 3; c++) {
+		printf("%-22s", cases[c]);
+		bench_isolated(run, c);
+		printf("\n");
+	}
+	return 0;
+}
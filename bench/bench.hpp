@@ -0,0 +1,315 @@
+#ifndef BENCH_HPP
+#define BENCH_HPP
+
+// Small helpers shared by the benchmarks in this directory : a wall clock,
+// the peak resident set size, and generators for synthetic assets.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+// Seconds since an arbitrary point, with microsecond resolution.
+double bench_now() {
+	struct timeval tv;
+	gettimeofday(&tv, 0);
+	return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+// High-water mark of the resident set of this process, in MB.
+double bench_peak_rss_mb() {
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+	return usage.ru_maxrss / (1024.0 * 1024.0); // bytes
+#else
+	return usage.ru_maxrss / 1024.0;            // kilobytes
+#endif
+}
+
+// Private (anonymous) part of the resident set right now, in MB, leaving
+// out file pages that are mapped and could be dropped at any time. -1
+// where /proc/self/status doesn't exist.
+double bench_rss_anon_mb() {
+	FILE *fp = fopen("/proc/self/status", "r");
+	if (!fp) return -1;
+	char line[256];
+	double mb = -1;
+	while (fgets(line, sizeof line, fp)) {
+		long kb;
+		if (sscanf(line, "RssAnon: %ld kB", &kb) == 1) mb = kb / 1024.0;
+	}
+	fclose(fp);
+	return mb;
+}
+
+long bench_file_size(const char *path) {
+	FILE *fp = fopen(path, "rb");
+	if (!fp) return -1;
+	fseek(fp, 0, SEEK_END);
+	long size = ftell(fp);
+	fclose(fp);
+	return size;
+}
+
+// Asks the kernel to drop `path` from the page cache, so the next read
+// comes from disk. Only does something where posix_fadvise exists.
+void bench_drop_cache(const char *path) {
+#ifdef POSIX_FADV_DONTNEED
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) return;
+	fdatasync(fd);
+	posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+	close(fd);
+#endif
+}
+
+// Runs `fn(arg)` in a child process so that its peak RSS is not polluted by
+// whatever ran before it. Returns false if the child failed.
+template <typename F, typename A>
+bool bench_isolated(F fn, A arg) {
+	fflush(stdout);
+	pid_t pid = fork();
+	if (pid == 0) {
+		int ok = fn(arg);
+		fflush(stdout);
+		_exit(ok ? 0 : 1);
+	}
+	int status = 0;
+	waitpid(pid, &status, 0);
+	return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+// The face layouts bench_write_grid_obj can write.
+enum BenchFaceFormat {
+	FACE_V_VT_VN,  // f 1/1/1 2/2/2 3/3/3
+	FACE_V,        // f 1 2 3
+	FACE_V_VT,     // f 1/1 2/2 3/3
+	FACE_V_VN,     // f 1//1 2//2 3//3
+	FACE_RELATIVE, // f -3/-3/-3 ... (counted back from the last vertex)
+	FACE_QUADS     // f 1/1/1 2/2/2 4/4/4 3/3/3, one per quad
+};
+
+static void bench_write_corner(FILE *fp, BenchFaceFormat format, unsigned int i, unsigned int count) {
+	long r = (long)i - (long)count - 1;
+	switch (format) {
+	case FACE_V:        fprintf(fp, " %u", i); break;
+	case FACE_V_VT:     fprintf(fp, " %u/%u", i, i); break;
+	case FACE_V_VN:     fprintf(fp, " %u//%u", i, i); break;
+	case FACE_RELATIVE: fprintf(fp, " %ld/%ld/%ld", r, r, r); break;
+	default:            fprintf(fp, " %u/%u/%u", i, i, i); break;
+	}
+}
+
+// Writes a w*h grid of quads (2*w*h triangles, or w*h quads) as an OBJ
+// file. The result is a reasonable stand-in for a large scanned mesh :
+// shared positions, one uv and one normal per position.
+bool bench_write_grid_obj(const char *path, unsigned int w, unsigned int h, BenchFaceFormat format = FACE_V_VT_VN) {
+	FILE *fp = fopen(path, "w");
+	if (!fp) {
+		printf("%s could not be opened for writing\n", path);
+		return false;
+	}
+	unsigned int count = (w + 1) * (h + 1);
+	fprintf(fp, "# synthetic %ux%u grid\n", w, h);
+	for (unsigned int y = 0; y <= h; y++)
+		for (unsigned int x = 0; x <= w; x++)
+			fprintf(fp, "v %f %f %f\n", x / (float)w - 0.5f, y / (float)h - 0.5f, 0.05f * ((x ^ y) & 7));
+	if (format != FACE_V && format != FACE_V_VN)
+		for (unsigned int y = 0; y <= h; y++)
+			for (unsigned int x = 0; x <= w; x++)
+				fprintf(fp, "vt %f %f\n", x / (float)w, y / (float)h);
+	if (format != FACE_V && format != FACE_V_VT)
+		for (unsigned int i = 0; i < count; i++)
+			fprintf(fp, "vn 0.000000 0.000000 1.000000\n");
+	for (unsigned int y = 0; y < h; y++) {
+		for (unsigned int x = 0; x < w; x++) {
+			unsigned int a = y * (w + 1) + x + 1, b = a + 1, c = a + w + 1, d = c + 1;
+			unsigned int faces[2][4] = { { a, b, d, 0 }, { a, d, c, 0 } };
+			if (format == FACE_QUADS) {
+				faces[0][3] = c;
+				fputc('f', fp);
+				for (int k = 0; k < 4; k++) bench_write_corner(fp, format, faces[0][k], count);
+				fputc('\n', fp);
+				continue;
+			}
+			for (int f = 0; f < 2; f++) {
+				fputc('f', fp);
+				for (int k = 0; k < 3; k++) bench_write_corner(fp, format, faces[f][k], count);
+				fputc('\n', fp);
+			}
+		}
+	}
+	fclose(fp);
+	return true;
+}
+
+// Writes a w*h binary PPM (P6) with a smooth gradient in it.
+bool bench_write_ppm(const char *path, unsigned int w, unsigned int h) {
+	FILE *fp = fopen(path, "wb");
+	if (!fp) {
+		printf("%s could not be opened for writing\n", path);
+		return false;
+	}
+	fprintf(fp, "P6\n%u %u\n255\n", w, h);
+	for (unsigned int y = 0; y < h; y++) {
+		for (unsigned int x = 0; x < w; x++) {
+			unsigned char rgb[3] = { (unsigned char)(x * 255 / w), (unsigned char)(y * 255 / h), (unsigned char)((x ^ y) & 255) };
+			fwrite(rgb, 1, 3, fp);
+		}
+	}
+	fclose(fp);
+	return true;
+}
+
+// Writes a 24-bit BMP of w*h pixels, bottom row first as loadBMP wants
+// it : gradients, a checkerboard's hard edges and a little noise, so that
+// it compresses and filters somewhat like a real texture.
+bool bench_write_bmp(const char *path, unsigned int w, unsigned int h) {
+	FILE *fp = fopen(path, "wb");
+	if (!fp) {
+		printf("%s could not be opened for writing\n", path);
+		return false;
+	}
+	unsigned int rowBytes = (w * 3 + 3) & ~3u, imageSize = rowBytes * h;
+	unsigned char header[54] = { 'B', 'M' };
+	unsigned int fields[][2] = { { 0x02, 54 + imageSize }, { 0x0A, 54 }, { 0x0E, 40 }, { 0x12, w }, { 0x16, h }, { 0x1A, 1 | 24 << 16 }, { 0x22, imageSize } };
+	for (size_t i = 0; i < sizeof fields / sizeof fields[0]; i++)
+		for (int b = 0; b < 4; b++) header[fields[i][0] + b] = (unsigned char)(fields[i][1] >> (8 * b));
+	fwrite(header, 1, 54, fp);
+	std::vector<unsigned char> row(rowBytes, 0);
+	unsigned int seed = 2463534242u;
+	for (unsigned int y = 0; y < h; y++) {
+		for (unsigned int x = 0; x < w; x++) {
+			seed ^= seed << 13; seed ^= seed >> 17; seed ^= seed << 5;
+			unsigned int noise = seed & 15, checker = ((x * 16 / w) ^ (y * 16 / h)) & 1;
+			row[3 * x + 0] = (unsigned char)(checker ? 200 + noise : 40 + noise);      // blue
+			row[3 * x + 1] = (unsigned char)((y * 255 / h + noise) & 255);             // green
+			row[3 * x + 2] = (unsigned char)(x * 240 / w + noise);                     // red
+		}
+		fwrite(&row[0], 1, rowBytes, fp);
+	}
+	fclose(fp);
+	return true;
+}
+
+// Writes a DDS file of w*h BC1 ("DXT1", 8 bytes per block) or BC3 ("DXT5",
+// 16 bytes) blocks with a full mipmap chain, `layers` array elements
+// (through a DX10 header if more than one) and 6 faces each if `cube`.
+// The blocks are noise : right for I/O, not for looking at.
+bool bench_write_dds(const char *path, unsigned int w, unsigned int h, bool bc3, unsigned int layers = 1, bool cube = false) {
+	FILE *fp = fopen(path, "wb");
+	if (!fp) {
+		printf("%s could not be opened for writing\n", path);
+		return false;
+	}
+	unsigned int blockBytes = bc3 ? 16 : 8, levels = 1;
+	while ((w | h) >> levels) levels++;
+	unsigned int header[32] = { 0 }; // magic, then the 124-byte header
+	header[0] = 0x20534444;                         // "DDS "
+	header[1] = 124;                                // size
+	header[2] = 0x1 | 0x2 | 0x4 | 0x1000 | 0x20000 | 0x80000; // caps, height, width, pixel format, mipmap count, linear size
+	header[3] = h;
+	header[4] = w;
+	header[5] = ((w + 3) / 4) * ((h + 3) / 4) * blockBytes;
+	header[7] = levels;
+	header[19] = 32;                                // pixel format size
+	header[20] = 0x4;                               // DDPF_FOURCC
+	header[21] = layers > 1 ? 0x30315844 : bc3 ? 0x35545844 : 0x31545844; // "DX10", "DXT5", "DXT1"
+	header[27] = 0x1000 | 0x400000 | 0x8;           // texture, mipmap, complex
+	if (cube && layers == 1) header[28] = 0x200 | 0xFC00;
+	fwrite(header, 4, 32, fp);
+	if (layers > 1) {
+		unsigned int dx10[5] = { bc3 ? 77u : 71u, 3, cube ? 0x4u : 0u, layers, 0 };
+		fwrite(dx10, 4, 5, fp);
+	}
+	std::vector<unsigned char> level;
+	unsigned long long seed = 88172645463325252ULL;
+	for (unsigned int surface = 0; surface < layers * (cube ? 6 : 1); surface++) {
+		for (unsigned int l = 0; l < levels; l++) {
+			unsigned int lw = w >> l ? w >> l : 1, lh = h >> l ? h >> l : 1;
+			level.resize((size_t)((lw + 3) / 4) * ((lh + 3) / 4) * blockBytes);
+			for (size_t i = 0; i < level.size(); i++) {
+				seed ^= seed << 13; seed ^= seed >> 7; seed ^= seed << 17;
+				level[i] = (unsigned char)seed;
+			}
+			fwrite(&level[0], 1, level.size(), fp);
+		}
+	}
+	fclose(fp);
+	return true;
+}
+
+// Writes a vertex and a fragment shader of about the weight of a real
+// lit material : a loop over LIGHTS point lights and OCTAVES of value
+// noise, both defaulting to 4 and meant to be set with defines, so that
+// one pair of files gives many programs. The vertex shader takes a
+// position at location 0 and draws in clip space.
+bool bench_write_shaders(const char *vertexPath, const char *fragmentPath) {
+	FILE *vs = fopen(vertexPath, "wb"), *fs = fopen(fragmentPath, "wb");
+	if (!vs || !fs) {
+		printf("%s could not be opened for writing\n", vs ? fragmentPath : vertexPath);
+		if (vs) fclose(vs);
+		if (fs) fclose(fs);
+		return false;
+	}
+	fputs("#version 330 core\n"
+		"layout(location = 0) in vec3 position;\n"
+		"out vec3 worldPosition;\n"
+		"out vec3 normal;\n"
+		"uniform mat4 MVP;\n"
+		"void main() {\n"
+		"\tgl_Position = MVP * vec4(position, 1.0);\n"
+		"\tworldPosition = position;\n"
+		"\tnormal = normalize(vec3(position.xy, 1.0));\n"
+		"}\n", vs);
+	fputs("#version 330 core\n"
+		"#ifndef LIGHTS\n#define LIGHTS 4\n#endif\n"
+		"#ifndef OCTAVES\n#define OCTAVES 4\n#endif\n"
+		"in vec3 worldPosition;\n"
+		"in vec3 normal;\n"
+		"out vec4 color;\n"
+		"uniform vec3 lightPositions[LIGHTS];\n"
+		"uniform vec3 lightColors[LIGHTS];\n"
+		"uniform vec3 eye;\n"
+		"float hash(vec3 p) { return fract(sin(dot(p, vec3(12.9898, 78.233, 37.719))) * 43758.5453); }\n"
+		"float noise(vec3 p) {\n"
+		"\tvec3 i = floor(p), f = fract(p);\n"
+		"\tf = f * f * (3.0 - 2.0 * f);\n"
+		"\treturn mix(mix(mix(hash(i), hash(i + vec3(1, 0, 0)), f.x), mix(hash(i + vec3(0, 1, 0)), hash(i + vec3(1, 1, 0)), f.x), f.y),\n"
+		"\t\tmix(mix(hash(i + vec3(0, 0, 1)), hash(i + vec3(1, 0, 1)), f.x), mix(hash(i + vec3(0, 1, 1)), hash(i + vec3(1, 1, 1)), f.x), f.y), f.z);\n"
+		"}\n"
+		"void main() {\n"
+		"\tfloat albedo = 0.0, amplitude = 0.5;\n"
+		"\tvec3 p = worldPosition * 4.0;\n"
+		"\tfor (int o = 0; o < OCTAVES; o++) { albedo += amplitude * noise(p); p *= 2.03; amplitude *= 0.5; }\n"
+		"\tvec3 n = normalize(normal), v = normalize(eye - worldPosition), lit = vec3(0.05);\n"
+		"\tfor (int i = 0; i < LIGHTS; i++) {\n"
+		"\t\tvec3 l = lightPositions[i] - worldPosition;\n"
+		"\t\tfloat d = length(l);\n"
+		"\t\tl /= d;\n"
+		"\t\tvec3 h = normalize(l + v);\n"
+		"\t\tfloat diffuse = max(dot(n, l), 0.0), specular = pow(max(dot(n, h), 0.0), 32.0);\n"
+		"\t\tlit += lightColors[i] * (albedo * diffuse + 0.3 * specular) / (1.0 + d * d);\n"
+		"\t}\n"
+		"\tcolor = vec4(lit, 1.0);\n"
+		"}\n", fs);
+	bool ok = fclose(vs) == 0;
+	return fclose(fs) == 0 && ok;
+}
+
+// Grid dimensions giving roughly `faces` triangles.
+void bench_grid_for_faces(unsigned long faces, unsigned int *w, unsigned int *h) {
+	unsigned long quads = faces / 2;
+	unsigned int side = 1;
+	while ((unsigned long)side * side < quads) side++;
+	*w = side;
+	*h = (unsigned int)((quads + side - 1) / side);
+}
+
+#endif
@@ -0,0 +1,174 @@
+// loadBMP on each kind of BMP it takes : how long until the texture is
+// there, mipmaps included, and how many bytes were copied on the way,
+// against the loader it replaced, which read the file into a buffer of its
+// own before glTexImage2D (24-bit bottom-up files only). Level 0 is read
+// back and checked against readBMPRGBA.
+//
+//   ./bmp_load            4096x4096 (and 4095 wide for the padded rows)
+//   ./bmp_load 2048       2048x2048
+//
+// Files are read warm ; every figure is the best of 3 runs. The GL part
+// runs on whatever the default context is (llvmpipe on the test machines).
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+#include "../basic_shading/common.hpp"
+#include "bench.hpp"
+
+// The old loader, less its header checks : fread into a buffer, then the
+// same upload and mipmaps as the new one.
+GLuint old_loadBMP(const char *path, size_t *copied) {
+	unsigned char header[54];
+	FILE *file = fopen(path, "rb");
+	if (!file || fread(header, 1, 54, file) != 54) return 0;
+	unsigned int dataPos = readLE32(header + 0x0A), imageSize = readLE32(header + 0x22);
+	unsigned int width = readLE32(header + 0x12), height = readLE32(header + 0x16);
+	if (imageSize == 0) imageSize = width * height * 3;
+	unsigned char *data = new unsigned char[imageSize];
+	fseek(file, dataPos, SEEK_SET);
+	fread(data, 1, imageSize, file);
+	fclose(file);
+	GLuint texture;
+	glGenTextures(1, &texture);
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_BGR, GL_UNSIGNED_BYTE, data);
+	MipChain chain;
+	buildMipChain(data, width, height, 3, (width * 3 + 3) & ~3u, true, chain);
+	uploadMipChain(GL_TEXTURE_2D, chain, GL_RGB, GL_BGR);
+	delete[] data;
+	*copied = imageSize;
+	return texture;
+}
+
+// Writes `rgba` (top row first) as a BMP of `bpp` bits : 8 with a palette
+// of the colours' top 3-3-2 bits, 32 with an alpha mask.
+bool write_bmp(const char *path, const std::vector<unsigned char> &rgba, unsigned int w, unsigned int h, unsigned int bpp, bool topDown) {
+	FILE *fp = fopen(path, "wb");
+	if (!fp) return false;
+	unsigned int headerSize = bpp == 32 ? 108 : 40, paletteBytes = bpp == 8 ? 1024 : 0;
+	unsigned int pitch = (w * bpp / 8 + 3) & ~3u, dataPos = 14 + headerSize + paletteBytes;
+	std::vector<unsigned char> header(dataPos, 0);
+	int height = topDown ? -(int)h : (int)h;
+	unsigned int fields[][2] = { { 0x02, dataPos + pitch * h }, { 0x0A, dataPos }, { 0x0E, headerSize }, { 0x12, w }, { 0x16, (unsigned int)height },
+		{ 0x1A, 1 | bpp << 16 }, { 0x1E, bpp == 32 ? 3u : 0u }, { 0x22, pitch * h }, { 0x2E, bpp == 8 ? 256u : 0u },
+		{ 0x36, 0x00ff0000 }, { 0x3A, 0x0000ff00 }, { 0x3E, 0x000000ff }, { 0x42, 0xff000000 } };
+	for (size_t i = 0; i < sizeof fields / sizeof fields[0]; i++) {
+		if (fields[i][0] >= 0x36 && bpp != 32) break;
+		for (int b = 0; b < 4; b++) header[fields[i][0] + b] = (unsigned char)(fields[i][1] >> (8 * b));
+	}
+	header[0] = 'B';
+	header[1] = 'M';
+	for (unsigned int i = 0; i < paletteBytes / 4; i++) {
+		header[14 + headerSize + 4 * i + 0] = (unsigned char)((i & 3) * 85);
+		header[14 + headerSize + 4 * i + 1] = (unsigned char)((i >> 2 & 7) * 255 / 7);
+		header[14 + headerSize + 4 * i + 2] = (unsigned char)((i >> 5) * 255 / 7);
+	}
+	fwrite(&header[0], 1, header.size(), fp);
+	std::vector<unsigned char> row(pitch, 0);
+	for (unsigned int y = 0; y < h; y++) {
+		const unsigned char *src = &rgba[(size_t)(topDown ? y : h - 1 - y) * w * 4];
+		for (unsigned int x = 0; x < w; x++, src += 4) {
+			if (bpp == 8) {
+				row[x] = (unsigned char)((src[0] >> 5) << 5 | (src[1] >> 5) << 2 | src[2] >> 6);
+			} else {
+				unsigned char *dst = &row[x * bpp / 8];
+				dst[0] = src[2]; dst[1] = src[1]; dst[2] = src[0];
+				if (bpp == 32) dst[3] = (unsigned char)(x * 255 / w);
+			}
+		}
+		fwrite(&row[0], 1, pitch, fp);
+	}
+	fclose(fp);
+	return true;
+}
+
+// Loads `path` 3 times with the old loader or the new one ; prints the
+// best time and the bytes copied, and checks level 0.
+void run(const char *name, const char *path, bool old) {
+	double best = 1e30;
+	size_t copied = 0;
+	GLuint texture = 0;
+	// loadBMP's own messages, out of the way of the table.
+	fflush(stdout);
+	int out = dup(1), null = open("/dev/null", O_WRONLY);
+	dup2(null, 1);
+	for (int run = 0; run < 3; run++) {
+		if (texture) glDeleteTextures(1, &texture);
+		glFinish();
+		double start = bench_now();
+		texture = old ? old_loadBMP(path, &copied) : loadBMP(path, NULL, &copied);
+		glFinish();
+		double t = bench_now() - start;
+		if (t < best) best = t;
+	}
+	fflush(stdout);
+	dup2(out, 1);
+	close(out);
+	close(null);
+	if (!texture) {
+		printf("%-28s %10s\n", name, "failed");
+		return;
+	}
+
+	// Level 0, bottom row first, against the file's pixels, top row first.
+	std::vector<unsigned char> expected;
+	unsigned int w, h;
+	bool alpha;
+	readImageRGBA(path, expected, w, h, alpha);
+	std::vector<unsigned char> level0((size_t)w * h * 4);
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, &level0[0]);
+	bool same = true;
+	for (unsigned int y = 0; y < h && same; y++)
+		same = memcmp(&level0[(size_t)y * w * 4], &expected[(size_t)(h - 1 - y) * w * 4], (size_t)w * 4) == 0;
+	glDeleteTextures(1, &texture);
+	printf("%-28s %7.1f ms %12.1f MB  %s\n", name, best * 1e3, copied / (1024.0 * 1024.0), same ? "same pixels" : "DIFFERENT pixels");
+}
+
+int main(int argc, char **argv) {
+	unsigned int size = argc > 1 ? (unsigned int)atoi(argv[1]) : 4096;
+
+	glfwInit();
+	GLFWwindow *window = glfwCreateWindow(64, 64, "bmp_load", NULL, NULL);
+	if (!window) return 1;
+	glfwMakeContextCurrent(window);
+	glewExperimental = true;
+	glewInit();
+
+	char source[64];
+	snprintf(source, sizeof source, "/tmp/bench_bmp_%u.bmp", size);
+	if (bench_file_size(source) < 0 && !bench_write_bmp(source, size, size)) return 1;
+	std::vector<unsigned char> rgba;
+	unsigned int width, height;
+	bool alpha;
+	if (!readImageRGBA(source, rgba, width, height, alpha)) return 1;
+	// The same picture one column narrower, for rows that need padding.
+	std::vector<unsigned char> narrow((size_t)(width - 1) * height * 4);
+	for (unsigned int y = 0; y < height; y++) memcpy(&narrow[(size_t)y * (width - 1) * 4], &rgba[(size_t)y * width * 4], (size_t)(width - 1) * 4);
+
+	struct { const char *name; unsigned int bpp; bool topDown, narrow; } cases[] = {
+		{ "24-bit", 24, false, false },
+		{ "24-bit, padded rows", 24, false, true },
+		{ "24-bit top-down", 24, true, false },
+		{ "32-bit with alpha", 32, false, false },
+		{ "8-bit palette", 8, false, false },
+	};
+	printf("%ux%u\n%-28s %10s %15s\n", size, size, "", "load", "copied");
+	for (size_t c = 0; c < sizeof cases / sizeof cases[0]; c++) {
+		char path[64];
+		snprintf(path, sizeof path, "/tmp/bench_bmp_%u_%u%s%s.bmp", size, cases[c].bpp, cases[c].topDown ? "_td" : "", cases[c].narrow ? "_n" : "");
+		if (bench_file_size(path) < 0 && !write_bmp(path, cases[c].narrow ? narrow : rgba, width - cases[c].narrow, height, cases[c].bpp, cases[c].topDown)) return 1;
+		bool oldTakes = cases[c].bpp == 24 && !cases[c].topDown;
+		run(cases[c].name, path, false);
+		if (oldTakes) run("  old loadBMP", path, true);
+	}
+	glfwTerminate();
+	return 0;
+}
@@ -0,0 +1,25 @@
+#!/usr/bin sh
+g++ -O2 obj_load.cpp /Local/Users/john/Documents/c/ogl/deps/tinycthread.c -o obj_load -L/usr/local/lib -I/usr/local/include -I/Local/Users/john/Documents/c/ogl/ -lglew -framework OpenGL -lglfw3
+g++ -O2 obj_parallel.cpp /Local/Users/john/Documents/c/ogl/deps/tinycthread.c -o obj_parallel -L/usr/local/lib -I/usr/local/include -I/Local/Users/john/Documents/c/ogl/ -lglew -framework OpenGL -lglfw3
+g++ -O2 obj_indexed.cpp /Local/Users/john/Documents/c/ogl/deps/tinycthread.c -o obj_indexed -L/usr/local/lib -I/usr/local/include -I/Local/Users/john/Documents/c/ogl/ -lglew -framework OpenGL -lglfw3
+g++ -O2 mesh_cache.cpp /Local/Users/john/Documents/c/ogl/deps/tinycthread.c -o mesh_cache -L/usr/local/lib -I/usr/local/include -I/Local/Users/john/Documents/c/ogl/ -lglew -framework OpenGL -lglfw3
+g++ -O2 obj_faces.cpp /Local/Users/john/Documents/c/ogl/deps/tinycthread.c -o obj_faces -L/usr/local/lib -I/usr/local/include -I/Local/Users/john/Documents/c/ogl/ -lglew -framework OpenGL -lglfw3
+g++ -O2 obj_stream.cpp /Local/Users/john/Documents/c/ogl/deps/tinycthread.c -o obj_stream -L/usr/local/lib -I/usr/local/include -I/Local/Users/john/Documents/c/ogl/ -lglew -framework OpenGL -lglfw3
+g++ -O2 arena.cpp /Local/Users/john/Documents/c/ogl/deps/tinycthread.c -o arena -L/usr/local/lib -I/usr/local/include -I/Local/Users/john/Documents/c/ogl/ -lglew -framework OpenGL -lglfw3
+g++ -O2 vertex_cache.cpp /Local/Users/john/Documents/c/ogl/deps/tinycthread.c -o vertex_cache -L/usr/local/lib -I/usr/local/include -I/Local/Users/john/Documents/c/ogl/ -lglew -framework OpenGL -lglfw3
+g++ -O2 quantize.cpp /Local/Users/john/Documents/c/ogl/deps/tinycthread.c -o quantize -L/usr/local/lib -I/usr/local/include -I/Local/Users/john/Documents/c/ogl/ -lglew -framework OpenGL -lglfw3
+g++ -O2 meshlets.cpp /Local/Users/john/Documents/c/ogl/deps/tinycthread.c -o meshlets -L/usr/local/lib -I/usr/local/include -I/Local/Users/john/Documents/c/ogl/ -lglew -framework OpenGL -lglfw3
+g++ -O2 simplify.cpp /Local/Users/john/Documents/c/ogl/deps/tinycthread.c -o simplify -L/usr/local/lib -I/usr/local/include -I/Local/Users/john/Documents/c/ogl/ -lglew -framework OpenGL -lglfw3
+g++ -O2 dds_load.cpp /Local/Users/john/Documents/c/ogl/deps/tinycthread.c -o dds_load -L/usr/local/lib -I/usr/local/include -I/Local/Users/john/Documents/c/ogl/ -lglew -framework OpenGL -lglfw3
+g++ -O2 texture_stream.cpp /Local/Users/john/Documents/c/ogl/deps/tinycthread.c -o texture_stream -L/usr/local/lib -I/usr/local/include -I/Local/Users/john/Documents/c/ogl/ -lglew -framework OpenGL -lglfw3
+g++ -O2 bc_decode.cpp /Local/Users/john/Documents/c/ogl/deps/tinycthread.c -o bc_decode -L/usr/local/lib -I/usr/local/include -I/Local/Users/john/Documents/c/ogl/ -lglew -framework OpenGL -lglfw3
+g++ -O2 bc_encode.cpp /Local/Users/john/Documents/c/ogl/deps/tinycthread.c -o bc_encode -L/usr/local/lib -I/usr/local/include -I/Local/Users/john/Documents/c/ogl/ -lglew -framework OpenGL -lglfw3
+g++ -O2 mip_gen.cpp /Local/Users/john/Documents/c/ogl/deps/tinycthread.c -o mip_gen -L/usr/local/lib -I/usr/local/include -I/Local/Users/john/Documents/c/ogl/ -lglew -framework OpenGL -lglfw3
+g++ -O2 ppm_load.cpp /Local/Users/john/Documents/c/ogl/deps/tinycthread.c -o ppm_load -L/usr/local/lib -I/usr/local/include -I/Local/Users/john/Documents/c/ogl/ -lglew -framework OpenGL -lglfw3
+g++ -O2 bmp_load.cpp /Local/Users/john/Documents/c/ogl/deps/tinycthread.c -o bmp_load -L/usr/local/lib -I/usr/local/include -I/Local/Users/john/Documents/c/ogl/ -lglew -framework OpenGL -lglfw3
+g++ -O2 texture_cache.cpp /Local/Users/john/Documents/c/ogl/deps/tinycthread.c -o texture_cache -L/usr/local/lib -I/usr/local/include -I/Local/Users/john/Documents/c/ogl/ -lglew -framework OpenGL -lglfw3
+g++ -O2 texture_atlas.cpp /Local/Users/john/Documents/c/ogl/deps/tinycthread.c -o texture_atlas -L/usr/local/lib -I/usr/local/include -I/Local/Users/john/Documents/c/ogl/ -lglew -framework OpenGL -lglfw3
+g++ -O2 program_cache.cpp /Local/Users/john/Documents/c/ogl/deps/tinycthread.c -o program_cache -L/usr/local/lib -I/usr/local/include -I/Local/Users/john/Documents/c/ogl/ -lglew -framework OpenGL -lglfw3
+g++ -O2 program_batch.cpp /Local/Users/john/Documents/c/ogl/deps/tinycthread.c -o program_batch -L/usr/local/lib -I/usr/local/include -I/Local/Users/john/Documents/c/ogl/ -lglew -framework OpenGL -lglfw3
+g++ -O2 shader_reload.cpp /Local/Users/john/Documents/c/ogl/deps/tinycthread.c -o shader_reload -L/usr/local/lib -I/usr/local/include -I/Local/Users/john/Documents/c/ogl/ -lglew -framework OpenGL -lglfw3
+g++ -O2 shader_permutations.cpp /Local/Users/john/Documents/c/ogl/deps/tinycthread.c -o shader_permutations -L/usr/local/lib -I/usr/local/include -I/Local/Users/john/Documents/c/ogl/ -lglew -framework OpenGL -lglfw3
@@ -0,0 +1,115 @@
+// Loading a set of 4K DDS textures the old way (fread of the whole file into
+// a malloc'd buffer, with the linearSize * 2 guess) and through openDDS
+// (mapped, every level handed over in place). Both are timed cold (files
+// dropped from the page cache) and warm ; the peak RSS and the private
+// memory at the moment every level is ready for upload are reported.
+//
+//   ./dds_load             8 files of 4096x4096, BC1 and BC3, full mipmaps
+//   ./dds_load 4 2048      4 files of 2048x2048
+//
+// glCompressedTexImage2D is stood in for by a pass over the bytes, which is
+// what the driver does first.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include "../basic_shading/common.hpp"
+#include "bench.hpp"
+
+static std::vector<std::string> files;
+static unsigned long long checksum;
+static double anonAtPeak;
+
+void fake_upload(const unsigned char *data, size_t size) {
+	unsigned long long sum = 0;
+	for (size_t i = 0; i < size; i += 64) sum += data[i];
+	checksum += sum;
+}
+
+// The loader as it was : one read of the header, one of "linearSize * 2"
+// bytes, levels sliced out of that.
+bool load_fread(const char *path, std::vector<unsigned char *> &buffers) {
+	FILE *fp = fopen(path, "rb");
+	if (!fp) return false;
+	char filecode[4];
+	unsigned char header[124];
+	if (fread(filecode, 1, 4, fp) != 4 || strncmp(filecode, "DDS ", 4) != 0 || fread(header, 124, 1, fp) != 1) {
+		fclose(fp);
+		return false;
+	}
+	unsigned int height      = *(unsigned int*)&(header[8 ]);
+	unsigned int width       = *(unsigned int*)&(header[12]);
+	unsigned int linearSize  = *(unsigned int*)&(header[16]);
+	unsigned int mipMapCount = *(unsigned int*)&(header[24]);
+	unsigned int fourCC      = *(unsigned int*)&(header[80]);
+	unsigned int bufsize = mipMapCount > 1 ? linearSize * 2 : linearSize;
+	unsigned char *buffer = (unsigned char *)malloc(bufsize);
+	size_t got = fread(buffer, 1, bufsize, fp);
+	fclose(fp);
+	unsigned int blockSize = fourCC == FOURCC_DXT1 ? 8 : 16, offset = 0;
+	for (unsigned int level = 0; level < mipMapCount && (width || height); ++level) {
+		unsigned int size = ((width + 3) / 4) * ((height + 3) / 4) * blockSize;
+		if (offset + size <= got) fake_upload(buffer + offset, size);
+		offset += size;
+		width = width > 1 ? width / 2 : 1;
+		height = height > 1 ? height / 2 : 1;
+	}
+	buffers.push_back(buffer);
+	return true;
+}
+
+bool load_mapped(const char *path, std::vector<DDSImage> &images) {
+	DDSImage image;
+	if (!openDDS(path, image)) return false;
+	for (unsigned int level = 0; level < image.levels; level++)
+		fake_upload(ddsLevelData(image, 0, 0, level), ddsLevelSize(image, level));
+	images.push_back(image);
+	return true;
+}
+
+// Each file is let go only once all of them are loaded, the way a scene
+// load keeps its buffers until the last glCompressedTexImage2D returns.
+int run(int mapped) {
+	double start = bench_now();
+	std::vector<unsigned char *> buffers;
+	std::vector<DDSImage> images;
+	for (size_t i = 0; i < files.size(); i++) {
+		bool ok = mapped ? load_mapped(files[i].c_str(), images) : load_fread(files[i].c_str(), buffers);
+		if (!ok) return 0;
+	}
+	anonAtPeak = bench_rss_anon_mb();
+	for (size_t i = 0; i < buffers.size(); i++) free(buffers[i]);
+	for (size_t i = 0; i < images.size(); i++) closeDDS(images[i]);
+	printf("  %9.1f ms %8.1f MB %8.1f MB", (bench_now() - start) * 1e3, bench_peak_rss_mb(), anonAtPeak);
+	return 1;
+}
+
+int main(int argc, char **argv) {
+	int count = argc > 1 ? atoi(argv[1]) : 8;
+	unsigned int size = argc > 2 ? (unsigned int)atoi(argv[2]) : 4096;
+
+	long total = 0;
+	for (int i = 0; i < count; i++) {
+		char path[64];
+		snprintf(path, sizeof path, "/tmp/bench_dds_%u_%d_%s.dds", size, i, i % 2 ? "bc3" : "bc1");
+		if (bench_file_size(path) < 0 && !bench_write_dds(path, size, size, i % 2 != 0)) return 1;
+		files.push_back(path);
+		total += bench_file_size(path);
+	}
+	printf("%d files of %ux%u, %.1f MB in all\n", count, size, size, total / (1024.0 * 1024.0));
+	printf("%-16s %12s %11s %11s\n", "", "time", "peak RSS", "private");
+
+	const char *names[] = { "fread cold", "fread warm", "mmap cold", "mmap warm" };
+	for (int c = 0; c < 4; c++) {
+		printf("%-16s", names[c]);
+		if (c % 2 == 0)
+			for (size_t i = 0; i < files.size(); i++) bench_drop_cache(files[i].c_str());
+		bench_isolated(run, c / 2);
+		printf("\n");
+	}
+	return 0;
+}
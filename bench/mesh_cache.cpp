@@ -0,0 +1,89 @@
+// Compares the startup cost of getting a mesh ready for glBufferData
+// through the text .obj and through its binary cache, each with the files
+// dropped from the page cache first (cold) and right after a first run
+// (warm). The copy glBufferData would do is stood in for by a memcpy.
+//
+//   ./mesh_cache                 suzanne.obj, then a synthetic 1M face mesh
+//   ./mesh_cache a.obj 500000    any mix of OBJ files and synthetic face counts
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+using namespace glm;
+#include "../basic_shading/common.hpp"
+#include "../basic_shading/objloader.hpp"
+#include "../basic_shading/vboindexer.hpp"
+#include "../basic_shading/meshcache.hpp"
+#include "bench.hpp"
+
+static std::vector<char> upload;
+
+void fake_upload(const void *data, size_t size) {
+	if (upload.size() < size) upload.resize(size);
+	if (size) memcpy(&upload[0], data, size);
+}
+
+int run_text(const char *path) {
+	double start = bench_now();
+	std::vector<glm::vec3> vertices, normals;
+	std::vector<glm::vec2> uvs;
+	if (!loadOBJ(path, vertices, uvs, normals)) return 0;
+	fake_upload(&vertices[0], vertices.size() * sizeof vertices[0]);
+	fake_upload(&uvs[0], uvs.size() * sizeof uvs[0]);
+	fake_upload(&normals[0], normals.size() * sizeof normals[0]);
+	printf(" %9.2f ms ", (bench_now() - start) * 1e3);
+	return 1;
+}
+
+int run_cached(const char *path) {
+	double start = bench_now();
+	CachedMesh mesh;
+	if (!loadOBJCached(path, mesh)) return 0;
+	fake_upload(mesh.vertices, mesh.vertexCount * sizeof(glm::vec3));
+	fake_upload(mesh.uvs, mesh.vertexCount * sizeof(glm::vec2));
+	fake_upload(mesh.normals, mesh.vertexCount * sizeof(glm::vec3));
+	fake_upload(mesh.indices, mesh.indexCount * mesh.indexSize);
+	closeMeshCache(mesh);
+	printf(" %9.2f ms ", (bench_now() - start) * 1e3);
+	return 1;
+}
+
+int main(int argc, char **argv) {
+	const char *defaults[] = { "../basic_shading/suzanne.obj", "1000000" };
+	int ncases = argc > 1 ? argc - 1 : 2;
+	char **cases = argc > 1 ? argv + 1 : (char **)defaults;
+
+	printf("%-32s %12s %12s %12s %12s %12s\n", "", "text cold", "text warm", "first run", "cache cold", "cache warm");
+	for (int i = 0; i < ncases; i++) {
+		const char *path = cases[i];
+		char synthetic[64];
+		if (isdigit(cases[i][0])) {
+			unsigned int w, h;
+			bench_grid_for_faces(strtoul(cases[i], 0, 10), &w, &h);
+			snprintf(synthetic, sizeof synthetic, "/tmp/bench_grid_%ux%u.obj", w, h);
+			if (bench_file_size(synthetic) < 0 && !bench_write_grid_obj(synthetic, w, h)) return 1;
+			path = synthetic;
+		}
+		std::string cachepath = std::string(path) + ".mesh";
+		printf("%-32s", path);
+
+		bench_drop_cache(path);
+		bench_isolated(run_text, path);
+		bench_isolated(run_text, path);
+
+		remove(cachepath.c_str());
+		bench_isolated(run_cached, path);
+		bench_drop_cache(cachepath.c_str());
+		bench_isolated(run_cached, path);
+		bench_isolated(run_cached, path);
+		printf("\n");
+	}
+	return 0;
+}
@@ -0,0 +1,104 @@
+// Meshlet building and CPU culling on a scene of many triangles : how long
+// buildMeshlets takes, how much of the scene the frustum and normal cone
+// tests reject, and what culling costs per frame.
+//
+//   ./meshlets             10 spheres of 1M triangles each (10M triangles)
+//   ./meshlets 20 500000   20 spheres of 500K triangles each
+//
+// The camera orbits the scene looking at its centre, with the projection
+// of controls.hpp ; the cull figures are averaged over the orbit.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+using namespace glm;
+#include "../basic_shading/meshoptimize.hpp"
+#include "../basic_shading/meshlets.hpp"
+#include "bench.hpp"
+
+// A UV sphere of about `faces` triangles appended to the scene, in Tipsify
+// order as the mesh cache would store it.
+void add_sphere(std::vector<glm::vec3> &vertices, std::vector<unsigned int> &indices, glm::vec3 centre, float radius, size_t faces) {
+	int rings = (int)sqrt(faces / 4.0);
+	int segments = rings * 2;
+	if (rings < 2) rings = 2;
+	unsigned int first = (unsigned int)vertices.size();
+	for (int r = 0; r <= rings; r++) {
+		float theta = 3.14159265f * r / rings;
+		for (int s = 0; s <= segments; s++) {
+			float phi = 2.0f * 3.14159265f * s / segments;
+			vertices.push_back(centre + radius * glm::vec3(sinf(theta) * cosf(phi), cosf(theta), sinf(theta) * sinf(phi)));
+		}
+	}
+	std::vector<unsigned int> local;
+	local.reserve((size_t)rings * segments * 6);
+	for (int r = 0; r < rings; r++) {
+		for (int s = 0; s < segments; s++) {
+			unsigned int a = r * (segments + 1) + s, b = a + segments + 1;
+			// Counter-clockwise seen from outside, like the OBJ exports
+			if (r > 0) { local.push_back(a); local.push_back(a + 1); local.push_back(b); }
+			if (r < rings - 1) { local.push_back(a + 1); local.push_back(b + 1); local.push_back(b); }
+		}
+	}
+	optimizeVertexCache(&local[0], local.size(), vertices.size() - first);
+	for (size_t i = 0; i < local.size(); i++) indices.push_back(local[i] + first);
+}
+
+int main(int argc, char **argv) {
+	int spheres = argc > 1 ? atoi(argv[1]) : 10;
+	size_t faces = argc > 2 ? (size_t)atol(argv[2]) : 1000000;
+
+	// Spheres on a ring of radius 10, the camera on a wider one around it
+	std::vector<glm::vec3> vertices;
+	std::vector<unsigned int> indices;
+	double start = bench_now();
+	for (int i = 0; i < spheres; i++) {
+		float a = 2.0f * 3.14159265f * i / spheres;
+		add_sphere(vertices, indices, glm::vec3(10.0f * cosf(a), 0.0f, 10.0f * sinf(a)), 1.5f, faces);
+	}
+	printf("scene : %d spheres, %.1fM triangles, %.1fM vertices (%.1f s to make)\n", spheres,
+		indices.size() / 3 / 1e6, vertices.size() / 1e6, bench_now() - start);
+
+	std::vector<Meshlet> meshlets;
+	start = bench_now();
+	buildMeshlets(&indices[0], indices.size(), &vertices[0], vertices.size(), meshlets);
+	double tbuild = bench_now() - start;
+	size_t meshletVertices = 0, coneless = 0;
+	for (size_t m = 0; m < meshlets.size(); m++) {
+		meshletVertices += meshlets[m].vertexCount;
+		if (meshlets[m].coneCutoff > 1.0f) coneless++;
+	}
+	printf("meshlets : %lu, %.1f triangles and %.1f vertices each, %.1f%% without a cone ; built in %.0f ms (%.1f Mtris/s)\n",
+		(unsigned long)meshlets.size(), indices.size() / 3.0 / meshlets.size(), (double)meshletVertices / meshlets.size(),
+		100.0 * coneless / meshlets.size(), tbuild * 1e3, indices.size() / 3 / 1e6 / tbuild);
+
+	glm::mat4 proj = glm::perspective(glm::radians(45.0f), 4.0f / 3.0f, 0.1f, 100.0f);
+	std::vector<int> counts;
+	std::vector<const void *> offsets;
+	const int frames = 256;
+	double frustumCulled = 0, backfaceCulled = 0, tcull = 0, drawCalls = 0;
+	for (int f = 0; f < frames; f++) {
+		float a = 2.0f * 3.14159265f * f / frames;
+		glm::vec3 eye(18.0f * cosf(a), 4.0f, 18.0f * sinf(a));
+		glm::mat4 mvp = proj * glm::lookAt(eye, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+		MeshletCullStats stats;
+		start = bench_now();
+		size_t visible = cullMeshlets(meshlets, mvp, eye, sizeof(unsigned int), counts, offsets, &stats);
+		tcull += bench_now() - start;
+		frustumCulled += (double)stats.frustumCulled / stats.triangles;
+		backfaceCulled += (double)stats.backfaceCulled / stats.triangles;
+		drawCalls += visible;
+	}
+	frustumCulled /= frames;
+	backfaceCulled /= frames;
+	printf("culled : %.1f%% of the triangles by the frustum, %.1f%% by the cones, %.1f%% drawn in %.0f ranges\n",
+		100.0 * frustumCulled, 100.0 * backfaceCulled, 100.0 * (1.0 - frustumCulled - backfaceCulled), drawCalls / frames);
+	printf("cull : %.3f ms per frame (%.1f Mmeshlets/s)\n", tcull * 1e3 / frames, meshlets.size() * frames / 1e6 / tcull);
+	return 0;
+}
@@ -0,0 +1,154 @@
+// Mipmap chains made on the CPU (mipgen.hpp) against glGenerateMipmap, at
+// 1K to 8K : the CPU filters on one thread and on all the cores, as plain
+// values and as sRGB light, with the box and the Kaiser filter ; then what
+// loadBMP pays either way, chain and upload, before the texture can be
+// drawn.
+//
+//   ./mip_gen                  1024 to 8192, up to 2x the cores
+//   ./mip_gen 4096 16          4096 alone, up to 16 threads
+//
+// Every figure is the best of 3 runs. The GL part runs on whatever the
+// default context is (llvmpipe on the test machines), where
+// glGenerateMipmap is itself a CPU filter, on the render thread. "diff"
+// is the largest difference of a channel of level 1 between the CPU's
+// plain box and the driver's.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+#include "../basic_shading/common.hpp"
+#include "bench.hpp"
+
+static std::vector<unsigned char> rgba, rgb;
+static unsigned int width, height;
+
+// Seconds to make the chain of `pixels`.
+double cpu_chain(const std::vector<unsigned char> &pixels, unsigned int channels, bool srgb, MipFilter filter, unsigned int threads, MipChain &chain) {
+	double best = 1e30;
+	for (int run = 0; run < 3; run++) {
+		double start = bench_now();
+		buildMipChain(&pixels[0], width, height, channels, 0, srgb, chain, filter, threads);
+		double t = bench_now() - start;
+		if (t < best) best = t;
+	}
+	return best;
+}
+
+// Seconds for glGenerateMipmap on a texture of `internalFormat` that has
+// its level 0, and for the whole of glTexImage2D + glGenerateMipmap ; the
+// driver's level 1 goes in `level1`.
+void gl_chain(GLint internalFormat, double *generate, double *total, std::vector<unsigned char> &level1) {
+	*generate = *total = 1e30;
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	for (int run = 0; run < 3; run++) {
+		GLuint texture;
+		glGenTextures(1, &texture);
+		glBindTexture(GL_TEXTURE_2D, texture);
+		glFinish();
+		double start = bench_now();
+		glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, &rgba[0]);
+		glFinish();
+		double mid = bench_now();
+		glGenerateMipmap(GL_TEXTURE_2D);
+		glFinish();
+		double end = bench_now();
+		if (end - mid < *generate) *generate = end - mid;
+		if (end - start < *total) *total = end - start;
+		if (run == 0) {
+			level1.resize((size_t)(width / 2) * (height / 2) * 4);
+			glPixelStorei(GL_PACK_ALIGNMENT, 1);
+			glGetTexImage(GL_TEXTURE_2D, 1, GL_RGBA, GL_UNSIGNED_BYTE, &level1[0]);
+		}
+		glDeleteTextures(1, &texture);
+	}
+}
+
+// Seconds for glTexImage2D of level 0 and uploadMipChain of `chain`.
+double gl_upload(const MipChain &chain, GLint internalFormat) {
+	double best = 1e30;
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	for (int run = 0; run < 3; run++) {
+		GLuint texture;
+		glGenTextures(1, &texture);
+		glBindTexture(GL_TEXTURE_2D, texture);
+		glFinish();
+		double start = bench_now();
+		glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, &rgba[0]);
+		uploadMipChain(GL_TEXTURE_2D, chain, internalFormat, GL_RGBA);
+		glFinish();
+		double t = bench_now() - start;
+		if (t < best) best = t;
+		glDeleteTextures(1, &texture);
+	}
+	return best;
+}
+
+int main(int argc, char **argv) {
+	unsigned int sizes[] = { 1024, 2048, 4096, 8192 }, count = 4;
+	if (argc > 1) {
+		sizes[0] = (unsigned int)atoi(argv[1]);
+		count = 1;
+	}
+	unsigned int cores = defaultThreadCount();
+	unsigned int maxThreads = argc > 2 ? (unsigned int)atoi(argv[2]) : 2 * cores;
+
+	glfwInit();
+	GLFWwindow *window = glfwCreateWindow(64, 64, "mip_gen", NULL, NULL);
+	if (!window) return 1;
+	glfwMakeContextCurrent(window);
+	glewExperimental = true;
+	glewInit();
+	printf("%s ; %u cores\n", (const char *)glGetString(GL_RENDERER), cores);
+
+	for (unsigned int s = 0; s < count; s++) {
+		char path[64];
+		snprintf(path, sizeof path, "/tmp/bench_bmp_%u.bmp", sizes[s]);
+		if (bench_file_size(path) < 0 && !bench_write_bmp(path, sizes[s], sizes[s])) return 1;
+		bool alpha;
+		if (!readImageRGBA(path, rgba, width, height, alpha)) return 1;
+		rgb.resize((size_t)width * height * 3);
+		for (size_t i = 0, j = 0; i < rgba.size(); i += 4, j += 3) memcpy(&rgb[j], &rgba[i], 3);
+		double mpixels = (double)width * height / 1e6;
+		printf("\n%ux%u, %.1f Mpixels in level 0\n", width, height, mpixels);
+
+		MipChain chain;
+		printf("%-22s %8s %12s %9s\n", "CPU", "threads", "time", "Mpix/s");
+		struct { const char *name; unsigned int channels; bool srgb; MipFilter filter; } cases[] = {
+			{ "RGB8 box", 3, false, MIP_BOX },
+			{ "RGBA8 box", 4, false, MIP_BOX },
+			{ "RGBA8 box sRGB", 4, true, MIP_BOX },
+			{ "RGBA8 Kaiser sRGB", 4, true, MIP_KAISER },
+		};
+		for (int c = 0; c < 4; c++) {
+			for (unsigned int threads = 1; threads <= maxThreads; threads *= 2) {
+				double t = cpu_chain(cases[c].channels == 3 ? rgb : rgba, cases[c].channels, cases[c].srgb, cases[c].filter, threads, chain);
+				printf("%-22s %8u %9.1f ms %9.1f\n", threads == 1 ? cases[c].name : "", threads, t * 1e3, mpixels / t);
+				if (threads < cores && threads * 2 > cores) threads = cores / 2; // the core count itself too
+			}
+		}
+
+		// The driver's, and the difference with the CPU's plain box.
+		std::vector<unsigned char> level1;
+		double generate, total, srgbGenerate, srgbTotal;
+		gl_chain(GL_SRGB8_ALPHA8, &srgbGenerate, &srgbTotal, level1);
+		gl_chain(GL_RGBA8, &generate, &total, level1);
+		buildMipChain(&rgba[0], width, height, 4, 0, false, chain, MIP_BOX, cores);
+		int diff = 0;
+		for (size_t i = 0; i < level1.size(); i++) diff = std::max(diff, abs((int)level1[i] - (int)chain.level(1)[i]));
+		printf("%-22s %8s %9.1f ms %9.1f  diff %d\n", "glGenerateMipmap", "", generate * 1e3, mpixels / generate, diff);
+		printf("%-22s %8s %9.1f ms %9.1f\n", "  on GL_SRGB8_ALPHA8", "", srgbGenerate * 1e3, mpixels / srgbGenerate);
+
+		// Level 0 to a drawable texture, each way.
+		double cpu = cpu_chain(rgba, 4, true, MIP_BOX, cores, chain);
+		double upload = gl_upload(chain, GL_RGBA8);
+		printf("%-40s %9.1f ms\n", "glTexImage2D + glGenerateMipmap", total * 1e3);
+		printf("%-40s %9.1f ms (%.1f + %.1f)\n", "buildMipChain sRGB + glTexImage2D x levels", (cpu + upload) * 1e3, cpu * 1e3, upload * 1e3);
+	}
+	glfwTerminate();
+	return 0;
+}
@@ -0,0 +1,52 @@
+// Measures loadOBJ throughput for each face layout it accepts, on the same
+// synthetic grid written out every way.
+//
+//   ./obj_faces            about 1M triangles
+//   ./obj_faces 5000000    about that many triangles
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+using namespace glm;
+#include "../basic_shading/common.hpp"
+#include "../basic_shading/objloader.hpp"
+#include "bench.hpp"
+
+struct FaceCase {
+	BenchFaceFormat format;
+	const char *name;
+};
+
+int main(int argc, char **argv) {
+	unsigned long faces = argc > 1 ? strtoul(argv[1], 0, 10) : 1000000;
+	const FaceCase cases[] = {
+		{ FACE_V_VT_VN,  "v/vt/vn" },
+		{ FACE_V,        "v" },
+		{ FACE_V_VT,     "v/vt" },
+		{ FACE_V_VN,     "v//vn" },
+		{ FACE_RELATIVE, "negative" },
+		{ FACE_QUADS,    "quads" },
+	};
+
+	unsigned int w, h;
+	bench_grid_for_faces(faces, &w, &h);
+	for (size_t i = 0; i < sizeof cases / sizeof cases[0]; i++) {
+		char path[64];
+		snprintf(path, sizeof path, "/tmp/bench_grid_%ux%u_%d.obj", w, h, (int)cases[i].format);
+		if (bench_file_size(path) < 0 && !bench_write_grid_obj(path, w, h, cases[i].format)) return 1;
+		long bytes = bench_file_size(path);
+
+		std::vector<glm::vec3> vertices, normals;
+		std::vector<glm::vec2> uvs;
+		double start = bench_now();
+		if (!loadOBJ(path, vertices, uvs, normals)) return 1;
+		double elapsed = bench_now() - start;
+		printf("%-10s %8.1f MB %10lu tris %9.3f s %9.1f MB/s %10.1f Mtris/s\n", cases[i].name, bytes / 1e6,
+			(unsigned long)vertices.size() / 3, elapsed, bytes / 1e6 / elapsed, vertices.size() / 3 / 1e6 / elapsed);
+	}
+	return 0;
+}
@@ -0,0 +1,110 @@
+#ifndef OBJ_FSCANF_HPP
+#define OBJ_FSCANF_HPP
+
+// The original fscanf-based loadOBJ, kept here as the baseline the
+// benchmarks compare the mapped tokenizer in objloader.hpp against.
+
+bool loadOBJ_fscanf(const char* path, std::vector<glm::vec3>& out_vertices, std::vector<glm::vec2>& out_uvs, std::vector<glm::vec3>& out_normals) {
+  // Open file for reading
+	FILE * file = fopen(path, "r");
+	if( file == NULL ){
+		printf("Impossible to open the file ! Are you in the right path ? See Tutorial 1 for details\n");
+		getchar();
+		return false;
+	}
+
+  // Temp vars to store contents of .obj
+	std::vector<unsigned int> vertexIndices, uvIndices, normalIndices;
+	std::vector<glm::vec3> temp_vertices; 
+	std::vector<glm::vec2> temp_uvs;
+	std::vector<glm::vec3> temp_normals;
+
+  // Reads until EOF is reached
+  while (1) {
+    char lineHeader[128];
+    // read first word
+    int res = fscanf(file, "%127s", lineHeader);
+    if (EOF == res) break;
+
+    if (strcmp(lineHeader, "v") == 0) {
+      glm::vec3 vertex;
+      fscanf(file, "%f %f %f\n", &vertex.x, &vertex.y, &vertex.z );
+      temp_vertices.push_back(vertex);
+    }
+    else if (strcmp(lineHeader, "vt") == 0) {
+			glm::vec2 uv;
+			fscanf(file, "%f %f\n", &uv.x, &uv.y );
+			uv.y = -uv.y; // Invert V coordinate since we will only use DDS texture, which are inverted. Remove if you want to use TGA or BMP loaders.
+			temp_uvs.push_back(uv);
+    }
+    else if (strcmp(lineHeader, "vn") == 0) {
+			glm::vec3 normal;
+			fscanf(file, "%f %f %f\n", &normal.x, &normal.y, &normal.z );
+			temp_normals.push_back(normal);
+    }
+    else if (strcmp(lineHeader, "f") == 0) {
+			std::string vertex1, vertex2, vertex3;
+			unsigned int vertexIndex[3], uvIndex[3], normalIndex[3];
+			int matches = fscanf(file, "%d/%d/%d %d/%d/%d %d/%d/%d\n", &vertexIndex[0], &uvIndex[0], &normalIndex[0], &vertexIndex[1], &uvIndex[1], &normalIndex[1], &vertexIndex[2], &uvIndex[2], &normalIndex[2] );
+			if (matches != 9){
+				printf("File can't be read by our simple parser :-( Try exporting with other options\n");
+				fclose(file);
+				return false;
+			}
+			vertexIndices.push_back(vertexIndex[0]);
+			vertexIndices.push_back(vertexIndex[1]);
+			vertexIndices.push_back(vertexIndex[2]);
+			uvIndices    .push_back(uvIndex[0]);
+			uvIndices    .push_back(uvIndex[1]);
+			uvIndices    .push_back(uvIndex[2]);
+			normalIndices.push_back(normalIndex[0]);
+			normalIndices.push_back(normalIndex[1]);
+			normalIndices.push_back(normalIndex[2]);
+    }
+		else{
+			// Probably a comment, eat up the rest of the line
+			char stupidBuffer[1000];
+
+      // fgets:
+      // Reads characters from stream and stores them as a C string 
+      // into str until (num-1) characters have been read or either 
+      // a newline or the end-of-file is reached, whichever happens first.
+			fgets(stupidBuffer, 1000, file);
+		}
+  }
+  fclose(file);
+
+  //We go through each vertex ( each v/vt/vn ) of each triangle ( each line with a "f" ),
+  // once, after the whole file has been read.
+  size_t nindices = vertexIndices.size();
+  out_vertices.reserve(out_vertices.size() + nindices);
+  out_uvs     .reserve(out_uvs.size() + nindices);
+  out_normals .reserve(out_normals.size() + nindices);
+
+  // For each vertex of each triangle
+  for( size_t i=0; i<nindices; i++ ){
+
+    // Get the indices of its attributes
+    unsigned int vertexIndex = vertexIndices[i];
+    unsigned int uvIndex = uvIndices[i];
+    unsigned int normalIndex = normalIndices[i];
+
+    if (vertexIndex-1 >= temp_vertices.size() || uvIndex-1 >= temp_uvs.size() || normalIndex-1 >= temp_normals.size()) {
+      printf("Face references a vertex that doesn't exist in %s\n", path);
+      return false;
+    }
+
+    // Get the attributes thanks to the index
+    glm::vec3 vertex = temp_vertices[ vertexIndex-1 ];
+    glm::vec2 uv = temp_uvs[ uvIndex-1 ];
+    glm::vec3 normal = temp_normals[ normalIndex-1 ];
+
+    // Put the attributes in buffers
+    out_vertices.push_back(vertex);
+    out_uvs     .push_back(uv);
+    out_normals .push_back(normal);
+  }
+  return true;
+}
+
+#endif
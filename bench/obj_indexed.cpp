@@ -0,0 +1,76 @@
+// Reports how much loadOBJIndexed shrinks a mesh compared to the triangle
+// soup from loadOBJ, and checks that drawing the indexed mesh gives back
+// exactly the same triangles.
+//
+//   ./obj_indexed                  suzanne.obj, cube.obj, synthetic 1M and 10M face meshes
+//   ./obj_indexed a.obj 500000     any mix of OBJ files and synthetic face counts
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <string.h>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+using namespace glm;
+#include "../basic_shading/common.hpp"
+#include "../basic_shading/objloader.hpp"
+#include "../basic_shading/vboindexer.hpp"
+#include "bench.hpp"
+
+int run_indexed(const char *path) {
+	std::vector<glm::vec3> vertices, normals;
+	std::vector<glm::vec2> uvs;
+	double start = bench_now();
+	if (!loadOBJ(path, vertices, uvs, normals)) return 0;
+	double soupTime = bench_now() - start;
+
+	std::vector<unsigned int> indices;
+	std::vector<glm::vec3> ivertices, inormals;
+	std::vector<glm::vec2> iuvs;
+	start = bench_now();
+	if (!loadOBJIndexed(path, indices, ivertices, iuvs, inormals)) return 0;
+	double indexedTime = bench_now() - start;
+
+	for (size_t i = 0; i < indices.size(); i++) {
+		unsigned int j = indices[i];
+		if (memcmp(&ivertices[j], &vertices[i], sizeof vertices[i]) || memcmp(&iuvs[j], &uvs[i], sizeof uvs[i]) ||
+			memcmp(&inormals[j], &normals[i], sizeof normals[i])) {
+			printf("  corner %lu differs !\n", (unsigned long)i);
+			return 0;
+		}
+	}
+
+	size_t stride = sizeof(glm::vec3) * 2 + sizeof(glm::vec2);
+	size_t indexSize = ivertices.size() <= 65536 ? 2 : 4;
+	size_t soupBytes = vertices.size() * stride;
+	size_t indexedBytes = ivertices.size() * stride + indices.size() * indexSize;
+	printf("  %10lu corners -> %10lu vertices (%5.1f%%), %10.3f MB -> %10.3f MB with %lu-bit indices\n",
+		(unsigned long)vertices.size(), (unsigned long)ivertices.size(), 100.0 * ivertices.size() / vertices.size(),
+		soupBytes / 1e6, indexedBytes / 1e6, (unsigned long)indexSize * 8);
+	printf("  load %.3f s as soup, %.3f s indexed\n", soupTime, indexedTime);
+	return 1;
+}
+
+int main(int argc, char **argv) {
+	const char *defaults[] = { "../basic_shading/suzanne.obj", "../basic_shading/cube.obj", "1000000", "10000000" };
+	int ncases = argc > 1 ? argc - 1 : 4;
+	char **cases = argc > 1 ? argv + 1 : (char **)defaults;
+
+	for (int i = 0; i < ncases; i++) {
+		const char *path = cases[i];
+		char synthetic[64];
+		if (isdigit(cases[i][0])) {
+			unsigned int w, h;
+			bench_grid_for_faces(strtoul(cases[i], 0, 10), &w, &h);
+			snprintf(synthetic, sizeof synthetic, "/tmp/bench_grid_%ux%u.obj", w, h);
+			if (bench_file_size(synthetic) < 0 && !bench_write_grid_obj(synthetic, w, h)) return 1;
+			path = synthetic;
+		}
+		printf("%s\n", path);
+		if (!bench_isolated(run_indexed, path)) printf("  failed\n");
+	}
+	return 0;
+}
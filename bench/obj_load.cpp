@@ -0,0 +1,83 @@
+// Measures loadOBJ throughput and memory against the original fscanf loader.
+//
+//   ./obj_load                 suzanne.obj, then synthetic 1M and 10M face meshes
+//   ./obj_load a.obj 500000    any mix of OBJ files and synthetic face counts
+//
+// Each case runs in its own process so peak RSS is per-case.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <string.h>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+using namespace glm;
+#include "../basic_shading/common.hpp"
+#include "../basic_shading/objloader.hpp"
+#include "obj_fscanf.hpp"
+#include "bench.hpp"
+
+typedef bool (*ObjLoader)(const char*, std::vector<glm::vec3>&, std::vector<glm::vec2>&, std::vector<glm::vec3>&);
+
+struct LoadCase {
+	const char *name;
+	const char *path;
+	ObjLoader loader;
+};
+
+int run_load(const LoadCase *c) {
+	long bytes = bench_file_size(c->path);
+	std::vector<glm::vec3> vertices;
+	std::vector<glm::vec2> uvs;
+	std::vector<glm::vec3> normals;
+
+	double start = bench_now();
+	bool res = c->loader(c->path, vertices, uvs, normals);
+	double elapsed = bench_now() - start;
+	if (!res) return 0;
+
+	printf("  %-8s %10lu tris %9.3f s %9.1f MB/s  peak RSS %8.1f MB\n",
+		c->name, (unsigned long)vertices.size() / 3, elapsed,
+		bytes / 1e6 / elapsed, bench_peak_rss_mb());
+	return 1;
+}
+
+// Both loaders must produce exactly the same buffers.
+bool same_output(const char *path) {
+	std::vector<glm::vec3> v0, n0, v1, n1;
+	std::vector<glm::vec2> t0, t1;
+	if (!loadOBJ_fscanf(path, v0, t0, n0) || !loadOBJ(path, v1, t1, n1)) return false;
+	return v0.size() == v1.size() && t0.size() == t1.size() && n0.size() == n1.size() &&
+		memcmp(&v0[0], &v1[0], v0.size() * sizeof v0[0]) == 0 &&
+		memcmp(&t0[0], &t1[0], t0.size() * sizeof t0[0]) == 0 &&
+		memcmp(&n0[0], &n1[0], n0.size() * sizeof n0[0]) == 0;
+}
+
+int main(int argc, char **argv) {
+	const char *defaults[] = { "../basic_shading/suzanne.obj", "1000000", "10000000" };
+	int ncases = argc > 1 ? argc - 1 : 3;
+	char **cases = argc > 1 ? argv + 1 : (char **)defaults;
+
+	for (int i = 0; i < ncases; i++) {
+		const char *path = cases[i];
+		char synthetic[64];
+		if (isdigit(cases[i][0])) {
+			unsigned int w, h;
+			bench_grid_for_faces(strtoul(cases[i], 0, 10), &w, &h);
+			snprintf(synthetic, sizeof synthetic, "/tmp/bench_grid_%ux%u.obj", w, h);
+			if (bench_file_size(synthetic) < 0 && !bench_write_grid_obj(synthetic, w, h)) return 1;
+			path = synthetic;
+		}
+		printf("%s (%.1f MB)\n", path, bench_file_size(path) / 1e6);
+
+		LoadCase fscanf_case = { "fscanf", path, loadOBJ_fscanf };
+		LoadCase mapped_case = { "mapped", path, loadOBJ };
+		if (!bench_isolated(run_load, &fscanf_case)) printf("  fscanf : load failed\n");
+		if (!bench_isolated(run_load, &mapped_case)) printf("  mapped : load failed\n");
+		if (!bench_isolated(same_output, path)) printf("  outputs differ !\n");
+	}
+	return 0;
+}
@@ -0,0 +1,45 @@
+// Measures how loadOBJParallel scales with the number of threads.
+//
+//   ./obj_parallel                   synthetic 10M face mesh, 1..cores threads
+//   ./obj_parallel a.obj 16          a given file (or face count), 1..16 threads
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+using namespace glm;
+#include "../basic_shading/common.hpp"
+#include "../basic_shading/objloader.hpp"
+#include "bench.hpp"
+
+int main(int argc, char **argv) {
+	const char *path = argc > 1 ? argv[1] : "10000000";
+	unsigned int maxThreads = argc > 2 ? atoi(argv[2]) : defaultThreadCount();
+
+	char synthetic[64];
+	if (isdigit(path[0])) {
+		unsigned int w, h;
+		bench_grid_for_faces(strtoul(path, 0, 10), &w, &h);
+		snprintf(synthetic, sizeof synthetic, "/tmp/bench_grid_%ux%u.obj", w, h);
+		if (bench_file_size(synthetic) < 0 && !bench_write_grid_obj(synthetic, w, h)) return 1;
+		path = synthetic;
+	}
+	long bytes = bench_file_size(path);
+	printf("%s (%.1f MB), %u cores\n", path, bytes / 1e6, defaultThreadCount());
+
+	double single = 0;
+	for (unsigned int n = 1; n <= maxThreads; n++) {
+		std::vector<glm::vec3> vertices, normals;
+		std::vector<glm::vec2> uvs;
+		double start = bench_now();
+		if (!loadOBJParallel(path, vertices, uvs, normals, n)) return 1;
+		double elapsed = bench_now() - start;
+		if (n == 1) single = elapsed;
+		printf("  %2u threads %9.3f s %9.1f MB/s  speedup %5.2fx\n", n, elapsed, bytes / 1e6 / elapsed, single / elapsed);
+	}
+	return 0;
+}
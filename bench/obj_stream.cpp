@@ -0,0 +1,113 @@
+// Peak memory of loadOBJ against loadOBJStreaming, which hands the
+// triangles to a sink one window at a time. The sink copies each batch
+// into a fixed staging block, standing in for a mapped GL buffer.
+//
+//   ./obj_stream                  suzanne.obj, then a synthetic 1M face mesh
+//   ./obj_stream a.obj 48000000   any mix of OBJ files and synthetic face
+//                                 counts (48M faces is about 5 GB)
+//
+// Each case runs in its own process so peak RSS is per-case.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <string.h>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+using namespace glm;
+#include "../basic_shading/common.hpp"
+#include "../basic_shading/objloader.hpp"
+#include "bench.hpp"
+
+struct Staging {
+	std::vector<char> block;
+	size_t corners;
+};
+
+bool stage_batch(void *user, const glm::vec3 *vertices, const glm::vec2 *uvs, const glm::vec3 *normals, size_t count) {
+	Staging *staging = (Staging *)user;
+	size_t size = count * (2 * sizeof(glm::vec3) + sizeof(glm::vec2));
+	if (staging->block.size() < size) staging->block.resize(size);
+	char *p = &staging->block[0];
+	memcpy(p, vertices, count * sizeof(glm::vec3)); p += count * sizeof(glm::vec3);
+	memcpy(p, uvs, count * sizeof(glm::vec2));      p += count * sizeof(glm::vec2);
+	memcpy(p, normals, count * sizeof(glm::vec3));
+	staging->corners += count;
+	return true;
+}
+
+void print_result(const char *name, size_t corners, long bytes, double elapsed) {
+	printf("  %-10s %10lu tris %9.3f s %9.1f MB/s  peak RSS %8.1f MB\n",
+		name, (unsigned long)corners / 3, elapsed, bytes / 1e6 / elapsed, bench_peak_rss_mb());
+}
+
+int run_whole(const char *path) {
+	std::vector<glm::vec3> vertices, normals;
+	std::vector<glm::vec2> uvs;
+	double start = bench_now();
+	if (!loadOBJ(path, vertices, uvs, normals)) return 0;
+	print_result("loadOBJ", vertices.size(), bench_file_size(path), bench_now() - start);
+	return 1;
+}
+
+int run_streaming(const char *path) {
+	Staging staging;
+	staging.corners = 0;
+	double start = bench_now();
+	if (!loadOBJStreaming(path, stage_batch, &staging)) return 0;
+	print_result("streaming", staging.corners, bench_file_size(path), bench_now() - start);
+	return 1;
+}
+
+struct Collected {
+	std::vector<glm::vec3> vertices, normals;
+	std::vector<glm::vec2> uvs;
+};
+
+bool collect_batch(void *user, const glm::vec3 *vertices, const glm::vec2 *uvs, const glm::vec3 *normals, size_t count) {
+	Collected *out = (Collected *)user;
+	out->vertices.insert(out->vertices.end(), vertices, vertices + count);
+	out->uvs.insert(out->uvs.end(), uvs, uvs + count);
+	out->normals.insert(out->normals.end(), normals, normals + count);
+	return true;
+}
+
+// With a small window, so that plenty of lines straddle two reads, the
+// streamed triangles must be exactly loadOBJ's.
+bool same_output(const char *path) {
+	std::vector<glm::vec3> v0, n0;
+	std::vector<glm::vec2> t0;
+	Collected c;
+	if (!loadOBJ(path, v0, t0, n0) || !loadOBJStreaming(path, collect_batch, &c, 4096)) return false;
+	return v0.size() == c.vertices.size() && t0.size() == c.uvs.size() && n0.size() == c.normals.size() &&
+		(v0.empty() || (memcmp(&v0[0], &c.vertices[0], v0.size() * sizeof v0[0]) == 0 &&
+		memcmp(&t0[0], &c.uvs[0], t0.size() * sizeof t0[0]) == 0 &&
+		memcmp(&n0[0], &c.normals[0], n0.size() * sizeof n0[0]) == 0));
+}
+
+int main(int argc, char **argv) {
+	const char *defaults[] = { "../basic_shading/suzanne.obj", "1000000" };
+	int ncases = argc > 1 ? argc - 1 : 2;
+	char **cases = argc > 1 ? argv + 1 : (char **)defaults;
+
+	for (int i = 0; i < ncases; i++) {
+		const char *path = cases[i];
+		char synthetic[64];
+		if (isdigit(cases[i][0])) {
+			unsigned int w, h;
+			bench_grid_for_faces(strtoul(cases[i], 0, 10), &w, &h);
+			snprintf(synthetic, sizeof synthetic, "/tmp/bench_grid_%ux%u.obj", w, h);
+			if (bench_file_size(synthetic) < 0 && !bench_write_grid_obj(synthetic, w, h)) return 1;
+			path = synthetic;
+		}
+		printf("%s (%.1f MB)\n", path, bench_file_size(path) / 1e6);
+
+		if (!bench_isolated(run_whole, path)) printf("  loadOBJ : load failed\n");
+		if (!bench_isolated(run_streaming, path)) printf("  streaming : load failed\n");
+		if (bench_file_size(path) < (256L << 20) && !bench_isolated(same_output, path)) printf("  outputs differ !\n");
+	}
+	return 0;
+}
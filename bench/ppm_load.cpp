@@ -0,0 +1,197 @@
+// load_image on netpbm files : the decoder of ppmdecode.hpp, reading a
+// mapping of the whole file, against the load_ppm it replaced (below,
+// as it was), which called fgetc three times a pixel. Then each of the
+// formats the new one takes, and its 8-bit converters one against the
+// other.
+//
+//   ./ppm_load            4096x4096
+//   ./ppm_load 2048       2048x2048
+//
+// Files are read warm ; every figure is the best of 3 runs.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include "../basic_shading/common.hpp"
+#include "bench.hpp"
+
+// The old loader, P6 with a maximum of 255 only.
+static int old_read_to_wspace(FILE *fp, char *buf, int bsize) {
+	int c, count = 0;
+	while((c = fgetc(fp)) != -1 && !isspace(c) && count < bsize - 1) {
+		if(c == '#') {
+			while((c = fgetc(fp)) != -1 && c != '\n' && c != '\r');
+			c = fgetc(fp);
+			if(c == '\n' || c == '\r') continue;
+		}
+		*buf++ = c;
+		count++;
+	}
+	*buf = 0;
+	while((c = fgetc(fp)) != -1 && isspace(c));
+	ungetc(c, fp);
+	return count;
+}
+
+void *old_load_ppm(const char *path, unsigned long *xsz, unsigned long *ysz) {
+	char buf[64];
+	FILE *fp = fopen(path, "r");
+	if(!fp) return 0;
+	old_read_to_wspace(fp, buf, 64);
+	old_read_to_wspace(fp, buf, 64);
+	unsigned int w = atoi(buf);
+	old_read_to_wspace(fp, buf, 64);
+	unsigned int h = atoi(buf);
+	old_read_to_wspace(fp, buf, 64);
+	uint32_t *pixels = (uint32_t *)malloc((size_t)w * h * sizeof *pixels);
+	for(size_t i = 0; i < (size_t)w * h; i++) {
+		int r = fgetc(fp);
+		int g = fgetc(fp);
+		int b = fgetc(fp);
+		if(r == -1 || g == -1 || b == -1) {
+			free(pixels);
+			fclose(fp);
+			return 0;
+		}
+		pixels[i] = PACK_COLOR24(r, g, b);
+	}
+	fclose(fp);
+	*xsz = w;
+	*ysz = h;
+	return pixels;
+}
+
+// The same picture in each format, from the RGBA8 pixels of the P6 one.
+bool write_format(const char *path, const char *magic, const std::vector<unsigned char> &rgba, unsigned int w, unsigned int h) {
+	FILE *fp = fopen(path, "wb");
+	if (!fp) return false;
+	size_t count = (size_t)w * h;
+	if (strcmp(magic, "P7") == 0) {
+		fprintf(fp, "P7\nWIDTH %u\nHEIGHT %u\nDEPTH 4\nMAXVAL 255\nTUPLTYPE RGB_ALPHA\nENDHDR\n", w, h);
+		fwrite(&rgba[0], 1, rgba.size(), fp);
+	} else if (strcmp(magic, "P5") == 0) {
+		fprintf(fp, "P5\n%u %u\n255\n", w, h);
+		for (size_t i = 0; i < count; i++) fputc(rgba[4 * i + 1], fp);
+	} else if (strcmp(magic, "P6/16") == 0) {
+		fprintf(fp, "P6\n%u %u\n65535\n", w, h);
+		for (size_t i = 0; i < count; i++)
+			for (int c = 0; c < 3; c++) { fputc(rgba[4 * i + c], fp); fputc(rgba[4 * i + c], fp); } // v * 257
+	} else {
+		fprintf(fp, "P3\n# written by ppm_load\n%u %u\n255\n", w, h);
+		for (size_t i = 0; i < count; i++) fprintf(fp, "%u %u %u%c", rgba[4 * i], rgba[4 * i + 1], rgba[4 * i + 2], i % 5 == 4 ? '\n' : ' ');
+	}
+	fclose(fp);
+	return true;
+}
+
+// Seconds for load_image of `path`, checked against `expected` if given.
+double time_load_image(const char *path, const uint32_t *expected, bool *same) {
+	double best = 1e30;
+	for (int run = 0; run < 3; run++) {
+		unsigned long w, h;
+		double start = bench_now();
+		uint32_t *pixels = (uint32_t *)load_image(path, &w, &h);
+		double t = bench_now() - start;
+		if (!pixels) return 0;
+		if (t < best) best = t;
+		if (expected) {
+			// The old loader left alpha at 0, the new one sets it to 255.
+			*same = true;
+			for (size_t i = 0; i < w * h; i++) *same = *same && ((pixels[i] ^ expected[i]) & 0xffffff) == 0;
+		}
+		free(pixels);
+	}
+	return best;
+}
+
+// Seconds for ppmDecode of a mapping of `path` with `row`.
+double time_decode(const char *path, PPMRow row) {
+	MappedFile file;
+	if (!mapFile(path, file)) return 0;
+	PPMHeader header;
+	double best = 1e30;
+	if (ppmReadHeader((const unsigned char *)file.data, file.size, header)) {
+		std::vector<unsigned char> out((size_t)header.width * header.height * 4);
+		for (int run = 0; run < 3; run++) {
+			double start = bench_now();
+			ppmDecode((const unsigned char *)file.data, file.size, header, PACKED_ORDER, &out[0], row);
+			double t = bench_now() - start;
+			if (t < best) best = t;
+		}
+	}
+	unmapFile(file);
+	return best;
+}
+
+int main(int argc, char **argv) {
+	unsigned int size = argc > 1 ? (unsigned int)atoi(argv[1]) : 4096;
+	char path[64];
+	snprintf(path, sizeof path, "/tmp/bench_ppm_%u.ppm", size);
+	if (bench_file_size(path) < 0 && !bench_write_ppm(path, size, size)) return 1;
+	double mpixels = (double)size * size / 1e6;
+	printf("%ux%u, %.1f Mpixels\n", size, size, mpixels);
+
+	// The old loader, and the new one on the same file.
+	unsigned long w, h;
+	double best = 1e30;
+	uint32_t *old = NULL;
+	for (int run = 0; run < 3; run++) {
+		free(old);
+		double start = bench_now();
+		old = (uint32_t *)old_load_ppm(path, &w, &h);
+		double t = bench_now() - start;
+		if (!old) return 1;
+		if (t < best) best = t;
+	}
+	bool same = false;
+	double t = time_load_image(path, old, &same);
+	double mb = bench_file_size(path) / (1024.0 * 1024.0);
+	printf("%-26s %10s %10s %10s\n", "P6", "time", "MB/s", "Mpix/s");
+	printf("%-26s %7.1f ms %10.0f %10.1f\n", "fgetc load_ppm (old)", best * 1e3, mb / best, mpixels / best);
+	printf("%-26s %7.1f ms %10.0f %10.1f  %.1fx, %s\n", "load_image (new)", t * 1e3, mb / t, mpixels / t, best / t, same ? "same pixels" : "DIFFERENT pixels");
+	free(old);
+
+	// Each 8-bit converter, on the mapping alone.
+	const char *names[] = { "  scalar", "  SSSE3", "  NEON" };
+	PPMRow rows[3] = { ppmRowScalar, NULL, NULL };
+#ifdef PPM_DECODE_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("ssse3")) rows[1] = ppmRowSSSE3;
+#endif
+#ifdef PPM_DECODE_NEON
+	rows[2] = ppmRowNEON;
+#endif
+	for (int r = 0; r < 3; r++) {
+		if (!rows[r]) continue;
+		t = time_decode(path, rows[r]);
+		printf("%-26s %7.1f ms %10.0f %10.1f\n", names[r], t * 1e3, mb / t, mpixels / t);
+	}
+
+	// The other formats, through load_image.
+	std::vector<unsigned char> rgba;
+	unsigned int width, height;
+	bool alpha;
+	if (!readImageRGBA(path, rgba, width, height, alpha)) return 1;
+	const char *formats[] = { "P5", "P6/16", "P7", "P3" };
+	const char *labels[] = { "P5 grey", "P6 16-bit", "P7 (PAM) RGB_ALPHA", "P3 (ASCII)" };
+	for (int f = 0; f < 4; f++) {
+		char other[64];
+		snprintf(other, sizeof other, "/tmp/bench_ppm_%u_%d.pnm", size, f);
+		if (bench_file_size(other) < 0 && !write_format(other, formats[f], rgba, width, height)) return 1;
+		std::vector<unsigned char> check;
+		unsigned int cw, ch;
+		if (!readImageRGBA(other, check, cw, ch, alpha)) return 1;
+		bool ok = true;
+		for (size_t i = 0; i < check.size() && ok; i += 4)
+			for (int c = 0; c < 3; c++) ok = ok && check[i + c] == rgba[i + (f == 0 ? 1 : c)];
+		double mbOther = bench_file_size(other) / (1024.0 * 1024.0);
+		t = time_load_image(other, NULL, NULL);
+		printf("%-26s %7.1f ms %10.0f %10.1f  %s\n", labels[f], t * 1e3, mbOther / t, mpixels / t, ok ? "same pixels" : "DIFFERENT pixels");
+	}
+	return 0;
+}
@@ -0,0 +1,156 @@
+// 50 programs compiled with LoadShaders one after the other, against
+// ProgramBatch (programbatch.hpp) : every program submitted, then waited
+// for ; and submitted, then polled from a render loop that draws a loading
+// screen with a fallback program until all are ready. Every run is its own
+// process with the program cache and Mesa's shader cache empty, so that
+// everything is really compiled.
+//
+//   ./program_batch               50 programs
+//   ./program_batch 100           100 programs
+//
+// The programs are one pair of shaders (bench_write_shaders) with a
+// different number of lights and noise octaves each. Only compiling and
+// linking is timed : llvmpipe makes the machine code of a program when it
+// is first drawn with, whichever way it was compiled. The GL part runs on
+// whatever the default context is (llvmpipe on the test machines).
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#define PROGRAM_CACHE_DIR "/tmp/bench_program_batch_cache"
+
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+#include "../basic_shading/common.hpp"
+#include "bench.hpp"
+
+#define VERTEX_PATH    "/tmp/bench_program_batch.vertexshader"
+#define FRAGMENT_PATH  "/tmp/bench_program_batch.fragmentshader"
+#define FALLBACK_PATH  "/tmp/bench_program_batch_fallback.fragmentshader"
+#define MESA_CACHE_DIR "/tmp/bench_program_batch_mesa"
+
+enum Mode {
+	ONE_BY_ONE,
+	BATCH_WAIT,
+	BATCH_POLL
+};
+
+struct Run {
+	Mode mode;
+	unsigned int programs;
+};
+
+void defines_for(unsigned int i, char *defines, size_t size) {
+	snprintf(defines, size, "#define LIGHTS %u\n#define OCTAVES %u\n#define VARIANT %u\n", 1 + i % 8, 1 + i / 8 % 6, i);
+}
+
+int run(Run *r) {
+	glfwInit();
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+	GLFWwindow *window = glfwCreateWindow(64, 64, "program_batch", NULL, NULL);
+	if (!window) return 0;
+	glfwMakeContextCurrent(window);
+	glewExperimental = true;
+	glewInit();
+	GLuint vao, buffer;
+	glGenVertexArrays(1, &vao);
+	glBindVertexArray(vao);
+	glGenBuffers(1, &buffer);
+	glBindBuffer(GL_ARRAY_BUFFER, buffer);
+	float triangle[] = { -1, -1, 0.5f, 3, -1, 0.5f, -1, 3, 0.5f };
+	glBufferData(GL_ARRAY_BUFFER, sizeof triangle, triangle, GL_STATIC_DRAW);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (void *)0);
+
+	// The messages of LoadShaders and ProgramBatch, out of the way.
+	fflush(stdout);
+	int out = dup(1), null = open("/dev/null", O_WRONLY);
+	dup2(null, 1);
+	GLuint fallback = r->mode == BATCH_POLL ? LoadShaders(VERTEX_PATH, FALLBACK_PATH) : 0;
+	std::vector<GLuint> programs(r->programs);
+	unsigned long frames = 0, readyAtFirstFrame = 0;
+	double begin = bench_now(), submitted = 0, firstFrame = 0;
+	if (r->mode == ONE_BY_ONE) {
+		for (unsigned int i = 0; i < r->programs; i++) {
+			char defines[96];
+			defines_for(i, defines, sizeof defines);
+			programs[i] = LoadShaders(VERTEX_PATH, FRAGMENT_PATH, defines);
+		}
+		submitted = bench_now() - begin;
+	} else {
+		ProgramBatch batch;
+		for (unsigned int i = 0; i < r->programs; i++) {
+			char defines[96];
+			defines_for(i, defines, sizeof defines);
+			batch.add(VERTEX_PATH, FRAGMENT_PATH, defines, fallback);
+		}
+		submitted = bench_now() - begin;
+		if (r->mode == BATCH_WAIT) {
+			batch.finish();
+		} else {
+			// A loading screen, drawn with the fallback, until every program is in.
+			size_t pending;
+			do {
+				pending = batch.poll();
+				glClear(GL_COLOR_BUFFER_BIT);
+				glUseProgram(fallback);
+				glDrawArrays(GL_TRIANGLES, 0, 3);
+				glFinish();
+				if (frames++ == 0) {
+					firstFrame = bench_now() - begin;
+					readyAtFirstFrame = r->programs - pending;
+				}
+			} while (pending);
+		}
+		for (unsigned int i = 0; i < r->programs; i++) programs[i] = batch.state(i) == PROGRAM_READY ? batch.program(i) : 0;
+	}
+	glFinish();
+	double total = bench_now() - begin;
+	fflush(stdout);
+	dup2(out, 1);
+	close(out);
+	close(null);
+
+	unsigned int linked = 0;
+	for (unsigned int i = 0; i < r->programs; i++) {
+		if (programs[i]) linked++;
+		glDeleteProgram(programs[i]);
+	}
+	printf("%9.1f ms %9.1f ms %9.1f ms   %u of %u linked", submitted * 1e3, total * 1e3, total * 1e3 / r->programs, linked, r->programs);
+	if (r->mode == BATCH_POLL)
+		printf(" ; first frame after %.1f ms with %lu ready, %lu frames", firstFrame * 1e3, readyAtFirstFrame, frames);
+	printf("\n");
+	if (r->mode == BATCH_POLL) printf("%s, GL_KHR_parallel_shader_compile %s\n", (const char *)glGetString(GL_RENDERER), GLEW_KHR_parallel_shader_compile ? "there" : "not there");
+	glDeleteProgram(fallback);
+	glDeleteBuffers(1, &buffer);
+	glDeleteVertexArrays(1, &vao);
+	glfwTerminate();
+	return 1;
+}
+
+int main(int argc, char **argv) {
+	unsigned int count = argc > 1 ? (unsigned int)atoi(argv[1]) : 50;
+	setenv("MESA_SHADER_CACHE_DIR", MESA_CACHE_DIR, 1);
+	setenv("MESA_GLSL_CACHE_DIR", MESA_CACHE_DIR, 1);
+	if (!bench_write_shaders(VERTEX_PATH, FRAGMENT_PATH)) return 1;
+	FILE *fp = fopen(FALLBACK_PATH, "wb");
+	if (!fp) return 1;
+	fputs("#version 330 core\nout vec4 color;\nvoid main() { color = vec4(0.5, 0.0, 0.5, 1.0); }\n", fp);
+	fclose(fp);
+
+	const char *names[] = { "LoadShaders one by one", "ProgramBatch, finish()", "ProgramBatch, poll()" };
+	printf("%u programs\n", count);
+	printf("%-26s %12s %12s %12s\n", "", "submitted", "all ready", "a program");
+	for (int mode = ONE_BY_ONE; mode <= BATCH_POLL; mode++) {
+		if (system("rm -rf " PROGRAM_CACHE_DIR " " MESA_CACHE_DIR) != 0) return 1;
+		Run r = { (Mode)mode, count };
+		printf("%-26s", names[mode]);
+		if (!bench_isolated(run, &r)) return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,164 @@
+// LoadShaders through the program binary cache (programcache.hpp) : a
+// start with the cache empty, which compiles, links and writes every
+// program, then starts with it full, which only hands the binaries back to
+// glProgramBinary. Each start is its own process, as a real one would be ;
+// every program then draws a frame, and the pixels of the cold and warm
+// starts are compared.
+//
+//   ./program_cache               32 programs
+//   ./program_cache 64            64 programs
+//
+// The programs are one pair of shaders (bench_write_shaders) with a
+// different number of lights and noise octaves each. Mesa keeps a shader
+// cache of its own, and its program binaries are made from it, so it can't
+// be turned off : it goes to a directory of its own, emptied for the cold
+// start, and a last start with only Mesa's cache warm shows what the
+// program cache adds to it. The GL part runs on whatever the default
+// context is (llvmpipe on the test machines).
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#define PROGRAM_CACHE_DIR "/tmp/bench_program_cache"
+
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+#include "../basic_shading/common.hpp"
+#include "bench.hpp"
+
+#define VERTEX_PATH   "/tmp/bench_program_cache.vertexshader"
+#define FRAGMENT_PATH "/tmp/bench_program_cache.fragmentshader"
+#define MESA_CACHE_DIR "/tmp/bench_program_cache_mesa"
+
+struct Start {
+	unsigned int programs;
+	const char *hashPath; // where the frame hash goes
+};
+
+// One start : a context, every program, a frame each. Prints the time
+// LoadShaders took, then the first draws : llvmpipe, like some other
+// drivers, only makes machine code for a program when it is first drawn
+// with, and that is where most of the time goes.
+int start(Start *s) {
+	glfwInit();
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+	GLFWwindow *window = glfwCreateWindow(64, 64, "program_cache", NULL, NULL);
+	if (!window) return 0;
+	glfwMakeContextCurrent(window);
+	glewExperimental = true;
+	glewInit();
+
+	// LoadShaders' own messages, out of the way.
+	fflush(stdout);
+	int out = dup(1), null = open("/dev/null", O_WRONLY);
+	dup2(null, 1);
+	std::vector<GLuint> programs(s->programs);
+	double begin = bench_now();
+	for (unsigned int i = 0; i < s->programs; i++) {
+		char defines[64];
+		snprintf(defines, sizeof defines, "#define LIGHTS %u\n#define OCTAVES %u\n", 1 + i % 8, 1 + i / 8 % 6);
+		programs[i] = LoadShaders(VERTEX_PATH, FRAGMENT_PATH, defines);
+	}
+	glFinish();
+	double loading = bench_now() - begin;
+	fflush(stdout);
+	dup2(out, 1);
+	close(out);
+	close(null);
+	ProgramCacheStats stats = programCacheStats();
+
+	// A triangle over the whole window with each program.
+	GLuint vao, buffer;
+	glGenVertexArrays(1, &vao);
+	glBindVertexArray(vao);
+	glGenBuffers(1, &buffer);
+	glBindBuffer(GL_ARRAY_BUFFER, buffer);
+	float triangle[] = { -1, -1, 0.5f, 3, -1, 0.5f, -1, 3, 0.5f };
+	glBufferData(GL_ARRAY_BUFFER, sizeof triangle, triangle, GL_STATIC_DRAW);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (void *)0);
+	float identity[16] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 };
+	float lights[8 * 3], colors[8 * 3];
+	for (int i = 0; i < 8 * 3; i++) {
+		lights[i] = (float)(i % 3) - 1.0f + 0.25f * (i / 3);
+		colors[i] = 0.2f + 0.1f * (i % 5);
+	}
+	uint64_t hash = 0xcbf29ce484222325ULL;
+	std::vector<unsigned char> pixels(64 * 64 * 4);
+	double drawing = 0;
+	for (unsigned int i = 0; i < s->programs; i++) {
+		begin = bench_now();
+		glUseProgram(programs[i]);
+		glUniformMatrix4fv(glGetUniformLocation(programs[i], "MVP"), 1, GL_FALSE, identity);
+		glUniform3fv(glGetUniformLocation(programs[i], "lightPositions"), 1 + i % 8, lights);
+		glUniform3fv(glGetUniformLocation(programs[i], "lightColors"), 1 + i % 8, colors);
+		glUniform3f(glGetUniformLocation(programs[i], "eye"), 0, 0, 2);
+		glClear(GL_COLOR_BUFFER_BIT);
+		glDrawArrays(GL_TRIANGLES, 0, 3);
+		glFinish();
+		drawing += bench_now() - begin;
+		glReadPixels(0, 0, 64, 64, GL_RGBA, GL_UNSIGNED_BYTE, &pixels[0]);
+		hash = programHash(&pixels[0], pixels.size(), hash);
+		glDeleteProgram(programs[i]);
+	}
+	FILE *fp = fopen(s->hashPath, "wb");
+	if (fp) {
+		fwrite(&hash, sizeof hash, 1, fp);
+		fclose(fp);
+	}
+	printf("%9.1f ms %9.1f ms %9.1f ms   %lu loaded, %lu compiled, %lu written\n",
+		loading * 1e3, drawing * 1e3, (loading + drawing) * 1e3, stats.hits, stats.misses + stats.rejected, stats.written);
+	glDeleteBuffers(1, &buffer);
+	glDeleteVertexArrays(1, &vao);
+	glfwTerminate();
+	return glGetError() == GL_NO_ERROR;
+}
+
+uint64_t read_hash(const char *path) {
+	uint64_t hash = 0;
+	FILE *fp = fopen(path, "rb");
+	if (fp) {
+		if (fread(&hash, sizeof hash, 1, fp) != 1) hash = 0;
+		fclose(fp);
+	}
+	return hash;
+}
+
+int main(int argc, char **argv) {
+	unsigned int count = argc > 1 ? (unsigned int)atoi(argv[1]) : 32;
+	setenv("MESA_SHADER_CACHE_DIR", MESA_CACHE_DIR, 1);
+	setenv("MESA_GLSL_CACHE_DIR", MESA_CACHE_DIR, 1);
+	if (!bench_write_shaders(VERTEX_PATH, FRAGMENT_PATH)) return 1;
+	if (system("rm -rf " PROGRAM_CACHE_DIR " " MESA_CACHE_DIR) != 0) return 1;
+
+	printf("%u programs\n%-24s %12s %12s %12s\n", count, "", "LoadShaders", "first draws", "together");
+	Start cold = { count, "/tmp/bench_program_cache.cold" }, warm = { count, "/tmp/bench_program_cache.warm" };
+	printf("%-24s", "cold (empty cache)");
+	double begin = bench_now();
+	if (!bench_isolated(start, &cold)) return 1;
+	double coldProcess = bench_now() - begin;
+	printf("%-24s", "warm");
+	begin = bench_now();
+	if (!bench_isolated(start, &warm)) return 1;
+	double warmProcess = bench_now() - begin;
+	printf("%-24s", "warm again");
+	if (!bench_isolated(start, &warm)) return 1;
+	if (system("rm -rf " PROGRAM_CACHE_DIR) != 0) return 1;
+	printf("%-24s", "only Mesa's cache warm");
+	if (!bench_isolated(start, &warm)) return 1;
+
+	long bytes = 0;
+	FILE *du = popen("du -sk " PROGRAM_CACHE_DIR, "r");
+	if (du) {
+		if (fscanf(du, "%ld", &bytes) != 1) bytes = 0;
+		pclose(du);
+	}
+	printf("whole process : %.0f ms cold, %.0f ms warm ; %ld KB of binaries ; %s\n", coldProcess * 1e3, warmProcess * 1e3, bytes,
+		read_hash(cold.hashPath) == read_hash(warm.hashPath) ? "same pixels" : "DIFFERENT pixels");
+	return 0;
+}
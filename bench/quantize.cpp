@@ -0,0 +1,111 @@
+// Vertex quantization : encode and decode throughput of the scalar and SSE2
+// paths (which must give the same bits), and the error on each mesh.
+//
+//   ./quantize                 suzanne.obj, then a synthetic 1M face mesh
+//   ./quantize a.obj 500000    any mix of OBJ files and synthetic face counts
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <string.h>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+using namespace glm;
+#include "../basic_shading/common.hpp"
+#include "../basic_shading/objloader.hpp"
+#include "../basic_shading/vboindexer.hpp"
+#include "../basic_shading/quantize.hpp"
+#include "bench.hpp"
+
+typedef void (*Encoder)(const glm::vec3 *, const glm::vec2 *, const glm::vec3 *, size_t, QuantizedMesh &);
+typedef void (*Decoder)(const QuantizedMesh &, glm::vec3 *, glm::vec2 *, glm::vec3 *);
+
+// Both without the bounding box, which quantizeVertices computes first.
+void encode_scalar(const glm::vec3 *p, const glm::vec2 *t, const glm::vec3 *n, size_t count, QuantizedMesh &mesh) {
+	quantizeVerticesScalar(p, t, n, count, mesh);
+}
+
+void encode_simd(const glm::vec3 *p, const glm::vec2 *t, const glm::vec3 *n, size_t count, QuantizedMesh &mesh) {
+#ifdef QUANTIZE_HAVE_SSE2
+	quantizeVerticesSSE2(p, t, n, count, mesh);
+#else
+	quantizeVerticesScalar(p, t, n, count, mesh);
+#endif
+}
+
+void decode_scalar(const QuantizedMesh &mesh, glm::vec3 *p, glm::vec2 *t, glm::vec3 *n) {
+	dequantizeVerticesScalar(mesh, p, t, n);
+}
+
+// Best of a few runs, in millions of vertices per second.
+double encode_rate(Encoder encode, const std::vector<glm::vec3> &p, const std::vector<glm::vec2> &t, const std::vector<glm::vec3> &n, QuantizedMesh &mesh) {
+	double best = 1e9;
+	int runs = p.size() < 100000 ? 200 : 5;
+	for (int r = 0; r < runs; r++) {
+		double start = bench_now();
+		encode(&p[0], &t[0], &n[0], p.size(), mesh);
+		best = std::min(best, bench_now() - start);
+	}
+	return p.size() / 1e6 / best;
+}
+
+double decode_rate(Decoder decode, const QuantizedMesh &mesh, std::vector<glm::vec3> &p, std::vector<glm::vec2> &t, std::vector<glm::vec3> &n) {
+	double best = 1e9;
+	int runs = p.size() < 100000 ? 200 : 5;
+	for (int r = 0; r < runs; r++) {
+		double start = bench_now();
+		decode(mesh, &p[0], &t[0], &n[0]);
+		best = std::min(best, bench_now() - start);
+	}
+	return p.size() / 1e6 / best;
+}
+
+void run(const char *path) {
+	std::vector<unsigned int> indices;
+	std::vector<glm::vec3> vertices, normals;
+	std::vector<glm::vec2> uvs;
+	if (!loadOBJIndexed(path, indices, vertices, uvs, normals) || vertices.empty()) return;
+	size_t count = vertices.size();
+	printf("%s : %lu vertices, %lu -> %lu bytes\n", path, (unsigned long)count,
+		(unsigned long)(count * (2 * sizeof(glm::vec3) + sizeof(glm::vec2))), (unsigned long)(count * sizeof(QuantizedVertex)));
+
+	QuantizedMesh scalar, simd;
+	quantizeVertices(&vertices[0], &uvs[0], &normals[0], count, simd);
+	scalar.offset = simd.offset;
+	scalar.scale = simd.scale;
+	scalar.vertices.resize(count);
+	double encodeScalar = encode_rate(encode_scalar, vertices, uvs, normals, scalar);
+	double encodeSimd = encode_rate(encode_simd, vertices, uvs, normals, simd);
+	bool same = memcmp(&scalar.vertices[0], &simd.vertices[0], count * sizeof(QuantizedVertex)) == 0;
+
+	std::vector<glm::vec3> p(count), n(count);
+	std::vector<glm::vec2> t(count);
+	double decodeScalar = decode_rate(decode_scalar, simd, p, t, n);
+	double decodeSimd = decode_rate(dequantizeVertices, simd, p, t, n);
+	printf("  encode %7.1f Mverts/s scalar, %7.1f SIMD%s\n", encodeScalar, encodeSimd, same ? "" : " (outputs differ !)");
+	printf("  decode %7.1f Mverts/s scalar, %7.1f SIMD\n", decodeScalar, decodeSimd);
+	printQuantizationError("  error", quantizationError(simd, &vertices[0], &uvs[0], &normals[0]));
+}
+
+int main(int argc, char **argv) {
+	const char *defaults[] = { "../basic_shading/suzanne.obj", "1000000" };
+	int ncases = argc > 1 ? argc - 1 : 2;
+	char **cases = argc > 1 ? argv + 1 : (char **)defaults;
+
+	for (int i = 0; i < ncases; i++) {
+		const char *path = cases[i];
+		char synthetic[64];
+		if (isdigit(cases[i][0])) {
+			unsigned int w, h;
+			bench_grid_for_faces(strtoul(cases[i], 0, 10), &w, &h);
+			snprintf(synthetic, sizeof synthetic, "/tmp/bench_grid_%ux%u.obj", w, h);
+			if (bench_file_size(synthetic) < 0 && !bench_write_grid_obj(synthetic, w, h)) return 1;
+			path = synthetic;
+		}
+		run(path);
+	}
+	return 0;
+}
@@ -0,0 +1,205 @@
+// The repo's own shader set through ProgramPermutations (programbatch.hpp)
+// : every LoadShaders call in the tutorials is found in their sources, and
+// the programs they ask for are built once with LoadShaders each, as the
+// tutorials do, then through ProgramPermutations, which builds a program
+// once per preprocessed text (shaderpreprocess.hpp). The tutorials keep
+// copies of the same shaders in each directory, so several calls come to
+// the same text. A second round asks for everything again, as a scene
+// change or a reload would.
+//
+//   ./shader_permutations         the tutorials in ..
+//   ./shader_permutations dir     the tutorials in dir
+//
+// Each program is drawn with once, as llvmpipe, like some other drivers,
+// only makes machine code for a program when it is first drawn with. Each
+// way runs in its own process with Mesa's shader cache turned off, which
+// turns the program cache off too (no binary format), so that nothing is
+// found on disk.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <string>
+#include <vector>
+#include <set>
+
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+#include "../basic_shading/common.hpp"
+#include "bench.hpp"
+
+struct ShaderRequest {
+	std::string caller; // the source file and line of the LoadShaders call
+	std::string vertexPath, fragmentPath;
+};
+
+// The string literal at `p`, after blanks ; false if there is none.
+bool read_literal(const char *&p, const char *end, std::string &text) {
+	while (p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')) p++;
+	if (p == end || *p != '"') return false;
+	const char *close = (const char *)memchr(p + 1, '"', end - p - 1);
+	if (!close) return false;
+	text.assign(p + 1, close);
+	p = close + 1;
+	return true;
+}
+
+// Every LoadShaders("a", "b") in the .cpp files of the directories of
+// `root`, with the paths made relative to here.
+void find_requests(const std::string &root, std::vector<ShaderRequest> &requests) {
+	DIR *top = opendir(root.c_str());
+	if (!top) return;
+	std::set<std::string> dirs;
+	for (struct dirent *d; (d = readdir(top));)
+		if (d->d_name[0] != '.' && strcmp(d->d_name, "bench") != 0) dirs.insert(d->d_name);
+	closedir(top);
+	for (std::set<std::string>::iterator dir = dirs.begin(); dir != dirs.end(); ++dir) {
+		std::string path = root + "/" + *dir;
+		DIR *sub = opendir(path.c_str());
+		if (!sub) continue;
+		std::set<std::string> sources;
+		for (struct dirent *d; (d = readdir(sub));) {
+			size_t n = strlen(d->d_name);
+			if (n > 4 && strcmp(d->d_name + n - 4, ".cpp") == 0) sources.insert(d->d_name);
+		}
+		closedir(sub);
+		for (std::set<std::string>::iterator s = sources.begin(); s != sources.end(); ++s) {
+			MappedFile file;
+			if (!mapFile((path + "/" + *s).c_str(), file)) continue;
+			const char *p = file.data, *end = file.data + file.size;
+			while (p < end) {
+				const char *call = (const char *)memmem(p, end - p, "LoadShaders(", 12);
+				if (!call) break;
+				p = call + 12;
+				ShaderRequest r;
+				if (!read_literal(p, end, r.vertexPath)) continue;
+				while (p < end && (*p == ' ' || *p == '\t')) p++;
+				if (p == end || *p++ != ',' || !read_literal(p, end, r.fragmentPath)) continue;
+				int line = 1;
+				for (const char *q = file.data; q < call; q++) line += *q == '\n';
+				char where[32];
+				snprintf(where, sizeof where, ":%d", line);
+				r.caller = *dir + "/" + *s + where;
+				r.vertexPath = path + "/" + r.vertexPath;
+				r.fragmentPath = path + "/" + r.fragmentPath;
+				requests.push_back(r);
+			}
+			unmapFile(file);
+		}
+	}
+}
+
+struct Run {
+	bool permutations;
+	const std::vector<ShaderRequest> *requests;
+};
+
+GLFWwindow *open_window() {
+	glfwInit();
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+	GLFWwindow *window = glfwCreateWindow(64, 64, "shader_permutations", NULL, NULL);
+	if (!window) return NULL;
+	glfwMakeContextCurrent(window);
+	glewExperimental = true;
+	glewInit();
+	GLuint vao, buffer;
+	glGenVertexArrays(1, &vao);
+	glBindVertexArray(vao);
+	glGenBuffers(1, &buffer);
+	glBindBuffer(GL_ARRAY_BUFFER, buffer);
+	float triangle[] = { -1, -1, 0.5f, 3, -1, 0.5f, -1, 3, 0.5f };
+	glBufferData(GL_ARRAY_BUFFER, sizeof triangle, triangle, GL_STATIC_DRAW);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (void *)0);
+	return window;
+}
+
+int run(Run *r) {
+	setenv("MESA_SHADER_CACHE_DISABLE", "true", 1);
+	if (!open_window()) return 0;
+	const std::vector<ShaderRequest> &requests = *r->requests;
+
+	// LoadShaders' own messages, out of the way.
+	fflush(stdout);
+	int out = dup(1), null = open("/dev/null", O_WRONLY);
+	dup2(null, 1);
+	ProgramPermutations permutations;
+	std::vector<GLuint> programs;
+	std::set<GLuint> drawn;
+	double rounds[2] = { 0, 0 };
+	ProgramPermutationStats first = permutations.stats();
+	unsigned int failed = 0;
+	for (int round = 0; round < (r->permutations ? 2 : 1); round++) {
+		double begin = bench_now();
+		for (size_t i = 0; i < requests.size(); i++) {
+			const char *vs = requests[i].vertexPath.c_str(), *fs = requests[i].fragmentPath.c_str();
+			GLuint program = r->permutations ? permutations.get(vs, fs) : LoadShaders(vs, fs);
+			if (!program) {
+				failed++;
+				continue;
+			}
+			if (!r->permutations) programs.push_back(program);
+			if (drawn.insert(program).second) {
+				glUseProgram(program);
+				glClear(GL_COLOR_BUFFER_BIT);
+				glDrawArrays(GL_TRIANGLES, 0, 3);
+				glFinish();
+			}
+		}
+		rounds[round] = bench_now() - begin;
+		if (round == 0) first = permutations.stats();
+	}
+	fflush(stdout);
+	dup2(out, 1);
+	close(out);
+	close(null);
+
+	if (r->permutations) {
+		const ProgramPermutationStats &s = permutations.stats();
+		printf("%9.1f ms %9.1f ms   %lu built ; compiles avoided : %lu in the first round (%lu the same text from another directory), %lu in the second\n",
+			rounds[0] * 1e3, rounds[1] * 1e3, s.built, first.reused + first.contentHits, first.contentHits, s.reused + s.contentHits - first.reused - first.contentHits);
+	} else {
+		printf("%9.1f ms %12s   %lu built\n", rounds[0] * 1e3, "", (unsigned long)programs.size());
+	}
+	if (failed) printf("%u requests FAILED\n", failed);
+	for (size_t i = 0; i < programs.size(); i++) glDeleteProgram(programs[i]);
+	permutations.clear();
+	glfwTerminate();
+	return failed == 0;
+}
+
+int main(int argc, char **argv) {
+	std::string root = argc > 1 ? argv[1] : "..";
+	std::vector<ShaderRequest> requests;
+	find_requests(root, requests);
+	if (requests.empty()) {
+		printf("no LoadShaders call under %s\n", root.c_str());
+		return 1;
+	}
+
+	// The texts, without a context : how many of each are really different.
+	std::set<std::string> vertexTexts, fragmentTexts, programTexts;
+	unsigned long includes = 0;
+	for (size_t i = 0; i < requests.size(); i++) {
+		ShaderSource vs, fs;
+		if (!preprocessShader(requests[i].vertexPath.c_str(), NULL, vs) || !preprocessShader(requests[i].fragmentPath.c_str(), NULL, fs)) return 1;
+		printf("%-38s %s, %s\n", requests[i].caller.c_str(), requests[i].vertexPath.c_str() + root.size() + 1, requests[i].fragmentPath.c_str() + root.size() + 1);
+		vertexTexts.insert(vs.code);
+		fragmentTexts.insert(fs.code);
+		programTexts.insert(vs.code + '\0' + fs.code);
+		includes += vs.files.size() + fs.files.size() - 2;
+	}
+	printf("%lu LoadShaders calls : %lu different programs, %lu different vertex shaders, %lu different fragment shaders, %lu #include resolved\n\n",
+		(unsigned long)requests.size(), (unsigned long)programTexts.size(), (unsigned long)vertexTexts.size(), (unsigned long)fragmentTexts.size(), includes);
+
+	printf("%-26s %12s %12s\n", "", "first round", "second");
+	Run loadShaders = { false, &requests }, permutations = { true, &requests };
+	printf("%-26s", "LoadShaders each");
+	if (!bench_isolated(run, &loadShaders)) return 1;
+	printf("%-26s", "ProgramPermutations");
+	return bench_isolated(run, &permutations) ? 0 : 1;
+}
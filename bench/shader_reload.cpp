@@ -0,0 +1,223 @@
+// Shader hot reload (shaderreload.hpp) : a render loop draws with a program
+// while its fragment shader is saved again and again, with a different
+// number of lights and noise octaves each time, and every save is timed
+// from the modification time of the file to the end of the first frame
+// drawn with the new program. Half the saves write the file in place, the
+// other half write another file and rename it over the first, as most
+// editors do ; one save doesn't compile, and must leave the program that
+// was there. The first edit made by restarting the program instead (a new
+// process, a context, LoadShaders, a frame) is timed last.
+//
+//   ./shader_reload               8 edits
+//   ./shader_reload 20            20 edits
+//
+// The program cache and Mesa's shader cache go to directories of their
+// own, emptied first, so that every edit is really compiled. The GL part
+// runs on whatever the default context is (llvmpipe on the test machines) ;
+// llvmpipe makes the machine code of a program when it is first drawn
+// with, so the first frame is where most of the time goes.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#define PROGRAM_CACHE_DIR "/tmp/bench_shader_reload_cache"
+
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+#include "../basic_shading/common.hpp"
+#include "../basic_shading/shaderreload.hpp"
+#include "bench.hpp"
+
+#define SHADER_DIR     "/tmp/bench_shader_reload"
+#define VERTEX_PATH    SHADER_DIR "/bench.vertexshader"
+#define FRAGMENT_PATH  SHADER_DIR "/bench.fragmentshader"
+#define MESA_CACHE_DIR "/tmp/bench_shader_reload_mesa"
+
+// The fragment shader of edit `e` : bench_write_shaders' with other
+// defaults, or something that doesn't compile.
+std::string edited_shader(const std::string &original, unsigned int e, bool broken) {
+	std::string text = original;
+	char lights[32], octaves[32];
+	snprintf(lights, sizeof lights, "#define LIGHTS %u\n", 1 + e % 8);
+	snprintf(octaves, sizeof octaves, "#define OCTAVES %u\n", 1 + (e + 3) % 6);
+	text.replace(text.find("#define LIGHTS 4\n"), strlen("#define LIGHTS 4\n"), lights);
+	text.replace(text.find("#define OCTAVES 4\n"), strlen("#define OCTAVES 4\n"), octaves);
+	if (broken) text.replace(text.find("color = "), strlen("color = "), "color = undeclared + ");
+	return text;
+}
+
+bool save(const char *path, const std::string &text, bool rename_over) {
+	std::string target = rename_over ? std::string(path) + ".swp" : path;
+	FILE *fp = fopen(target.c_str(), "wb");
+	if (!fp) return false;
+	bool ok = fwrite(text.data(), 1, text.size(), fp) == text.size();
+	ok = fclose(fp) == 0 && ok;
+	return ok && (!rename_over || rename(target.c_str(), path) == 0);
+}
+
+struct Run {
+	unsigned int edits;
+	std::string original;
+};
+
+GLFWwindow *open_window() {
+	glfwInit();
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+	GLFWwindow *window = glfwCreateWindow(64, 64, "shader_reload", NULL, NULL);
+	if (!window) return NULL;
+	glfwMakeContextCurrent(window);
+	glewExperimental = true;
+	glewInit();
+	GLuint vao, buffer;
+	glGenVertexArrays(1, &vao);
+	glBindVertexArray(vao);
+	glGenBuffers(1, &buffer);
+	glBindBuffer(GL_ARRAY_BUFFER, buffer);
+	float triangle[] = { -1, -1, 0.5f, 3, -1, 0.5f, -1, 3, 0.5f };
+	glBufferData(GL_ARRAY_BUFFER, sizeof triangle, triangle, GL_STATIC_DRAW);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (void *)0);
+	return window;
+}
+
+// A triangle over the whole window, finished.
+void draw(GLuint program, GLint mvp, GLint lightPositions, GLint lightColors, GLint eye) {
+	float identity[16] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 };
+	float lights[8 * 3], colors[8 * 3];
+	for (int i = 0; i < 8 * 3; i++) {
+		lights[i] = (float)(i % 3) - 1.0f + 0.25f * (i / 3);
+		colors[i] = 0.2f + 0.1f * (i % 5);
+	}
+	glUseProgram(program);
+	glUniformMatrix4fv(mvp, 1, GL_FALSE, identity);
+	glUniform3fv(lightPositions, 8, lights);
+	glUniform3fv(lightColors, 8, colors);
+	glUniform3f(eye, 0, 0, 2);
+	glClear(GL_COLOR_BUFFER_BIT);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+	glFinish();
+}
+
+int reload(Run *r) {
+	GLFWwindow *window = open_window();
+	if (!window) return 0;
+
+	// LoadShaders' and the reloader's own messages, out of the way.
+	fflush(stdout);
+	int out = dup(1), null = open("/dev/null", O_WRONLY);
+	dup2(null, 1);
+	GLuint program = LoadShaders(VERTEX_PATH, FRAGMENT_PATH);
+	GLint mvp, lightPositions, lightColors, eye;
+	ShaderReloader shaders;
+	size_t watched = shaders.watch(&program, VERTEX_PATH, FRAGMENT_PATH);
+	shaders.uniform(watched, "MVP", &mvp);
+	shaders.uniform(watched, "lightPositions", &lightPositions);
+	shaders.uniform(watched, "lightColors", &lightColors);
+	shaders.uniform(watched, "eye", &eye);
+	draw(program, mvp, lightPositions, lightColors, eye);
+
+	// Frames with nothing to reload, for what a frame costs.
+	unsigned long frames = 0;
+	double begin = bench_now();
+	for (; frames < 100; frames++) {
+		shaders.update();
+		draw(program, mvp, lightPositions, lightColors, eye);
+		shaders.presented();
+	}
+	double frame = (bench_now() - begin) / frames;
+
+	std::vector<ShaderReloadStats> results;
+	std::vector<unsigned long> framesTaken;
+	bool errors = false, kept = false;
+	for (unsigned int e = 0; e <= r->edits; e++) {
+		// The last but one edit doesn't compile.
+		bool broken = e == r->edits - 1;
+		unsigned long reloads = shaders.stats().reloads, failures = shaders.stats().failures;
+		GLuint before = program;
+		if (!save(FRAGMENT_PATH, edited_shader(r->original, e, broken), e % 2 == 1)) return 0;
+		unsigned long n = 0;
+		for (; n < 1000; n++) {
+			shaders.update();
+			draw(program, mvp, lightPositions, lightColors, eye);
+			shaders.presented();
+			if (glGetError() != GL_NO_ERROR) errors = true;
+			if (shaders.stats().reloads != reloads || shaders.stats().failures != failures) break;
+		}
+		if (broken) {
+			kept = shaders.stats().failures == failures + 1 && program == before;
+			continue;
+		}
+		results.push_back(shaders.stats());
+		framesTaken.push_back(n + 1);
+	}
+	fflush(stdout);
+	dup2(out, 1);
+	close(out);
+	close(null);
+
+	printf("a frame with nothing to reload : %.2f ms\n\n", frame * 1e3);
+	printf("%-6s %-10s %12s %12s %14s %8s\n", "edit", "saved by", "noticed", "swapped", "first frame", "frames");
+	double sum = 0, worst = 0;
+	for (size_t i = 0; i < results.size(); i++) {
+		unsigned int e = i < r->edits - 1 ? (unsigned int)i : (unsigned int)i + 1;
+		printf("%-6u %-10s %9.1f ms %9.1f ms %11.1f ms %8lu\n", e, e % 2 ? "rename" : "writing", results[i].noticed * 1e3, results[i].swapped * 1e3,
+			results[i].presented * 1e3, framesTaken[i]);
+		sum += results[i].presented;
+		if (results[i].presented > worst) worst = results[i].presented;
+	}
+	printf("save to first frame : %.1f ms on average, %.1f ms at worst ; %lu reloads, %lu failed (%s), %s\n", sum / results.size() * 1e3, worst * 1e3,
+		shaders.stats().reloads, shaders.stats().failures, kept ? "the program that was there kept" : "the program that was there LOST",
+		errors ? "GL ERRORS in between" : "no GL error in between");
+	shaders.stop();
+	glDeleteProgram(program);
+	glfwTerminate();
+	return kept && !errors;
+}
+
+// Edit 0 by starting again, with the caches emptied : a context,
+// LoadShaders, a frame.
+int restart(Run *) {
+	double begin = bench_now();
+	GLFWwindow *window = open_window();
+	if (!window) return 0;
+	fflush(stdout);
+	int out = dup(1), null = open("/dev/null", O_WRONLY);
+	dup2(null, 1);
+	GLuint program = LoadShaders(VERTEX_PATH, FRAGMENT_PATH);
+	fflush(stdout);
+	dup2(out, 1);
+	close(out);
+	close(null);
+	draw(program, glGetUniformLocation(program, "MVP"), glGetUniformLocation(program, "lightPositions"), glGetUniformLocation(program, "lightColors"),
+		glGetUniformLocation(program, "eye"));
+	printf("edit 0 by restarting instead : first frame %.1f ms after the start, before any mesh or texture is loaded\n", (bench_now() - begin) * 1e3);
+	glDeleteProgram(program);
+	glfwTerminate();
+	return 1;
+}
+
+int main(int argc, char **argv) {
+	Run run;
+	run.edits = argc > 1 ? (unsigned int)atoi(argv[1]) : 8;
+	if (run.edits < 2) run.edits = 2;
+	setenv("MESA_SHADER_CACHE_DIR", MESA_CACHE_DIR, 1);
+	setenv("MESA_GLSL_CACHE_DIR", MESA_CACHE_DIR, 1);
+	if (system("rm -rf " SHADER_DIR " " PROGRAM_CACHE_DIR " " MESA_CACHE_DIR " && mkdir " SHADER_DIR) != 0) return 1;
+	if (!bench_write_shaders(VERTEX_PATH, FRAGMENT_PATH)) return 1;
+	MappedFile original;
+	if (!mapFile(FRAGMENT_PATH, original)) return 1;
+	run.original.assign(original.data, original.size);
+	unmapFile(original);
+
+	printf("%u edits of %s\n", run.edits, FRAGMENT_PATH);
+	if (!bench_isolated(reload, &run)) return 1;
+	if (system("rm -rf " PROGRAM_CACHE_DIR " " MESA_CACHE_DIR) != 0) return 1;
+	if (!save(FRAGMENT_PATH, edited_shader(run.original, 0, false), false)) return 1;
+	return bench_isolated(restart, &run) ? 0 : 1;
+}
@@ -0,0 +1,69 @@
+// Level of detail chains built by buildLODChain, as the mesh cache builds
+// them : the triangles and error of every level, and how fast the whole
+// chain is made.
+//
+//   ./simplify                 suzanne.obj, then a synthetic 1M face mesh
+//   ./simplify a.obj 500000    any mix of OBJ files and synthetic face counts
+//
+// The error is in model units ; suzanne is about 2.7 units wide, the grid 1.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <string.h>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+using namespace glm;
+#include "../basic_shading/common.hpp"
+#include "../basic_shading/objloader.hpp"
+#include "../basic_shading/vboindexer.hpp"
+#include "../basic_shading/meshoptimize.hpp"
+#include "../basic_shading/meshsimplify.hpp"
+#include "bench.hpp"
+
+void run(const char *path) {
+	std::vector<unsigned int> indices;
+	std::vector<glm::vec3> vertices, normals;
+	std::vector<glm::vec2> uvs;
+	if (!loadOBJIndexed(path, indices, vertices, uvs, normals) || indices.empty()) return;
+	optimizeMesh(indices, vertices, uvs, normals);
+	size_t triangles = indices.size() / 3;
+
+	std::vector<MeshLOD> lods;
+	double start = bench_now();
+	buildLODChain(indices, &vertices[0], vertices.size(), lods);
+	double t = bench_now() - start;
+
+	printf("%s : %lu triangles, %lu vertices\n", path, (unsigned long)triangles, (unsigned long)vertices.size());
+	for (size_t l = 0; l < lods.size(); l++) {
+		VertexCacheStats stats = simulateVertexCache(&indices[lods[l].firstIndex], lods[l].indexCount, vertices.size());
+		printf("  LOD %lu : %9lu triangles (%5.1f%%), error %.5f, ACMR %.3f\n", (unsigned long)l,
+			(unsigned long)lods[l].indexCount / 3, 100.0 * lods[l].indexCount / 3 / triangles, lods[l].error, stats.acmr);
+	}
+	size_t removed = triangles - lods.back().indexCount / 3;
+	printf("  chain built in %.0f ms : %.2f Mtris/s of input, %.2f Mtris/s removed\n",
+		t * 1e3, triangles / 1e6 / t, removed / 1e6 / t);
+}
+
+int main(int argc, char **argv) {
+	const char *defaults[] = { "../basic_shading/suzanne.obj", "1000000" };
+	int ncases = argc > 1 ? argc - 1 : 2;
+	char **cases = argc > 1 ? argv + 1 : (char **)defaults;
+
+	for (int i = 0; i < ncases; i++) {
+		const char *path = cases[i];
+		char synthetic[64];
+		if (isdigit(cases[i][0])) {
+			unsigned int w, h;
+			bench_grid_for_faces(strtoul(cases[i], 0, 10), &w, &h);
+			snprintf(synthetic, sizeof synthetic, "/tmp/bench_grid_%ux%u.obj", w, h);
+			if (bench_file_size(synthetic) < 0 && !bench_write_grid_obj(synthetic, w, h)) return 1;
+			path = synthetic;
+		}
+		run(path);
+	}
+	return 0;
+}
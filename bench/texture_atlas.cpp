@@ -0,0 +1,279 @@
+// textureatlas.hpp on thousands of small images : how full the skyline
+// packer gets a 2D atlas and the layers of an array, and how long it takes,
+// against shelves (rows as tall as their first, tallest first) ; then the
+// atlas built and uploaded against one texture per image, and a frame
+// drawing every image once, with a glBindTexture per draw or a single one.
+//
+//   ./texture_atlas               4000 images, 8 to 256 texels a side
+//   ./texture_atlas 200           200 images
+//
+// Packing is tried on sizes that are powers of two, anything, and half
+// and half, the rest on half and half only. Packing figures are the best
+// of 3 runs. The GL part runs on whatever the default context is
+// (llvmpipe on the test machines).
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+#include "../basic_shading/common.hpp"
+#include "../basic_shading/textureatlas.hpp"
+#include "bench.hpp"
+
+static const char *vertexSource =
+	"#version 330 core\n"
+	"layout(location = 0) in vec2 position;\n"
+	"layout(location = 1) in vec2 vertexUV;\n"
+	"out vec2 uv;\n"
+	"void main() { gl_Position = vec4(position, 0.0, 1.0); uv = vertexUV; }\n";
+static const char *fragmentSource =
+	"#version 330 core\n"
+	"in vec2 uv;\n"
+	"out vec3 color;\n"
+	"uniform sampler2D tex;\n"
+	"void main() { color = texture(tex, uv).rgb; }\n";
+
+GLuint make_program() {
+	GLuint vs = glCreateShader(GL_VERTEX_SHADER), fs = glCreateShader(GL_FRAGMENT_SHADER);
+	glShaderSource(vs, 1, &vertexSource, NULL);
+	glShaderSource(fs, 1, &fragmentSource, NULL);
+	glCompileShader(vs);
+	glCompileShader(fs);
+	GLuint program = glCreateProgram();
+	glAttachShader(program, vs);
+	glAttachShader(program, fs);
+	glLinkProgram(program);
+	glDeleteShader(vs);
+	glDeleteShader(fs);
+	return program;
+}
+
+// Shelves, for comparison : tallest first, left to right, a new shelf as
+// tall as its first rectangle when the row is full. Returns the height used.
+unsigned int shelf_pack(const std::vector<unsigned int> &widths, const std::vector<unsigned int> &heights, unsigned int width) {
+	std::vector<size_t> order(widths.size());
+	for (size_t i = 0; i < order.size(); i++) order[i] = i;
+	SkylineTallerFirst taller = { &widths[0], &heights[0] };
+	std::sort(order.begin(), order.end(), taller);
+	unsigned int x = 0, y = 0, shelf = 0;
+	for (size_t k = 0; k < order.size(); k++) {
+		size_t i = order[k];
+		if (x + widths[i] > width) {
+			y += shelf;
+			x = shelf = 0;
+		}
+		if (shelf == 0) shelf = heights[i];
+		x += widths[i];
+	}
+	return y + shelf;
+}
+
+void print_pack(const char *name, const TextureAtlas &atlas, double seconds) {
+	char size[64];
+	snprintf(size, sizeof size, atlas.kind == ATLAS_ARRAY ? "%ux%u x %u" : "%ux%u", atlas.width, atlas.height, atlas.layers);
+	printf("%-30s %-18s %5.1f%% full %9.2f ms\n", name, size, atlas.occupancy * 100.0, seconds * 1e3);
+}
+
+// Seconds for packTextureAtlas, the best of 3.
+double time_pack(const std::vector<unsigned int> &widths, const std::vector<unsigned int> &heights, AtlasKind kind, unsigned int padding, unsigned int layerSize, TextureAtlas &atlas) {
+	double best = 1e30;
+	for (int run = 0; run < 3; run++) {
+		double start = bench_now();
+		bool ok = packTextureAtlas(&widths[0], &heights[0], widths.size(), kind, atlas, padding, layerSize);
+		double t = bench_now() - start;
+		if (!ok) return 0;
+		if (t < best) best = t;
+	}
+	return best;
+}
+
+// Milliseconds a frame for `frames` frames of one quad per image, each
+// drawn with its own texture bound, or all with the atlas's.
+double time_frames(const std::vector<GLuint> &textures, GLuint atlas, size_t count, int frames) {
+	glFinish();
+	double start = bench_now();
+	for (int frame = 0; frame < frames; frame++) {
+		glClear(GL_COLOR_BUFFER_BIT);
+		if (atlas) glBindTexture(GL_TEXTURE_2D, atlas);
+		for (size_t i = 0; i < count; i++) {
+			if (!atlas) glBindTexture(GL_TEXTURE_2D, textures[i]);
+			glDrawArrays(GL_TRIANGLES, (GLint)(i * 6), 6);
+		}
+		glFinish();
+	}
+	return (bench_now() - start) * 1e3 / frames;
+}
+
+// Sizes for `count` images : 8 to 256 texels a side, powers of two (1),
+// anything (2) or half and half (0).
+void make_sizes(int set, size_t count, std::vector<unsigned int> &widths, std::vector<unsigned int> &heights) {
+	srand(1);
+	widths.resize(count);
+	heights.resize(count);
+	for (size_t i = 0; i < count; i++) {
+		if (set == 1 || (set == 0 && i % 2)) {
+			widths[i] = 8u << rand() % 6;
+			heights[i] = 8u << rand() % 6;
+		} else {
+			widths[i] = 8 + rand() % 249;
+			heights[i] = 8 + rand() % 249;
+		}
+	}
+}
+
+int main(int argc, char **argv) {
+	size_t count = argc > 1 ? (size_t)atoi(argv[1]) : 4000;
+
+	// Packing alone, on three sets of sizes.
+	const char *sets[] = { "mixed", "powers of two", "any size" };
+	std::vector<unsigned int> widths, heights;
+	TextureAtlas atlas;
+	for (int set = 2; set >= 0; set--) {
+		make_sizes(set, count, widths, heights);
+		double texels = 0;
+		for (size_t i = 0; i < count; i++) texels += (double)widths[i] * heights[i];
+		printf("%lu images, %s, %.1f Mtexels\n", (unsigned long)count, sets[set], texels / 1e6);
+		double t = time_pack(widths, heights, ATLAS_2D, 0, 0, atlas);
+		print_pack("skyline 2D, no gutter", atlas, t);
+		double start = bench_now();
+		unsigned int shelfHeight = shelf_pack(widths, heights, atlas.width);
+		t = bench_now() - start;
+		printf("%-30s %ux%-13u %5.1f%% full %9.2f ms\n", "  shelves, same width", atlas.width, shelfHeight, texels / ((double)atlas.width * shelfHeight) * 100.0, t * 1e3);
+		t = time_pack(widths, heights, ATLAS_2D, 4, 0, atlas);
+		print_pack("skyline 2D, 4 texel gutter", atlas, t);
+		t = time_pack(widths, heights, ATLAS_ARRAY, 4, 1024, atlas);
+		print_pack("skyline array, 4 texel gutter", atlas, t);
+		t = time_pack(widths, heights, ATLAS_ARRAY, 4, 2048, atlas);
+		print_pack("skyline array, 4 texel gutter", atlas, t);
+		printf("\n");
+	}
+
+	glfwInit();
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+	GLFWwindow *window = glfwCreateWindow(256, 256, "texture_atlas", NULL, NULL);
+	if (!window) return 1;
+	glfwMakeContextCurrent(window);
+	glewExperimental = true;
+	glewInit();
+
+	// A gradient and the image's number, so that any two differ.
+	std::vector<std::vector<unsigned char> > pixels(count);
+	std::vector<AtlasImage> images(count);
+	for (size_t i = 0; i < count; i++) {
+		pixels[i].resize((size_t)widths[i] * heights[i] * 4);
+		for (unsigned int y = 0; y < heights[i]; y++)
+			for (unsigned int x = 0; x < widths[i]; x++) {
+				unsigned char *p = &pixels[i][((size_t)y * widths[i] + x) * 4];
+				p[0] = (unsigned char)(x * 255 / widths[i]);
+				p[1] = (unsigned char)(y * 255 / heights[i]);
+				p[2] = (unsigned char)i;
+				p[3] = (unsigned char)(i >> 8);
+			}
+		images[i].rgba = &pixels[i][0];
+		images[i].width = widths[i];
+		images[i].height = heights[i];
+	}
+
+	// One texture each, with the mipmaps loadBMP makes.
+	glFinish();
+	double start = bench_now();
+	std::vector<GLuint> textures(count);
+	glGenTextures((GLsizei)count, &textures[0]);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	for (size_t i = 0; i < count; i++) {
+		glBindTexture(GL_TEXTURE_2D, textures[i]);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, widths[i], heights[i], 0, GL_RGBA, GL_UNSIGNED_BYTE, images[i].rgba);
+		MipChain chain;
+		buildMipChain(images[i].rgba, widths[i], heights[i], 4, 0, true, chain);
+		uploadMipChain(GL_TEXTURE_2D, chain, GL_RGBA8, GL_RGBA);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	}
+	glFinish();
+	double separate = bench_now() - start;
+
+	TextureAtlas array;
+	start = bench_now();
+	if (!buildTextureAtlas(&images[0], count, ATLAS_ARRAY, array)) return 1;
+	glFinish();
+	double arrayBuild = bench_now() - start;
+
+	start = bench_now();
+	if (!buildTextureAtlas(&images[0], count, ATLAS_2D, atlas)) return 1;
+	glFinish();
+	double atlasBuild = bench_now() - start;
+
+	// Level 0 of the atlas against the images, gutters included.
+	std::vector<unsigned char> level0((size_t)atlas.width * atlas.height * 4);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, &level0[0]);
+	bool same = true;
+	for (size_t i = 0; i < count && same; i++) {
+		const AtlasRect &r = atlas.rects[i];
+		for (int y = -(int)atlas.padding; y < (int)(r.height + atlas.padding) && same; y++)
+			for (int x = -(int)atlas.padding; x < (int)(r.width + atlas.padding) && same; x++) {
+				int sx = std::min(std::max(x, 0), (int)r.width - 1), sy = std::min(std::max(y, 0), (int)r.height - 1);
+				same = memcmp(&level0[((size_t)(r.y + y) * atlas.width + r.x + x) * 4], &pixels[i][((size_t)sy * r.width + sx) * 4], 4) == 0;
+			}
+	}
+	printf("%-30s %9.1f ms\n", "a texture each", separate * 1e3);
+	printf("%-30s %9.1f ms  %ux%u, %u levels, %s\n", "2D atlas", atlasBuild * 1e3, atlas.width, atlas.height, atlas.levels, same ? "same pixels" : "DIFFERENT pixels");
+	printf("%-30s %9.1f ms  %ux%u x %u\n", "array", arrayBuild * 1e3, array.width, array.height, array.layers);
+
+	// Every image once on a grid of quads : its own UVs, or the atlas's.
+	unsigned int side = 1;
+	while ((size_t)side * side < count) side++;
+	std::vector<float> own, shared;
+	std::vector<glm::vec2> uvs;
+	for (size_t i = 0; i < count; i++) {
+		float x0 = -1.0f + 2.0f * (i % side) / side, y0 = -1.0f + 2.0f * (i / side) / side, d = 2.0f / side;
+		float corners[6][4] = { { x0, y0, 0, 0 }, { x0 + d, y0, 1, 0 }, { x0 + d, y0 + d, 1, -1 }, { x0, y0, 0, 0 }, { x0 + d, y0 + d, 1, -1 }, { x0, y0 + d, 0, -1 } };
+		uvs.clear();
+		for (int c = 0; c < 6; c++) uvs.push_back(glm::vec2(corners[c][2], corners[c][3])); // V turned, as objloader does
+		atlasRemapUVs(&uvs[0], 6, atlas, i);
+		for (int c = 0; c < 6; c++) {
+			own.push_back(corners[c][0]); own.push_back(corners[c][1]); own.push_back(corners[c][2]); own.push_back(corners[c][3]);
+			shared.push_back(corners[c][0]); shared.push_back(corners[c][1]); shared.push_back(uvs[c].x); shared.push_back(uvs[c].y);
+		}
+	}
+	GLuint program = make_program(), vao, buffers[2];
+	glUseProgram(program);
+	glUniform1i(glGetUniformLocation(program, "tex"), 0);
+	glGenVertexArrays(1, &vao);
+	glBindVertexArray(vao);
+	glGenBuffers(2, buffers);
+	glBindBuffer(GL_ARRAY_BUFFER, buffers[0]);
+	glBufferData(GL_ARRAY_BUFFER, own.size() * sizeof(float), &own[0], GL_STATIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, buffers[1]);
+	glBufferData(GL_ARRAY_BUFFER, shared.size() * sizeof(float), &shared[0], GL_STATIC_DRAW);
+	glEnableVertexAttribArray(0);
+	glEnableVertexAttribArray(1);
+
+	const int frames = 10;
+	glBindBuffer(GL_ARRAY_BUFFER, buffers[0]);
+	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 16, (void *)0);
+	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 16, (void *)8);
+	time_frames(textures, 0, count, 1);
+	double perDraw = time_frames(textures, 0, count, frames);
+	glBindBuffer(GL_ARRAY_BUFFER, buffers[1]);
+	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 16, (void *)0);
+	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 16, (void *)8);
+	time_frames(textures, atlas.texture, count, 1);
+	double once = time_frames(textures, atlas.texture, count, frames);
+	printf("\n%lu draws a frame\n%-30s %9.2f ms a frame, %lu binds\n%-30s %9.2f ms a frame, 1 bind\n", (unsigned long)count,
+		"a texture each", perDraw, (unsigned long)count, "2D atlas", once);
+
+	glDeleteBuffers(2, buffers);
+	glDeleteVertexArrays(1, &vao);
+	glDeleteProgram(program);
+	glDeleteTextures((GLsizei)count, &textures[0]);
+	glDeleteTextures(1, &atlas.texture);
+	glDeleteTextures(1, &array.texture);
+	glfwTerminate();
+	return 0;
+}
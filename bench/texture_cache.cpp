@@ -0,0 +1,108 @@
+// TextureCache (texturecache.hpp) over a run of scenes that share their
+// textures : each scene acquires its set, draws nothing, and releases it
+// before the next. Against loading every texture of every scene with
+// loadDDS and deleting them at the end of the scene, which is what the
+// tutorials do.
+//
+//   ./texture_cache               32 files of 1024x1024 BC1, 4 of them
+//                                 copies of others under another name
+//   ./texture_cache 2048 16       16 files of 2048x2048
+//
+// Scenes take 12 textures each, the ones of the scene before shifted by 4,
+// so that a third of a scene is new. The budget holds 20 textures, less
+// than two scenes. The GL part runs on whatever the default context is
+// (llvmpipe on the test machines).
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+#include "../basic_shading/common.hpp"
+#include "../basic_shading/texturecache.hpp"
+#include "bench.hpp"
+
+#define SCENES        16
+#define PER_SCENE     12
+#define SCENE_SHIFT   4
+
+int main(int argc, char **argv) {
+	unsigned int size = argc > 1 ? (unsigned int)atoi(argv[1]) : 1024;
+	unsigned int files = argc > 2 ? (unsigned int)atoi(argv[2]) : 32;
+	size_t budget = (size_t)size * size / 2 * 4 / 3 * 20;
+
+	glfwInit();
+	GLFWwindow *window = glfwCreateWindow(64, 64, "texture_cache", NULL, NULL);
+	if (!window) return 1;
+	glfwMakeContextCurrent(window);
+	glewExperimental = true;
+	glewInit();
+
+	// The last 4 files are byte for byte copies of the first 4.
+	std::vector<std::string> paths(files);
+	for (unsigned int i = 0; i < files; i++) {
+		char path[64];
+		snprintf(path, sizeof path, "/tmp/bench_cache_%u_%u.dds", size, i);
+		paths[i] = path;
+		if (bench_file_size(path) >= 0) continue;
+		if (i + 4 >= files && i >= 4) {
+			char copy[128];
+			snprintf(copy, sizeof copy, "cp %s %s", paths[i - (files - 4)].c_str(), path);
+			if (system(copy) != 0) return 1;
+		} else {
+			// bench_write_dds writes the same noise every time : the first
+			// block tells the files apart.
+			if (!bench_write_dds(path, size, size, false)) return 1;
+			FILE *fp = fopen(path, "r+b");
+			if (!fp) return 1;
+			fseek(fp, 128, SEEK_SET);
+			fwrite(&i, sizeof i, 1, fp);
+			fclose(fp);
+		}
+	}
+	printf("%u DDS files of %ux%u BC1 ; %d scenes of %d textures, %d new each\n", files, size, size, SCENES, PER_SCENE, SCENE_SHIFT);
+
+	// loadDDS and delete, scene after scene.
+	double start = bench_now();
+	unsigned long loads = 0;
+	for (int scene = 0; scene < SCENES; scene++) {
+		GLuint textures[PER_SCENE];
+		for (int i = 0; i < PER_SCENE; i++, loads++) textures[i] = loadDDS(paths[(scene * SCENE_SHIFT + i) % files].c_str());
+		glFinish();
+		glDeleteTextures(PER_SCENE, textures);
+	}
+	double plain = bench_now() - start;
+
+	// The same through the cache.
+	TextureCache cache(budget);
+	start = bench_now();
+	double firstScene = 0;
+	for (int scene = 0; scene < SCENES; scene++) {
+		GLuint textures[PER_SCENE];
+		for (int i = 0; i < PER_SCENE; i++) textures[i] = cache.acquire(paths[(scene * SCENE_SHIFT + i) % files].c_str());
+		glFinish();
+		for (int i = 0; i < PER_SCENE; i++) cache.release(textures[i]);
+		if (scene == 0) firstScene = bench_now() - start;
+	}
+	double cached = bench_now() - start;
+
+	// A scene that was just there again : nothing to load.
+	start = bench_now();
+	GLuint again[PER_SCENE];
+	for (int i = 0; i < PER_SCENE; i++) again[i] = cache.acquire(paths[((SCENES - 1) * SCENE_SHIFT + i) % files].c_str());
+	double repeat = bench_now() - start;
+	for (int i = 0; i < PER_SCENE; i++) cache.release(again[i]);
+
+	const TextureCacheStats &stats = cache.stats();
+	printf("%-30s %9.1f ms, %.2f ms a scene, %lu loads\n", "loadDDS + delete", plain * 1e3, plain * 1e3 / SCENES, loads);
+	printf("%-30s %9.1f ms, %.2f ms a scene (first %.2f ms)\n", "TextureCache", cached * 1e3, cached * 1e3 / SCENES, firstScene * 1e3);
+	printf("%-30s %9.3f ms\n", "last scene again", repeat * 1e3);
+	printf("%lu hits, %lu by content, %lu misses, %lu evictions ; %.1f MB resident of %.1f MB\n",
+		stats.hits, stats.contentHits, stats.misses, stats.evictions, stats.residentBytes / (1024.0 * 1024.0), budget / (1024.0 * 1024.0));
+	cache.clear();
+	glfwTerminate();
+	return 0;
+}
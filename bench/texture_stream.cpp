@@ -0,0 +1,169 @@
+// Frame times while a set of 4K DDS textures is loaded : with loadDDS,
+// all before the first frame or one per frame, and with the
+// TextureStreamer at a few upload budgets. Every frame draws each texture
+// on its own tile of the window and waits for the result (glFinish), so
+// a frame's time is what it would hold the screen for.
+//
+//   ./texture_stream             8 files of 4096x4096, BC1 and BC3
+//   ./texture_stream 16 2048     16 files of 2048x2048
+//
+// The files are dropped from the page cache before each case. "visible"
+// is when every texture has some level to show, "complete" when all of
+// them are fully in.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include <algorithm>
+
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+#include "../basic_shading/common.hpp"
+#include "../basic_shading/texturestream.hpp"
+#include "bench.hpp"
+
+static std::vector<std::string> files;
+
+static const char *vertexSource =
+	"#version 330 core\n"
+	"out vec2 uv;\n"
+	"void main() {\n"
+	"	uv = vec2(gl_VertexID & 1, gl_VertexID >> 1) * 2.0;\n"
+	"	gl_Position = vec4(uv * 2.0 - 1.0, 0.0, 1.0);\n"
+	"}\n";
+static const char *fragmentSource =
+	"#version 330 core\n"
+	"in vec2 uv;\n"
+	"out vec3 color;\n"
+	"uniform sampler2D tex;\n"
+	"void main() { color = texture(tex, uv * 4.0).rgb + 0.1; }\n";
+
+GLuint make_program() {
+	GLuint vs = glCreateShader(GL_VERTEX_SHADER), fs = glCreateShader(GL_FRAGMENT_SHADER);
+	glShaderSource(vs, 1, &vertexSource, NULL);
+	glShaderSource(fs, 1, &fragmentSource, NULL);
+	glCompileShader(vs);
+	glCompileShader(fs);
+	GLuint program = glCreateProgram();
+	glAttachShader(program, vs);
+	glAttachShader(program, fs);
+	glLinkProgram(program);
+	glDeleteShader(vs);
+	glDeleteShader(fs);
+	return program;
+}
+
+bool texture_visible(GLuint texture) {
+	GLint base = 1, max = 0;
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glGetTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, &base);
+	glGetTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, &max);
+	return texture != 0 && base <= max;
+}
+
+// mode 0 : loadDDS of every file before the first frame ; 1 : one loadDDS
+// per frame ; otherwise streamed with a budget of `mode` bytes per frame.
+int run(int mode) {
+	glfwInit();
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+	GLFWwindow *window = glfwCreateWindow(1024, 768, "texture_stream", NULL, NULL);
+	if (!window) return 0;
+	glfwMakeContextCurrent(window);
+	glewExperimental = true;
+	glewInit();
+
+	GLuint vao, program = make_program();
+	glGenVertexArrays(1, &vao);
+	glBindVertexArray(vao);
+	glUseProgram(program);
+	glUniform1i(glGetUniformLocation(program, "tex"), 0);
+
+	TextureStreamer streamer;
+	std::vector<GLuint> textures(files.size(), 0);
+	if (mode > 1) streamer.start();
+	size_t loaded = 0;
+	std::vector<double> frames;
+	double start = bench_now(), visibleAt = -1, completeAt = -1;
+	int cols = 4, rows = ((int)files.size() + cols - 1) / cols;
+
+	for (int settled = 0; settled < 30 && frames.size() < 10000; ) {
+		double frameStart = bench_now();
+		if (mode == 0) {
+			for (; loaded < files.size(); loaded++) textures[loaded] = loadDDS(files[loaded].c_str());
+		} else if (mode == 1) {
+			if (loaded < files.size()) { textures[loaded] = loadDDS(files[loaded].c_str()); loaded++; }
+		} else {
+			for (; loaded < files.size(); loaded++) textures[loaded] = streamer.load(files[loaded].c_str());
+			streamer.update(mode);
+		}
+
+		bool visible = true;
+		for (size_t i = 0; i < textures.size(); i++) visible = texture_visible(textures[i]) && visible;
+		bool complete = mode > 1 ? streamer.idle() : loaded == files.size();
+
+		glClear(GL_COLOR_BUFFER_BIT);
+		for (size_t i = 0; i < textures.size(); i++) {
+			glViewport((GLint)(i % cols) * 1024 / cols, (GLint)(i / cols) * 768 / rows, 1024 / cols, 768 / rows);
+			glBindTexture(GL_TEXTURE_2D, textures[i]);
+			glDrawArrays(GL_TRIANGLES, 0, 3);
+		}
+		glfwSwapBuffers(window);
+		glFinish();
+		double now = bench_now();
+		frames.push_back(now - frameStart);
+		if (visible && visibleAt < 0) visibleAt = now - start;
+		if (complete && completeAt < 0) completeAt = now - start;
+		if (complete) settled++;
+	}
+	streamer.stop();
+
+	// Steady state : the frames after everything is in.
+	std::vector<double> sorted(frames);
+	std::sort(sorted.begin(), sorted.end());
+	std::vector<double> tail(frames.end() - 30, frames.end());
+	std::sort(tail.begin(), tail.end());
+	double steady = tail[15];
+	size_t spikes = 0;
+	for (size_t i = 0; i < frames.size(); i++) if (frames[i] > 2.0 * steady + 0.005) spikes++;
+	printf(" %6lu %8.1f %8.1f %8.1f %8.1f %6lu %9.0f %9.0f", (unsigned long)frames.size(), steady * 1e3,
+		sorted[sorted.size() / 2] * 1e3, sorted[sorted.size() * 99 / 100] * 1e3, sorted.back() * 1e3,
+		(unsigned long)spikes, visibleAt * 1e3, completeAt * 1e3);
+
+	for (size_t i = 0; i < textures.size(); i++) glDeleteTextures(1, &textures[i]);
+	glDeleteProgram(program);
+	glDeleteVertexArrays(1, &vao);
+	glfwTerminate();
+	return 1;
+}
+
+int main(int argc, char **argv) {
+	int count = argc > 1 ? atoi(argv[1]) : 8;
+	unsigned int size = argc > 2 ? (unsigned int)atoi(argv[2]) : 4096;
+
+	long total = 0;
+	for (int i = 0; i < count; i++) {
+		char path[64];
+		snprintf(path, sizeof path, "/tmp/bench_dds_%u_%d_%s.dds", size, i, i % 2 ? "bc3" : "bc1");
+		if (bench_file_size(path) < 0 && !bench_write_dds(path, size, size, i % 2 != 0)) return 1;
+		files.push_back(path);
+		total += bench_file_size(path);
+	}
+	printf("%d files of %ux%u, %.1f MB in all ; times in ms, spikes are frames over twice the steady one\n",
+		count, size, size, total / (1024.0 * 1024.0));
+	printf("%-22s %6s %8s %8s %8s %8s %6s %9s %9s\n", "", "frames", "steady", "median", "p99", "max", "spikes", "visible", "complete");
+
+	const char *names[] = { "loadDDS, all at once", "loadDDS, one a frame", "streamed, 2 MB/frame", "streamed, 8 MB/frame", "streamed, 32 MB/frame" };
+	int modes[] = { 0, 1, 2 << 20, 8 << 20, 32 << 20 };
+	for (int c = 0; c < 5; c++) {
+		printf("%-22s", names[c]);
+		fflush(stdout);
+		for (size_t i = 0; i < files.size(); i++) bench_drop_cache(files[i].c_str());
+		bench_isolated(run, modes[c]);
+		printf("\n");
+	}
+	return 0;
+}
@@ -0,0 +1,93 @@
+// Post-transform vertex cache efficiency of indexed meshes before and after
+// optimizeMesh, measured with the FIFO cache simulator (no GPU needed).
+//
+//   ./vertex_cache                 suzanne.obj, a 1M face grid, and the
+//                                  same grid with its triangles shuffled
+//   ./vertex_cache a.obj 500000    any mix of OBJ files and synthetic face counts
+//
+// ACMR is transformed vertices per triangle (0.5 at best on a closed
+// mesh), ATVR transformed vertices per vertex (1.0 at best).
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <string.h>
+#include <vector>
+#include <algorithm>
+
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+using namespace glm;
+#include "../basic_shading/common.hpp"
+#include "../basic_shading/objloader.hpp"
+#include "../basic_shading/vboindexer.hpp"
+#include "../basic_shading/meshoptimize.hpp"
+#include "bench.hpp"
+
+void print_stats(const char *name, const std::vector<unsigned int> &indices, size_t vertexCount) {
+	VertexCacheStats s16 = simulateVertexCache(&indices[0], indices.size(), vertexCount, 16);
+	VertexCacheStats s32 = simulateVertexCache(&indices[0], indices.size(), vertexCount, 32);
+	printf("  %-10s ACMR %5.3f / %5.3f  ATVR %5.3f / %5.3f\n", name, s16.acmr, s32.acmr, s16.atvr, s32.atvr);
+}
+
+// Same triangles in a random order, like the output of some scanners.
+void shuffle_triangles(std::vector<unsigned int> &indices) {
+	srand(1);
+	size_t n = indices.size() / 3;
+	for (size_t i = n - 1; i > 0; i--) {
+		size_t j = ((size_t)rand() * RAND_MAX + rand()) % (i + 1);
+		for (int k = 0; k < 3; k++) std::swap(indices[i * 3 + k], indices[j * 3 + k]);
+	}
+}
+
+void run(const char *path, bool shuffled) {
+	std::vector<unsigned int> indices;
+	std::vector<glm::vec3> vertices, normals;
+	std::vector<glm::vec2> uvs;
+	if (!loadOBJIndexed(path, indices, vertices, uvs, normals) || indices.empty()) return;
+	if (shuffled) shuffle_triangles(indices);
+	printf("%s%s : %lu triangles, %lu vertices (FIFO 16 / 32)\n", path, shuffled ? ", shuffled" : "",
+		(unsigned long)indices.size() / 3, (unsigned long)vertices.size());
+	print_stats("file order", indices, vertices.size());
+
+	std::vector<unsigned int> tipsify = indices;
+	std::vector<size_t> clusters;
+	double start = bench_now();
+	optimizeVertexCache(&tipsify[0], tipsify.size(), vertices.size(), VERTEX_CACHE_SIZE, &clusters);
+	double tcache = bench_now() - start;
+	print_stats("tipsify", tipsify, vertices.size());
+
+	start = bench_now();
+	optimizeOverdraw(&tipsify[0], tipsify.size(), vertices, clusters);
+	double toverdraw = bench_now() - start;
+	print_stats("+overdraw", tipsify, vertices.size());
+
+	start = bench_now();
+	optimizeVertexFetch(&tipsify[0], tipsify.size(), vertices, uvs, normals);
+	double tfetch = bench_now() - start;
+	printf("  %lu clusters ; %.1f ms cache, %.1f ms overdraw, %.1f ms fetch (%.1f Mtris/s overall)\n",
+		(unsigned long)clusters.size(), tcache * 1e3, toverdraw * 1e3, tfetch * 1e3,
+		tipsify.size() / 3 / 1e6 / (tcache + toverdraw + tfetch));
+}
+
+int main(int argc, char **argv) {
+	const char *defaults[] = { "../basic_shading/suzanne.obj", "1000000", "~1000000" };
+	int ncases = argc > 1 ? argc - 1 : 3;
+	char **cases = argc > 1 ? argv + 1 : (char **)defaults;
+
+	for (int i = 0; i < ncases; i++) {
+		const char *path = cases[i];
+		bool shuffled = cases[i][0] == '~';
+		char synthetic[64];
+		if (isdigit(cases[i][shuffled])) {
+			unsigned int w, h;
+			bench_grid_for_faces(strtoul(cases[i] + shuffled, 0, 10), &w, &h);
+			snprintf(synthetic, sizeof synthetic, "/tmp/bench_grid_%ux%u.obj", w, h);
+			if (bench_file_size(synthetic) < 0 && !bench_write_grid_obj(synthetic, w, h)) return 1;
+			path = synthetic;
+		}
+		run(path, shuffled);
+	}
+	return 0;
+}
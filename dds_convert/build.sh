@@ -0,0 +1,2 @@
+#!/usr/bin sh
+g++ -O2 dds_convert.cpp /Local/Users/john/Documents/c/ogl/deps/tinycthread.c -o dds_convert -L/usr/local/lib -I/usr/local/include -I/Local/Users/john/Documents/c/ogl/ -lglew -framework OpenGL -lglfw3
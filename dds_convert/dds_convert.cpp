@@ -0,0 +1,64 @@
+// Converts BMP, TGA and binary PPM images to DDS files that loadDDS reads :
+// BC1, or BC3 for images with alpha, with a full mipmap chain.
+//
+//   ./dds_convert uvtemplate.bmp uvtemplate.dds
+//   ./dds_convert -bc3 -nomips pal.ppm pal.dds
+//
+// Prints the time taken and the PSNR of the top level against the input.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <sys/time.h>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include "../basic_shading/common.hpp"
+
+double now() {
+	struct timeval tv;
+	gettimeofday(&tv, 0);
+	return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+int main(int argc, char **argv) {
+	bool bc3 = false, mipmaps = true;
+	int arg = 1;
+	for (; arg < argc && argv[arg][0] == '-'; arg++) {
+		if (strcmp(argv[arg], "-bc3") == 0) bc3 = true;
+		else if (strcmp(argv[arg], "-nomips") == 0) mipmaps = false;
+		else break;
+	}
+	if (argc - arg != 2) {
+		printf("usage : %s [-bc3] [-nomips] input.bmp|.tga|.ppm output.dds\n", argv[0]);
+		return 1;
+	}
+
+	std::vector<unsigned char> pixels, blocks;
+	unsigned int width, height;
+	bool alpha;
+	if (!readImageRGBA(argv[arg], pixels, width, height, alpha)) return 1;
+
+	double start = now();
+	DDSImage image;
+	encodeDDS(&pixels[0], width, height, alpha || bc3, image, blocks, mipmaps);
+	double elapsed = now() - start;
+	if (!writeDDS(argv[arg + 1], image)) return 1;
+
+	// The top level back, against what went in.
+	std::vector<unsigned char> decoded((size_t)width * height * 4);
+	BCSurface surface = { image.pixels, width, height, &decoded[0] };
+	bcDecodeSurfaces(image.internalFormat, &surface, 1);
+	double error = 0;
+	int channels = image.internalFormat == GL_COMPRESSED_RGBA_S3TC_DXT5_EXT ? 4 : 3;
+	for (size_t i = 0; i < decoded.size(); i += 4)
+		for (int c = 0; c < channels; c++) error += (double)(decoded[i + c] - pixels[i + c]) * (decoded[i + c] - pixels[i + c]);
+	error /= (double)width * height * channels;
+
+	printf("%s : %ux%u, %s, %u levels, %.1f KB in %.1f ms (%.0f Mpixels/s), PSNR %.2f dB\n", argv[arg + 1], width, height,
+		channels == 4 ? "BC3" : "BC1", image.levels, blocks.size() / 1024.0, elapsed * 1e3,
+		width * (double)height / elapsed / 1e6, error > 0 ? 10.0 * log10(255.0 * 255.0 / error) : 99.0);
+	return 0;
+}
@@ -0,0 +1,201 @@
+#ifndef ARENA_HPP
+#define ARENA_HPP
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <new>
+#include <vector>
+
+// What an arena handed out, for one asset or since it was made.
+struct ArenaStats {
+	size_t bytes;           // asked for, padding excluded
+	size_t allocations;
+	size_t blocks;          // blocks malloc'd to hold them
+	size_t reallocsAvoided; // vector growths a heap load goes through and this one didn't
+	size_t bytesNotCopied;  // what those growths would have copied
+};
+
+// A bump allocator for the temporaries of the loaders. Memory comes from a
+// list of big blocks, is handed out in order and is never freed one
+// allocation at a time : everything allocated after a mark() goes at once
+// with reset(mark). The blocks are kept for the next asset, so a batch of
+// loads touches the heap only while the arena warms up.
+class Arena {
+public:
+	struct Marker {
+		size_t block, offset;
+	};
+
+	Arena(size_t blockSize = 1 << 20) : blockSize(blockSize), current(0), offset(0) {
+		clearStats(stats);
+		clearStats(last);
+	}
+
+	~Arena() {
+		for (size_t i = 0; i < blocks.size(); i++) free(blocks[i].data);
+	}
+
+	// `size` bytes aligned on `align` (a power of two), or NULL if malloc
+	// fails.
+	void * allocate(size_t size, size_t align = 16) {
+		for (;;) {
+			if (current < blocks.size()) {
+				size_t start = (offset + align - 1) & ~(align - 1);
+				if (start + size <= blocks[current].size) {
+					offset = start + size;
+					stats.bytes += size;
+					stats.allocations++;
+					return blocks[current].data + start;
+				}
+				if (current + 1 < blocks.size() && blocks[current + 1].size >= size + align) {
+					current++;
+					offset = 0;
+					continue;
+				}
+			}
+			// Next block is missing or too small : put a new one there.
+			Block block;
+			block.size = size + align > blockSize ? size + align : blockSize;
+			block.data = (char *)malloc(block.size);
+			if (!block.data) return NULL;
+			stats.blocks++;
+			size_t at = blocks.empty() ? 0 : current + 1;
+			blocks.insert(blocks.begin() + at, block);
+			current = at;
+			offset = 0;
+		}
+	}
+
+	Marker mark() const {
+		Marker marker = { current, offset };
+		return marker;
+	}
+
+	// Gives back everything allocated since `marker`.
+	void reset(const Marker & marker) {
+		current = marker.block;
+		offset = marker.offset;
+	}
+
+	// Records that an array of `count` elements of `size` bytes was sized
+	// once up front, where a std::vector filled one push_back at a time
+	// would have doubled its way there.
+	void noteReserve(size_t count, size_t size) {
+		for (size_t capacity = 0; capacity < count; capacity = capacity ? capacity * 2 : 1) {
+			if (capacity == 0) continue;
+			stats.reallocsAvoided++;
+			stats.bytesNotCopied += capacity * size;
+		}
+	}
+
+	ArenaStats stats; // since the arena was made
+	ArenaStats last;  // of the last ArenaScope to end
+
+private:
+	struct Block {
+		char * data;
+		size_t size;
+	};
+
+	static void clearStats(ArenaStats & s) {
+		s.bytes = s.allocations = s.blocks = s.reallocsAvoided = s.bytesNotCopied = 0;
+	}
+
+	size_t blockSize;
+	std::vector<Block> blocks;
+	size_t current, offset;
+};
+
+// Everything allocated from `arena` while the scope is alive is given back
+// when it ends, and what it took is left in arena->last. A NULL arena is
+// allowed and does nothing, so loaders can take an optional one.
+class ArenaScope {
+public:
+	ArenaScope(Arena * arena) : arena(arena), marker(), start() {
+		if (!arena) return;
+		marker = arena->mark();
+		start = arena->stats;
+	}
+
+	~ArenaScope() {
+		if (!arena) return;
+		ArenaStats & last = arena->last;
+		const ArenaStats & now = arena->stats;
+		last.bytes           = now.bytes - start.bytes;
+		last.allocations     = now.allocations - start.allocations;
+		last.blocks          = now.blocks - start.blocks;
+		last.reallocsAvoided = now.reallocsAvoided - start.reallocsAvoided;
+		last.bytesNotCopied  = now.bytesNotCopied - start.bytesNotCopied;
+		arena->reset(marker);
+	}
+
+private:
+	ArenaScope(const ArenaScope &);
+	ArenaScope & operator=(const ArenaScope &);
+
+	Arena * arena;
+	Arena::Marker marker;
+	ArenaStats start;
+};
+
+// malloc and free for loaders that take an optional arena : from the arena
+// if there is one (and then free does nothing), from the heap otherwise.
+inline void * arenaAlloc(Arena * arena, size_t size) {
+	return arena ? arena->allocate(size) : malloc(size);
+}
+
+inline void arenaFree(Arena * arena, void * p) {
+	if (!arena) free(p);
+}
+
+void printArenaStats(const char * asset, const ArenaStats & s) {
+	printf("%s : %.1f KB in %lu allocations, %lu new blocks, %lu reallocations avoided (%.1f KB not copied)\n",
+		asset, s.bytes / 1024.0, (unsigned long)s.allocations, (unsigned long)s.blocks,
+		(unsigned long)s.reallocsAvoided, s.bytesNotCopied / 1024.0);
+}
+
+// Lets a std::vector live in an arena. With no arena it uses the heap, so
+// that a container can take an arena or not at run time.
+template <typename T>
+class ArenaAllocator {
+public:
+	typedef T value_type;
+	typedef T * pointer;
+	typedef const T * const_pointer;
+	typedef T & reference;
+	typedef const T & const_reference;
+	typedef size_t size_type;
+	typedef ptrdiff_t difference_type;
+
+	template <typename U> struct rebind { typedef ArenaAllocator<U> other; };
+
+	ArenaAllocator(Arena * arena = NULL) : arena(arena) {}
+	template <typename U> ArenaAllocator(const ArenaAllocator<U> & other) : arena(other.arena) {}
+
+	pointer allocate(size_type n, const void * = 0) {
+		void * p = arena ? arena->allocate(n * sizeof(T)) : ::operator new(n * sizeof(T));
+		if (!p) throw std::bad_alloc();
+		return (pointer)p;
+	}
+
+	void deallocate(pointer p, size_type) {
+		if (!arena) ::operator delete(p);
+	}
+
+	size_type max_size() const { return (size_type)-1 / sizeof(T); }
+	void construct(pointer p, const T & value) { new ((void *)p) T(value); }
+	void destroy(pointer p) { p->~T(); }
+	pointer address(reference x) const { return &x; }
+	const_pointer address(const_reference x) const { return &x; }
+
+	Arena * arena;
+};
+
+template <typename T, typename U>
+bool operator==(const ArenaAllocator<T> & a, const ArenaAllocator<U> & b) { return a.arena == b.arena; }
+
+template <typename T, typename U>
+bool operator!=(const ArenaAllocator<T> & a, const ArenaAllocator<U> & b) { return a.arena != b.arena; }
+
+#endif
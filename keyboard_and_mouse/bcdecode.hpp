@@ -0,0 +1,363 @@
+#ifndef BCDECODE_HPP
+#define BCDECODE_HPP
+
+#include <string.h>
+#include <stdint.h>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include "threads.hpp"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define BC_DECODE_X86 // SSSE3 and AVX2 versions, picked at run time
+#endif
+#if defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define BC_DECODE_NEON
+#endif
+
+// Software decoding of S3TC (BC1, BC2 and BC3, that is DXT1, DXT3 and
+// DXT5) to RGBA8, for drivers that can't take those formats compressed :
+// llvmpipe without S3TC, for one, where loadDDS would otherwise give
+// nothing. The arithmetic is that of Mesa's own software decoder ; GPUs,
+// and llvmpipe's texture sampling, round the interpolated colours each
+// their way, which the format allows : pixels may be one step off theirs.
+//
+// A 4x4 block is a palette plus 2-bit indices (and, for BC2 and BC3, an
+// alpha block in front). The SIMD versions make the palette in scalar code
+// and do the per pixel lookups with byte shuffles : pshufb (SSSE3) or tbl
+// (NEON) from a table of shuffle masks for each possible row of indices,
+// or vpermd on 8 pixels at once (AVX2). Pixels are stored R, G, B, A in
+// memory ; palettes are built as little-endian words, so this expects a
+// little-endian machine, as the SIMD targets all are.
+
+// Decodes `count` blocks in a row of blocks into 4 rows of 4 * `count`
+// pixels, `stride` bytes apart.
+typedef void (*BCDecodeRow)(GLenum format, const unsigned char * blocks, unsigned int count, unsigned char * out, size_t stride);
+
+inline bool bcDecodable(GLenum format) {
+	switch (format) {
+	case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+	case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:
+	case GL_COMPRESSED_RGBA_S3TC_DXT3_EXT:
+	case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+	case GL_COMPRESSED_SRGB_S3TC_DXT1_EXT:
+	case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT:
+	case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT:
+	case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT:
+		return true;
+	}
+	return false;
+}
+
+// The uncompressed internal format to upload the decoded pixels as.
+inline GLenum bcDecodedFormat(GLenum format) {
+	switch (format) {
+	case GL_COMPRESSED_SRGB_S3TC_DXT1_EXT:
+	case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT:
+	case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT:
+	case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT:
+		return GL_SRGB8_ALPHA8;
+	}
+	return GL_RGBA8;
+}
+
+// 0 for BC1, 2 for BC2, 3 for BC3.
+inline int bcAlphaKind(GLenum format) {
+	switch (format) {
+	case GL_COMPRESSED_RGBA_S3TC_DXT3_EXT:
+	case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT:
+		return 2;
+	case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+	case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT:
+		return 3;
+	}
+	return 0;
+}
+
+inline uint32_t bcPack(unsigned int r, unsigned int g, unsigned int b, unsigned int a) {
+	return r | g << 8 | b << 16 | a << 24;
+}
+
+inline uint32_t bcLoad32(const unsigned char * p) {
+	return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+// The four colours of a colour block. BC1 blocks with c0 <= c1 have three
+// and transparent black ; the colour blocks of BC2 and BC3 always have four.
+inline void bcColorPalette(const unsigned char * block, bool alwaysFour, uint32_t palette[4]) {
+	unsigned int c0 = block[0] | block[1] << 8, c1 = block[2] | block[3] << 8;
+	unsigned int r0 = (c0 >> 8 & 0xf8) | (c0 >> 13), g0 = (c0 >> 3 & 0xfc) | (c0 >> 9 & 0x3), b0 = (c0 << 3 & 0xf8) | (c0 >> 2 & 0x7);
+	unsigned int r1 = (c1 >> 8 & 0xf8) | (c1 >> 13), g1 = (c1 >> 3 & 0xfc) | (c1 >> 9 & 0x3), b1 = (c1 << 3 & 0xf8) | (c1 >> 2 & 0x7);
+	palette[0] = bcPack(r0, g0, b0, 255);
+	palette[1] = bcPack(r1, g1, b1, 255);
+	if (c0 > c1 || alwaysFour) {
+		palette[2] = bcPack((2 * r0 + r1) / 3, (2 * g0 + g1) / 3, (2 * b0 + b1) / 3, 255);
+		palette[3] = bcPack((r0 + 2 * r1) / 3, (g0 + 2 * g1) / 3, (b0 + 2 * b1) / 3, 255);
+	} else {
+		palette[2] = bcPack((r0 + r1) / 2, (g0 + g1) / 2, (b0 + b1) / 2, 255);
+		palette[3] = 0;
+	}
+}
+
+// The eight alphas of a BC3 alpha block.
+inline void bcAlphaPalette(const unsigned char * block, unsigned char palette[8]) {
+	unsigned int a0 = block[0], a1 = block[1];
+	palette[0] = a0;
+	palette[1] = a1;
+	if (a0 > a1) {
+		for (int i = 2; i < 8; i++) palette[i] = (unsigned char)(((8 - i) * a0 + (i - 1) * a1) / 7);
+	} else {
+		for (int i = 2; i < 6; i++) palette[i] = (unsigned char)(((6 - i) * a0 + (i - 1) * a1) / 5);
+		palette[6] = 0;
+		palette[7] = 255;
+	}
+}
+
+// The alpha of each of the 16 pixels of a BC2 or BC3 block.
+inline void bcBlockAlpha(int kind, const unsigned char * block, unsigned char alpha[16]) {
+	if (kind == 2) {
+		for (int i = 0; i < 8; i++) {
+			alpha[2 * i] = (unsigned char)((block[i] & 0xf) * 17);
+			alpha[2 * i + 1] = (unsigned char)((block[i] >> 4) * 17);
+		}
+		return;
+	}
+	unsigned char palette[8];
+	bcAlphaPalette(block, palette);
+	uint64_t bits = 0;
+	for (int i = 7; i >= 2; i--) bits = bits << 8 | block[i];
+	for (int i = 0; i < 16; i++) alpha[i] = palette[(bits >> (3 * i)) & 7];
+}
+
+void bcDecodeRowScalar(GLenum format, const unsigned char * blocks, unsigned int count, unsigned char * out, size_t stride) {
+	int kind = bcAlphaKind(format);
+	size_t blockBytes = kind ? 16 : 8;
+	for (unsigned int b = 0; b < count; b++, blocks += blockBytes, out += 16) {
+		const unsigned char * color = kind ? blocks + 8 : blocks;
+		uint32_t palette[4];
+		bcColorPalette(color, kind != 0, palette);
+		uint32_t bits = bcLoad32(color + 4);
+		unsigned char alpha[16];
+		if (kind) bcBlockAlpha(kind, blocks, alpha);
+		for (int y = 0; y < 4; y++) {
+			unsigned char * p = out + y * stride;
+			for (int x = 0; x < 4; x++, p += 4) {
+				uint32_t c = palette[bits >> (2 * (4 * y + x)) & 3];
+				p[0] = (unsigned char)c;
+				p[1] = (unsigned char)(c >> 8);
+				p[2] = (unsigned char)(c >> 16);
+				p[3] = kind ? alpha[4 * y + x] : (unsigned char)(c >> 24);
+			}
+		}
+	}
+}
+
+#if defined(BC_DECODE_X86) || defined(BC_DECODE_NEON)
+// For each byte of four 2-bit indices, the byte shuffle that takes the
+// four pixels of that row from a 16-byte palette.
+struct BCRowShuffles {
+	unsigned char masks[256][16];
+	BCRowShuffles() {
+		for (int row = 0; row < 256; row++)
+			for (int x = 0; x < 4; x++)
+				for (int c = 0; c < 4; c++)
+					masks[row][4 * x + c] = (unsigned char)(4 * (row >> (2 * x) & 3) + c);
+	}
+};
+
+inline const BCRowShuffles & bcRowShuffles() {
+	static BCRowShuffles shuffles;
+	return shuffles;
+}
+#endif
+
+#ifdef BC_DECODE_X86
+__attribute__((target("ssse3")))
+void bcDecodeRowSSSE3(GLenum format, const unsigned char * blocks, unsigned int count, unsigned char * out, size_t stride) {
+	const BCRowShuffles & shuffles = bcRowShuffles();
+	int kind = bcAlphaKind(format);
+	size_t blockBytes = kind ? 16 : 8;
+	const __m128i rgb = _mm_set1_epi32(0x00ffffff);
+	// Spreads 4 alpha bytes to the alpha byte of 4 pixels.
+	const __m128i spread = _mm_setr_epi8(-1, -1, -1, 0, -1, -1, -1, 1, -1, -1, -1, 2, -1, -1, -1, 3);
+	for (unsigned int b = 0; b < count; b++, blocks += blockBytes, out += 16) {
+		const unsigned char * color = kind ? blocks + 8 : blocks;
+		uint32_t palette[4];
+		bcColorPalette(color, kind != 0, palette);
+		__m128i pal = _mm_loadu_si128((const __m128i *)palette);
+		unsigned char alpha[16];
+		if (kind) bcBlockAlpha(kind, blocks, alpha);
+		for (int y = 0; y < 4; y++) {
+			__m128i pixels = _mm_shuffle_epi8(pal, _mm_loadu_si128((const __m128i *)shuffles.masks[color[4 + y]]));
+			if (kind) {
+				__m128i a = _mm_shuffle_epi8(_mm_cvtsi32_si128((int)bcLoad32(alpha + 4 * y)), spread);
+				pixels = _mm_or_si128(_mm_and_si128(pixels, rgb), a);
+			}
+			_mm_storeu_si128((__m128i *)(out + y * stride), pixels);
+		}
+	}
+}
+
+__attribute__((target("avx2")))
+void bcDecodeRowAVX2(GLenum format, const unsigned char * blocks, unsigned int count, unsigned char * out, size_t stride) {
+	int kind = bcAlphaKind(format);
+	size_t blockBytes = kind ? 16 : 8;
+	// Pixel i of a pair of rows is at bits 2i of the row pair's 16 bits, 3i
+	// of the 24 alpha bits of BC3, 4i of the 32 alpha bits of BC2.
+	const __m256i colorShifts = _mm256_setr_epi32(0, 2, 4, 6, 8, 10, 12, 14);
+	const __m256i alphaShifts3 = _mm256_setr_epi32(0, 3, 6, 9, 12, 15, 18, 21);
+	const __m256i alphaShifts2 = _mm256_setr_epi32(0, 4, 8, 12, 16, 20, 24, 28);
+	const __m256i rgb = _mm256_set1_epi32(0x00ffffff);
+	for (unsigned int b = 0; b < count; b++, blocks += blockBytes, out += 16) {
+		const unsigned char * color = kind ? blocks + 8 : blocks;
+		uint32_t palette[4];
+		bcColorPalette(color, kind != 0, palette);
+		__m256i pal = _mm256_castsi128_si256(_mm_loadu_si128((const __m128i *)palette));
+		uint32_t bits = bcLoad32(color + 4);
+		__m256i three = _mm256_set1_epi32(3);
+		__m256i rows01 = _mm256_permutevar8x32_epi32(pal, _mm256_and_si256(_mm256_srlv_epi32(_mm256_set1_epi32(bits & 0xffff), colorShifts), three));
+		__m256i rows23 = _mm256_permutevar8x32_epi32(pal, _mm256_and_si256(_mm256_srlv_epi32(_mm256_set1_epi32(bits >> 16), colorShifts), three));
+
+		if (kind == 3) {
+			unsigned char alphas[8];
+			bcAlphaPalette(blocks, alphas);
+			__m256i apal = _mm256_slli_epi32(_mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)alphas)), 24);
+			uint32_t lo = blocks[2] | blocks[3] << 8 | blocks[4] << 16, hi = blocks[5] | blocks[6] << 8 | blocks[7] << 16;
+			__m256i seven = _mm256_set1_epi32(7);
+			__m256i a01 = _mm256_permutevar8x32_epi32(apal, _mm256_and_si256(_mm256_srlv_epi32(_mm256_set1_epi32(lo), alphaShifts3), seven));
+			__m256i a23 = _mm256_permutevar8x32_epi32(apal, _mm256_and_si256(_mm256_srlv_epi32(_mm256_set1_epi32(hi), alphaShifts3), seven));
+			rows01 = _mm256_or_si256(_mm256_and_si256(rows01, rgb), a01);
+			rows23 = _mm256_or_si256(_mm256_and_si256(rows23, rgb), a23);
+		} else if (kind == 2) {
+			__m256i fifteen = _mm256_set1_epi32(15);
+			__m256i a01 = _mm256_and_si256(_mm256_srlv_epi32(_mm256_set1_epi32(bcLoad32(blocks)), alphaShifts2), fifteen);
+			__m256i a23 = _mm256_and_si256(_mm256_srlv_epi32(_mm256_set1_epi32(bcLoad32(blocks + 4)), alphaShifts2), fifteen);
+			// a * 17 is a | a << 4, then up to the alpha byte.
+			a01 = _mm256_slli_epi32(_mm256_or_si256(a01, _mm256_slli_epi32(a01, 4)), 24);
+			a23 = _mm256_slli_epi32(_mm256_or_si256(a23, _mm256_slli_epi32(a23, 4)), 24);
+			rows01 = _mm256_or_si256(_mm256_and_si256(rows01, rgb), a01);
+			rows23 = _mm256_or_si256(_mm256_and_si256(rows23, rgb), a23);
+		}
+		_mm_storeu_si128((__m128i *)out, _mm256_castsi256_si128(rows01));
+		_mm_storeu_si128((__m128i *)(out + stride), _mm256_extracti128_si256(rows01, 1));
+		_mm_storeu_si128((__m128i *)(out + 2 * stride), _mm256_castsi256_si128(rows23));
+		_mm_storeu_si128((__m128i *)(out + 3 * stride), _mm256_extracti128_si256(rows23, 1));
+	}
+}
+#endif
+
+#ifdef BC_DECODE_NEON
+void bcDecodeRowNEON(GLenum format, const unsigned char * blocks, unsigned int count, unsigned char * out, size_t stride) {
+	const BCRowShuffles & shuffles = bcRowShuffles();
+	int kind = bcAlphaKind(format);
+	size_t blockBytes = kind ? 16 : 8;
+	const uint8x16_t alphaBytes = vreinterpretq_u8_u32(vdupq_n_u32(0xff000000));
+	// Spreads 4 alpha bytes to the alpha byte of 4 pixels.
+	static const unsigned char spreadBytes[16] = { 16, 16, 16, 0, 16, 16, 16, 1, 16, 16, 16, 2, 16, 16, 16, 3 };
+	const uint8x16_t spread = vld1q_u8(spreadBytes);
+	for (unsigned int b = 0; b < count; b++, blocks += blockBytes, out += 16) {
+		const unsigned char * color = kind ? blocks + 8 : blocks;
+		uint32_t palette[4];
+		bcColorPalette(color, kind != 0, palette);
+		uint8x16_t pal = vreinterpretq_u8_u32(vld1q_u32(palette));
+		unsigned char alpha[16];
+		if (kind) bcBlockAlpha(kind, blocks, alpha);
+		for (int y = 0; y < 4; y++) {
+			uint8x16_t pixels = vqtbl1q_u8(pal, vld1q_u8(shuffles.masks[color[4 + y]]));
+			if (kind) {
+				uint8x16_t a = vqtbl1q_u8(vreinterpretq_u8_u32(vdupq_n_u32(bcLoad32(alpha + 4 * y))), spread);
+				pixels = vbslq_u8(alphaBytes, a, pixels);
+			}
+			vst1q_u8(out + y * stride, pixels);
+		}
+	}
+}
+#endif
+
+// The fastest version this machine runs.
+inline BCDecodeRow bcBestDecoder() {
+#ifdef BC_DECODE_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) return bcDecodeRowAVX2;
+	if (__builtin_cpu_supports("ssse3")) return bcDecodeRowSSSE3;
+#endif
+#ifdef BC_DECODE_NEON
+	return bcDecodeRowNEON;
+#endif
+	return bcDecodeRowScalar;
+}
+
+// One compressed image and where its pixels go : `width` * `height` RGBA8
+// pixels, rows one after the other.
+struct BCSurface {
+	const unsigned char * blocks;
+	unsigned int width, height;
+	unsigned char * pixels;
+};
+
+// A thread's share : the block rows whose first block falls in
+// [firstBlock, endBlock) counting across all the surfaces.
+struct BCDecodeChunk {
+	GLenum format;
+	const BCSurface * surfaces;
+	size_t surfaceCount;
+	uint64_t firstBlock, endBlock;
+	BCDecodeRow decode;
+};
+
+int bcDecodeChunk(void * arg) {
+	const BCDecodeChunk & chunk = *(const BCDecodeChunk *)arg;
+	size_t blockBytes = bcAlphaKind(chunk.format) ? 16 : 8;
+	std::vector<unsigned char> scratch;
+	uint64_t block = 0;
+	for (size_t s = 0; s < chunk.surfaceCount && block < chunk.endBlock; s++) {
+		const BCSurface & surface = chunk.surfaces[s];
+		unsigned int blocksX = (surface.width + 3) / 4, blocksY = (surface.height + 3) / 4;
+		size_t stride = (size_t)surface.width * 4;
+		for (unsigned int by = 0; by < blocksY; by++, block += blocksX) {
+			if (block < chunk.firstBlock) continue;
+			if (block >= chunk.endBlock) break;
+			const unsigned char * row = surface.blocks + (size_t)by * blocksX * blockBytes;
+			unsigned char * out = surface.pixels + (size_t)by * 4 * stride;
+			unsigned int rows = surface.height - by * 4 < 4 ? surface.height - by * 4 : 4;
+			if (surface.width % 4 == 0 && rows == 4) {
+				chunk.decode(chunk.format, row, blocksX, out, stride);
+				continue;
+			}
+			// Blocks hanging over the edge : whole, then the part inside.
+			scratch.resize((size_t)blocksX * 64);
+			chunk.decode(chunk.format, row, blocksX, &scratch[0], (size_t)blocksX * 16);
+			for (unsigned int y = 0; y < rows; y++) memcpy(out + y * stride, &scratch[(size_t)y * blocksX * 16], stride);
+		}
+	}
+	return 0;
+}
+
+// Decodes `count` surfaces of `format` (a whole mipmap chain, say) on
+// `threads` threads (0 : one per core), split by blocks so that the small
+// levels don't leave threads idle. `decode` picks a version, the fastest
+// by default.
+void bcDecodeSurfaces(GLenum format, const BCSurface * surfaces, size_t count, unsigned int threads = 0, BCDecodeRow decode = NULL) {
+	if (!decode) decode = bcBestDecoder();
+#if defined(BC_DECODE_X86) || defined(BC_DECODE_NEON)
+	bcRowShuffles(); // made before the threads need it
+#endif
+	uint64_t totalBlocks = 0;
+	for (size_t s = 0; s < count; s++)
+		totalBlocks += (uint64_t)((surfaces[s].width + 3) / 4) * ((surfaces[s].height + 3) / 4);
+	if (threads == 0) threads = defaultThreadCount();
+	// Not worth a thread under a few thousand blocks.
+	if (totalBlocks / threads < 4096) threads = (unsigned int)(totalBlocks / 4096) + 1;
+
+	std::vector<BCDecodeChunk> chunks(threads);
+	for (unsigned int i = 0; i < threads; i++) {
+		BCDecodeChunk chunk = { format, surfaces, count, totalBlocks * i / threads, totalBlocks * (i + 1) / threads, decode };
+		chunks[i] = chunk;
+	}
+	runChunks(chunks, bcDecodeChunk);
+}
+
+#endif
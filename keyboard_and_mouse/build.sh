@@ -1,2 +1,2 @@
 #!/usr/bin sh
-g++ keyboard_and_mouse.cpp -o keyboard_and_mouse -L/usr/local/lib -I/usr/local/include -I/Local/Users/john/Documents/c/ogl/ -lglew -framework OpenGL -lglfw3
+g++ keyboard_and_mouse.cpp /Local/Users/john/Documents/c/ogl/deps/tinycthread.c -o keyboard_and_mouse -L/usr/local/lib -I/usr/local/include -I/Local/Users/john/Documents/c/ogl/ -lglew -framework OpenGL -lglfw3
@@ -14,6 +14,7 @@ GLFWwindow* window;
 #include <glm/gtc/matrix_transform.hpp>
 using namespace glm;
 #include "common.hpp"
+#include "shaderreload.hpp"
 #include "controls.hpp"
 #include "palettes.hpp"
 
@@ -101,6 +102,16 @@ int main( void )
 	// Get a handle for our "myTextureSampler" uniform
 	GLuint TextureID  = glGetUniformLocation(programID, "myTextureSampler");
 
+	// Build the program again when its shaders are saved, and look the
+	// uniforms up again in the new one
+	ShaderReloader shaders;
+	size_t julia = shaders.watch(&programID, "julia_vertex_shader.glsl", "julia_fragment_shader.glsl");
+	shaders.uniform(julia, "MVP", &MatrixID);
+	shaders.uniform(julia, "myTextureSampler", &TextureID);
+	shaders.uniform(julia, "zoom", &uniforms.zoom);
+	shaders.uniform(julia, "offset", &uniforms.offset);
+	shaders.uniform(julia, "C", &uniforms.C);
+
 	// Our vertices. Tree consecutive floats give a 3D vertex; Three consecutive vertices give a triangle.
 	// A cube has 6 faces with 2 triangles each, so this makes 6*2=12 triangles, and 12*3 vertices
 	static const GLfloat g_vertex_buffer_data[] = { 
@@ -156,6 +167,12 @@ int main( void )
 
 	do{
 
+		// Swap in the program if its shaders were saved since the last frame,
+		// and use it before any glUniform : every uniform is set again below,
+		// so a new program needs nothing more
+		shaders.update();
+		glUseProgram(programID);
+
 		// Clear the screen
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
@@ -171,7 +188,7 @@ int main( void )
 
 		// Bind our texture in Texture Unit 0
 		glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_1D, TextureID);
+    glBindTexture(GL_TEXTURE_1D, palette_texture);
 		//glBindTexture(GL_TEXTURE_2D, Texture);
 		// Set our "myTextureSampler" sampler to user Texture Unit 0
 		glUniform1i(TextureID, 0);
@@ -195,7 +212,6 @@ int main( void )
     float C[2] = { (sinf(r * 0.1f) + cosf(r * 0.23f)) * 0.5f, (cosf(r * 0.13f) + sinf(r * 0.21f)) * 0.5f };
     float offset[2] = { x_offset, y_offset };
 
-    glUseProgram(programID);
     glUniform2fv(uniforms.C, 1, C);
     glUniform2fv(uniforms.offset, 1, offset);
     glUniform1f(uniforms.zoom, zoom);
@@ -208,17 +224,20 @@ int main( void )
 
 		// Swap buffers
 		glfwSwapBuffers(window);
+		shaders.presented();
 		glfwPollEvents();
 
 	} // Check if the ESC key was pressed or the window was closed
 	while( glfwGetKey(window, GLFW_KEY_ESCAPE ) != GLFW_PRESS &&
 		   glfwWindowShouldClose(window) == 0 );
 
+	shaders.stop();
+
 	// Cleanup VBO and shader
 	glDeleteBuffers(1, &vertexbuffer);
 	//glDeleteBuffers(1, &uvbuffer);
 	glDeleteProgram(programID);
-	glDeleteTextures(1, &TextureID);
+	glDeleteTextures(1, &palette_texture);
 	glDeleteVertexArrays(1, &VertexArrayID);
 
 	// Close OpenGL window and terminate GLFW
@@ -14,6 +14,7 @@ GLFWwindow* window;
 #include <glm/gtc/matrix_transform.hpp>
 using namespace glm;
 #include "common.hpp"
+#include "texturecache.hpp"
 #include "controls.hpp"
 
 
@@ -76,10 +77,15 @@ int main( void )
 	// Load the texture using any two methods
 	//GLuint Texture = loadBMP_custom("uvtemplate.bmp");
 	//GLuint Texture = loadBMP("uvtemplate.bmp");
-	GLuint Texture = loadDDS("uvtemplate.DDS");
-	glBindTexture(GL_TEXTURE_2D, Texture);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	// ... through the cache, which loads each image once however many ask.
+	TextureCache textures;
+	GLuint Texture = textures.acquire("uvtemplate.DDS");
+	// Nearest filtering, on a sampler of our own : the texture is the
+	// cache's, shared with whoever else asks for the same image.
+	GLuint Sampler;
+	glGenSamplers(1, &Sampler);
+	glSamplerParameteri(Sampler, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glSamplerParameteri(Sampler, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 	
 	// Get a handle for our "myTextureSampler" uniform
 	GLuint TextureID  = glGetUniformLocation(programID, "myTextureSampler");
@@ -198,6 +204,7 @@ int main( void )
 		// Bind our texture in Texture Unit 0
 		glActiveTexture(GL_TEXTURE0);
 		glBindTexture(GL_TEXTURE_2D, Texture);
+		glBindSampler(0, Sampler);
 		// Set our "myTextureSampler" sampler to user Texture Unit 0
 		glUniform1i(TextureID, 0);
 
@@ -243,7 +250,10 @@ int main( void )
 	glDeleteBuffers(1, &vertexbuffer);
 	glDeleteBuffers(1, &uvbuffer);
 	glDeleteProgram(programID);
-	glDeleteTextures(1, &TextureID);
+	textures.release(Texture);
+	glDeleteSamplers(1, &Sampler);
+	textures.printStats();
+	textures.clear();
 	glDeleteVertexArrays(1, &VertexArrayID);
 
 	// Close OpenGL window and terminate GLFW
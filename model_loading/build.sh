@@ -1,2 +1,2 @@
 #!/usr/bin sh
-g++ model_loading.cpp -o model_loading  -L/usr/local/lib -I/usr/local/include -I/Local/Users/john/Documents/c/ogl/ -lglew -framework OpenGL -lglfw3
+g++ model_loading.cpp /Local/Users/john/Documents/c/ogl/deps/tinycthread.c -o model_loading  -L/usr/local/lib -I/usr/local/include -I/Local/Users/john/Documents/c/ogl/ -lglew -framework OpenGL -lglfw3
@@ -0,0 +1,230 @@
+#ifndef MESHOPTIMIZE_HPP
+#define MESHOPTIMIZE_HPP
+
+#include <stdint.h>
+#include <vector>
+#include <algorithm>
+
+// Include GLM
+#include <glm/glm.hpp>
+
+// Reorders an indexed mesh (as made by indexOBJ) for the GPU : triangles
+// for the post-transform vertex cache, clusters of triangles for less
+// overdraw, and vertices in the order the triangles first use them. None of
+// this changes what is drawn, only in which order.
+
+// Post-transform cache sizes modern GPUs behave like. Tipsify is not very
+// sensitive to the exact value.
+#define VERTEX_CACHE_SIZE 16
+
+struct VertexCacheStats {
+	float acmr; // average cache miss ratio : transformed vertices per triangle, 0.5 at best
+	float atvr; // average transformed to vertex ratio : 1.0 at best
+};
+
+// Replays `indices` through a FIFO cache of `cacheSize` vertices, the way
+// the hardware would, and counts the misses.
+template <typename Index>
+VertexCacheStats simulateVertexCache(const Index * indices, size_t indexCount, size_t vertexCount, unsigned int cacheSize = VERTEX_CACHE_SIZE) {
+	std::vector<unsigned int> cacheTime(vertexCount, 0);
+	std::vector<char> used(vertexCount, 0);
+	unsigned int time = cacheSize + 1;
+	size_t misses = 0, unique = 0;
+	for (size_t i = 0; i < indexCount; i++) {
+		Index v = indices[i];
+		if (time - cacheTime[v] > cacheSize) {
+			cacheTime[v] = time++;
+			misses++;
+		}
+		if (!used[v]) {
+			used[v] = 1;
+			unique++;
+		}
+	}
+	VertexCacheStats stats;
+	stats.acmr = indexCount ? (float)misses / (indexCount / 3) : 0.0f;
+	stats.atvr = unique ? (float)misses / unique : 0.0f;
+	return stats;
+}
+
+// The triangles around each vertex, as one list of triangle numbers with
+// an offset per vertex.
+struct VertexTriangles {
+	std::vector<unsigned int> offsets; // vertexCount + 1
+	std::vector<unsigned int> triangles;
+};
+
+template <typename Index>
+void buildVertexTriangles(const Index * indices, size_t indexCount, size_t vertexCount, VertexTriangles & adjacency) {
+	adjacency.offsets.assign(vertexCount + 1, 0);
+	for (size_t i = 0; i < indexCount; i++) adjacency.offsets[indices[i] + 1]++;
+	for (size_t v = 0; v < vertexCount; v++) adjacency.offsets[v + 1] += adjacency.offsets[v];
+	adjacency.triangles.resize(indexCount);
+	std::vector<unsigned int> fill(adjacency.offsets.begin(), adjacency.offsets.end() - 1);
+	for (size_t i = 0; i < indexCount; i++) adjacency.triangles[fill[indices[i]]++] = (unsigned int)(i / 3);
+}
+
+// Triangle order for the vertex cache, with Tipsify (Sander, Nehab and
+// Barczak, "Fast Triangle Reordering for Vertex Locality and Reduced
+// Overdraw", 2007). Runs in linear time : it fans around one vertex at a
+// time, then moves to the neighbour that is still in the cache and has the
+// most triangles left, or to a vertex left behind ("dead end") when none
+// is. `indices` is rewritten in place. If `clusters` is given it receives
+// the first triangle of each run that starts with such a jump, where the
+// cache is likely cold anyway, for optimizeOverdraw.
+template <typename Index>
+void optimizeVertexCache(Index * indices, size_t indexCount, size_t vertexCount, unsigned int cacheSize = VERTEX_CACHE_SIZE, std::vector<size_t> * clusters = NULL) {
+	size_t triangleCount = indexCount / 3;
+	if (triangleCount == 0) return;
+
+	VertexTriangles adjacency;
+	buildVertexTriangles(indices, indexCount, vertexCount, adjacency);
+	std::vector<unsigned int> live(vertexCount);
+	for (size_t v = 0; v < vertexCount; v++) live[v] = adjacency.offsets[v + 1] - adjacency.offsets[v];
+
+	std::vector<unsigned int> cacheTime(vertexCount, 0);
+	std::vector<char> emitted(triangleCount, 0);
+	std::vector<Index> result;
+	result.reserve(indexCount);
+	std::vector<unsigned int> deadEnds, candidates;
+	unsigned int time = cacheSize + 1;
+	size_t cursor = 0;  // next vertex to try when out of dead ends
+	size_t emittedTriangles = 0;
+	int fan = 0;        // the vertex being fanned around
+	bool jumped = true; // whether `fan` was picked outside the cache
+
+	while (fan >= 0) {
+		if (clusters && jumped) clusters->push_back(emittedTriangles);
+		candidates.clear();
+		for (unsigned int k = adjacency.offsets[fan]; k < adjacency.offsets[fan + 1]; k++) {
+			unsigned int t = adjacency.triangles[k];
+			if (emitted[t]) continue;
+			for (int j = 0; j < 3; j++) {
+				Index v = indices[t * 3 + j];
+				result.push_back(v);
+				deadEnds.push_back(v);
+				candidates.push_back(v);
+				live[v]--;
+				if (time - cacheTime[v] > cacheSize) cacheTime[v] = time++;
+			}
+			emitted[t] = 1;
+			emittedTriangles++;
+		}
+
+		// Best candidate : still has triangles, and they can all be
+		// emitted before the vertex leaves the cache, the longest in the
+		// cache first. Failing that, the first one with triangles left.
+		int best = -1;
+		int bestPriority = -1;
+		for (size_t k = 0; k < candidates.size(); k++) {
+			unsigned int v = candidates[k];
+			if (live[v] == 0) continue;
+			int priority = 0;
+			if (time - cacheTime[v] + 2 * live[v] <= cacheSize) priority = time - cacheTime[v];
+			if (priority > bestPriority) {
+				bestPriority = priority;
+				best = v;
+			}
+		}
+		jumped = best < 0;
+		while (best < 0 && !deadEnds.empty()) {
+			unsigned int v = deadEnds.back();
+			deadEnds.pop_back();
+			if (live[v] > 0) best = v;
+		}
+		for (; best < 0 && cursor < vertexCount; cursor++)
+			if (live[cursor] > 0) best = (int)cursor;
+		fan = best;
+	}
+	std::copy(result.begin(), result.end(), indices);
+}
+
+// Puts the clusters from optimizeVertexCache in an order that draws the
+// triangles most likely to hide the others first, for any viewpoint :
+// clusters facing outwards and far from the centre of the mesh first (the
+// "view-independent" sort of the Tipsify paper). Triangles keep their
+// order within a cluster, so the cache hit rate barely moves.
+template <typename Index>
+void optimizeOverdraw(Index * indices, size_t indexCount, const std::vector<glm::vec3> & vertices, const std::vector<size_t> & clusters) {
+	size_t triangleCount = indexCount / 3;
+	if (clusters.size() < 2) return;
+
+	glm::vec3 centre(0.0f);
+	float area = 0.0f;
+	std::vector<glm::vec3> clusterCentre(clusters.size(), glm::vec3(0.0f)), clusterNormal(clusters.size(), glm::vec3(0.0f));
+	std::vector<float> clusterArea(clusters.size(), 0.0f);
+	for (size_t c = 0; c < clusters.size(); c++) {
+		size_t end = c + 1 < clusters.size() ? clusters[c + 1] : triangleCount;
+		for (size_t t = clusters[c]; t < end; t++) {
+			const glm::vec3 & a = vertices[indices[t * 3 + 0]];
+			const glm::vec3 & b = vertices[indices[t * 3 + 1]];
+			const glm::vec3 & d = vertices[indices[t * 3 + 2]];
+			glm::vec3 n = glm::cross(b - a, d - a);
+			float w = glm::length(n);
+			clusterCentre[c] += (a + b + d) * (w / 3.0f);
+			clusterNormal[c] += n;
+			clusterArea[c] += w;
+		}
+		centre += clusterCentre[c];
+		area += clusterArea[c];
+	}
+	if (area > 0.0f) centre /= area;
+
+	std::vector<std::pair<float, size_t> > order(clusters.size());
+	for (size_t c = 0; c < clusters.size(); c++) {
+		float key = 0.0f;
+		float length = glm::length(clusterNormal[c]);
+		if (clusterArea[c] > 0.0f && length > 0.0f)
+			key = glm::dot(clusterCentre[c] / clusterArea[c] - centre, clusterNormal[c] / length);
+		order[c] = std::make_pair(-key, c);
+	}
+	std::stable_sort(order.begin(), order.end());
+
+	std::vector<Index> result;
+	result.reserve(indexCount);
+	for (size_t k = 0; k < order.size(); k++) {
+		size_t c = order[k].second;
+		size_t end = c + 1 < clusters.size() ? clusters[c + 1] : triangleCount;
+		result.insert(result.end(), indices + clusters[c] * 3, indices + end * 3);
+	}
+	std::copy(result.begin(), result.end(), indices);
+}
+
+// Renumbers the vertices in the order the triangles first use them, so
+// that the vertex fetch walks the buffers forwards. Vertices no triangle
+// uses are dropped.
+template <typename Index>
+void optimizeVertexFetch(Index * indices, size_t indexCount, std::vector<glm::vec3> & vertices, std::vector<glm::vec2> & uvs, std::vector<glm::vec3> & normals) {
+	const uint32_t unused = 0xFFFFFFFFu;
+	std::vector<uint32_t> remap(vertices.size(), unused);
+	std::vector<glm::vec3> newVertices, newNormals;
+	std::vector<glm::vec2> newUvs;
+	newVertices.reserve(vertices.size());
+	newUvs.reserve(uvs.size());
+	newNormals.reserve(normals.size());
+	for (size_t i = 0; i < indexCount; i++) {
+		Index v = indices[i];
+		if (remap[v] == unused) {
+			remap[v] = (uint32_t)newVertices.size();
+			newVertices.push_back(vertices[v]);
+			if (!uvs.empty()) newUvs.push_back(uvs[v]);
+			if (!normals.empty()) newNormals.push_back(normals[v]);
+		}
+		indices[i] = (Index)remap[v];
+	}
+	vertices.swap(newVertices);
+	uvs.swap(newUvs);
+	normals.swap(newNormals);
+}
+
+// All three, in the order they have to run.
+template <typename Index>
+void optimizeMesh(std::vector<Index> & indices, std::vector<glm::vec3> & vertices, std::vector<glm::vec2> & uvs, std::vector<glm::vec3> & normals, unsigned int cacheSize = VERTEX_CACHE_SIZE) {
+	if (indices.empty()) return;
+	std::vector<size_t> clusters;
+	optimizeVertexCache(&indices[0], indices.size(), vertices.size(), cacheSize, &clusters);
+	optimizeOverdraw(&indices[0], indices.size(), vertices, clusters);
+	optimizeVertexFetch(&indices[0], indices.size(), vertices, uvs, normals);
+}
+
+#endif
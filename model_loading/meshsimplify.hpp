@@ -0,0 +1,246 @@
+#ifndef MESHSIMPLIFY_HPP
+#define MESHSIMPLIFY_HPP
+
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <vector>
+#include <algorithm>
+
+// Include GLM
+#include <glm/glm.hpp>
+
+#include "vboindexer.hpp"
+#include "meshoptimize.hpp"
+
+// Levels of detail of an indexed mesh by quadric edge collapse (Garland and
+// Heckbert, "Surface Simplification Using Quadric Error Metrics", 1997).
+//
+// Edges are collapsed onto one of their two vertices, never onto a new
+// point, so every level is only a new index buffer over the vertices of the
+// full mesh : the levels share one vertex buffer and live one after the
+// other in one element buffer. Vertices on a border or on a seam (a
+// position split by indexOBJ because its uvs or normals differ) never move,
+// so the levels have no cracks.
+
+#define MESH_LOD_MAX 8
+
+struct MeshLOD {
+	unsigned int firstIndex;
+	unsigned int indexCount;
+	// How far, in model units, the surface may be from the full mesh.
+	float error;
+};
+
+// Sum of squared distances to a set of planes, weighted by the area of the
+// triangles they come from. Kept in double : the terms cancel a lot.
+struct Quadric {
+	double a00, a01, a02, a11, a12, a22; // A = sum w n n^T
+	double b0, b1, b2;                   // b = sum w d n
+	double c;                            // sum w d^2
+	double w;                            // sum w
+};
+
+inline void quadricAdd(Quadric & q, const Quadric & r) {
+	q.a00 += r.a00; q.a01 += r.a01; q.a02 += r.a02;
+	q.a11 += r.a11; q.a12 += r.a12; q.a22 += r.a22;
+	q.b0 += r.b0; q.b1 += r.b1; q.b2 += r.b2;
+	q.c += r.c;
+	q.w += r.w;
+}
+
+// Weighted sum of squared distances from `p` to the planes of `q`.
+inline double quadricEvaluate(const Quadric & q, const glm::vec3 & p) {
+	double x = p.x, y = p.y, z = p.z;
+	return q.a00 * x * x + q.a11 * y * y + q.a22 * z * z
+		+ 2.0 * (q.a01 * x * y + q.a02 * x * z + q.a12 * y * z)
+		+ 2.0 * (q.b0 * x + q.b1 * y + q.b2 * z) + q.c;
+}
+
+// Mean squared distance from `p` to the planes of `q` and `r` together.
+inline float quadricError(const Quadric & q, const Quadric & r, const glm::vec3 & p) {
+	double w = q.w + r.w;
+	if (w <= 0.0) return 0.0f;
+	double e = quadricEvaluate(q, p) + quadricEvaluate(r, p);
+	return e > 0.0 ? (float)(e / w) : 0.0f;
+}
+
+struct SimplifyCollapse {
+	float cost;
+	unsigned int from, to;
+	bool operator<(const SimplifyCollapse & other) const { return cost < other.cost; }
+};
+
+// Removes collapses from `indices` until there are no more than
+// `targetIndexCount` left, or no edge can go without flipping a triangle or
+// moving a locked vertex. `canonical` maps each vertex to the first one at
+// its position, `quadrics` and `locked` are per canonical vertex and are
+// updated ; the largest error of a collapse goes in `error`, squared.
+template <typename Index>
+void simplifyLevel(std::vector<Index> & indices, size_t targetIndexCount, const glm::vec3 * vertices, size_t vertexCount,
+	const std::vector<unsigned int> & canonical, const std::vector<char> & locked, std::vector<Quadric> & quadrics, float & error) {
+	VertexTriangles adjacency;
+	std::vector<SimplifyCollapse> candidates;
+	std::vector<char> touched(vertexCount);
+	std::vector<unsigned int> collapseTo(vertexCount);
+
+	while (indices.size() > targetIndexCount) {
+		size_t triangleCount = indices.size() / 3;
+		buildVertexTriangles(&indices[0], indices.size(), vertexCount, adjacency);
+
+		// Both ways along every edge. An edge inside the mesh is in two
+		// triangles, once each way : take it from the one where it goes up.
+		candidates.clear();
+		for (size_t t = 0; t < triangleCount; t++) {
+			for (int k = 0; k < 3; k++) {
+				unsigned int a = indices[t * 3 + k], b = indices[t * 3 + (k + 1) % 3];
+				unsigned int ca = canonical[a], cb = canonical[b];
+				if (ca >= cb || (locked[ca] && locked[cb])) continue;
+				if (!locked[ca]) {
+					SimplifyCollapse collapse = { quadricError(quadrics[ca], quadrics[cb], vertices[b]), a, b };
+					candidates.push_back(collapse);
+				}
+				if (!locked[cb]) {
+					SimplifyCollapse collapse = { quadricError(quadrics[ca], quadrics[cb], vertices[a]), b, a };
+					candidates.push_back(collapse);
+				}
+			}
+		}
+
+		// Cheapest first, at most one collapse around each vertex per pass
+		// so that the flip test below sees the final neighbourhood. Each
+		// collapse inside the mesh removes two triangles ; only the few
+		// times that many cheapest candidates are sorted, the next pass sees
+		// the rest again.
+		size_t needed = (triangleCount - targetIndexCount / 3) / 2 + 1, collapsed = 0;
+		size_t considered = std::min(candidates.size(), needed * 4);
+		std::nth_element(candidates.begin(), candidates.begin() + considered - (considered > 0), candidates.end());
+		std::sort(candidates.begin(), candidates.begin() + considered);
+		std::fill(touched.begin(), touched.end(), 0);
+		for (size_t v = 0; v < vertexCount; v++) collapseTo[v] = (unsigned int)v;
+		for (size_t i = 0; i < considered && collapsed < needed; i++) {
+			unsigned int a = candidates[i].from, b = candidates[i].to;
+			if (touched[canonical[a]] || touched[canonical[b]]) continue;
+
+			// Moving `a` onto `b` must not turn any triangle around `a` over.
+			bool flips = false;
+			for (unsigned int k = adjacency.offsets[a]; k < adjacency.offsets[a + 1] && !flips; k++) {
+				const Index * t = &indices[adjacency.triangles[k] * 3];
+				if (canonical[t[0]] == canonical[b] || canonical[t[1]] == canonical[b] || canonical[t[2]] == canonical[b]) continue;
+				glm::vec3 p[3] = { vertices[t[0]], vertices[t[1]], vertices[t[2]] };
+				glm::vec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+				for (int j = 0; j < 3; j++) if (t[j] == a) p[j] = vertices[b];
+				glm::vec3 after = glm::cross(p[1] - p[0], p[2] - p[0]);
+				flips = glm::dot(before, after) <= 0.0f;
+			}
+			if (flips) continue;
+
+			collapseTo[a] = b;
+			quadricAdd(quadrics[canonical[b]], quadrics[canonical[a]]);
+			error = fmaxf(error, candidates[i].cost);
+			collapsed++;
+			for (unsigned int k = adjacency.offsets[a]; k < adjacency.offsets[a + 1]; k++) {
+				const Index * t = &indices[adjacency.triangles[k] * 3];
+				for (int j = 0; j < 3; j++) touched[canonical[t[j]]] = 1;
+			}
+		}
+		if (collapsed == 0) break;
+
+		size_t out = 0;
+		for (size_t t = 0; t < triangleCount; t++) {
+			Index v0 = (Index)collapseTo[indices[t * 3 + 0]];
+			Index v1 = (Index)collapseTo[indices[t * 3 + 1]];
+			Index v2 = (Index)collapseTo[indices[t * 3 + 2]];
+			if (canonical[v0] == canonical[v1] || canonical[v1] == canonical[v2] || canonical[v2] == canonical[v0]) continue;
+			indices[out++] = v0;
+			indices[out++] = v1;
+			indices[out++] = v2;
+		}
+		indices.resize(out);
+	}
+}
+
+// Appends to `indices` (the full mesh, ordered as optimizeMesh leaves it)
+// up to MESH_LOD_MAX - 1 coarser levels, each with about `ratio` times the
+// triangles of the one before, stopping under `minTriangles` triangles or
+// when the mesh can't be simplified further. `lods` receives every level,
+// the full mesh first. Each level is reordered for the vertex cache.
+template <typename Index>
+void buildLODChain(std::vector<Index> & indices, const glm::vec3 * vertices, size_t vertexCount, std::vector<MeshLOD> & lods,
+	float ratio = 0.5f, size_t minTriangles = 256) {
+	MeshLOD full = { 0, (unsigned int)indices.size(), 0.0f };
+	lods.assign(1, full);
+	if (indices.size() / 3 * ratio < minTriangles) return;
+
+	// Vertices at the same position are one as far as the surface goes.
+	std::vector<unsigned int> canonical(vertexCount);
+	std::vector<char> locked(vertexCount, 0);
+	VertexTupleMap positions(vertexCount);
+	for (size_t v = 0; v < vertexCount; v++) {
+		uint32_t bits[3];
+		memcpy(bits, &vertices[v], sizeof bits);
+		canonical[v] = positions.findOrInsert(bits[0], bits[1], bits[2], (uint32_t)v);
+		if (canonical[v] != v) locked[canonical[v]] = 1; // seam
+	}
+
+	// Borders : edges no triangle crosses the other way.
+	std::vector<uint64_t> edges;
+	edges.reserve(indices.size());
+	for (size_t i = 0; i < indices.size(); i += 3)
+		for (int k = 0; k < 3; k++)
+			edges.push_back((uint64_t)canonical[indices[i + k]] << 32 | canonical[indices[i + (k + 1) % 3]]);
+	std::sort(edges.begin(), edges.end());
+	for (size_t e = 0; e < edges.size(); e++) {
+		uint32_t a = (uint32_t)(edges[e] >> 32), b = (uint32_t)edges[e];
+		if (!std::binary_search(edges.begin(), edges.end(), (uint64_t)b << 32 | a)) locked[a] = locked[b] = 1;
+	}
+	std::vector<uint64_t>().swap(edges);
+
+	// The plane of every triangle, on its three corners.
+	Quadric zero;
+	memset(&zero, 0, sizeof zero);
+	std::vector<Quadric> quadrics(vertexCount, zero);
+	for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+		const glm::vec3 & p0 = vertices[indices[i]];
+		glm::vec3 n = glm::cross(vertices[indices[i + 1]] - p0, vertices[indices[i + 2]] - p0);
+		float area = glm::length(n);
+		if (area == 0.0f) continue;
+		n /= area;
+		double d = -glm::dot(n, p0), w = area * 0.5;
+		Quadric q = { w * n.x * n.x, w * n.x * n.y, w * n.x * n.z, w * n.y * n.y, w * n.y * n.z, w * n.z * n.z,
+			w * d * n.x, w * d * n.y, w * d * n.z, w * d * d, w };
+		for (int k = 0; k < 3; k++) quadricAdd(quadrics[canonical[indices[i + k]]], q);
+	}
+
+	std::vector<Index> level(indices.begin(), indices.end());
+	float error = 0.0f;
+	while (lods.size() < MESH_LOD_MAX) {
+		size_t before = level.size();
+		size_t target = (size_t)(before / 3 * ratio) * 3;
+		if (target / 3 < minTriangles) break;
+		simplifyLevel(level, target, vertices, vertexCount, canonical, locked, quadrics, error);
+		// Not worth a level if it barely got smaller.
+		if (level.size() > before - (before - target) / 2) break;
+
+		MeshLOD lod = { (unsigned int)indices.size(), (unsigned int)level.size(), sqrtf(error) };
+		std::vector<Index> ordered(level);
+		optimizeVertexCache(&ordered[0], ordered.size(), vertexCount);
+		indices.insert(indices.end(), ordered.begin(), ordered.end());
+		lods.push_back(lod);
+	}
+}
+
+// The coarsest level whose error, seen from `distance` away with
+// `projection` in a viewport `viewportHeight` pixels high, stays under
+// `maxPixels` pixels.
+inline size_t selectLOD(const MeshLOD * lods, size_t lodCount, const glm::mat4 & projection, float distance, float viewportHeight, float maxPixels = 1.0f) {
+	// projection[1][1] is cot(fov / 2) : one model unit at distance 1
+	// covers projection[1][1] * viewportHeight / 2 pixels.
+	float pixelsPerUnit = projection[1][1] * viewportHeight * 0.5f / fmaxf(distance, 1e-3f);
+	size_t selected = 0;
+	for (size_t i = 1; i < lodCount; i++)
+		if (lods[i].error * pixelsPerUnit <= maxPixels) selected = i;
+	return selected;
+}
+
+#endif
@@ -14,6 +14,10 @@ GLFWwindow* window;
 #include <glm/gtc/matrix_transform.hpp>
 using namespace glm;
 #include "common.hpp"
+#include "texturecache.hpp"
+#include "objloader.hpp"
+#include "vboindexer.hpp"
+#include "meshcache.hpp"
 #include "controls.hpp"
 
 
@@ -76,29 +80,47 @@ int main( void )
 	// Load the texture using any two methods
 	//GLuint Texture = loadBMP_custom("uvtemplate.bmp");
 	//GLuint Texture = loadBMP("uvtemplate.bmp");
-	GLuint Texture = loadDDS("uvtemplate.DDS");
-	glBindTexture(GL_TEXTURE_2D, Texture);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	// ... through the cache, which loads each image once however many ask.
+	TextureCache textures;
+	GLuint Texture = textures.acquire("uvtemplate.DDS");
+	// Nearest filtering, on a sampler of our own : the texture is the
+	// cache's, shared with whoever else asks for the same image.
+	GLuint Sampler;
+	glGenSamplers(1, &Sampler);
+	glSamplerParameteri(Sampler, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glSamplerParameteri(Sampler, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 	
 	// Get a handle for our "myTextureSampler" uniform
 	GLuint TextureID  = glGetUniformLocation(programID, "myTextureSampler");
 
-	// Read our .obj file
-	std::vector<glm::vec3> vertices;
-	std::vector<glm::vec2> uvs;
-	std::vector<glm::vec3> normals; // Won't be used at the moment.
-	bool res = loadOBJ("cube.obj", vertices, uvs, normals);
+	// Read our .obj file. The first run writes cube.obj.mesh ; later runs
+	// just map it. Normals won't be used at the moment.
+	CachedMesh mesh;
+	bool res = loadOBJCached("cube.obj", mesh);
+	if (!res) {
+		glfwTerminate();
+		return -1;
+	}
+	GLsizei indexCount = mesh.lods[0].indexCount; // the full mesh, not its coarser levels
+	GLenum indexType = mesh.indexSize == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
 
 	GLuint vertexbuffer;
 	glGenBuffers(1, &vertexbuffer);
 	glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer);
-	glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(glm::vec3), &vertices[0], GL_STATIC_DRAW);
+	glBufferData(GL_ARRAY_BUFFER, mesh.vertexCount * sizeof(glm::vec3), mesh.vertices, GL_STATIC_DRAW);
 
 	GLuint uvbuffer;
 	glGenBuffers(1, &uvbuffer);
 	glBindBuffer(GL_ARRAY_BUFFER, uvbuffer);
-	glBufferData(GL_ARRAY_BUFFER, uvs.size() * sizeof(glm::vec2), &uvs[0], GL_STATIC_DRAW);
+	glBufferData(GL_ARRAY_BUFFER, mesh.vertexCount * sizeof(glm::vec2), mesh.uvs, GL_STATIC_DRAW);
+
+	GLuint elementbuffer;
+	glGenBuffers(1, &elementbuffer);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementbuffer);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, mesh.indexCount * mesh.indexSize, mesh.indices, GL_STATIC_DRAW);
+
+	// OpenGL has its own copy now
+	closeMeshCache(mesh);
 
   glEnable(GL_CULL_FACE);
 
@@ -123,6 +145,7 @@ int main( void )
 		// Bind our texture in Texture Unit 0
 		glActiveTexture(GL_TEXTURE0);
 		glBindTexture(GL_TEXTURE_2D, Texture);
+		glBindSampler(0, Sampler);
 		// Set our "myTextureSampler" sampler to user Texture Unit 0
 		glUniform1i(TextureID, 0);
 
@@ -150,8 +173,9 @@ int main( void )
 			(void*)0                          // array buffer offset
 		);
 
-		// Draw the triangle !
-		glDrawArrays(GL_TRIANGLES, 0, vertices.size());
+		// Draw the triangles !
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementbuffer);
+		glDrawElements(GL_TRIANGLES, indexCount, indexType, (void*)0);
 
 		glDisableVertexAttribArray(0);
 		glDisableVertexAttribArray(1);
@@ -167,8 +191,12 @@ int main( void )
 	// Cleanup VBO and shader
 	glDeleteBuffers(1, &vertexbuffer);
 	glDeleteBuffers(1, &uvbuffer);
+	glDeleteBuffers(1, &elementbuffer);
 	glDeleteProgram(programID);
-	glDeleteTextures(1, &TextureID);
+	textures.release(Texture);
+	glDeleteSamplers(1, &Sampler);
+	textures.printStats();
+	textures.clear();
 	glDeleteVertexArrays(1, &VertexArrayID);
 
 	// Close OpenGL window and terminate GLFW
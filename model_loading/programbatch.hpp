@@ -0,0 +1,286 @@
+#ifndef PROGRAMBATCH_HPP
+#define PROGRAMBATCH_HPP
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+
+#include <GL/glew.h>
+
+#include "programcache.hpp"
+#include "shaderpreprocess.hpp"
+
+// Programs compiled and linked together, without waiting on any of them.
+//
+// add() reads the two files and hands both shaders and the link to the
+// driver straight away, asking for nothing back ; the status and logs of
+// all of them are looked at only later, by poll() or finish(). With
+// GL_KHR_parallel_shader_compile (or its ARB twin) the driver compiles on
+// threads of its own, poll() asks GL_COMPLETION_STATUS_KHR, which never
+// blocks, and the render loop can go on drawing with a fallback program
+// (program() gives it until the real one is ready). Without it the driver
+// still gets every program before the first status query, which is when
+// most of them wait for the compiler ; poll() then completes everything it
+// is asked about.
+//
+// Shader files go through the preprocessor (shaderpreprocess.hpp), for
+// #include and defines, and programs through the program cache
+// (programcache.hpp) : one linked before by this driver is ready as soon as
+// it is added.
+
+// Prints the info log of a shader or program, if there is one, and which
+// file each source string number of a shader stands for, if it included
+// any.
+void printShaderLog(GLuint object, bool program, const std::vector<std::string> & files = std::vector<std::string>()) {
+	GLint length = 0;
+	if (program) glGetProgramiv(object, GL_INFO_LOG_LENGTH, &length);
+	else glGetShaderiv(object, GL_INFO_LOG_LENGTH, &length);
+	if (length <= 0) return;
+	std::vector<char> log(length + 1);
+	if (program) glGetProgramInfoLog(object, length, NULL, &log[0]);
+	else glGetShaderInfoLog(object, length, NULL, &log[0]);
+	printf("%s\n", &log[0]);
+	if (files.size() > 1)
+		for (size_t i = 0; i < files.size(); i++) printf("%lu : %s\n", (unsigned long)i, files[i].c_str());
+}
+
+enum ProgramState {
+	PROGRAM_PENDING,
+	PROGRAM_READY,
+	PROGRAM_FAILED
+};
+
+class ProgramBatch {
+public:
+	ProgramBatch() : parallel(false), cacheable(programBinarySupported()) {
+		// Every thread the driver cares to use.
+		if (GLEW_KHR_parallel_shader_compile) {
+			glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+			parallel = true;
+		} else if (GLEW_ARB_parallel_shader_compile) {
+			glMaxShaderCompilerThreadsARB(0xFFFFFFFF);
+			parallel = true;
+		}
+	}
+
+	// Completes whatever is left, so that no shader object outlives it.
+	~ProgramBatch() { finish(); }
+
+	// Submits the program of two shader files, with `defines` after their
+	// #version line ; `fallback` is what program() gives until it is
+	// ready, or if it fails. Returns its index in the batch.
+	size_t add(const char * vertex_file_path, const char * fragment_file_path, const char * defines = NULL, GLuint fallback = 0) {
+		Entry e;
+		e.vertexShader = e.fragmentShader = e.program = 0;
+		e.fallback = fallback;
+		e.key = 0;
+		e.state = PROGRAM_FAILED;
+		entries.push_back(e);
+		Entry & entry = entries.back();
+
+		ShaderSource vertexSource, fragmentSource;
+		if (!preprocessShader(vertex_file_path, defines, vertexSource) || !preprocessShader(fragment_file_path, defines, fragmentSource))
+			return entries.size() - 1;
+		entry.vertexFiles = vertexSource.files;
+		entry.fragmentFiles = fragmentSource.files;
+		if (cacheable) {
+			const char * sources[2] = { vertexSource.code.c_str(), fragmentSource.code.c_str() };
+			entry.key = programCacheKey(sources, 2, defines);
+			entry.program = loadProgramBinary(entry.key);
+			if (entry.program) {
+				printf("Loading program from cache : %s, %s\n", vertex_file_path, fragment_file_path);
+				entry.state = PROGRAM_READY;
+				return entries.size() - 1;
+			}
+		}
+
+		printf("Compiling shader : %s\n", vertex_file_path);
+		entry.vertexShader = compile(GL_VERTEX_SHADER, vertexSource.code);
+		printf("Compiling shader : %s\n", fragment_file_path);
+		entry.fragmentShader = compile(GL_FRAGMENT_SHADER, fragmentSource.code);
+		printf("Linking program\n");
+		entry.program = glCreateProgram();
+		glAttachShader(entry.program, entry.vertexShader);
+		glAttachShader(entry.program, entry.fragmentShader);
+		if (cacheable) glProgramParameteri(entry.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+		glLinkProgram(entry.program);
+		entry.state = PROGRAM_PENDING;
+		return entries.size() - 1;
+	}
+
+	// Completes every program the driver is done with, without blocking
+	// when it compiles in parallel. Returns how many are still pending.
+	size_t poll() {
+		size_t pending = 0;
+		for (size_t i = 0; i < entries.size(); i++) {
+			if (entries[i].state != PROGRAM_PENDING) continue;
+			if (parallel) {
+				GLint done = GL_FALSE;
+				glGetProgramiv(entries[i].program, GL_COMPLETION_STATUS_KHR, &done);
+				if (!done) {
+					pending++;
+					continue;
+				}
+			}
+			complete(entries[i]);
+		}
+		return pending;
+	}
+
+	// Waits for every program.
+	void finish() {
+		for (size_t i = 0; i < entries.size(); i++)
+			if (entries[i].state == PROGRAM_PENDING) complete(entries[i]);
+	}
+
+	ProgramState state(size_t i) const { return entries[i].state; }
+
+	// What to draw with : the program once it is ready, its fallback before
+	// that or if it failed.
+	GLuint program(size_t i) const { return entries[i].state == PROGRAM_READY ? entries[i].program : entries[i].fallback; }
+
+	// The files program i was made from, includes too ; empty if they
+	// couldn't be read.
+	std::vector<std::string> files(size_t i) const {
+		std::vector<std::string> all(entries[i].vertexFiles);
+		all.insert(all.end(), entries[i].fragmentFiles.begin(), entries[i].fragmentFiles.end());
+		return all;
+	}
+
+	size_t size() const { return entries.size(); }
+	bool parallelCompile() const { return parallel; }
+
+private:
+	struct Entry {
+		GLuint vertexShader, fragmentShader, program, fallback;
+		uint64_t key;
+		ProgramState state;
+		std::vector<std::string> vertexFiles, fragmentFiles;
+	};
+
+	static GLuint compile(GLenum type, const std::string & code) {
+		GLuint shader = glCreateShader(type);
+		const char * source = code.c_str();
+		glShaderSource(shader, 1, &source, NULL);
+		glCompileShader(shader);
+		return shader;
+	}
+
+	// Status and logs, now that they are there ; the shaders go, and the
+	// binary goes to the cache.
+	void complete(Entry & entry) {
+		printShaderLog(entry.vertexShader, false, entry.vertexFiles);
+		printShaderLog(entry.fragmentShader, false, entry.fragmentFiles);
+		GLint linked = GL_FALSE;
+		glGetProgramiv(entry.program, GL_LINK_STATUS, &linked);
+		printShaderLog(entry.program, true);
+		glDetachShader(entry.program, entry.vertexShader);
+		glDetachShader(entry.program, entry.fragmentShader);
+		glDeleteShader(entry.vertexShader);
+		glDeleteShader(entry.fragmentShader);
+		entry.vertexShader = entry.fragmentShader = 0;
+		if (linked) {
+			if (cacheable) saveProgramBinary(entry.program, entry.key);
+			entry.state = PROGRAM_READY;
+		} else {
+			glDeleteProgram(entry.program);
+			entry.program = 0;
+			entry.state = PROGRAM_FAILED;
+		}
+	}
+
+	bool parallel, cacheable;
+	std::vector<Entry> entries;
+};
+
+// Programs kept per permutation : a pair of shader files and the defines
+// they are compiled with.
+//
+// get() builds the program of a permutation the first time it is asked
+// for, and gives the same one after that, while none of its files has
+// changed. The key is the preprocessed text of both shaders, so a
+// permutation whose text is that of another one, from a copy of the same
+// files or the same includes, is given the program already there : a
+// compile avoided. A permutation that fails isn't tried again until its
+// files change. Programs belong to it, and go with clear() ; the program of
+// an older text stays until then, for when an edit is undone.
+struct ProgramPermutationStats {
+	unsigned long requests;
+	unsigned long built;       // compiled, or loaded from the program cache
+	unsigned long reused;      // same permutation, files unchanged
+	unsigned long contentHits; // another permutation, same text
+	unsigned long failures;
+};
+
+class ProgramPermutations {
+public:
+	ProgramPermutations() { memset(&counters, 0, sizeof counters); }
+	~ProgramPermutations() { clear(); }
+
+	// The program of two shader files with `defines` (NULL for none) ; 0 if
+	// it doesn't compile.
+	GLuint get(const char * vertex_file_path, const char * fragment_file_path, const char * defines = NULL) {
+		counters.requests++;
+		ShaderSource vertexSource, fragmentSource;
+		if (!preprocessShader(vertex_file_path, defines, vertexSource) || !preprocessShader(fragment_file_path, defines, fragmentSource)) {
+			counters.failures++;
+			return 0;
+		}
+		uint64_t key = programHashString(fragmentSource.code.c_str(), programHashString(vertexSource.code.c_str(), 0xcbf29ce484222325ULL));
+		std::string name = std::string(vertex_file_path) + '\0' + fragment_file_path + '\0' + (defines ? defines : "");
+		std::map<std::string, uint64_t>::iterator n = names.find(name);
+		if (failed.count(key)) {
+			counters.failures++;
+			names[name] = key;
+			return 0;
+		}
+		std::map<uint64_t, GLuint>::iterator p = programs.find(key);
+		if (p != programs.end()) {
+			if (n != names.end() && n->second == key) counters.reused++;
+			else counters.contentHits++;
+			names[name] = key;
+			return p->second;
+		}
+
+		ProgramBatch batch;
+		batch.add(vertex_file_path, fragment_file_path, defines);
+		batch.finish();
+		GLuint program = batch.program(0);
+		if (program) {
+			counters.built++;
+			programs[key] = program;
+		} else {
+			counters.failures++;
+			failed.insert(key);
+		}
+		names[name] = key;
+		return program;
+	}
+
+	void clear() {
+		for (std::map<uint64_t, GLuint>::iterator p = programs.begin(); p != programs.end(); ++p) glDeleteProgram(p->second);
+		programs.clear();
+		failed.clear();
+		names.clear();
+	}
+
+	size_t size() const { return programs.size(); }
+	const ProgramPermutationStats & stats() const { return counters; }
+
+	void printStats() const {
+		printf("Program permutations : %lu asked for, %lu built, %lu the same as before, %lu the same text as another, %lu failed\n",
+			counters.requests, counters.built, counters.reused, counters.contentHits, counters.failures);
+	}
+
+private:
+	std::map<uint64_t, GLuint> programs;    // by the text of both shaders
+	std::set<uint64_t> failed;              // texts that didn't compile
+	std::map<std::string, uint64_t> names;  // the key each permutation had last
+	ProgramPermutationStats counters;
+};
+
+#endif
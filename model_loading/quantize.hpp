@@ -0,0 +1,357 @@
+#ifndef QUANTIZE_HPP
+#define QUANTIZE_HPP
+
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define QUANTIZE_HAVE_SSE2
+#endif
+
+// Include GLM
+#include <glm/glm.hpp>
+
+// A compressed vertex, 16 bytes instead of the 32 of three float arrays :
+// - the position as three unsigned 16-bit integers spanning the bounding
+//   box of the mesh (glVertexAttribPointer(..., 3, GL_UNSIGNED_SHORT,
+//   GL_FALSE, ...), so the shader gets the integer steps, and
+//   PositionOffset + value * PositionScale in the shader),
+// - the uv as two half floats (GL_HALF_FLOAT, nothing to decode),
+// - the normal folded onto an octahedron and stored as two signed 16-bit
+//   integers (GL_SHORT, normalized, unfolded in the shader).
+struct QuantizedVertex {
+	uint16_t position[4]; // x, y, z, unused
+	uint16_t uv[2];
+	int16_t normal[2];
+};
+
+struct QuantizedMesh {
+	std::vector<QuantizedVertex> vertices;
+	glm::vec3 offset; // position = offset + position[] * scale
+	glm::vec3 scale;
+};
+
+// The largest difference between a mesh and its quantized version, next to
+// what the format promises.
+struct QuantizationError {
+	float position;      // in model units
+	float positionBound; // half a step of the coarsest axis, plus float rounding
+	float uv;
+	float uvBound;       // half an ulp of a half float at the largest |uv|
+	float normalDegrees;
+};
+
+// float <-> half, rounding to nearest. Halves too small to be normal are
+// flushed to zero and values too big become infinity : a uv is neither.
+inline uint16_t floatToHalf(float value) {
+	uint32_t bits;
+	memcpy(&bits, &value, 4);
+	uint32_t sign = (bits >> 16) & 0x8000;
+	uint32_t magnitude = bits & 0x7FFFFFFF;
+	if (magnitude > 0x7F800000) return (uint16_t)(sign | 0x7E00);  // NaN
+	if (magnitude >= 0x477FF000) return (uint16_t)(sign | 0x7C00); // rounds past the largest half
+	if (magnitude < 0x38800000) return (uint16_t)sign;             // below the smallest normal half
+	return (uint16_t)(sign | ((magnitude - 0x38000000 + 0x1000) >> 13));
+}
+
+inline float halfToFloat(uint16_t half) {
+	uint32_t sign = (uint32_t)(half & 0x8000) << 16;
+	uint32_t exponent = half & 0x7C00;
+	uint32_t bits = sign;
+	if (exponent == 0x7C00)  bits |= 0x7F800000 | ((uint32_t)(half & 0x03FF) << 13);
+	else if (exponent != 0) bits |= ((uint32_t)(half & 0x7FFF) << 13) + 0x38000000;
+	float value;
+	memcpy(&value, &bits, 4);
+	return value;
+}
+
+inline int16_t quantizeSnorm16(float value) {
+	value = value < -1.0f ? -1.0f : value > 1.0f ? 1.0f : value;
+	return (int16_t)lrintf(value * 32767.0f);
+}
+
+// Octahedral mapping (Meyer et al., "On Floating-Point Normal Vectors",
+// 2010) : the unit sphere is projected on the octahedron |x|+|y|+|z| = 1,
+// whose lower half is folded over the upper one onto the square [-1,1]^2.
+inline glm::vec2 octEncode(const glm::vec3 & n) {
+	float l1 = fabsf(n.x) + fabsf(n.y) + fabsf(n.z);
+	if (l1 == 0.0f) return glm::vec2(0.0f, 0.0f);
+	float x = n.x / l1, y = n.y / l1;
+	if (n.z < 0.0f) {
+		float fx = copysignf(1.0f - fabsf(y), x);
+		float fy = copysignf(1.0f - fabsf(x), y);
+		x = fx;
+		y = fy;
+	}
+	return glm::vec2(x, y);
+}
+
+inline glm::vec3 octDecode(float x, float y) {
+	glm::vec3 n(x, y, 1.0f - fabsf(x) - fabsf(y));
+	float t = n.z < 0.0f ? -n.z : 0.0f;
+	n.x += n.x >= 0.0f ? -t : t;
+	n.y += n.y >= 0.0f ? -t : t;
+	return glm::normalize(n);
+}
+
+// Bounds of the positions, and the offset and scale that map them to
+// [0, 65535].
+inline void quantizationRange(const glm::vec3 * positions, size_t count, glm::vec3 & offset, glm::vec3 & scale) {
+	glm::vec3 lo(0.0f), hi(0.0f);
+	if (count) lo = hi = positions[0];
+	for (size_t i = 1; i < count; i++) {
+		lo = glm::min(lo, positions[i]);
+		hi = glm::max(hi, positions[i]);
+	}
+	offset = lo;
+	scale = (hi - lo) / 65535.0f;
+}
+
+inline float quantizationInverse(float scale) {
+	return scale > 0.0f ? 1.0f / scale : 0.0f;
+}
+
+// One vertex at a time. Gives the same bits as the SIMD version.
+void quantizeVerticesScalar(const glm::vec3 * positions, const glm::vec2 * uvs, const glm::vec3 * normals, size_t count, QuantizedMesh & mesh, size_t first = 0) {
+	glm::vec3 inverse(quantizationInverse(mesh.scale.x), quantizationInverse(mesh.scale.y), quantizationInverse(mesh.scale.z));
+	for (size_t i = first; i < count; i++) {
+		QuantizedVertex & q = mesh.vertices[i];
+		for (int k = 0; k < 3; k++) {
+			float value = (positions[i][k] - mesh.offset[k]) * inverse[k];
+			value = value < 0.0f ? 0.0f : value > 65535.0f ? 65535.0f : value;
+			q.position[k] = (uint16_t)lrintf(value);
+		}
+		q.position[3] = 0;
+		q.uv[0] = floatToHalf(uvs[i].x);
+		q.uv[1] = floatToHalf(uvs[i].y);
+		glm::vec2 oct = octEncode(normals[i]);
+		q.normal[0] = quantizeSnorm16(oct.x);
+		q.normal[1] = quantizeSnorm16(oct.y);
+	}
+}
+
+void dequantizeVerticesScalar(const QuantizedMesh & mesh, glm::vec3 * positions, glm::vec2 * uvs, glm::vec3 * normals, size_t first = 0) {
+	for (size_t i = first; i < mesh.vertices.size(); i++) {
+		const QuantizedVertex & q = mesh.vertices[i];
+		positions[i] = mesh.offset + glm::vec3(q.position[0], q.position[1], q.position[2]) * mesh.scale;
+		uvs[i] = glm::vec2(halfToFloat(q.uv[0]), halfToFloat(q.uv[1]));
+		normals[i] = octDecode(q.normal[0] / 32767.0f, q.normal[1] / 32767.0f);
+	}
+}
+
+#ifdef QUANTIZE_HAVE_SSE2
+// floatToHalf on four lanes.
+inline __m128i floatToHalf4(__m128 value) {
+	__m128i bits = _mm_castps_si128(value);
+	__m128i sign = _mm_and_si128(_mm_srli_epi32(bits, 16), _mm_set1_epi32(0x8000));
+	__m128i magnitude = _mm_and_si128(bits, _mm_set1_epi32(0x7FFFFFFF));
+	__m128i normal = _mm_srli_epi32(_mm_add_epi32(magnitude, _mm_set1_epi32(0x1000 - 0x38000000)), 13);
+	__m128i nan = _mm_cmpgt_epi32(magnitude, _mm_set1_epi32(0x7F800000));
+	__m128i inf = _mm_cmpgt_epi32(magnitude, _mm_set1_epi32(0x477FF000 - 1));
+	__m128i tiny = _mm_cmplt_epi32(magnitude, _mm_set1_epi32(0x38800000));
+	__m128i half = _mm_andnot_si128(_mm_or_si128(inf, tiny), normal);
+	half = _mm_or_si128(half, _mm_and_si128(inf, _mm_set1_epi32(0x7C00)));
+	half = _mm_or_si128(half, _mm_and_si128(nan, _mm_set1_epi32(0x0200)));
+	return _mm_or_si128(half, sign);
+}
+
+inline __m128 halfToFloat4(__m128i half) {
+	__m128i sign = _mm_slli_epi32(_mm_and_si128(half, _mm_set1_epi32(0x8000)), 16);
+	__m128i exponent = _mm_and_si128(half, _mm_set1_epi32(0x7C00));
+	__m128i bits = _mm_add_epi32(_mm_slli_epi32(_mm_and_si128(half, _mm_set1_epi32(0x7FFF)), 13), _mm_set1_epi32(0x38000000));
+	__m128i zero = _mm_cmpeq_epi32(exponent, _mm_setzero_si128());
+	__m128i special = _mm_cmpeq_epi32(exponent, _mm_set1_epi32(0x7C00));
+	bits = _mm_add_epi32(bits, _mm_and_si128(special, _mm_set1_epi32(0x38000000)));
+	bits = _mm_andnot_si128(zero, bits);
+	return _mm_castsi128_ps(_mm_or_si128(bits, sign));
+}
+
+inline __m128 clamp4(__m128 value, __m128 lo, __m128 hi) {
+	return _mm_min_ps(_mm_max_ps(value, lo), hi);
+}
+
+// Four vertices at a time : the arithmetic is done one component per
+// register, then each vertex is put back together with a 4x4 transpose and
+// packed to 16 bits in one go.
+void quantizeVerticesSSE2(const glm::vec3 * positions, const glm::vec2 * uvs, const glm::vec3 * normals, size_t count, QuantizedMesh & mesh) {
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 signBit = _mm_set1_ps(-0.0f);
+	const __m128 top = _mm_set1_ps(65535.0f);
+	const __m128i bias = _mm_set1_epi32(32768);
+	// packs_epi32 saturates to signed : unsigned lanes go through it biased
+	// by -32768 and get their top bit flipped back after.
+	const __m128i flipPosition = _mm_set1_epi16((short)0x8000);
+	const __m128i flipUv = _mm_setr_epi16((short)0x8000, (short)0x8000, 0, 0, 0, 0, 0, 0);
+	const __m128 snorm = _mm_set1_ps(32767.0f);
+	__m128 offset[3], inverse[3];
+	for (int k = 0; k < 3; k++) {
+		offset[k] = _mm_set1_ps(mesh.offset[k]);
+		inverse[k] = _mm_set1_ps(quantizationInverse(mesh.scale[k]));
+	}
+
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4) {
+		const glm::vec3 * p = positions + i;
+		const glm::vec2 * t = uvs + i;
+		const glm::vec3 * n = normals + i;
+		__m128 px = _mm_setr_ps(p[0].x, p[1].x, p[2].x, p[3].x);
+		__m128 py = _mm_setr_ps(p[0].y, p[1].y, p[2].y, p[3].y);
+		__m128 pz = _mm_setr_ps(p[0].z, p[1].z, p[2].z, p[3].z);
+		__m128 pw = zero;
+		px = clamp4(_mm_mul_ps(_mm_sub_ps(px, offset[0]), inverse[0]), zero, top);
+		py = clamp4(_mm_mul_ps(_mm_sub_ps(py, offset[1]), inverse[1]), zero, top);
+		pz = clamp4(_mm_mul_ps(_mm_sub_ps(pz, offset[2]), inverse[2]), zero, top);
+		_MM_TRANSPOSE4_PS(px, py, pz, pw);
+
+		__m128 nx = _mm_setr_ps(n[0].x, n[1].x, n[2].x, n[3].x);
+		__m128 ny = _mm_setr_ps(n[0].y, n[1].y, n[2].y, n[3].y);
+		__m128 nz = _mm_setr_ps(n[0].z, n[1].z, n[2].z, n[3].z);
+		__m128 l1 = _mm_add_ps(_mm_add_ps(_mm_andnot_ps(signBit, nx), _mm_andnot_ps(signBit, ny)), _mm_andnot_ps(signBit, nz));
+		__m128 valid = _mm_cmpneq_ps(l1, zero);
+		__m128 ox = _mm_and_ps(valid, _mm_div_ps(nx, l1));
+		__m128 oy = _mm_and_ps(valid, _mm_div_ps(ny, l1));
+		// Lower half : (1 - |y|, 1 - |x|) with the signs of x and y.
+		__m128 below = _mm_cmplt_ps(nz, zero);
+		__m128 sx = _mm_or_ps(_mm_and_ps(ox, signBit), one);
+		__m128 sy = _mm_or_ps(_mm_and_ps(oy, signBit), one);
+		__m128 fx = _mm_mul_ps(_mm_sub_ps(one, _mm_andnot_ps(signBit, oy)), sx);
+		__m128 fy = _mm_mul_ps(_mm_sub_ps(one, _mm_andnot_ps(signBit, ox)), sy);
+		ox = _mm_or_ps(_mm_and_ps(below, fx), _mm_andnot_ps(below, ox));
+		oy = _mm_or_ps(_mm_and_ps(below, fy), _mm_andnot_ps(below, oy));
+		__m128i qx = _mm_cvtps_epi32(_mm_mul_ps(clamp4(ox, _mm_set1_ps(-1.0f), one), snorm));
+		__m128i qy = _mm_cvtps_epi32(_mm_mul_ps(clamp4(oy, _mm_set1_ps(-1.0f), one), snorm));
+
+		__m128i hu = _mm_sub_epi32(floatToHalf4(_mm_setr_ps(t[0].x, t[1].x, t[2].x, t[3].x)), bias);
+		__m128i hv = _mm_sub_epi32(floatToHalf4(_mm_setr_ps(t[0].y, t[1].y, t[2].y, t[3].y)), bias);
+		// Transpose (u, v, nx, ny) the same way, on integers.
+		__m128 r0 = _mm_castsi128_ps(hu), r1 = _mm_castsi128_ps(hv), r2 = _mm_castsi128_ps(qx), r3 = _mm_castsi128_ps(qy);
+		_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+
+		__m128i * out = (__m128i *)&mesh.vertices[i];
+		__m128 rows[4] = { px, py, pz, pw };
+		__m128 rest[4] = { r0, r1, r2, r3 };
+		for (int k = 0; k < 4; k++) {
+			__m128i position = _mm_sub_epi32(_mm_cvtps_epi32(rows[k]), bias);
+			__m128i packed = _mm_packs_epi32(position, _mm_castps_si128(rest[k]));
+			// The unused w went in as -32768 and comes out as 0.
+			packed = _mm_xor_si128(packed, _mm_unpacklo_epi64(flipPosition, flipUv));
+			_mm_storeu_si128(out + k, packed);
+		}
+	}
+	quantizeVerticesScalar(positions, uvs, normals, count, mesh, i);
+}
+
+void dequantizeVerticesSSE2(const QuantizedMesh & mesh, glm::vec3 * positions, glm::vec2 * uvs, glm::vec3 * normals) {
+	const __m128 signBit = _mm_set1_ps(-0.0f);
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 offset = _mm_setr_ps(mesh.offset.x, mesh.offset.y, mesh.offset.z, 0.0f);
+	const __m128 scale = _mm_setr_ps(mesh.scale.x, mesh.scale.y, mesh.scale.z, 0.0f);
+	const __m128 snorm = _mm_set1_ps(1.0f / 32767.0f);
+	size_t count = mesh.vertices.size();
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4) {
+		const __m128i * in = (const __m128i *)&mesh.vertices[i];
+		__m128 p[4], r[4];
+		for (int k = 0; k < 4; k++) {
+			__m128i v = _mm_loadu_si128(in + k);
+			// Low half : unsigned positions ; high half : halves, then signed normals.
+			__m128i position = _mm_unpacklo_epi16(v, _mm_setzero_si128());
+			__m128i rest = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+			p[k] = _mm_add_ps(offset, _mm_mul_ps(_mm_cvtepi32_ps(position), scale));
+			r[k] = _mm_castsi128_ps(rest);
+		}
+		_MM_TRANSPOSE4_PS(p[0], p[1], p[2], p[3]);
+		_MM_TRANSPOSE4_PS(r[0], r[1], r[2], r[3]);
+
+		// r[0], r[1] : sign-extended halves, r[2], r[3] : normals.
+		__m128 u = halfToFloat4(_mm_and_si128(_mm_castps_si128(r[0]), _mm_set1_epi32(0xFFFF)));
+		__m128 v = halfToFloat4(_mm_and_si128(_mm_castps_si128(r[1]), _mm_set1_epi32(0xFFFF)));
+		__m128 nx = _mm_mul_ps(_mm_cvtepi32_ps(_mm_castps_si128(r[2])), snorm);
+		__m128 ny = _mm_mul_ps(_mm_cvtepi32_ps(_mm_castps_si128(r[3])), snorm);
+		__m128 nz = _mm_sub_ps(_mm_sub_ps(one, _mm_andnot_ps(signBit, nx)), _mm_andnot_ps(signBit, ny));
+		__m128 t = _mm_max_ps(_mm_sub_ps(zero, nz), zero);
+		nx = _mm_sub_ps(nx, _mm_or_ps(t, _mm_and_ps(nx, signBit)));
+		ny = _mm_sub_ps(ny, _mm_or_ps(t, _mm_and_ps(ny, signBit)));
+		__m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, nx), _mm_mul_ps(ny, ny)), _mm_mul_ps(nz, nz)));
+		nx = _mm_div_ps(nx, length);
+		ny = _mm_div_ps(ny, length);
+		nz = _mm_div_ps(nz, length);
+
+		float px[4], py[4], pz[4], fu[4], fv[4], fx[4], fy[4], fz[4];
+		_mm_storeu_ps(px, p[0]); _mm_storeu_ps(py, p[1]); _mm_storeu_ps(pz, p[2]);
+		_mm_storeu_ps(fu, u);    _mm_storeu_ps(fv, v);
+		_mm_storeu_ps(fx, nx);   _mm_storeu_ps(fy, ny);   _mm_storeu_ps(fz, nz);
+		for (int k = 0; k < 4; k++) {
+			positions[i + k] = glm::vec3(px[k], py[k], pz[k]);
+			uvs[i + k] = glm::vec2(fu[k], fv[k]);
+			normals[i + k] = glm::vec3(fx[k], fy[k], fz[k]);
+		}
+	}
+	dequantizeVerticesScalar(mesh, positions, uvs, normals, i);
+}
+#endif
+
+// Quantizes `count` vertices into `mesh`, whose offset and scale come from
+// the bounding box of the positions. Normals are expected to be unit length.
+void quantizeVertices(const glm::vec3 * positions, const glm::vec2 * uvs, const glm::vec3 * normals, size_t count, QuantizedMesh & mesh) {
+	quantizationRange(positions, count, mesh.offset, mesh.scale);
+	mesh.vertices.resize(count);
+#ifdef QUANTIZE_HAVE_SSE2
+	quantizeVerticesSSE2(positions, uvs, normals, count, mesh);
+#else
+	quantizeVerticesScalar(positions, uvs, normals, count, mesh);
+#endif
+}
+
+// Back to floats, mesh.vertices.size() of each.
+void dequantizeVertices(const QuantizedMesh & mesh, glm::vec3 * positions, glm::vec2 * uvs, glm::vec3 * normals) {
+#ifdef QUANTIZE_HAVE_SSE2
+	dequantizeVerticesSSE2(mesh, positions, uvs, normals);
+#else
+	dequantizeVerticesScalar(mesh, positions, uvs, normals);
+#endif
+}
+
+// Compares `mesh` with the vertices it was made from.
+QuantizationError quantizationError(const QuantizedMesh & mesh, const glm::vec3 * positions, const glm::vec2 * uvs, const glm::vec3 * normals) {
+	size_t count = mesh.vertices.size();
+	std::vector<glm::vec3> p(count), n(count);
+	std::vector<glm::vec2> t(count);
+	QuantizationError error;
+	memset(&error, 0, sizeof error);
+	if (count == 0) return error;
+	dequantizeVertices(mesh, &p[0], &t[0], &n[0]);
+
+	float largestPosition = 0.0f, largestUv = 0.0f, largestAngle = 0.0f;
+	for (size_t i = 0; i < count; i++) {
+		for (int k = 0; k < 3; k++) {
+			error.position = fmaxf(error.position, fabsf(p[i][k] - positions[i][k]));
+			largestPosition = fmaxf(largestPosition, fabsf(positions[i][k]));
+		}
+		for (int k = 0; k < 2; k++) {
+			error.uv = fmaxf(error.uv, fabsf(t[i][k] - uvs[i][k]));
+			largestUv = fmaxf(largestUv, fabsf(uvs[i][k]));
+		}
+		// atan2 rather than acos, which has no precision left this close to 0.
+		if (glm::length(normals[i]) > 0.0f)
+			largestAngle = fmaxf(largestAngle, atan2f(glm::length(glm::cross(n[i], normals[i])), glm::dot(n[i], normals[i])));
+	}
+	error.positionBound = 0.5f * fmaxf(mesh.scale.x, fmaxf(mesh.scale.y, mesh.scale.z)) + 2.0f * FLT_EPSILON * largestPosition;
+	// Half floats keep 11 significant bits.
+	error.uvBound = largestUv > 0.0f ? ldexpf(1.0f, ilogbf(largestUv) - 11) : 0.0f;
+	error.normalDegrees = largestAngle * 57.2957795f;
+	return error;
+}
+
+void printQuantizationError(const char * name, const QuantizationError & e) {
+	printf("%s : position error %g (bound %g), uv error %g (bound %g), normal error %.4f degrees\n",
+		name, e.position, e.positionBound, e.uv, e.uvBound, e.normalDegrees);
+}
+
+#endif
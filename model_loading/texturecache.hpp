@@ -0,0 +1,297 @@
+#ifndef TEXTURECACHE_HPP
+#define TEXTURECACHE_HPP
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <sys/stat.h>
+
+#include <GL/glew.h>
+
+#include "mappedfile.hpp"
+
+// DDSImage, openDDS, uploadDDS, closeDDS, loadBMP and loadCompressed come
+// from common.hpp, to be included first.
+
+// Texture objects shared by everything that asks for the same image.
+//
+// acquire() gives the texture of a path, loading it the first time only,
+// and counts a reference ; release() gives the reference back. A path is
+// known again by its size and modification time, without reading the
+// file. A path not seen before, or changed, is read and hashed : if
+// another path already gave the same hash, and its file, unchanged, has
+// the same bytes, that texture is shared.
+//
+// Textures nobody holds stay resident for the next acquire() until the
+// total, as the driver reports it, goes over the budget ; the least
+// recently used of them are then deleted first. Textures held are never
+// deleted, even over budget.
+//
+// DDS files go through openDDS and uploadDDS, BMP through loadBMP, and
+// TGA and netpbm through loadCompressed. All of it on the GL thread.
+//
+// A texture acquired is shared : it keeps the parameters its loader gave
+// it, and must not be changed. Filtering or wrapping of one's own goes on
+// a sampler object (glBindSampler), which overrides them for its unit.
+
+#define TEXTURE_CACHE_BUDGET (256u << 20) // bytes
+
+struct TextureCacheStats {
+	unsigned long hits;        // path known and unchanged : no file read
+	unsigned long contentHits; // new or changed path, bytes already loaded from another
+	unsigned long misses;      // loaded
+	unsigned long evictions;
+	unsigned long failures;
+	size_t residentBytes;
+	size_t heldBytes;          // of textures with references
+};
+
+// 64-bit hash of a file's bytes, 8 at a time (FNV-1a's multiplier on
+// words rather than bytes).
+inline uint64_t textureContentHash(const unsigned char * data, size_t size) {
+	const uint64_t prime = 0x100000001b3ULL;
+	uint64_t h = 0xcbf29ce484222325ULL ^ size;
+	size_t i = 0;
+	for (; i + 8 <= size; i += 8) {
+		uint64_t word;
+		memcpy(&word, data + i, 8);
+		h = (h ^ word) * prime;
+		h ^= h >> 29;
+	}
+	for (; i < size; i++) h = (h ^ data[i]) * prime;
+	return h ^ (h >> 32);
+}
+
+// Bytes of every level of `texture`, as the driver reports them. Leaves it
+// bound to `target`.
+size_t textureBytes(GLenum target, GLuint texture) {
+	glBindTexture(target, texture);
+	GLenum query = target == GL_TEXTURE_CUBE_MAP ? GL_TEXTURE_CUBE_MAP_POSITIVE_X : target;
+	size_t faces = target == GL_TEXTURE_CUBE_MAP ? 6 : 1, total = 0;
+	for (GLint level = 0; level < 16; level++) {
+		GLint w = 0, h = 0, d = 1, compressed = 0;
+		glGetTexLevelParameteriv(query, level, GL_TEXTURE_WIDTH, &w);
+		glGetTexLevelParameteriv(query, level, GL_TEXTURE_HEIGHT, &h);
+		if (w == 0 || h == 0) break;
+		if (target != GL_TEXTURE_2D && target != GL_TEXTURE_CUBE_MAP) glGetTexLevelParameteriv(query, level, GL_TEXTURE_DEPTH, &d);
+		glGetTexLevelParameteriv(query, level, GL_TEXTURE_COMPRESSED, &compressed);
+		if (compressed) {
+			GLint size = 0;
+			glGetTexLevelParameteriv(query, level, GL_TEXTURE_COMPRESSED_IMAGE_SIZE, &size);
+			total += (size_t)size * faces;
+			continue;
+		}
+		GLenum channels[] = { GL_TEXTURE_RED_SIZE, GL_TEXTURE_GREEN_SIZE, GL_TEXTURE_BLUE_SIZE, GL_TEXTURE_ALPHA_SIZE, GL_TEXTURE_DEPTH_SIZE };
+		GLint bits = 0;
+		for (int c = 0; c < 5; c++) {
+			GLint b = 0;
+			glGetTexLevelParameteriv(query, level, channels[c], &b);
+			bits += b;
+		}
+		total += (size_t)w * h * d * faces * bits / 8;
+	}
+	return total;
+}
+
+class TextureCache {
+public:
+	TextureCache(size_t budget = TEXTURE_CACHE_BUDGET) : budget(budget), clock(0) {
+		memset(&counters, 0, sizeof counters);
+	}
+
+	// The texture of `imagepath`, with one more reference ; 0 if it can't
+	// be loaded.
+	GLuint acquire(const char * imagepath) {
+		uint64_t size = 0;
+		int64_t mtime = 0;
+		struct stat st;
+		if (stat(imagepath, &st) == 0) {
+			size = (uint64_t)st.st_size;
+			mtime = (int64_t)st.st_mtime;
+		}
+		std::map<std::string, PathEntry>::iterator p = paths.find(imagepath);
+		if (p != paths.end() && p->second.size == size && p->second.mtime == mtime && textures.count(p->second.texture)) {
+			counters.hits++;
+			return hold(p->second.texture);
+		}
+
+		// New or changed : the bytes decide.
+		MappedFile file;
+		if (!mapFile(imagepath, file)) {
+			printf("%s could not be opened. Are you in the right directory ? Don't forget to read the FAQ !\n", imagepath);
+			counters.failures++;
+			return 0;
+		}
+		uint64_t hash = textureContentHash((const unsigned char *)file.data, file.size);
+		bool dds = file.size >= 4 && memcmp(file.data, "DDS ", 4) == 0;
+		bool bmp = file.size >= 2 && file.data[0] == 'B' && file.data[1] == 'M';
+		if (p != paths.end()) forget(imagepath);
+		std::map<uint64_t, GLuint>::iterator c = contents.find(hash);
+		if (c != contents.end() && sameBytes(file, textures[c->second])) {
+			unmapFile(file);
+			counters.contentHits++;
+			remember(imagepath, size, mtime, c->second);
+			return hold(c->second);
+		}
+		uint64_t fileSize = file.size;
+		unmapFile(file);
+
+		counters.misses++;
+		GLenum target = GL_TEXTURE_2D;
+		GLuint texture;
+		if (dds) {
+			DDSImage image;
+			texture = 0;
+			if (openDDS(imagepath, image)) {
+				if (image.faces == 6) target = image.layers > 1 ? GL_TEXTURE_CUBE_MAP_ARRAY : GL_TEXTURE_CUBE_MAP;
+				else                  target = image.layers > 1 ? GL_TEXTURE_2D_ARRAY : GL_TEXTURE_2D;
+				texture = uploadDDS(image);
+				closeDDS(image);
+			}
+		} else if (bmp) {
+			texture = loadBMP(imagepath);
+		} else {
+			texture = loadCompressed(imagepath);
+		}
+		if (!texture) {
+			counters.failures++;
+			return 0;
+		}
+		TextureEntry & entry = textures[texture];
+		entry.hash = hash;
+		entry.fileSize = fileSize;
+		entry.bytes = textureBytes(target, texture);
+		entry.refs = 0;
+		contents[hash] = texture;
+		remember(imagepath, size, mtime, texture);
+		counters.residentBytes += entry.bytes;
+		hold(texture);
+		evict();
+		return texture;
+	}
+
+	// Gives back a reference from acquire(). The texture stays resident
+	// until the budget needs its memory.
+	void release(GLuint texture) {
+		std::map<GLuint, TextureEntry>::iterator t = textures.find(texture);
+		if (t == textures.end() || t->second.refs == 0) return;
+		if (--t->second.refs == 0) {
+			counters.heldBytes -= t->second.bytes;
+			evict();
+		}
+	}
+
+	void setBudget(size_t bytes) {
+		budget = bytes;
+		evict();
+	}
+
+	// Deletes every texture, held or not. Needs the GL context still there.
+	void clear() {
+		for (std::map<GLuint, TextureEntry>::iterator t = textures.begin(); t != textures.end(); ++t) glDeleteTextures(1, &t->first);
+		textures.clear();
+		paths.clear();
+		contents.clear();
+		counters.residentBytes = counters.heldBytes = 0;
+	}
+
+	const TextureCacheStats & stats() const { return counters; }
+
+	void printStats() const {
+		printf("Texture cache : %lu hits, %lu by content, %lu misses, %lu evictions, %lu failures ; %.1f MB resident (%.1f MB held) of %.1f MB\n",
+			counters.hits, counters.contentHits, counters.misses, counters.evictions, counters.failures,
+			counters.residentBytes / (1024.0 * 1024.0), counters.heldBytes / (1024.0 * 1024.0), budget / (1024.0 * 1024.0));
+	}
+
+private:
+	struct TextureEntry {
+		uint64_t hash;
+		uint64_t fileSize; // of the file that was hashed
+		size_t bytes;
+		unsigned int refs;
+		uint64_t lastUse;
+		std::vector<std::string> paths;
+	};
+	struct PathEntry {
+		GLuint texture;
+		uint64_t size;
+		int64_t mtime;
+	};
+
+	GLuint hold(GLuint texture) {
+		TextureEntry & entry = textures[texture];
+		if (entry.refs++ == 0) counters.heldBytes += entry.bytes;
+		entry.lastUse = ++clock;
+		return texture;
+	}
+
+	// Whether `file` holds the bytes `entry` was loaded from, as one of its
+	// paths still has them : same size, then compared. Two files of the same
+	// hash aren't taken for one on the hash alone.
+	bool sameBytes(const MappedFile & file, const TextureEntry & entry) {
+		if (file.size != entry.fileSize) return false;
+		for (size_t i = 0; i < entry.paths.size(); i++) {
+			std::map<std::string, PathEntry>::iterator p = paths.find(entry.paths[i]);
+			struct stat st;
+			if (p == paths.end() || stat(entry.paths[i].c_str(), &st) != 0 ||
+				(uint64_t)st.st_size != p->second.size || (int64_t)st.st_mtime != p->second.mtime)
+				continue;
+			MappedFile other;
+			if (!mapFile(entry.paths[i].c_str(), other)) continue;
+			bool same = other.size == file.size && memcmp(other.data, file.data, file.size) == 0;
+			unmapFile(other);
+			return same;
+		}
+		return false;
+	}
+
+	void remember(const char * imagepath, uint64_t size, int64_t mtime, GLuint texture) {
+		PathEntry & p = paths[imagepath];
+		p.texture = texture;
+		p.size = size;
+		p.mtime = mtime;
+		textures[texture].paths.push_back(imagepath);
+	}
+
+	void forget(const std::string & imagepath) {
+		std::map<std::string, PathEntry>::iterator p = paths.find(imagepath);
+		if (p == paths.end()) return;
+		std::map<GLuint, TextureEntry>::iterator t = textures.find(p->second.texture);
+		if (t != textures.end()) {
+			std::vector<std::string> & names = t->second.paths;
+			names.erase(std::remove(names.begin(), names.end(), imagepath), names.end());
+		}
+		paths.erase(p);
+	}
+
+	// The least recently used unheld textures go until the rest fits.
+	void evict() {
+		while (counters.residentBytes > budget) {
+			std::map<GLuint, TextureEntry>::iterator oldest = textures.end();
+			for (std::map<GLuint, TextureEntry>::iterator t = textures.begin(); t != textures.end(); ++t)
+				if (t->second.refs == 0 && (oldest == textures.end() || t->second.lastUse < oldest->second.lastUse)) oldest = t;
+			if (oldest == textures.end()) return;
+			TextureEntry & entry = oldest->second;
+			for (size_t i = 0; i < entry.paths.size(); i++) paths.erase(entry.paths[i]);
+			std::map<uint64_t, GLuint>::iterator c = contents.find(entry.hash);
+			if (c != contents.end() && c->second == oldest->first) contents.erase(c);
+			counters.residentBytes -= entry.bytes;
+			counters.evictions++;
+			glDeleteTextures(1, &oldest->first);
+			textures.erase(oldest);
+		}
+	}
+
+	size_t budget;
+	uint64_t clock;
+	TextureCacheStats counters;
+	std::map<GLuint, TextureEntry> textures;
+	std::map<std::string, PathEntry> paths;
+	std::map<uint64_t, GLuint> contents;
+};
+
+#endif
@@ -0,0 +1,43 @@
+#ifndef THREADS_HPP
+#define THREADS_HPP
+
+#include <vector>
+
+#include "deps/tinycthread.h"
+
+#if defined(__unix__) || defined(unix) || defined(__APPLE__)
+#include <unistd.h>
+#endif
+
+// Work split over threads, for the loaders : the OBJ parser, the BC
+// decoder and encoder and the mipmap maker each cut their job into chunks
+// and hand them to runChunks.
+
+// Threads to use when asked for 0 : one per core.
+inline unsigned int defaultThreadCount() {
+#if defined(__unix__) || defined(unix) || defined(__APPLE__)
+	long n = sysconf(_SC_NPROCESSORS_ONLN);
+	return n > 0 ? (unsigned int)n : 1;
+#else
+	return 4;
+#endif
+}
+
+// Runs `func` on every chunk, one thread each, and waits for all of them.
+// The first chunk runs on the calling thread, and so does any whose thread
+// couldn't be started.
+template <typename Chunk>
+void runChunks(std::vector<Chunk> & chunks, thrd_start_t func) {
+	if (chunks.empty()) return;
+	std::vector<thrd_t> threads(chunks.size());
+	std::vector<char> started(chunks.size(), 0);
+	for (size_t i = 1; i < chunks.size(); i++)
+		started[i] = thrd_create(&threads[i], func, &chunks[i]) == thrd_success;
+	func(&chunks[0]);
+	for (size_t i = 1; i < chunks.size(); i++) {
+		if (started[i]) thrd_join(threads[i], NULL);
+		else func(&chunks[i]);
+	}
+}
+
+#endif
@@ -0,0 +1,180 @@
+#ifndef VBOINDEXER_HPP
+#define VBOINDEXER_HPP
+
+#include <stdio.h>
+#include <stdint.h>
+#include <vector>
+#include <limits>
+#include <algorithm>
+
+// Include GLM
+#include <glm/glm.hpp>
+
+#include "objloader.hpp"
+
+// Open-addressing hash map from a (v, vt, vn) index triple of the .obj to
+// the output vertex it became. Linear probing, power-of-two sized, kept
+// at most half full.
+class VertexTupleMap {
+public:
+	VertexTupleMap(size_t expected) : count(0) {
+		size_t size = 16;
+		while (size < expected * 2) size *= 2;
+		slots.resize(size);
+		for (size_t i = 0; i < size; i++) slots[i].index = EMPTY;
+	}
+
+	// Returns the output vertex of the triple, or `next` if it wasn't in the
+	// map yet (in which case it is now).
+	uint32_t findOrInsert(uint32_t v, uint32_t vt, uint32_t vn, uint32_t next) {
+		if ((count + 1) * 2 > slots.size()) grow();
+		size_t mask = slots.size() - 1;
+		for (size_t i = hash(v, vt, vn) & mask; ; i = (i + 1) & mask) {
+			Slot & slot = slots[i];
+			if (slot.index == EMPTY) {
+				slot.v = v;
+				slot.vt = vt;
+				slot.vn = vn;
+				slot.index = next;
+				count++;
+				return next;
+			}
+			if (slot.v == v && slot.vt == vt && slot.vn == vn)
+				return slot.index;
+		}
+	}
+
+private:
+	static const uint32_t EMPTY = 0xFFFFFFFFu;
+
+	struct Slot {
+		uint32_t v, vt, vn, index;
+	};
+
+	static size_t hash(uint32_t v, uint32_t vt, uint32_t vn) {
+		uint64_t h = v * 0x9E3779B97F4A7C15ULL;
+		h ^= (vt + (h >> 29)) * 0xBF58476D1CE4E5B9ULL;
+		h ^= (vn + (h >> 31)) * 0x94D049BB133111EBULL;
+		return (size_t)(h ^ (h >> 32));
+	}
+
+	void grow() {
+		std::vector<Slot> old;
+		old.swap(slots);
+		slots.resize(old.size() * 2);
+		for (size_t i = 0; i < slots.size(); i++) slots[i].index = EMPTY;
+		size_t mask = slots.size() - 1;
+		for (size_t j = 0; j < old.size(); j++) {
+			if (old[j].index == EMPTY) continue;
+			size_t i = hash(old[j].v, old[j].vt, old[j].vn) & mask;
+			while (slots[i].index != EMPTY) i = (i + 1) & mask;
+			slots[i] = old[j];
+		}
+	}
+
+	std::vector<Slot> slots;
+	size_t count;
+};
+
+// Normals for the corners that have none in the file : the area-weighted
+// average of the faces around each position, so that the indexed mesh
+// stays smooth. Empty if every corner has a normal.
+void objSmoothNormals(const ObjData & data, std::vector<glm::vec3> & smooth) {
+	size_t ncorners = data.vertexIndices.size();
+	if (std::find(data.normalIndices.begin(), data.normalIndices.end(), 0u) == data.normalIndices.end())
+		return;
+	smooth.assign(data.vertices.size(), glm::vec3(0.0f));
+	for (size_t i = 0; i + 2 < ncorners; i += 3) {
+		const unsigned int * v = &data.vertexIndices[i];
+		if (v[0]-1 >= data.vertices.size() || v[1]-1 >= data.vertices.size() || v[2]-1 >= data.vertices.size())
+			continue;
+		const glm::vec3 & a = data.vertices[v[0]-1];
+		glm::vec3 n = glm::cross(data.vertices[v[1]-1] - a, data.vertices[v[2]-1] - a);
+		for (int j = 0; j < 3; j++)
+			if (!data.normalIndices[i + j]) smooth[v[j]-1] += n;
+	}
+	for (size_t i = 0; i < smooth.size(); i++) {
+		float length = glm::length(smooth[i]);
+		smooth[i] = length > 0.0f ? smooth[i] / length : glm::vec3(0.0f, 0.0f, 1.0f);
+	}
+}
+
+// Builds an indexed mesh from parsed .obj data : one output vertex per
+// distinct (v, vt, vn) triple, and three indices per triangle. `Index` is
+// unsigned short or unsigned int ; returns false if there are more
+// distinct vertices than `Index` can address, or a face is out of range.
+template <typename Index>
+bool indexOBJ(const ObjData & data, std::vector<Index> & out_indices, std::vector<glm::vec3> & out_vertices, std::vector<glm::vec2> & out_uvs, std::vector<glm::vec3> & out_normals) {
+	size_t ncorners = data.vertexIndices.size();
+	size_t expected = std::max(data.vertices.size(), std::max(data.uvs.size(), data.normals.size()));
+	const size_t maxVertices = (size_t)std::numeric_limits<Index>::max() + 1;
+
+	std::vector<glm::vec3> smooth;
+	objSmoothNormals(data, smooth);
+
+	VertexTupleMap map(expected);
+	out_indices.reserve(out_indices.size() + ncorners);
+	out_vertices.reserve(out_vertices.size() + expected);
+	out_uvs     .reserve(out_uvs.size() + expected);
+	out_normals .reserve(out_normals.size() + expected);
+
+	size_t first = out_vertices.size();
+	for (size_t i = 0; i < ncorners; i++) {
+		unsigned int vertexIndex = data.vertexIndices[i];
+		unsigned int uvIndex = data.uvIndices[i];
+		unsigned int normalIndex = data.normalIndices[i];
+		if (vertexIndex-1 >= data.vertices.size() ||
+			(uvIndex != 0 && uvIndex-1 >= data.uvs.size()) ||
+			(normalIndex != 0 && normalIndex-1 >= data.normals.size()))
+			return false;
+
+		uint32_t next = (uint32_t)(out_vertices.size() - first);
+		uint32_t index = map.findOrInsert(vertexIndex, uvIndex, normalIndex, next);
+		if (index == next) {
+			if (next >= maxVertices) return false;
+			out_vertices.push_back(data.vertices[vertexIndex-1]);
+			out_uvs     .push_back(uvIndex ? data.uvs[uvIndex-1] : glm::vec2(0.0f, 0.0f));
+			out_normals .push_back(normalIndex ? data.normals[normalIndex-1] : smooth[vertexIndex-1]);
+		}
+		out_indices.push_back((Index)index);
+	}
+	return true;
+}
+
+// Read file `path` as an indexed mesh : out_vertices|out_uvs|out_normals
+// hold each distinct vertex once, out_indices three entries per triangle,
+// ready for glDrawElements, and out_submeshes the runs of indices of each
+// group/material.
+template <typename Index>
+bool loadOBJIndexed(const char * path, std::vector<Index> & out_indices, std::vector<glm::vec3> & out_vertices, std::vector<glm::vec2> & out_uvs, std::vector<glm::vec3> & out_normals, std::vector<ObjSubmesh> & out_submeshes) {
+	MappedFile file;
+	if (!mapFile(path, file)) {
+		printf("Impossible to open the file ! Are you in the right path ? See Tutorial 1 for details\n");
+		getchar();
+		return false;
+	}
+
+	ObjData data;
+	const char * error = objParseRange(file.data, file.data + file.size, data);
+	unmapFile(file);
+	if (error) {
+		printf("File can't be read by our simple parser :-( Try exporting with other options\n");
+		return false;
+	}
+
+	size_t first = out_indices.size();
+	if (!indexOBJ(data, out_indices, out_vertices, out_uvs, out_normals)) {
+		printf("%s has a face out of range, or too many vertices for %d-bit indices\n", path, (int)sizeof(Index) * 8);
+		return false;
+	}
+	objBuildSubmeshes(data.groups, data.vertexIndices.size(), first, out_submeshes);
+	return true;
+}
+
+template <typename Index>
+bool loadOBJIndexed(const char * path, std::vector<Index> & out_indices, std::vector<glm::vec3> & out_vertices, std::vector<glm::vec2> & out_uvs, std::vector<glm::vec3> & out_normals) {
+	std::vector<ObjSubmesh> submeshes;
+	return loadOBJIndexed(path, out_indices, out_vertices, out_uvs, out_normals, submeshes);
+}
+
+#endif
@@ -1,2 +1,2 @@
 #!/usr/bin sh
-g++ textured_cube.cpp -o textured_cube -L/usr/local/lib -I/usr/local/include -I/Local/Users/john/Documents/c/ogl/ -lglew -framework OpenGL -lglfw3
+g++ textured_cube.cpp /Local/Users/john/Documents/c/ogl/deps/tinycthread.c -o textured_cube -L/usr/local/lib -I/usr/local/include -I/Local/Users/john/Documents/c/ogl/ -lglew -framework OpenGL -lglfw3
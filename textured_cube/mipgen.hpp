@@ -0,0 +1,336 @@
+#ifndef MIPGEN_HPP
+#define MIPGEN_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <vector>
+
+#include "threads.hpp"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define MIPGEN_SSE
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define MIPGEN_NEON
+#endif
+
+// Mipmap chains of 8-bit RGB or RGBA pixels made on the CPU, on every
+// core, instead of with glGenerateMipmap on the render thread.
+//
+// Each level is made from the one before with a separable filter : the
+// plain box (2x2 for even sizes, the exact overlaps for odd ones) or a
+// Kaiser-windowed sinc, sharper. Filtering is done on linear values, as
+// floats : sRGB-encoded colour (which is what images are, whatever the
+// texture format says) is decoded before and encoded after, so that a
+// black and white checkerboard turns to a 50% grey, not to a dark one.
+// Alpha is always linear. A pixel is 4 floats, and the filter is a
+// multiply-add of those, one SSE (NEON) register at a time.
+
+#define MIP_MAX_LEVELS 16 // 32768 x 32768
+
+enum MipFilter {
+	MIP_BOX,
+	MIP_KAISER
+};
+
+// Levels 1 and up of a chain, tightly packed rows one level after the
+// other. Level 0 is the caller's.
+struct MipChain {
+	unsigned int width, height;   // of level 0
+	unsigned int channels;        // 3 or 4, alpha last
+	unsigned int levels;          // level 0 included
+	std::vector<unsigned char> pixels;
+	size_t offset[MIP_MAX_LEVELS + 1]; // of each level in `pixels` ; offset[levels] is the size
+
+	unsigned int levelWidth(unsigned int level) const { return width >> level ? width >> level : 1; }
+	unsigned int levelHeight(unsigned int level) const { return height >> level ? height >> level : 1; }
+	const unsigned char * level(unsigned int level) const { return &pixels[0] + offset[level]; }
+};
+
+#if defined(MIPGEN_SSE)
+typedef __m128 MipPixel;
+inline MipPixel mipLoad(const float * p) { return _mm_loadu_ps(p); }
+inline void mipStore(float * p, MipPixel v) { _mm_storeu_ps(p, v); }
+inline MipPixel mipZero() { return _mm_setzero_ps(); }
+inline MipPixel mipMulAdd(MipPixel acc, MipPixel v, float w) { return _mm_add_ps(acc, _mm_mul_ps(v, _mm_set1_ps(w))); }
+inline void mipQuantize(MipPixel v, MipPixel scale, int * out) {
+	v = _mm_min_ps(_mm_max_ps(v, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+	_mm_storeu_si128((__m128i *)out, _mm_cvtps_epi32(_mm_mul_ps(v, scale)));
+}
+#elif defined(MIPGEN_NEON)
+typedef float32x4_t MipPixel;
+inline MipPixel mipLoad(const float * p) { return vld1q_f32(p); }
+inline void mipStore(float * p, MipPixel v) { vst1q_f32(p, v); }
+inline MipPixel mipZero() { return vdupq_n_f32(0.0f); }
+inline MipPixel mipMulAdd(MipPixel acc, MipPixel v, float w) { return vmlaq_n_f32(acc, v, w); }
+inline void mipQuantize(MipPixel v, MipPixel scale, int * out) {
+	v = vminq_f32(vmaxq_f32(v, vdupq_n_f32(0.0f)), vdupq_n_f32(1.0f));
+	vst1q_s32(out, vcvtq_s32_f32(vaddq_f32(vmulq_f32(v, scale), vdupq_n_f32(0.5f))));
+}
+#else
+struct MipPixel { float c[4]; };
+inline MipPixel mipLoad(const float * p) { MipPixel v; memcpy(v.c, p, sizeof v.c); return v; }
+inline void mipStore(float * p, MipPixel v) { memcpy(p, v.c, sizeof v.c); }
+inline MipPixel mipZero() { MipPixel v = { { 0.0f, 0.0f, 0.0f, 0.0f } }; return v; }
+inline MipPixel mipMulAdd(MipPixel acc, MipPixel v, float w) { for (int i = 0; i < 4; i++) acc.c[i] += v.c[i] * w; return acc; }
+inline void mipQuantize(MipPixel v, MipPixel scale, int * out) {
+	for (int i = 0; i < 4; i++) out[i] = (int)((v.c[i] < 0.0f ? 0.0f : v.c[i] > 1.0f ? 1.0f : v.c[i]) * scale.c[i] + 0.5f);
+}
+#endif
+
+#define MIP_ENCODE_STEPS 16384 // linear values, for the way back to sRGB
+
+// 8-bit to linear and back : for sRGB, and for plain values (alpha, or
+// colour that is not to be treated as sRGB).
+struct MipTables {
+	float toLinear[2][256];                     // [srgb]
+	unsigned char toSRGB[MIP_ENCODE_STEPS + 1];
+	MipTables() {
+		for (int i = 0; i < 256; i++) {
+			float v = i / 255.0f;
+			toLinear[0][i] = v;
+			toLinear[1][i] = v <= 0.04045f ? v / 12.92f : powf((v + 0.055f) / 1.055f, 2.4f);
+		}
+		for (int i = 0; i <= MIP_ENCODE_STEPS; i++) {
+			float v = (float)i / MIP_ENCODE_STEPS;
+			float s = v <= 0.0031308f ? v * 12.92f : 1.055f * powf(v, 1.0f / 2.4f) - 0.055f;
+			toSRGB[i] = (unsigned char)(s * 255.0f + 0.5f);
+		}
+	}
+};
+
+inline const MipTables & mipTables() {
+	static MipTables tables;
+	return tables;
+}
+
+// The taps of one axis of a filter from `source` pixels down to
+// `target` : for target pixel i, weights[first[i] .. first[i + 1]) on
+// source pixels index[...], summing to 1, edges clamped.
+struct MipTaps {
+	std::vector<unsigned int> first;
+	std::vector<unsigned int> index;
+	std::vector<float> weights;
+};
+
+inline float mipBesselI0(float x) {
+	float sum = 1.0f, term = 1.0f;
+	for (int k = 1; k < 20; k++) {
+		term *= (x / (2.0f * k)) * (x / (2.0f * k));
+		sum += term;
+	}
+	return sum;
+}
+
+// Kaiser-windowed sinc, `x` in target pixels : 3 of them each way, alpha 4.
+inline float mipKaiser(float x) {
+	const float width = 3.0f, alpha = 4.0f;
+	if (fabsf(x) >= width) return 0.0f;
+	float sinc = x == 0.0f ? 1.0f : sinf(3.14159265f * x) / (3.14159265f * x);
+	float t = x / width;
+	return sinc * mipBesselI0(alpha * sqrtf(1.0f - t * t)) / mipBesselI0(alpha);
+}
+
+void mipMakeTaps(unsigned int source, unsigned int target, MipFilter filter, MipTaps & taps) {
+	taps.first.assign(1, 0);
+	taps.index.clear();
+	taps.weights.clear();
+	float scale = (float)source / target;
+	for (unsigned int i = 0; i < target; i++) {
+		float start = i * scale, end = (i + 1) * scale, centre = (i + 0.5f) * scale;
+		int lo, hi;
+		if (filter == MIP_BOX) {
+			lo = (int)floorf(start);
+			hi = (int)ceilf(end) - 1;
+		} else {
+			lo = (int)floorf(centre - 3.0f * scale);
+			hi = (int)ceilf(centre + 3.0f * scale);
+		}
+		size_t begin = taps.weights.size();
+		float total = 0.0f;
+		for (int j = lo; j <= hi; j++) {
+			float w;
+			if (filter == MIP_BOX) w = fminf(end, j + 1.0f) - fmaxf(start, (float)j);
+			else w = mipKaiser((j + 0.5f - centre) / scale);
+			if (w == 0.0f) continue;
+			unsigned int clamped = j < 0 ? 0 : j >= (int)source ? source - 1 : (unsigned int)j;
+			// Clamped taps land on the same pixel : one tap.
+			size_t k = begin;
+			while (k < taps.index.size() && taps.index[k] != clamped) k++;
+			if (k == taps.index.size()) {
+				taps.index.push_back(clamped);
+				taps.weights.push_back(0.0f);
+			}
+			taps.weights[k] += w;
+			total += w;
+		}
+		for (size_t k = begin; k < taps.weights.size(); k++) taps.weights[k] /= total;
+		taps.first.push_back((unsigned int)taps.weights.size());
+	}
+}
+
+// A row of 8-bit pixels to linear floats, 4 per pixel.
+inline void mipConvertRow(const unsigned char * in, unsigned int width, unsigned int channels, const float * colour, const float * alpha, float * linear) {
+	if (channels == 4) {
+		for (unsigned int x = 0; x < width; x++, in += 4, linear += 4) {
+			linear[0] = colour[in[0]];
+			linear[1] = colour[in[1]];
+			linear[2] = colour[in[2]];
+			linear[3] = alpha[in[3]];
+		}
+	} else {
+		for (unsigned int x = 0; x < width; x++, in += 3, linear += 4) {
+			linear[0] = colour[in[0]];
+			linear[1] = colour[in[1]];
+			linear[2] = colour[in[2]];
+			linear[3] = 1.0f;
+		}
+	}
+}
+
+// One thread's share of a level : target rows [firstRow, endRow).
+struct MipJob {
+	const unsigned char * source;
+	unsigned int sourceWidth, sourceHeight;
+	ptrdiff_t sourceStride;
+	unsigned char * target;
+	unsigned int targetWidth;
+	unsigned int channels;
+	bool srgb;
+	const MipTaps * columns;
+	const MipTaps * rows;
+	unsigned int firstRow, endRow;
+};
+
+int mipRunJob(void * arg) {
+	const MipJob & job = *(const MipJob *)arg;
+	const MipTables & tables = mipTables();
+	const float * colour = tables.toLinear[job.srgb ? 1 : 0], * alpha = tables.toLinear[0];
+	size_t rowFloats = (size_t)job.sourceWidth * 4;
+	float colourSteps = job.srgb ? (float)MIP_ENCODE_STEPS : 255.0f, scales[4] = { colourSteps, colourSteps, colourSteps, 255.0f };
+	MipPixel scale = mipLoad(scales);
+
+	// Source rows in linear floats, a few of them kept when consecutive
+	// target rows share taps (Kaiser, odd sizes). When they do not (box,
+	// even sizes), rows are converted and summed in one go.
+	unsigned int ringSize = 1;
+	bool shared = false;
+	for (unsigned int y = job.firstRow; y < job.endRow; y++) {
+		if (job.rows->first[y + 1] - job.rows->first[y] > ringSize) ringSize = job.rows->first[y + 1] - job.rows->first[y];
+		if (y > job.firstRow && job.rows->index[job.rows->first[y]] <= job.rows->index[job.rows->first[y] - 1]) shared = true;
+	}
+	ringSize++;
+	std::vector<float> ring(shared ? ringSize * rowFloats : rowFloats), sum(rowFloats);
+	std::vector<int> ringRow(ringSize, -1);
+
+	for (unsigned int y = job.firstRow; y < job.endRow; y++) {
+		// Vertical pass into `sum`.
+		for (unsigned int t = job.rows->first[y]; t < job.rows->first[y + 1]; t++) {
+			unsigned int sy = job.rows->index[t];
+			float * linear = &ring[shared ? (sy % ringSize) * rowFloats : 0];
+			if (!shared || ringRow[sy % ringSize] != (int)sy) {
+				mipConvertRow(job.source + (ptrdiff_t)sy * job.sourceStride, job.sourceWidth, job.channels, colour, alpha, linear);
+				ringRow[sy % ringSize] = (int)sy;
+			}
+			float w = job.rows->weights[t];
+			if (t == job.rows->first[y]) {
+				for (size_t i = 0; i < rowFloats; i += 4) mipStore(&sum[i], mipMulAdd(mipZero(), mipLoad(linear + i), w));
+			} else {
+				for (size_t i = 0; i < rowFloats; i += 4) mipStore(&sum[i], mipMulAdd(mipLoad(&sum[i]), mipLoad(linear + i), w));
+			}
+		}
+
+		// Horizontal pass, and back to 8 bits.
+		unsigned char * out = job.target + (size_t)y * job.targetWidth * job.channels;
+		for (unsigned int x = 0; x < job.targetWidth; x++, out += job.channels) {
+			MipPixel acc = mipZero();
+			for (unsigned int t = job.columns->first[x]; t < job.columns->first[x + 1]; t++)
+				acc = mipMulAdd(acc, mipLoad(&sum[(size_t)job.columns->index[t] * 4]), job.columns->weights[t]);
+			int q[4];
+			mipQuantize(acc, scale, q);
+			if (job.srgb) {
+				out[0] = tables.toSRGB[q[0]];
+				out[1] = tables.toSRGB[q[1]];
+				out[2] = tables.toSRGB[q[2]];
+			} else {
+				out[0] = (unsigned char)q[0];
+				out[1] = (unsigned char)q[1];
+				out[2] = (unsigned char)q[2];
+			}
+			if (job.channels == 4) out[3] = (unsigned char)q[3];
+		}
+	}
+	return 0;
+}
+
+// Makes every level below `pixels` (`width` x `height`, `channels` 3 or
+// 4, rows `stride` bytes apart, 0 for tightly packed, negative to go up
+// from the last row of a top-down image) down to 1x1. `srgb`
+// says the colour channels are sRGB-encoded and to be filtered as light ;
+// false filters the values as they are, as glGenerateMipmap does for a
+// non-sRGB texture. Rows of a level are split over `threads` threads (0 :
+// one per core). `maxLevels`, if not 0, stops the chain short ; it never
+// goes past MIP_MAX_LEVELS, so an image bigger than 32768 stops above 1x1.
+void buildMipChain(const unsigned char * pixels, unsigned int width, unsigned int height, unsigned int channels, ptrdiff_t stride, bool srgb,
+	MipChain & chain, MipFilter filter = MIP_BOX, unsigned int threads = 0, unsigned int maxLevels = 0) {
+	chain.width = width;
+	chain.height = height;
+	chain.channels = channels;
+	if (maxLevels == 0 || maxLevels > MIP_MAX_LEVELS) maxLevels = MIP_MAX_LEVELS;
+	chain.levels = 1;
+	while ((width | height) >> chain.levels && chain.levels != maxLevels) chain.levels++;
+	chain.offset[0] = chain.offset[1] = 0;
+	for (unsigned int level = 1; level < chain.levels; level++)
+		chain.offset[level + 1] = chain.offset[level] + (size_t)chain.levelWidth(level) * chain.levelHeight(level) * channels;
+	chain.pixels.resize(chain.offset[chain.levels]);
+	if (threads == 0) threads = defaultThreadCount();
+	mipTables(); // made before the threads need them
+
+	MipTaps columns, rows;
+	for (unsigned int level = 1; level < chain.levels; level++) {
+		unsigned int sw = chain.levelWidth(level - 1), sh = chain.levelHeight(level - 1);
+		unsigned int tw = chain.levelWidth(level), th = chain.levelHeight(level);
+		mipMakeTaps(sw, tw, filter, columns);
+		mipMakeTaps(sh, th, filter, rows);
+
+		MipJob job;
+		job.source = level == 1 ? pixels : chain.level(level - 1);
+		job.sourceWidth = sw;
+		job.sourceHeight = sh;
+		job.sourceStride = level == 1 && stride ? stride : (ptrdiff_t)sw * channels;
+		job.target = &chain.pixels[chain.offset[level]];
+		job.targetWidth = tw;
+		job.channels = channels;
+		job.srgb = srgb;
+		job.columns = &columns;
+		job.rows = &rows;
+
+		// Not worth a thread under 64K target pixels.
+		unsigned int n = threads;
+		if ((size_t)tw * th / n < 65536) n = (unsigned int)((size_t)tw * th / 65536) + 1;
+		if (n > th) n = th;
+		std::vector<MipJob> jobs(n, job);
+		for (unsigned int i = 0; i < n; i++) {
+			jobs[i].firstRow = (unsigned int)((uint64_t)th * i / n);
+			jobs[i].endRow = (unsigned int)((uint64_t)th * (i + 1) / n);
+		}
+		runChunks(jobs, mipRunJob);
+	}
+}
+
+// Uploads levels 1 and up of `chain` to the texture bound to `target`,
+// which has level 0 already, one glTexImage2D each.
+void uploadMipChain(GLenum target, const MipChain & chain, GLint internalFormat, GLenum format) {
+	GLint alignment;
+	glGetIntegerv(GL_UNPACK_ALIGNMENT, &alignment);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	for (unsigned int level = 1; level < chain.levels; level++)
+		glTexImage2D(target, level, internalFormat, chain.levelWidth(level), chain.levelHeight(level), 0, format, GL_UNSIGNED_BYTE, chain.level(level));
+	glPixelStorei(GL_UNPACK_ALIGNMENT, alignment);
+	glTexParameteri(target, GL_TEXTURE_MAX_LEVEL, chain.levels - 1);
+}
+
+#endif
@@ -0,0 +1,251 @@
+#ifndef PPMDECODE_HPP
+#define PPMDECODE_HPP
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <vector>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define PPM_DECODE_X86 // SSSE3 version, picked at run time
+#endif
+#if defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define PPM_DECODE_NEON
+#endif
+
+// Netpbm images decoded from memory, the whole file at once (a mapping,
+// see mappedfile.hpp) : P3 (ASCII), P5 (grey) and P6 (RGB) with any
+// maximum value, 16-bit samples included, and P7 (PAM) of depth 1 to 4
+// (GRAYSCALE, GRAYSCALE_ALPHA, RGB, RGB_ALPHA). Pixels come out as 4
+// bytes, in whatever order the caller asks : R, G, B, A for GL_RGBA, or
+// the byte order of PACK_COLOR24 for load_ppm. Samples are scaled to 0 ..
+// 255, grey is copied to R, G and B, and alpha is 255 if there is none.
+//
+// 8-bit samples with a maximum of 255, which is nearly every file, go
+// through a byte shuffle (SSSE3, NEON), 4 pixels at a time, straight from
+// the file ; others are scaled to that, a row at a time, through a table.
+
+struct PPMHeader {
+	unsigned int width, height;
+	unsigned int channels;     // 1 grey, 2 grey + alpha, 3 RGB, 4 RGBA
+	unsigned int maxval;       // 1 .. 65535 ; over 255, samples are 2 bytes, big-endian
+	bool ascii;                // P3 : decimal samples
+	size_t dataOffset;         // of the first sample
+};
+
+// Converts `count` pixels of 8-bit samples (`channels` of them each, as
+// in PPMHeader) to 4 bytes each, channel c (R, G, B, A) going to byte
+// order[c] of the pixel.
+typedef void (*PPMRow)(const unsigned char * in, unsigned int channels, unsigned int count, const unsigned char order[4], unsigned char * out);
+
+// Skips whitespace and comments, then reads a decimal number. False at
+// the end of the data or if there is no number there.
+inline bool ppmReadNumber(const unsigned char * data, size_t size, size_t & pos, unsigned int & value) {
+	for (;;) {
+		while (pos < size && (data[pos] == ' ' || data[pos] == '\t' || data[pos] == '\n' || data[pos] == '\r' || data[pos] == '\v' || data[pos] == '\f')) pos++;
+		if (pos < size && data[pos] == '#') {
+			while (pos < size && data[pos] != '\n' && data[pos] != '\r') pos++;
+			continue;
+		}
+		break;
+	}
+	if (pos >= size || data[pos] < '0' || data[pos] > '9') return false;
+	uint64_t v = 0;
+	while (pos < size && data[pos] >= '0' && data[pos] <= '9' && v <= 0xffffffffu) v = v * 10 + (data[pos++] - '0');
+	if (v > 0xffffffffu) return false;
+	value = (unsigned int)v;
+	return true;
+}
+
+// The PAM header, "P7\n" up to "ENDHDR\n".
+inline bool ppmReadPAMHeader(const unsigned char * data, size_t size, PPMHeader & header) {
+	size_t pos = 3;
+	unsigned int depth = 0;
+	header.width = header.height = header.maxval = 0;
+	for (;;) {
+		while (pos < size && (data[pos] == ' ' || data[pos] == '\t' || data[pos] == '\n' || data[pos] == '\r')) pos++;
+		size_t start = pos;
+		while (pos < size && data[pos] != ' ' && data[pos] != '\t' && data[pos] != '\n' && data[pos] != '\r') pos++;
+		size_t length = pos - start;
+		const char * word = (const char *)data + start;
+		if (length == 0) {
+			fprintf(stderr, "PAM header without ENDHDR\n");
+			return false;
+		}
+		if (word[0] == '#' || (length == 8 && memcmp(word, "TUPLTYPE", 8) == 0)) {
+			// The depth says all this code needs of the tuple type.
+			while (pos < size && data[pos] != '\n') pos++;
+		} else if (length == 6 && memcmp(word, "ENDHDR", 6) == 0) {
+			while (pos < size && data[pos] != '\n') pos++;
+			header.dataOffset = pos + 1;
+			break;
+		} else {
+			unsigned int * field = NULL;
+			if (length == 5 && memcmp(word, "WIDTH", 5) == 0) field = &header.width;
+			else if (length == 6 && memcmp(word, "HEIGHT", 6) == 0) field = &header.height;
+			else if (length == 5 && memcmp(word, "DEPTH", 5) == 0) field = &depth;
+			else if (length == 6 && memcmp(word, "MAXVAL", 6) == 0) field = &header.maxval;
+			if (!field || !ppmReadNumber(data, size, pos, *field)) {
+				fprintf(stderr, "invalid PAM header line : %.*s\n", (int)length, word);
+				return false;
+			}
+		}
+	}
+	if (depth < 1 || depth > 4) {
+		fprintf(stderr, "unsupported PAM depth : %u\n", depth);
+		return false;
+	}
+	header.channels = depth;
+	return true;
+}
+
+// Reads and checks the header, P3, P5, P6 or P7.
+bool ppmReadHeader(const unsigned char * data, size_t size, PPMHeader & header) {
+	if (size < 3 || data[0] != 'P' || (data[1] != '3' && data[1] != '5' && data[1] != '6' && data[1] != '7')) {
+		fprintf(stderr, "not a P3, P5, P6 or P7 file\n");
+		return false;
+	}
+	header.ascii = data[1] == '3';
+	if (data[1] == '7') {
+		if (!ppmReadPAMHeader(data, size, header)) return false;
+	} else {
+		size_t pos = 2;
+		header.channels = data[1] == '5' ? 1 : 3;
+		if (!ppmReadNumber(data, size, pos, header.width) || !ppmReadNumber(data, size, pos, header.height) || !ppmReadNumber(data, size, pos, header.maxval)) {
+			fprintf(stderr, "invalid PPM header\n");
+			return false;
+		}
+		header.dataOffset = pos + 1; // one whitespace character after the maximum
+	}
+	if (header.width == 0 || header.height == 0 || header.width > 65535 || header.height > 65535) {
+		fprintf(stderr, "invalid image size : %u x %u\n", header.width, header.height);
+		return false;
+	}
+	if (header.maxval == 0 || header.maxval > 65535) {
+		fprintf(stderr, "invalid maximum value : %u\n", header.maxval);
+		return false;
+	}
+	if (!header.ascii) {
+		size_t needed = (size_t)header.width * header.height * header.channels * (header.maxval > 255 ? 2 : 1);
+		if (header.dataOffset > size || size - header.dataOffset < needed) {
+			fprintf(stderr, "truncated pixel data : %lu bytes for %lu\n", (unsigned long)(size - (header.dataOffset < size ? header.dataOffset : size)), (unsigned long)needed);
+			return false;
+		}
+	}
+	return true;
+}
+
+// Which input channel makes output channel c (R, G, B, A), -1 for none.
+inline int ppmSource(unsigned int channels, int c) {
+	if (c < 3) return channels < 3 ? 0 : c;
+	return channels == 2 ? 1 : channels == 4 ? 3 : -1;
+}
+
+void ppmRowScalar(const unsigned char * in, unsigned int channels, unsigned int count, const unsigned char order[4], unsigned char * out) {
+	int source[4];
+	for (int c = 0; c < 4; c++) source[c] = ppmSource(channels, c);
+	for (unsigned int x = 0; x < count; x++, in += channels, out += 4) {
+		out[order[0]] = in[source[0]];
+		out[order[1]] = in[source[1]];
+		out[order[2]] = in[source[2]];
+		out[order[3]] = source[3] < 0 ? 255 : in[source[3]];
+	}
+}
+
+#if defined(PPM_DECODE_X86) || defined(PPM_DECODE_NEON)
+// The byte shuffle that takes 4 pixels of `channels` to 4 bytes each, and
+// the bytes to set to 255 after it (alpha, when there is none).
+inline void ppmShuffle(unsigned int channels, const unsigned char order[4], unsigned char shuffle[16], unsigned char fill[16]) {
+	for (int p = 0; p < 4; p++) {
+		for (int c = 0; c < 4; c++) {
+			int source = ppmSource(channels, c);
+			shuffle[4 * p + order[c]] = source < 0 ? 0x80 : (unsigned char)(p * channels + source);
+			fill[4 * p + order[c]] = source < 0 ? 0xff : 0;
+		}
+	}
+}
+#endif
+
+#ifdef PPM_DECODE_X86
+__attribute__((target("ssse3")))
+void ppmRowSSSE3(const unsigned char * in, unsigned int channels, unsigned int count, const unsigned char order[4], unsigned char * out) {
+	unsigned char shuffleBytes[16], fillBytes[16];
+	ppmShuffle(channels, order, shuffleBytes, fillBytes);
+	__m128i shuffle = _mm_loadu_si128((const __m128i *)shuffleBytes), fill = _mm_loadu_si128((const __m128i *)fillBytes);
+	unsigned int x = 0;
+	// Each step reads 16 bytes for the 4 * channels it uses.
+	for (; (size_t)(count - x) * channels >= 16; x += 4, in += 4 * channels, out += 16) {
+		__m128i v = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)in), shuffle);
+		_mm_storeu_si128((__m128i *)out, _mm_or_si128(v, fill));
+	}
+	ppmRowScalar(in, channels, count - x, order, out);
+}
+#endif
+
+#ifdef PPM_DECODE_NEON
+void ppmRowNEON(const unsigned char * in, unsigned int channels, unsigned int count, const unsigned char order[4], unsigned char * out) {
+	unsigned char shuffleBytes[16], fillBytes[16];
+	ppmShuffle(channels, order, shuffleBytes, fillBytes);
+	uint8x16_t shuffle = vld1q_u8(shuffleBytes), fill = vld1q_u8(fillBytes);
+	unsigned int x = 0;
+	for (; (size_t)(count - x) * channels >= 16; x += 4, in += 4 * channels, out += 16)
+		vst1q_u8(out, vorrq_u8(vqtbl1q_u8(vld1q_u8(in), shuffle), fill));
+	ppmRowScalar(in, channels, count - x, order, out);
+}
+#endif
+
+inline PPMRow ppmBestRow() {
+#ifdef PPM_DECODE_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("ssse3")) return ppmRowSSSE3;
+#endif
+#ifdef PPM_DECODE_NEON
+	return ppmRowNEON;
+#endif
+	return ppmRowScalar;
+}
+
+// Decodes the pixels of `data`, whose header is `header`, to `out`
+// (width * height * 4 bytes, top row first, as in the file). `row` is the
+// 8-bit converter, NULL for the fastest.
+bool ppmDecode(const unsigned char * data, size_t size, const PPMHeader & header, const unsigned char order[4], unsigned char * out, PPMRow row = NULL) {
+	if (!row) row = ppmBestRow();
+	size_t rowSamples = (size_t)header.width * header.channels, rowPixels = (size_t)header.width * 4;
+	const unsigned char * in = data + header.dataOffset;
+	if (!header.ascii && header.maxval == 255) {
+		for (unsigned int y = 0; y < header.height; y++)
+			row(in + y * rowSamples, header.channels, header.width, order, out + y * rowPixels);
+		return true;
+	}
+
+	// Any other maximum, or ASCII : a row of samples scaled to 8 bits
+	// through a table, then converted as above.
+	std::vector<unsigned char> scale(header.maxval + 1), samples(rowSamples);
+	for (unsigned int v = 0; v <= header.maxval; v++) scale[v] = (unsigned char)((v * 255u + header.maxval / 2) / header.maxval);
+	size_t pos = header.dataOffset;
+	for (unsigned int y = 0; y < header.height; y++) {
+		if (header.ascii) {
+			for (size_t i = 0; i < rowSamples; i++) {
+				unsigned int v;
+				if (!ppmReadNumber(data, size, pos, v)) {
+					fprintf(stderr, "invalid or missing sample in row %u\n", y);
+					return false;
+				}
+				samples[i] = scale[v < header.maxval ? v : header.maxval];
+			}
+		} else if (header.maxval > 255) {
+			for (size_t i = 0; i < rowSamples; i++, in += 2) {
+				unsigned int v = in[0] << 8 | in[1];
+				samples[i] = scale[v < header.maxval ? v : header.maxval];
+			}
+		} else {
+			for (size_t i = 0; i < rowSamples; i++, in++) samples[i] = scale[*in < header.maxval ? *in : header.maxval];
+		}
+		row(&samples[0], header.channels, header.width, order, out + y * rowPixels);
+	}
+	return true;
+}
+
+#endif
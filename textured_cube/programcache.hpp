@@ -0,0 +1,212 @@
+#ifndef PROGRAMCACHE_HPP
+#define PROGRAMCACHE_HPP
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <dirent.h>
+#include <utime.h>
+
+#include <GL/glew.h>
+
+#include "mappedfile.hpp"
+
+// Linked programs kept on disk, as glGetProgramBinary gives them, so that
+// the next run loads them with glProgramBinary instead of compiling and
+// linking the GLSL again.
+//
+// A binary is only good for the driver that made it, so the key of a
+// program is a hash of its sources, the defines they were compiled with,
+// and the GL vendor, renderer, version and GLSL version strings : a new
+// driver, or an edited shader, simply misses. A driver may still refuse a
+// binary it made (after an update that keeps its version string, say) ;
+// the file is then deleted and the program compiled as if it had never
+// been there.
+//
+// Each program is one file in PROGRAM_CACHE_DIR, named after its key : the
+// header below and the binary. Files are written through a temporary one,
+// so that a reader never sees half a binary. A file loaded is touched, and
+// each write keeps the PROGRAM_CACHE_MAX_FILES most recently used : every
+// save of a shader being edited makes a new key, whose files would
+// otherwise pile up. Deleting the directory empties the cache.
+
+#ifndef PROGRAM_CACHE_DIR
+#define PROGRAM_CACHE_DIR "shadercache"
+#endif
+
+#ifndef PROGRAM_CACHE_MAX_FILES
+#define PROGRAM_CACHE_MAX_FILES 256
+#endif
+
+#define PROGRAM_CACHE_MAGIC   0x4D475250 // "PRGM"
+#define PROGRAM_CACHE_VERSION 1
+
+struct ProgramCacheHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint64_t key;          // programCacheKey, to tell a collision of names
+	uint32_t binaryFormat; // from glGetProgramBinary
+	uint32_t binarySize;   // bytes after the header
+};
+
+struct ProgramCacheStats {
+	unsigned long hits;     // loaded with glProgramBinary
+	unsigned long misses;   // no file : compiled
+	unsigned long rejected; // file there, refused by the driver : compiled
+	unsigned long written;
+	unsigned long evicted;  // deleted to stay within PROGRAM_CACHE_MAX_FILES
+};
+
+inline ProgramCacheStats & programCacheStats() {
+	static ProgramCacheStats stats = { 0, 0, 0, 0, 0 };
+	return stats;
+}
+
+// FNV-1a, 64-bit, carried on from `h`.
+inline uint64_t programHash(const void * data, size_t size, uint64_t h = 0xcbf29ce484222325ULL) {
+	const unsigned char * p = (const unsigned char *)data;
+	for (size_t i = 0; i < size; i++) h = (h ^ p[i]) * 0x100000001b3ULL;
+	return h;
+}
+
+inline uint64_t programHashString(const char * s, uint64_t h) {
+	// The terminating 0 goes in too, so that "ab" "c" and "a" "bc" differ.
+	return s ? programHash(s, strlen(s) + 1, h) : programHash("", 1, h);
+}
+
+// The key of a program linked from `count` shader sources with `defines`
+// (NULL for none) by the driver of the current context.
+uint64_t programCacheKey(const char * const * sources, size_t count, const char * defines) {
+	uint64_t h = programHashString((const char *)glGetString(GL_VENDOR), 0xcbf29ce484222325ULL);
+	h = programHashString((const char *)glGetString(GL_RENDERER), h);
+	h = programHashString((const char *)glGetString(GL_VERSION), h);
+	h = programHashString((const char *)glGetString(GL_SHADING_LANGUAGE_VERSION), h);
+	h = programHashString(defines, h);
+	for (size_t i = 0; i < count; i++) h = programHashString(sources[i], h);
+	return h;
+}
+
+// Whether the driver can give binaries back at all : the extension alone
+// isn't enough, some drivers list it with no binary format.
+bool programBinarySupported() {
+	if (!GLEW_ARB_get_program_binary) return false;
+	GLint formats = 0;
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+	return formats > 0;
+}
+
+std::string programCachePath(uint64_t key) {
+	char name[32];
+	snprintf(name, sizeof name, "/%016llx.bin", (unsigned long long)key);
+	return std::string(PROGRAM_CACHE_DIR) + name;
+}
+
+// The program of `key` from the cache, linked and ready ; 0 if it isn't
+// there or the driver won't take it.
+GLuint loadProgramBinary(uint64_t key) {
+	std::string path = programCachePath(key);
+	MappedFile file;
+	if (!mapFile(path.c_str(), file)) {
+		programCacheStats().misses++;
+		return 0;
+	}
+	const ProgramCacheHeader * header = (const ProgramCacheHeader *)file.data;
+	bool ok = file.size >= sizeof(ProgramCacheHeader) &&
+		header->magic == PROGRAM_CACHE_MAGIC && header->version == PROGRAM_CACHE_VERSION &&
+		header->key == key && header->binarySize == file.size - sizeof(ProgramCacheHeader);
+	GLuint program = 0;
+	if (ok) {
+		program = glCreateProgram();
+		glProgramBinary(program, header->binaryFormat, file.data + sizeof(ProgramCacheHeader), header->binarySize);
+		GLint linked = GL_FALSE;
+		glGetProgramiv(program, GL_LINK_STATUS, &linked);
+		if (!linked) {
+			glDeleteProgram(program);
+			program = 0;
+		}
+	}
+	unmapFile(file);
+	if (!program) {
+		printf("%s : cached program refused, compiling it again\n", path.c_str());
+		remove(path.c_str());
+		programCacheStats().rejected++;
+		return 0;
+	}
+	// Recently used, for pruneProgramCache.
+	utime(path.c_str(), NULL);
+	programCacheStats().hits++;
+	return program;
+}
+
+// Deletes the least recently used files of the cache beyond `keep`.
+void pruneProgramCache(size_t keep = PROGRAM_CACHE_MAX_FILES) {
+	DIR * dir = opendir(PROGRAM_CACHE_DIR);
+	if (!dir) return;
+	std::vector<std::pair<double, std::string> > files;
+	for (struct dirent * d; (d = readdir(dir));) {
+		size_t n = strlen(d->d_name);
+		if (n < 4 || strcmp(d->d_name + n - 4, ".bin") != 0) continue;
+		std::string path = std::string(PROGRAM_CACHE_DIR) + "/" + d->d_name;
+		struct stat st;
+		if (stat(path.c_str(), &st) != 0) continue;
+#ifdef __APPLE__
+		files.push_back(std::make_pair(st.st_mtimespec.tv_sec + st.st_mtimespec.tv_nsec * 1e-9, path));
+#else
+		files.push_back(std::make_pair(st.st_mtim.tv_sec + st.st_mtim.tv_nsec * 1e-9, path));
+#endif
+	}
+	closedir(dir);
+	if (files.size() <= keep) return;
+	std::sort(files.begin(), files.end());
+	for (size_t i = 0; i < files.size() - keep; i++)
+		if (remove(files[i].second.c_str()) == 0) programCacheStats().evicted++;
+}
+
+// Writes the binary of `program`, linked with
+// GL_PROGRAM_BINARY_RETRIEVABLE_HINT set, under `key`.
+bool saveProgramBinary(GLuint program, uint64_t key) {
+	GLint size = 0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &size);
+	if (size <= 0) return false;
+	std::vector<char> image(sizeof(ProgramCacheHeader) + size);
+	ProgramCacheHeader header;
+	memset(&header, 0, sizeof header);
+	GLenum format = 0;
+	GLsizei written = 0;
+	glGetProgramBinary(program, size, &written, &format, &image[sizeof header]);
+	if (written <= 0) return false;
+	header.magic = PROGRAM_CACHE_MAGIC;
+	header.version = PROGRAM_CACHE_VERSION;
+	header.key = key;
+	header.binaryFormat = format;
+	header.binarySize = (uint32_t)written;
+	memcpy(&image[0], &header, sizeof header);
+	image.resize(sizeof header + written);
+
+	mkdir(PROGRAM_CACHE_DIR, 0755);
+	std::string path = programCachePath(key), temppath = path + ".tmp";
+	FILE * fp = fopen(temppath.c_str(), "wb");
+	if (!fp) return false;
+	bool ok = fwrite(&image[0], 1, image.size(), fp) == image.size();
+	ok = fclose(fp) == 0 && ok;
+	if (!ok || rename(temppath.c_str(), path.c_str()) != 0) {
+		remove(temppath.c_str());
+		return false;
+	}
+	programCacheStats().written++;
+	pruneProgramCache();
+	return true;
+}
+
+void printProgramCacheStats() {
+	const ProgramCacheStats & s = programCacheStats();
+	printf("Program cache : %lu loaded, %lu compiled (%lu refused by the driver), %lu written, %lu evicted\n",
+		s.hits, s.misses + s.rejected, s.rejected, s.written, s.evicted);
+}
+
+#endif
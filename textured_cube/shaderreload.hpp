@@ -0,0 +1,286 @@
+#ifndef SHADERRELOAD_HPP
+#define SHADERRELOAD_HPP
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/inotify.h>
+#endif
+
+#include <GL/glew.h>
+
+#include "programbatch.hpp"
+
+// Programs rebuilt while the program runs, when their shader files are
+// saved.
+//
+// watch() takes the program handle the render loop draws with, and the
+// uniform locations it keeps, and update(), called between frames, does the
+// rest : the programs of the files that changed since the last frame,
+// files the shaders #include too (inotify on Linux, their modification
+// times elsewhere), are compiled again in a ProgramBatch, which doesn't
+// block when the driver compiles in parallel, and once the new program is
+// linked the handle and the locations are swapped for the new ones, all in
+// the same update(), and the old program deleted. A shader that doesn't
+// compile leaves the program that was there.
+//
+// inotify watches the directories, not the files : most editors save by
+// writing another file and renaming it over the old one, which a watch on
+// the file itself would lose.
+//
+// presented(), after glfwSwapBuffers, gives how long it took from the save
+// to the first frame drawn with the new program. The time of the save is
+// the modification time of the file, which the kernel only keeps to a few
+// milliseconds.
+
+inline double shaderClock() {
+	struct timespec ts;
+	clock_gettime(CLOCK_REALTIME, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+struct ShaderReloadStats {
+	unsigned long reloads;  // programs swapped
+	unsigned long failures; // edits that didn't compile or link
+	// The last reload, in seconds after the save : when it was noticed, when
+	// the new program was swapped in, when the first frame with it was done.
+	double noticed, swapped, presented;
+};
+
+class ShaderReloader {
+public:
+	ShaderReloader() : fd(-1), saved(0), noticed(0), swapped(0) {
+		memset(&counts, 0, sizeof counts);
+#ifdef __linux__
+		fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+		if (fd < 0) printf("inotify : %s, looking at modification times instead\n", strerror(errno));
+#endif
+	}
+
+	~ShaderReloader() { stop(); }
+
+	// Stops watching, and drops the programs still compiling ; the ones in
+	// use stay with whoever owns them. Before the context goes.
+	void stop() {
+		for (size_t r = 0; r < pending.size(); r++) {
+			pending[r].batch->finish();
+			for (size_t i = 0; i < pending[r].batch->size(); i++) glDeleteProgram(pending[r].batch->program(i));
+			delete pending[r].batch;
+		}
+		pending.clear();
+		files.clear();
+		programs.clear();
+#ifdef __linux__
+		if (fd >= 0) close(fd);
+		fd = -1;
+#endif
+	}
+
+	// Rebuilds *program, which LoadShaders made from these two files with
+	// `defines`, whenever one of them changes. Returns its index, for
+	// uniform().
+	size_t watch(GLuint * program, const char * vertex_file_path, const char * fragment_file_path, const char * defines = NULL) {
+		Program p;
+		p.handle = program;
+		p.vertexFile = addFile(vertex_file_path);
+		p.fragmentFile = addFile(fragment_file_path);
+		p.defines = defines ? defines : "";
+		// What they include too.
+		ShaderSource vertexSource, fragmentSource;
+		std::vector<std::string> included;
+		if (preprocessShader(vertex_file_path, defines, vertexSource)) included = vertexSource.files;
+		if (preprocessShader(fragment_file_path, defines, fragmentSource)) included.insert(included.end(), fragmentSource.files.begin(), fragmentSource.files.end());
+		setFiles(p, included);
+		programs.push_back(p);
+		return programs.size() - 1;
+	}
+
+	// Sets *location to the location of `name` in program i, now and after
+	// every reload.
+	void uniform(size_t i, const char * name, GLint * location) {
+		Uniform u;
+		u.name = name;
+		u.location = location;
+		programs[i].uniforms.push_back(u);
+		*location = glGetUniformLocation(*programs[i].handle, name);
+	}
+
+	// The tutorials keep their locations in a GLuint : same bits, -1 is
+	// 0xFFFFFFFF either way.
+	void uniform(size_t i, const char * name, GLuint * location) { uniform(i, name, (GLint *)location); }
+
+	// Between frames : starts compiling what changed since the last call, and
+	// swaps in whatever is done. Returns how many programs were swapped ;
+	// the caller binds them again and sets the uniforms it only sets once.
+	size_t update() {
+		std::vector<bool> dirty(files.size(), false);
+		bool any = false;
+#ifdef __linux__
+		if (fd >= 0) {
+			union {
+				struct inotify_event event;
+				char bytes[4096];
+			} buffer;
+			ssize_t n;
+			while ((n = read(fd, buffer.bytes, sizeof buffer.bytes)) > 0) {
+				for (char * p = buffer.bytes; p < buffer.bytes + n;) {
+					const struct inotify_event * e = (const struct inotify_event *)p;
+					if (e->len)
+						for (size_t f = 0; f < files.size(); f++)
+							if (files[f].watch == e->wd && files[f].name == e->name) any = dirty[f] = true;
+					p += sizeof(struct inotify_event) + e->len;
+				}
+			}
+		} else
+#endif
+		for (size_t f = 0; f < files.size(); f++) {
+			double t = shaderFileTime(files[f].path.c_str());
+			if (t != files[f].modified) any = dirty[f] = true;
+		}
+		if (any) submit(dirty);
+
+		// In order, so that the last edit of a program wins.
+		size_t count = 0;
+		while (!pending.empty() && pending[0].batch->poll() == 0) {
+			Reload & r = pending[0];
+			size_t done = 0;
+			for (size_t i = 0; i < r.programs.size(); i++) {
+				Program & p = programs[r.programs[i]];
+				// An edit may include other files.
+				std::vector<std::string> included = r.batch->files(i);
+				if (!included.empty()) setFiles(p, included);
+				if (r.batch->state(i) != PROGRAM_READY) {
+					printf("%s, %s : keeping the program that was there\n", files[p.vertexFile].path.c_str(), files[p.fragmentFile].path.c_str());
+					counts.failures++;
+					continue;
+				}
+				GLuint old = *p.handle;
+				*p.handle = r.batch->program(i);
+				for (size_t u = 0; u < p.uniforms.size(); u++)
+					*p.uniforms[u].location = glGetUniformLocation(*p.handle, p.uniforms[u].name.c_str());
+				glDeleteProgram(old);
+				counts.reloads++;
+				done++;
+			}
+			count += done;
+			if (done && (!saved || r.saved < saved)) {
+				saved = r.saved;
+				noticed = r.noticed;
+				swapped = shaderClock();
+			}
+			delete r.batch;
+			pending.erase(pending.begin());
+		}
+		return count;
+	}
+
+	// After glfwSwapBuffers : if this frame was the first with a reloaded
+	// program, prints how long it took from the save.
+	void presented() {
+		if (!saved) return;
+		counts.noticed = noticed - saved;
+		counts.swapped = swapped - saved;
+		counts.presented = shaderClock() - saved;
+		saved = 0;
+		printf("Shader reload : first frame %.1f ms after the save (noticed after %.1f ms, swapped after %.1f ms)\n",
+			counts.presented * 1e3, counts.noticed * 1e3, counts.swapped * 1e3);
+	}
+
+	const ShaderReloadStats & stats() const { return counts; }
+
+private:
+	struct File {
+		std::string path, name; // name : the part after the directory
+		int watch;
+		double modified;
+	};
+
+	struct Uniform {
+		std::string name;
+		GLint * location;
+	};
+
+	struct Program {
+		GLuint * handle;
+		size_t vertexFile, fragmentFile;
+		std::vector<size_t> files; // both, and every file they include
+		std::string defines;
+		std::vector<Uniform> uniforms;
+	};
+
+	// Programs compiling together, from the edits one update() noticed.
+	struct Reload {
+		ProgramBatch * batch;
+		std::vector<size_t> programs;
+		double saved, noticed;
+	};
+
+	size_t addFile(const char * path) {
+		for (size_t f = 0; f < files.size(); f++)
+			if (files[f].path == path) return f;
+		File file;
+		file.path = path;
+		file.watch = -1;
+		file.modified = shaderFileTime(path);
+		size_t slash = file.path.rfind('/');
+		file.name = slash == std::string::npos ? file.path : file.path.substr(slash + 1);
+#ifdef __linux__
+		if (fd >= 0) {
+			std::string dir = slash == std::string::npos ? "." : slash == 0 ? "/" : file.path.substr(0, slash);
+			file.watch = inotify_add_watch(fd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+			if (file.watch < 0) printf("%s : can't watch %s : %s\n", path, dir.c_str(), strerror(errno));
+		}
+#endif
+		files.push_back(file);
+		return files.size() - 1;
+	}
+
+	void setFiles(Program & p, const std::vector<std::string> & paths) {
+		p.files.clear();
+		p.files.push_back(p.vertexFile);
+		p.files.push_back(p.fragmentFile);
+		for (size_t i = 0; i < paths.size(); i++) {
+			size_t f = addFile(paths[i].c_str());
+			if (std::find(p.files.begin(), p.files.end(), f) == p.files.end()) p.files.push_back(f);
+		}
+	}
+
+	void submit(const std::vector<bool> & dirty) {
+		Reload r;
+		r.batch = NULL;
+		r.saved = 0;
+		r.noticed = shaderClock();
+		for (size_t f = 0; f < files.size(); f++) {
+			if (!dirty[f]) continue;
+			files[f].modified = shaderFileTime(files[f].path.c_str());
+			if (files[f].modified > r.saved) r.saved = files[f].modified;
+		}
+		for (size_t i = 0; i < programs.size(); i++) {
+			const Program & p = programs[i];
+			bool changed = false;
+			for (size_t f = 0; f < p.files.size(); f++) changed = changed || dirty[p.files[f]];
+			if (!changed) continue;
+			// Half-written, or gone for a rename : the next event brings it back.
+			if (!files[p.vertexFile].modified || !files[p.fragmentFile].modified) continue;
+			if (!r.batch) r.batch = new ProgramBatch;
+			r.batch->add(files[p.vertexFile].path.c_str(), files[p.fragmentFile].path.c_str(), p.defines.empty() ? NULL : p.defines.c_str());
+			r.programs.push_back(i);
+		}
+		if (r.batch) pending.push_back(r);
+	}
+
+	int fd;
+	std::vector<File> files;
+	std::vector<Program> programs;
+	std::vector<Reload> pending;
+	double saved, noticed, swapped; // of the reload the next frame is the first with
+	ShaderReloadStats counts;
+};
+
+#endif